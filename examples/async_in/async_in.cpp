@@ -3,6 +3,9 @@
  * USB host controller is busy, and that it will retrieve data from the endpoint
  * as fast as possible for an indefinite period of time.
  *
+ * On Linux, the pipe starts with a few small transfers and tunes their number
+ * and size while it runs, within the limits below.
+ *
  * This example is designed to connect to Test Device A and read ADC data from
  * endpoint 0x82. */
 
@@ -20,8 +23,20 @@ const uint16_t product_id = 0xDA01;
 const uint8_t interface_number = 0;
 const bool composite = true;
 const uint8_t endpoint_address = 0x82;
-const size_t transfer_size = 5;
+const size_t sample_size = 5;
+const size_t transfer_size = sample_size;
 const size_t transfer_count = 250;
+#ifdef __linux__
+const libusbp_async_in_tuning tuning = {
+    16, transfer_count,             // transfer count limits
+    sample_size, sample_size * 64,  // transfer size limits
+    0,                              // no memory limit beyond the ones above
+    20,                             // target latency in milliseconds
+};
+const size_t buffer_size = sample_size * 64;
+#else
+const size_t buffer_size = transfer_size;
+#endif
 
 // Prints the data in the given buffer to the standard output in HEX.
 void print_data(uint8_t * buffer, size_t size)
@@ -47,23 +62,36 @@ int main_with_exceptions()
     libusbp::generic_interface gi(device, interface_number, composite);
     libusbp::generic_handle handle(gi);
     libusbp::async_in_pipe pipe = handle.open_async_in_pipe(endpoint_address);
+    #ifdef __linux__
+    pipe.allocate_transfers(tuning.min_transfer_count, transfer_size);
+    pipe.enable_auto_tuning(&tuning);
+    #else
     pipe.allocate_transfers(transfer_count, transfer_size);
+    #endif
 
     pipe.start_endless_transfers();
 
     while(true)
     {
-        uint8_t buffer[transfer_size];
+        uint8_t buffer[buffer_size];
         size_t transferred;
         libusbp::error transfer_error;
         while(pipe.handle_finished_transfer(buffer, &transferred, &transfer_error))
         {
             if (transfer_error) { throw transfer_error; }
-            print_data(buffer, transferred);
+            for (size_t i = 0; i + sample_size <= transferred; i += sample_size)
+            {
+                print_data(buffer + i, sample_size);
+            }
         }
 
+        #ifdef __linux__
+        // Sleep until the next transfer finishes.
+        pipe.wait(0);
+        #else
         pipe.handle_events();
         usleep(500);
+        #endif
     }
 
     // Note that closing an async_in_pipe cleanly without causing memory leaks
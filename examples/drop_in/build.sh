@@ -34,5 +34,5 @@ cp ../lsusb/lsusb.cpp $SRC/../include/libusbp.h* .
 # TODO: fix the library so we don't need -fpermissive here
 
 g++ -std=gnu++11 -Wall -fpermissive -g -O2 -I. \
-    -DLIBUSBP_DROP_IN -DLIBUSBP_STATIC \
-    lsusb.cpp libusbp.c -ludev -o lsusb
+    -DLIBUSBP_DROP_IN -DLIBUSBP_STATIC -DLIBUSBP_USE_UDEV \
+    lsusb.cpp libusbp.c -ludev -pthread -o lsusb
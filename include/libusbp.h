@@ -109,6 +109,11 @@ enum libusbp_error_code
     /*! The error might have been caused by the transfer getting cancelled from
      * the host side.  Some data might have been transferred anyway. */
     LIBUSBP_ERROR_CANCELLED = 8,
+
+    /*! The device ended an IN transfer with a short packet, and the transfer
+     * had the ::LIBUSBP_TRANSFER_SHORT_NOT_OK flag.  Some data might have been
+     * transferred anyway. */
+    LIBUSBP_ERROR_SHORT_PACKET = 9,
 };
 
 /*! Attempts to copy an error.  If you copy a NULL ::libusbp_error
@@ -141,6 +146,117 @@ LIBUSBP_API bool libusbp_error_has_code(const libusbp_error *, uint32_t code);
 LIBUSBP_API const char * libusbp_error_get_message(const libusbp_error *);
 
 
+#ifdef __linux__
+
+/** libusbp_iovec **************************************************************/
+
+/*! Describes one piece of a buffer that is scattered across memory, for use
+ * with libusbp_write_pipe_v(), libusbp_read_pipe_v(), and
+ * libusbp_async_in_pipe_handle_finished_transfer_v().  This has the same
+ * layout as struct iovec from sys/uio.h.  This type is only available on
+ * Linux. */
+typedef struct libusbp_iovec
+{
+    /*! A pointer to the first byte of this piece of the buffer. */
+    void * base;
+
+    /*! The number of bytes in this piece of the buffer. */
+    size_t size;
+} libusbp_iovec;
+
+
+/** transfer flags *************************************************************/
+
+/*! Flags that change how a transfer on a bulk endpoint behaves.  They can be
+ * set for every transfer on a pipe with libusbp_generic_handle_set_pipe_flags()
+ * or for a single transfer with functions such as
+ * libusbp_write_pipe_with_flags().  These flags are only available on
+ * Linux. */
+enum libusbp_transfer_flag
+{
+    /*! For OUT transfers: if the size of the transfer is a non-zero multiple
+     * of the endpoint's maximum packet size, send a zero-length packet after
+     * the data, so the device knows the transfer is done without waiting for
+     * more. */
+    LIBUSBP_TRANSFER_ZERO_PACKET = (1 << 0),
+
+    /*! For IN transfers: if the device sends a short packet before the buffer
+     * is full, report an error with the code ::LIBUSBP_ERROR_SHORT_PACKET.  The
+     * kernel then discards any queued transfers on the endpoint that have the
+     * ::LIBUSBP_TRANSFER_BULK_CONTINUATION flag. */
+    LIBUSBP_TRANSFER_SHORT_NOT_OK = (1 << 1),
+
+    /*! For IN transfers: the transfer continues the data of the previous one,
+     * so it is refused if the previous transfer ended early because of the
+     * ::LIBUSBP_TRANSFER_SHORT_NOT_OK flag.  A transfer without this flag
+     * allows transfers on the endpoint again. */
+    LIBUSBP_TRANSFER_BULK_CONTINUATION = (1 << 2),
+};
+
+
+/** transfer timestamps ********************************************************/
+
+/*! The clocks that can be used for the timestamps of asynchronous transfers.
+ * See libusbp_async_in_pipe_set_timestamp_clock().  These values are only
+ * available on Linux. */
+enum libusbp_clock
+{
+    /*! CLOCK_MONOTONIC, which is adjusted by NTP to run at the right rate.
+     * This is the default. */
+    LIBUSBP_CLOCK_MONOTONIC = 0,
+
+    /*! CLOCK_MONOTONIC_RAW, which is the raw hardware clock with no NTP
+     * adjustments. */
+    LIBUSBP_CLOCK_MONOTONIC_RAW = 1,
+};
+
+/*! The times when an asynchronous transfer was submitted to the kernel and
+ * when the library reaped it from the kernel after it completed.  Both are in
+ * nanoseconds, measured with the pipe's timestamp clock.  See
+ * libusbp_async_in_pipe_handle_finished_transfer_ex().  This type is only
+ * available on Linux. */
+typedef struct libusbp_transfer_times
+{
+    /*! The time when the transfer was submitted. */
+    uint64_t submit_time_ns;
+
+    /*! The time when the transfer was reaped. */
+    uint64_t complete_time_ns;
+} libusbp_transfer_times;
+
+
+/** libusbp_async_in_tuning ****************************************************/
+
+/*! Limits and goals for an asynchronous IN pipe that adjusts its transfers
+ * at runtime.  See libusbp_async_in_pipe_enable_auto_tuning().  This type is
+ * only available on Linux. */
+typedef struct libusbp_async_in_tuning
+{
+    /*! The smallest number of transfers to use.  Must not be zero. */
+    size_t min_transfer_count;
+
+    /*! The largest number of transfers to use. */
+    size_t max_transfer_count;
+
+    /*! The smallest transfer size to use, in bytes.  Must not be zero. */
+    size_t min_transfer_size;
+
+    /*! The largest transfer size to use, in bytes. */
+    size_t max_transfer_size;
+
+    /*! The most memory that the transfer buffers can use together, in bytes,
+     * or 0 for no limit other than the ones above. */
+    size_t max_memory;
+
+    /*! The longest time that data should wait in a transfer before the
+     * transfer is completed, in milliseconds.  If this is 0, the pipe aims for
+     * the highest throughput instead. */
+    uint32_t target_latency_ms;
+} libusbp_async_in_tuning;
+
+#endif
+
+
 /** libusbp_async_in_pipe ******************************************************/
 
 /*! A libusbp_async_in_pipe is an object that holds the memory and other data
@@ -188,6 +304,159 @@ libusbp_error * libusbp_async_in_pipe_allocate_transfers(
     size_t transfer_count,
     size_t transfer_size);
 
+#ifdef __linux__
+/*! Makes the pipe pass the data from its transfers through a lock-free queue
+ * that can hold @a queue_length finished transfers.  This must be called after
+ * libusbp_async_in_pipe_allocate_transfers() and before any transfers are
+ * started.
+ *
+ * With a completion queue, each transfer is submitted again as soon as the
+ * thread that handles its completion has copied its data into the queue,
+ * instead of waiting for libusbp_async_in_pipe_handle_finished_transfer().
+ * This is most useful together with
+ * libusbp_generic_handle_start_reaper_thread(), so that a slow consumer does
+ * not prevent the host from reading data from the device.  If the queue is
+ * full, finished transfers are held until there is room for their data.
+ *
+ * A pipe with a completion queue does not support
+ * libusbp_async_in_pipe_borrow_finished_transfer().  This function is only
+ * available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_in_pipe_enable_completion_queue(
+    libusbp_async_in_pipe *,
+    size_t queue_length);
+
+/*! Makes the pipe deliver its data as one continuous stream of bytes instead
+ * of one transfer at a time.  This must be called after
+ * libusbp_async_in_pipe_allocate_transfers() and before any transfers are
+ * started.
+ *
+ * The data goes into a ring buffer of at least @a buffer_size bytes, rounded
+ * up to a whole number of pages, which must be able to hold all of the
+ * transfers.  The ring is mapped into memory twice in a row, so the data that
+ * is ready can always be read as one contiguous span with
+ * libusbp_async_in_pipe_stream_peek(), even when it wraps around the end of the
+ * ring.  Each transfer is submitted with a pointer into the ring, so the kernel
+ * copies full transfers straight into place; data that follows a short
+ * transfer is moved back to close the gap.
+ *
+ * Like with a completion queue, transfers are submitted again by the thread
+ * that reaps them, which can be the handle's reaper thread.  Transfers wait if
+ * the ring does not have room for them, so the device is not read faster than
+ * you consume the data.  If a transfer fails, no more transfers are submitted,
+ * and the error is reported after the data before it.
+ *
+ * A pipe with a stream does not support
+ * libusbp_async_in_pipe_handle_finished_transfer() and the other functions
+ * that handle one transfer at a time, completion queues, or auto-tuning.  This
+ * function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_in_pipe_enable_stream(
+    libusbp_async_in_pipe *,
+    size_t buffer_size);
+
+/*! Gets all of the stream data that is ready to be read, as one contiguous
+ * span.  The data stays in the ring until you call
+ * libusbp_async_in_pipe_stream_consume(), so you can parse it in place and
+ * only consume the parts you are done with.
+ *
+ * If there is no data, the size is 0 and @a transfer_error receives the error
+ * of the failed transfer that comes next in the stream, if there is one.  The
+ * error must later be freed with libusbp_error_free().  This function is only
+ * available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_in_pipe_stream_peek(
+    libusbp_async_in_pipe *,
+    const uint8_t ** data,
+    size_t * size,
+    libusbp_error ** transfer_error);
+
+/*! Marks the first @a size bytes returned by
+ * libusbp_async_in_pipe_stream_peek() as read, so their place in the ring can
+ * be used for new data.  This function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_in_pipe_stream_consume(
+    libusbp_async_in_pipe *,
+    size_t size);
+
+/*! The type of function that receives finished transfers from an
+ * asynchronous IN pipe.  See libusbp_async_in_pipe_set_callback().
+ *
+ * @a data points to the data that was received, and is only valid until the
+ * callback returns.  @a transfer_error is NULL if the transfer succeeded;
+ * otherwise it describes why the transfer failed and is freed by the library
+ * after the callback returns.  @a times holds the transfer's timestamps (see
+ * libusbp_async_in_pipe_handle_finished_transfer_ex()).
+ *
+ * If the library fails to submit a transfer again, it calls the callback with
+ * NULL for @a data and @a times, 0 for @a transferred, and the submission
+ * error in @a transfer_error, and stops submitting transfers. */
+typedef void libusbp_async_in_callback(
+    void * context,
+    const uint8_t * data,
+    size_t transferred,
+    const libusbp_error * transfer_error,
+    const libusbp_transfer_times * times);
+
+/*! Makes the pipe pass each finished transfer to a callback and then submit
+ * the transfer again, instead of waiting for you to call
+ * libusbp_async_in_pipe_handle_finished_transfer().  This must be called
+ * after libusbp_async_in_pipe_allocate_transfers() and while no transfers are
+ * pending.  Pass NULL for @a callback to remove the callback.
+ *
+ * The callback runs on the thread that reaps the transfers: the thread
+ * calling libusbp_async_in_pipe_handle_events() or
+ * libusbp_async_in_pipe_wait(), or the handle's reaper thread if it has one.
+ * It should return quickly and must not call functions on the pipe or its
+ * generic handle.  @a context is passed to the callback unchanged.
+ *
+ * libusbp_async_in_pipe_start_endless_transfers() starts the transfers and
+ * libusbp_async_in_pipe_cancel_transfers() stops them.  This function is only
+ * available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_in_pipe_set_callback(
+    libusbp_async_in_pipe *,
+    libusbp_async_in_callback * callback,
+    void * context);
+
+/*! Makes the pipe adjust its transfer count and size while it is running,
+ * based on how the transfers are completing.  This must be called after
+ * libusbp_async_in_pipe_allocate_transfers(), and the count and size passed
+ * to that function must be within the limits in @a settings.  Pass NULL for
+ * @a settings to stop tuning; the pipe keeps its current transfers.
+ *
+ * The pipe looks at the transfers that pass through
+ * libusbp_async_in_pipe_handle_finished_transfer() and its variants.  It uses
+ * more transfers if the kernel ever runs out of submitted transfers, uses
+ * bigger transfers if the device fills them completely, and uses smaller
+ * transfers if they are mostly short or if filling one would take longer than
+ * the target latency.  Each new size is the original size multiplied or divided
+ * by a power of two.  To switch to new transfers, the pipe stops submitting
+ * transfers, waits for all of the pending ones to be handled, and then
+ * allocates new ones, so there is a short gap in the data from the device.
+ *
+ * Since the transfer size can change, the buffers you pass to
+ * libusbp_async_in_pipe_handle_finished_transfer() must be at least
+ * @a max_transfer_size bytes long.  Use
+ * libusbp_async_in_pipe_get_transfer_info() to see the current transfers.
+ *
+ * A pipe with a completion queue does not support tuning.  This function is
+ * only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_in_pipe_enable_auto_tuning(
+    libusbp_async_in_pipe *,
+    const libusbp_async_in_tuning * settings);
+
+/*! Gets the number and size of the transfers that the pipe is currently using.
+ * These only change after libusbp_async_in_pipe_allocate_transfers() or when
+ * auto-tuning is enabled.  This function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_in_pipe_get_transfer_info(
+    libusbp_async_in_pipe *,
+    size_t * transfer_count,
+    size_t * transfer_size);
+#endif
+
 /*! Starts reading data from the pipe. */
 LIBUSBP_API LIBUSBP_WARN_UNUSED
 libusbp_error * libusbp_async_in_pipe_start_endless_transfers(
@@ -199,6 +468,23 @@ libusbp_error * libusbp_async_in_pipe_start_endless_transfers(
 LIBUSBP_API LIBUSBP_WARN_UNUSED
 libusbp_error * libusbp_async_in_pipe_handle_events(libusbp_async_in_pipe *);
 
+#ifdef __linux__
+/*! Blocks until the next transfer that
+ * libusbp_async_in_pipe_handle_finished_transfer() would return has finished,
+ * or the timeout elapses.  Events are handled while waiting, so you do not
+ * need to call libusbp_async_in_pipe_handle_events() afterwards.  This
+ * function returns immediately if there are no pending transfers.
+ *
+ * The timeout is in milliseconds, and 0 means to wait forever.  This function
+ * does not report an error when the timeout elapses, so you should call
+ * libusbp_async_in_pipe_handle_finished_transfer() to see whether a transfer
+ * is actually ready.  This function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_in_pipe_wait(
+    libusbp_async_in_pipe *,
+    uint32_t timeout);
+#endif
+
 /*! Retrieves a boolean saying whether there are any pending
  * transfers.  A pending transfer is a transfer that was submitted to
  * the operating system, and it may have been completed, but it has
@@ -241,6 +527,89 @@ libusbp_async_in_pipe_handle_finished_transfer(
     size_t * transferred,
     libusbp_error ** transfer_error);
 
+#ifdef __linux__
+/*! Like libusbp_async_in_pipe_handle_finished_transfer(), except that the
+ * data is copied into the pieces of the buffer described by @a iov, in
+ * order.  The pieces must add up to at least the transfer size.  This
+ * function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED libusbp_error *
+libusbp_async_in_pipe_handle_finished_transfer_v(
+    libusbp_async_in_pipe *,
+    bool * finished,
+    const libusbp_iovec * iov,
+    size_t iov_count,
+    size_t * transferred,
+    libusbp_error ** transfer_error);
+
+/*! Like libusbp_async_in_pipe_handle_finished_transfer(), except that it also
+ * retrieves the times when the transfer was submitted and when it completed.
+ *
+ * The completion time is recorded when the library reaps the transfer from
+ * the kernel, either in libusbp_async_in_pipe_handle_events() (or one of the
+ * waiting functions) or in the handle's reaper thread if it is running, so it
+ * does not depend on when you call this function.  The difference between the
+ * two times includes the time the transfer spent waiting in the kernel's queue
+ * behind the transfers that were submitted before it.
+ *
+ * @param times An optional output pointer used to return the timestamps.  If
+ * no transfer was finished, both timestamps are set to 0.
+ *
+ * This function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED libusbp_error *
+libusbp_async_in_pipe_handle_finished_transfer_ex(
+    libusbp_async_in_pipe *,
+    bool * finished,
+    void * buffer,
+    size_t * transferred,
+    libusbp_transfer_times * times,
+    libusbp_error ** transfer_error);
+
+/*! Chooses the clock used for the timestamps returned by
+ * libusbp_async_in_pipe_handle_finished_transfer_ex().  The @a clock argument
+ * should be a value from ::libusbp_clock.  The new clock is used for
+ * timestamps recorded after this call, so you should normally call it before
+ * starting any transfers.  This function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED libusbp_error *
+libusbp_async_in_pipe_set_timestamp_clock(
+    libusbp_async_in_pipe *,
+    uint32_t clock);
+#endif
+
+/*! Like libusbp_async_in_pipe_handle_finished_transfer(), except that
+ * instead of copying the data into a buffer supplied by the caller, this
+ * function lends the finished transfer's own buffer to the caller.
+ *
+ * A borrowed transfer is no longer pending, but it will not be submitted again
+ * until you pass the data pointer to libusbp_async_in_pipe_release_transfer().
+ * If endless transfers are enabled, the other transfers keep being submitted
+ * while it is borrowed, so holding one transfer for a long time only reduces
+ * the number of transfers in flight by one.  The data pointer becomes invalid
+ * when the transfer is released or the pipe is closed.
+ *
+ * @param data An output pointer used to return a pointer to the data
+ * received by the transfer.  It is set to NULL if no transfer was finished.
+ *
+ * The other parameters are the same as the parameters of
+ * libusbp_async_in_pipe_handle_finished_transfer(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED libusbp_error *
+libusbp_async_in_pipe_borrow_finished_transfer(
+    libusbp_async_in_pipe *,
+    bool * finished,
+    const uint8_t ** data,
+    size_t * transferred,
+    libusbp_error ** transfer_error);
+
+/*! Gives a transfer that was borrowed with
+ * libusbp_async_in_pipe_borrow_finished_transfer() back to the pipe.  If
+ * endless transfers are enabled, the transfer will be submitted again.
+ *
+ * @param data The data pointer that was returned when the transfer was
+ * borrowed. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_in_pipe_release_transfer(
+    libusbp_async_in_pipe *,
+    const uint8_t * data);
+
 /*! Cancels all the transfers for this pipe.  The cancellation is
  * asynchronous, so it won't have an immediate effect.  If you want
  * to actually make sure that all the transfers get cancelled, you
@@ -251,6 +620,406 @@ libusbp_async_in_pipe_handle_finished_transfer(
 LIBUSBP_API LIBUSBP_WARN_UNUSED
 libusbp_error * libusbp_async_in_pipe_cancel_transfers(libusbp_async_in_pipe *);
 
+#ifdef __linux__
+/*! Cancels all the transfers for this pipe and waits until the kernel has
+ * given every one of them back, or until the timeout elapses.  Transfers that
+ * finish while this function runs are discarded, including any that received
+ * data before they could be cancelled.  Borrowed transfers are not affected.
+ *
+ * The timeout is in milliseconds, and 0 means to wait forever.  If the
+ * timeout elapses, this function returns an error with the code
+ * ::LIBUSBP_ERROR_TIMEOUT.  This function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_in_pipe_cancel_transfers_and_drain(
+    libusbp_async_in_pipe *,
+    uint32_t timeout);
+#endif
+
+
+#ifdef __linux__
+
+/** libusbp_async_out_pipe *****************************************************/
+
+/*! A libusbp_async_out_pipe is an object that holds the memory and other data
+ * structures for a set of asynchronous USB requests to write data to a
+ * non-zero endpoint.  It can be used to write data to a bulk or interrupt OUT
+ * endpoint with high throughput, because several requests can be queued up in
+ * the operating system at once and the USB host controller does not have to
+ * wait for your program between them.
+ *
+ * This type of pipe is only available on Linux. */
+typedef struct libusbp_async_out_pipe
+               libusbp_async_out_pipe;
+
+/*! Closes the pipe immediately.  Note that if the pipe has any pending
+ * transfers, then it is possible that they cannot be freed by this function.
+ * Freeing a pipe with pending transfers could cause a memory leak, but is
+ * otherwise safe. */
+LIBUSBP_API
+void libusbp_async_out_pipe_close(libusbp_async_out_pipe *);
+
+/*! Allocates buffers and other data structures for performing multiple
+ * concurrent transfers on the pipe.
+ *
+ * The @a transfer_count parameter specifies how many transfers to allocate,
+ * which is the maximum number of transfers that can be queued in the operating
+ * system at the same time.
+ *
+ * The @a transfer_size parameter specifies how large each transfer's buffer
+ * should be, which is the maximum amount of data that can be passed to
+ * libusbp_async_out_pipe_submit_transfer() at once. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_out_pipe_allocate_transfers(
+    libusbp_async_out_pipe *,
+    size_t transfer_count,
+    size_t transfer_size);
+
+/*! Copies the specified data into the next available transfer and submits it
+ * to the operating system.
+ *
+ * The @a size must not be larger than the transfer size specified when
+ * libusbp_async_out_pipe_allocate_transfers() was called.  A size of 0 sends
+ * a zero-length packet.
+ *
+ * @param submitted An optional output pointer used to return a boolean that
+ * indicates whether the data was submitted.  If all of the pipe's transfers
+ * are pending, the data is not submitted, and you should call
+ * libusbp_async_out_pipe_handle_events() and
+ * libusbp_async_out_pipe_handle_finished_transfer() before trying again. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_out_pipe_submit_transfer(
+    libusbp_async_out_pipe *,
+    const void * buffer,
+    size_t size,
+    bool * submitted);
+
+/*! Like libusbp_async_out_pipe_submit_transfer(), except that the transfer
+ * uses the specified flags from ::libusbp_transfer_flag instead of the flags
+ * set with libusbp_generic_handle_set_pipe_flags(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_out_pipe_submit_transfer_with_flags(
+    libusbp_async_out_pipe *,
+    const void * buffer,
+    size_t size,
+    uint32_t flags,
+    bool * submitted);
+
+/*! Checks for new events, such as a transfer completing.  This function and
+ * libusbp_async_out_pipe_handle_finished_transfer() should be called regularly
+ * in order to free up transfers for new data. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_out_pipe_handle_events(libusbp_async_out_pipe *);
+
+/*! Blocks until the next pending transfer has finished or the timeout elapses.
+ * This works like libusbp_async_in_pipe_wait(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_out_pipe_wait(
+    libusbp_async_out_pipe *,
+    uint32_t timeout);
+
+/*! Retrieves a boolean saying whether there are any pending transfers.  A
+ * pending transfer is a transfer that was submitted to the operating system,
+ * and it may have been completed, but it has not been passed to the caller yet
+ * via libusbp_async_out_pipe_handle_finished_transfer(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_out_pipe_has_pending_transfers(
+    libusbp_async_out_pipe *,
+    bool * result);
+
+/*! Checks to see if there is a finished transfer that can be handled.  If
+ * there is one, then this function retrieves the number of bytes transferred
+ * and any error that might have occurred related to the transfer, and makes
+ * the transfer available for new data.  Transfers are finished in the same
+ * order they were submitted.
+ *
+ * @param finished An optional output pointer used to return a boolean that
+ * indicates whether a transfer was finished.
+ *
+ * @param transferred An optional output pointer used to return the number of
+ * bytes transferred.
+ *
+ * @param transfer_error An optional pointer used to return an error related
+ * to the transfer, such as a timeout or a cancellation.  If a non-NULL error is
+ * returned via this pointer, then it must later be freed with
+ * libusbp_error_free(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_out_pipe_handle_finished_transfer(
+    libusbp_async_out_pipe *,
+    bool * finished,
+    size_t * transferred,
+    libusbp_error ** transfer_error);
+
+/*! Cancels all the transfers for this pipe.  The cancellation is asynchronous,
+ * so you will need to call libusbp_async_out_pipe_handle_events() and
+ * libusbp_async_out_pipe_handle_finished_transfer() repeatedly until
+ * libusbp_async_out_pipe_has_pending_transfers() indicates there are no
+ * pending transfers left. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_out_pipe_cancel_transfers(libusbp_async_out_pipe *);
+
+#endif
+
+
+#ifdef __linux__
+
+/** libusbp_async_control_pipe *************************************************/
+
+/*! A libusbp_async_control_pipe is an object that holds the memory and other
+ * data structures for a set of asynchronous control transfers on endpoint 0.
+ * It lets you keep several requests in flight at once, for example to read
+ * status information from many devices with vendor requests without blocking
+ * on each one.
+ *
+ * This type of pipe is only available on Linux. */
+typedef struct libusbp_async_control_pipe
+               libusbp_async_control_pipe;
+
+/*! Closes the pipe immediately.  This works like
+ * libusbp_async_out_pipe_close(). */
+LIBUSBP_API
+void libusbp_async_control_pipe_close(libusbp_async_control_pipe *);
+
+/*! Allocates buffers and other data structures for performing multiple
+ * concurrent control transfers.
+ *
+ * The @a transfer_count parameter specifies how many transfers to allocate,
+ * which is the maximum number of requests that can be queued in the operating
+ * system at the same time.
+ *
+ * The @a max_data_size parameter specifies the largest data stage (wLength)
+ * that can be used with this pipe, and cannot be more than 65535. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_control_pipe_allocate_transfers(
+    libusbp_async_control_pipe *,
+    size_t transfer_count,
+    size_t max_data_size);
+
+/*! Submits a control transfer using the next available transfer.  The
+ * parameters are the same as for libusbp_control_transfer(), except that the
+ * data for a device-to-host request is not read until the transfer finishes
+ * (see libusbp_async_control_pipe_handle_finished_transfer()).  For a
+ * host-to-device request, @a wLength bytes are copied from @a data before this
+ * function returns.  For a device-to-host request, @a data is ignored and can
+ * be NULL.
+ *
+ * @param submitted An optional output pointer used to return a boolean that
+ * indicates whether the request was submitted.  If all of the pipe's transfers
+ * are pending, the request is not submitted, and you should call
+ * libusbp_async_control_pipe_handle_events() and
+ * libusbp_async_control_pipe_handle_finished_transfer() before trying again. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_control_pipe_submit_transfer(
+    libusbp_async_control_pipe *,
+    uint8_t bmRequestType,
+    uint8_t bRequest,
+    uint16_t wValue,
+    uint16_t wIndex,
+    const void * data,
+    uint16_t wLength,
+    bool * submitted);
+
+/*! Checks for new events, such as a transfer completing.  This function and
+ * libusbp_async_control_pipe_handle_finished_transfer() should be called
+ * regularly in order to get the results of the requests. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_control_pipe_handle_events(libusbp_async_control_pipe *);
+
+/*! Blocks until the next pending transfer has finished or the timeout elapses.
+ * This works like libusbp_async_in_pipe_wait(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_control_pipe_wait(
+    libusbp_async_control_pipe *,
+    uint32_t timeout);
+
+/*! Retrieves a boolean saying whether there are any pending transfers.  This
+ * works like libusbp_async_out_pipe_has_pending_transfers(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_control_pipe_has_pending_transfers(
+    libusbp_async_control_pipe *,
+    bool * result);
+
+/*! Checks to see if there is a finished transfer that can be handled.  If
+ * there is one, then this function retrieves the data it received (for a
+ * device-to-host request), the number of bytes in the data stage, and any
+ * error that might have occurred, and makes the transfer available for a new
+ * request.  Transfers are finished in the same order they were submitted.
+ *
+ * @param finished An optional output pointer used to return a boolean that
+ * indicates whether a transfer was finished.
+ *
+ * @param buffer An optional pointer to a buffer that will receive the data
+ * from a device-to-host request.  It must be at least as large as the
+ * wLength of that request.
+ *
+ * @param transferred An optional output pointer used to return the number of
+ * bytes transferred in the data stage.
+ *
+ * @param transfer_error An optional pointer used to return an error related
+ * to the transfer, such as a stall or a cancellation.  If a non-NULL error is
+ * returned via this pointer, then it must later be freed with
+ * libusbp_error_free(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_control_pipe_handle_finished_transfer(
+    libusbp_async_control_pipe *,
+    bool * finished,
+    void * buffer,
+    size_t * transferred,
+    libusbp_error ** transfer_error);
+
+/*! Cancels all the transfers for this pipe.  This works like
+ * libusbp_async_out_pipe_cancel_transfers(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_async_control_pipe_cancel_transfers(libusbp_async_control_pipe *);
+
+#endif
+
+
+#ifdef __linux__
+
+/** libusbp_iso_pipe ***********************************************************/
+
+/*! A libusbp_iso_pipe is an object that holds the memory and other data
+ * structures for a set of asynchronous transfers on an isochronous IN or OUT
+ * endpoint.  Each transfer holds a fixed number of packets, and the result of
+ * each packet is reported separately, because isochronous transfers do not
+ * retry packets that have errors.
+ *
+ * This type of pipe is only available on Linux. */
+typedef struct libusbp_iso_pipe
+               libusbp_iso_pipe;
+
+/*! The result of one packet of an isochronous transfer, as reported by
+ * libusbp_iso_pipe_handle_finished_transfer(). */
+typedef struct libusbp_iso_packet
+{
+    /*! The offset of the packet's data from the beginning of the transfer's
+     * buffer.  For IN pipes, this is the packet's index times the packet
+     * size. */
+    size_t offset;
+
+    /*! The number of bytes transferred in the packet. */
+    size_t transferred;
+
+    /*! 0 if the packet was transferred successfully, or a positive error
+     * code from the operating system (an errno value) otherwise. */
+    int status;
+} libusbp_iso_packet;
+
+/*! Closes the pipe immediately.  This works like
+ * libusbp_async_out_pipe_close(). */
+LIBUSBP_API
+void libusbp_iso_pipe_close(libusbp_iso_pipe *);
+
+/*! Allocates buffers and other data structures for performing multiple
+ * concurrent transfers on the pipe.
+ *
+ * The @a transfer_count parameter specifies how many transfers to allocate,
+ * which is the maximum number of transfers that can be queued in the operating
+ * system at the same time.
+ *
+ * The @a packets_per_transfer parameter specifies how many packets each
+ * transfer holds.  Each packet takes one (micro)frame of the bus, so this
+ * controls how often your program gets results.
+ *
+ * The @a packet_size parameter specifies the maximum size of each packet, and
+ * should usually be the maximum packet size of the endpoint (including any
+ * additional transactions per microframe). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_iso_pipe_allocate_transfers(
+    libusbp_iso_pipe *,
+    size_t transfer_count,
+    size_t packets_per_transfer,
+    size_t packet_size);
+
+/*! Starts reading data from an IN pipe.  Finished transfers are submitted
+ * again when libusbp_iso_pipe_handle_finished_transfer() returns them, until
+ * libusbp_iso_pipe_cancel_transfers() is called. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_iso_pipe_start_endless_transfers(libusbp_iso_pipe *);
+
+/*! Copies the specified packets into the next available transfer of an OUT
+ * pipe and submits it.
+ *
+ * @param buffer The data of the packets, stored back to back.
+ *
+ * @param packet_lengths An array with the length of each packet.  Each length
+ * must be less than or equal to the packet size.
+ *
+ * @param packet_count The number of packets, which must be between 1 and the
+ * number of packets per transfer.
+ *
+ * @param submitted An optional output pointer used to return a boolean that
+ * indicates whether the data was submitted.  This works like the @a submitted
+ * parameter of libusbp_async_out_pipe_submit_transfer(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_iso_pipe_submit_transfer(
+    libusbp_iso_pipe *,
+    const void * buffer,
+    const size_t * packet_lengths,
+    size_t packet_count,
+    bool * submitted);
+
+/*! Checks for new events, such as a transfer completing.  This function and
+ * libusbp_iso_pipe_handle_finished_transfer() should be called regularly. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_iso_pipe_handle_events(libusbp_iso_pipe *);
+
+/*! Blocks until the next pending transfer has finished or the timeout elapses.
+ * This works like libusbp_async_in_pipe_wait(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_iso_pipe_wait(
+    libusbp_iso_pipe *,
+    uint32_t timeout);
+
+/*! Retrieves a boolean saying whether there are any pending transfers.  This
+ * works like libusbp_async_out_pipe_has_pending_transfers(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_iso_pipe_has_pending_transfers(
+    libusbp_iso_pipe *,
+    bool * result);
+
+/*! Checks to see if there is a finished transfer that can be handled.  If
+ * there is one, this function retrieves its data and the result of each of its
+ * packets, and makes the transfer available again.  For IN pipes with endless
+ * transfers enabled, the transfer is submitted again.  Transfers are finished
+ * in the same order they were submitted.
+ *
+ * @param finished An optional output pointer used to return a boolean that
+ * indicates whether a transfer was finished.
+ *
+ * @param buffer For IN pipes, an optional pointer to a buffer that will
+ * receive the transfer's data.  It must be at least as large as the number of
+ * packets per transfer times the packet size.  Packet i is stored at offset
+ * i times the packet size, and might be shorter than the packet size.  This is
+ * ignored for OUT pipes.
+ *
+ * @param packets An optional pointer to an array that will receive the result
+ * of each packet.  It must have at least as many elements as the number of
+ * packets per transfer.
+ *
+ * @param packet_count An optional output pointer used to return the number of
+ * packets in the transfer.
+ *
+ * @param transfer_error An optional pointer used to return an error that
+ * affected the whole transfer, such as a cancellation.  Errors in individual
+ * packets are only reported in @a packets.  If a non-NULL error is returned
+ * via this pointer, then it must later be freed with libusbp_error_free(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_iso_pipe_handle_finished_transfer(
+    libusbp_iso_pipe *,
+    bool * finished,
+    void * buffer,
+    libusbp_iso_packet * packets,
+    size_t * packet_count,
+    libusbp_error ** transfer_error);
+
+/*! Cancels all the transfers for this pipe and stops endless transfers.  This
+ * works like libusbp_async_out_pipe_cancel_transfers(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_iso_pipe_cancel_transfers(libusbp_iso_pipe *);
+
+#endif
+
 
 /** libusbp_device *************************************************************/
 
@@ -529,8 +1298,8 @@ libusbp_error * libusbp_generic_handle_open(
 
 /*! Closes and frees the specified generic handle.  It is OK to pass NULL to
  * this function.  Do not close the same non-NULL handle twice. All
- * ::libusbp_async_in_pipe objects created by the handle must be closed before
- * closing the handle. */
+ * ::libusbp_async_in_pipe and ::libusbp_async_out_pipe objects created by the
+ * handle must be closed before closing the handle. */
 LIBUSBP_API
 void libusbp_generic_handle_close(
     libusbp_generic_handle *);
@@ -550,6 +1319,44 @@ libusbp_error * libusbp_generic_handle_open_async_in_pipe(
     uint8_t pipe_id,
     libusbp_async_in_pipe ** async_in_pipe);
 
+#ifdef __linux__
+/*! Creates a new asynchronous pipe object for writing data to the device on
+ * one of its bulk or interrupt OUT endpoints.  This function is only
+ * available on Linux.
+ *
+ * The behavior of this library is unspecified if you use both an asynchronous
+ * OUT pipe and synchronous writes with libusbp_write_pipe() on the same pipe
+ * at the same time, because the order of the data sent to the device would be
+ * unpredictable. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_generic_handle_open_async_out_pipe(
+    libusbp_generic_handle *,
+    uint8_t pipe_id,
+    libusbp_async_out_pipe ** async_out_pipe);
+
+/*! Creates a new asynchronous pipe object for performing control transfers on
+ * endpoint 0 of the device.  You can open several of these on the same handle,
+ * and use them at the same time as libusbp_control_transfer().  This function
+ * is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_generic_handle_open_async_control_pipe(
+    libusbp_generic_handle *,
+    libusbp_async_control_pipe ** async_control_pipe);
+
+/*! Creates a new pipe object for isochronous transfers on one of the
+ * device's isochronous IN or OUT endpoints.  This function is only available
+ * on Linux.
+ *
+ * Isochronous endpoints are often only available in an alternate setting of
+ * their interface, so you might need to select that setting with
+ * libusbp_generic_handle_set_alternate_setting() before opening the pipe. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_generic_handle_open_iso_pipe(
+    libusbp_generic_handle *,
+    uint8_t pipe_id,
+    libusbp_iso_pipe ** iso_pipe);
+#endif
+
 /*! Sets a timeout for a particular pipe on the USB device.
  *
  * The @a pipe_id should either be 0 to specify control transfers on endpoint 0, or
@@ -606,7 +1413,13 @@ libusbp_error * libusbp_control_transfer(
  * descriptors.  (Its most significant bit must be 0.)
  *
  * The @a transferred parameter is an optional pointer to a variable that will
- * receive the number of bytes transferred. */
+ * receive the number of bytes transferred.
+ *
+ * Under Linux, transfers larger than 16 KiB on bulk endpoints are split into
+ * 16 KiB USB request blocks and up to 16 of them are queued at a time, so the
+ * device does not have to wait for the host between them.  If such a transfer fails or
+ * times out, @a transferred still receives the number of bytes that were
+ * transferred before that.  The timeout applies to the whole transfer. */
 LIBUSBP_API LIBUSBP_WARN_UNUSED
 libusbp_error * libusbp_write_pipe(
     libusbp_generic_handle *,
@@ -631,7 +1444,13 @@ libusbp_error * libusbp_write_pipe(
  * descriptors.  (Its most significant bit must be 1.)
  *
  * The @a transferred parameter is an optional pointer to a variable that will
- * receive the number of bytes transferred. */
+ * receive the number of bytes transferred.
+ *
+ * Under Linux, transfers larger than 16 KiB on bulk endpoints are split into
+ * 16 KiB USB request blocks and up to 16 of them are queued at a time, so the
+ * device does not have to wait for the host between them.  If such a transfer fails or
+ * times out, @a transferred still receives the number of bytes that were
+ * transferred before that.  The timeout applies to the whole transfer. */
 LIBUSBP_API LIBUSBP_WARN_UNUSED
 libusbp_error * libusbp_read_pipe(
     libusbp_generic_handle *,
@@ -647,6 +1466,146 @@ libusbp_error * libusbp_read_pipe(
  * has not been closed. */
 LIBUSBP_API
 int libusbp_generic_handle_get_fd(libusbp_generic_handle *);
+
+/*! Sets flags from ::libusbp_transfer_flag that are used for every transfer
+ * on the specified bulk endpoint, unless a function such as
+ * libusbp_write_pipe_with_flags() specifies other flags.  The flags affect
+ * libusbp_read_pipe(), libusbp_write_pipe(), asynchronous OUT pipes, and
+ * asynchronous IN pipes whose transfers are allocated after this function is
+ * called.  Asynchronous IN pipes ignore ::LIBUSBP_TRANSFER_BULK_CONTINUATION
+ * because they keep transfers queued all the time, so after the first short
+ * packet every one of them would be refused.
+ *
+ * When any flags are set, synchronous transfers are submitted as USB request
+ * blocks instead of with the USBDEVFS_BULK ioctl, which cannot pass flags to
+ * the kernel.  This function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_generic_handle_set_pipe_flags(
+    libusbp_generic_handle *,
+    uint8_t pipe_id,
+    uint32_t flags);
+
+/*! Like libusbp_write_pipe(), except that the transfer uses the specified
+ * flags from ::libusbp_transfer_flag instead of the flags set with
+ * libusbp_generic_handle_set_pipe_flags().  This function is only available
+ * on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_write_pipe_with_flags(
+    libusbp_generic_handle *,
+    uint8_t pipe_id,
+    const void * buffer,
+    size_t size,
+    uint32_t flags,
+    size_t * transferred);
+
+/*! Like libusbp_read_pipe(), except that the transfer uses the specified
+ * flags from ::libusbp_transfer_flag instead of the flags set with
+ * libusbp_generic_handle_set_pipe_flags().  If the read fails because of
+ * ::LIBUSBP_TRANSFER_SHORT_NOT_OK, @a transferred still receives the number of
+ * bytes read.  This function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_read_pipe_with_flags(
+    libusbp_generic_handle *,
+    uint8_t pipe_id,
+    void * buffer,
+    size_t size,
+    uint32_t flags,
+    size_t * transferred);
+
+/*! Like libusbp_write_pipe(), except that the data to write is taken from
+ * the pieces of memory described by @a iov, in order, as if they were one
+ * contiguous buffer.
+ *
+ * On bulk endpoints, if the size of every piece except the last is a multiple
+ * of the endpoint's maximum packet size, each piece is sent directly from
+ * where it is in memory.  Otherwise, the pieces are copied into a temporary
+ * buffer first, because the device would see a short packet wherever one
+ * piece ended in the middle of a packet.  This function is only available on
+ * Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_write_pipe_v(
+    libusbp_generic_handle *,
+    uint8_t pipe_id,
+    const libusbp_iovec * iov,
+    size_t iov_count,
+    size_t * transferred);
+
+/*! Like libusbp_read_pipe(), except that the data is stored in the pieces of
+ * memory described by @a iov, in order, as if they were one contiguous
+ * buffer.  A short packet from the device ends the transfer early, just like
+ * it does for libusbp_read_pipe().
+ *
+ * The pieces are read into directly under the same conditions as
+ * libusbp_write_pipe_v(), as long as the kernel supports
+ * USBDEVFS_URB_BULK_CONTINUATION.  This function is only available on
+ * Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_read_pipe_v(
+    libusbp_generic_handle *,
+    uint8_t pipe_id,
+    const libusbp_iovec * iov,
+    size_t iov_count,
+    size_t * transferred);
+
+/*! Blocks until at least one asynchronous transfer on the handle has
+ * completed or the timeout elapses, and then handles the completed transfers
+ * so they can be retrieved from the pipes that they belong to.
+ *
+ * This uses poll() on the file descriptor returned by
+ * libusbp_generic_handle_get_fd(), which reports POLLOUT when there are
+ * completed transfers to handle.  The timeout is in milliseconds, and 0 means
+ * to wait forever.  This function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_generic_handle_wait(
+    libusbp_generic_handle *,
+    uint32_t timeout);
+
+/*! Controls whether the buffers for asynchronous transfers are allocated by
+ * calling mmap() on the device file.  This is enabled by default if the kernel
+ * supports it (Linux 4.6 and later), and it saves the kernel from copying the
+ * data of every transfer.  The setting only affects transfers allocated after
+ * it is changed.  This function is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_generic_handle_set_zero_copy(
+    libusbp_generic_handle *,
+    bool enabled);
+
+/*! Selects an alternate setting for the handle's interface by sending a
+ * SET_INTERFACE request to the device, and then reloads the endpoint
+ * information that the handle uses (such as which endpoints are isochronous)
+ * from the descriptors of that setting.
+ *
+ * No transfers should be in progress on the interface's endpoints while the
+ * setting changes, and pipes opened before the change should be closed, since
+ * the endpoints they were opened for might not exist any more.  This function
+ * is only available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_generic_handle_set_alternate_setting(
+    libusbp_generic_handle *,
+    uint8_t alternate_setting);
+
+/*! Starts a thread that waits for the handle's asynchronous transfers to
+ * complete and handles them as soon as they do.  For pipes with a completion
+ * queue (see libusbp_async_in_pipe_enable_completion_queue()), this thread
+ * also submits the transfers again.
+ *
+ * While the thread is running, the handle_events functions of the handle's
+ * pipes do nothing except report an error if the thread stopped because of
+ * one, and the wait functions wait for a signal from the thread.  A handle
+ * with a reaper thread cannot be added to a ::libusbp_event_loop, and this
+ * function returns an error for a handle that is in one.
+ *
+ * The thread is stopped when the handle is closed.  This function is only
+ * available on Linux. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_generic_handle_start_reaper_thread(
+    libusbp_generic_handle *);
+
+/*! Stops the thread started by libusbp_generic_handle_start_reaper_thread()
+ * and waits for it to exit.  Does nothing if the thread is not running. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_generic_handle_stop_reaper_thread(
+    libusbp_generic_handle *);
 #endif
 
 #ifdef _WIN32
@@ -668,6 +1627,110 @@ void ** libusbp_generic_handle_get_cf_plug_in(libusbp_generic_handle *);
 #endif
 
 
+#ifdef __linux__
+
+/** libusbp_event_loop *********************************************************/
+
+/*! A libusbp_event_loop lets one thread handle the asynchronous transfers of
+ * any number of generic handles.  It holds an epoll instance containing the
+ * file descriptor of each handle that was added to it.
+ *
+ * An event loop is not thread-safe, and each handle should only be added to
+ * one event loop.  Handles must be removed from the loop before they are
+ * closed.  This object is only available on Linux.
+ *
+ * The loop must be the only thing that reaps the transfers of its handles.
+ * Handles with a reaper thread (see
+ * libusbp_generic_handle_start_reaper_thread()) cannot be added to it, and
+ * while a handle is in the loop, other threads must not call functions that
+ * wait for its transfers, like libusbp_async_in_pipe_wait().  The loop could
+ * not reap the transfers while such a function is waiting, so it would keep
+ * waking up without doing anything. */
+typedef struct libusbp_event_loop
+               libusbp_event_loop;
+
+/*! Creates a new event loop with no handles in it.  The loop must later be
+ * freed with libusbp_event_loop_free(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_event_loop_create(libusbp_event_loop ** loop);
+
+/*! Frees the event loop.  This does not close the handles in it, but they
+ * must still be open. */
+LIBUSBP_API
+void libusbp_event_loop_free(libusbp_event_loop *);
+
+/*! Adds a generic handle to the event loop, so that the loop will handle
+ * events for all of the handle's asynchronous pipes.  The loop keeps a count
+ * of how many times each handle was added, so a handle that was added twice
+ * must be removed twice. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_event_loop_add_handle(
+    libusbp_event_loop *,
+    libusbp_generic_handle *);
+
+/*! Undoes one call to libusbp_event_loop_add_handle(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_event_loop_remove_handle(
+    libusbp_event_loop *,
+    libusbp_generic_handle *);
+
+/*! Adds the generic handle that the pipe was opened from to the event loop.
+ * This is the same as calling libusbp_event_loop_add_handle() with that
+ * handle. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_event_loop_add_async_in_pipe(
+    libusbp_event_loop *,
+    libusbp_async_in_pipe *);
+
+/*! Undoes one call to libusbp_event_loop_add_async_in_pipe(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_event_loop_remove_async_in_pipe(
+    libusbp_event_loop *,
+    libusbp_async_in_pipe *);
+
+/*! Adds the generic handle that the pipe was opened from to the event loop.
+ * This is the same as calling libusbp_event_loop_add_handle() with that
+ * handle. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_event_loop_add_async_out_pipe(
+    libusbp_event_loop *,
+    libusbp_async_out_pipe *);
+
+/*! Undoes one call to libusbp_event_loop_add_async_out_pipe(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_event_loop_remove_async_out_pipe(
+    libusbp_event_loop *,
+    libusbp_async_out_pipe *);
+
+/*! Gets a file descriptor that becomes readable when there are events for the
+ * loop to handle.  You can add it to your own epoll set, or to another event
+ * loop library, and call libusbp_event_loop_handle_events() when it is
+ * readable.  The file descriptor remains valid until the loop is freed. */
+LIBUSBP_API
+int libusbp_event_loop_get_fd(libusbp_event_loop *);
+
+/*! Handles events for every handle in the loop that has completed transfers,
+ * without blocking.  After this, the finished transfers can be retrieved from
+ * their pipes.
+ *
+ * If handling the events of one handle fails, usually because its device was
+ * disconnected, the loop stops watching that handle and this function returns
+ * an error.  The handle still needs to be removed from the loop. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_event_loop_handle_events(libusbp_event_loop *);
+
+/*! Blocks until at least one handle in the loop has completed transfers or the
+ * timeout elapses, and then handles events like
+ * libusbp_event_loop_handle_events().  The timeout is in milliseconds, and 0
+ * means to wait forever. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_event_loop_wait(
+    libusbp_event_loop *,
+    uint32_t timeout);
+
+#endif
+
+
 /** libusbp_serial_port ********************************************************/
 
 /*! Represents a serial port. A null libusbp_serial_port pointer is valid and
@@ -730,6 +1793,301 @@ libusbp_error * libusbp_serial_port_get_name(
     const libusbp_serial_port *,
     char ** name);
 
+
+#ifdef __linux__
+
+/** libusbp_context ************************************************************/
+
+/*! A libusbp_context holds resources that the functions for finding devices
+ * and interfaces can reuse from one call to the next, instead of setting them
+ * up and tearing them down every time.  On Linux, this is a udev context.
+ * Using a context is optional, and is most useful for a program that looks
+ * for devices many times per second.
+ *
+ * A context is not thread-safe, so it should only be used by one thread at a
+ * time.  The objects created with a context do not depend on it, so they can
+ * outlive it.  This object is only available on Linux. */
+typedef struct libusbp_context
+               libusbp_context;
+
+/*! Creates a new context.  The context must later be freed with
+ * libusbp_context_free().
+ *
+ * If libusbp was built with the LIBUSBP_USE_UDEV CMake option turned off,
+ * this is the same as calling libusbp_context_create_sysfs() with a NULL
+ * root, and functions that are not given a context read sysfs directly too. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_context_create(libusbp_context ** context);
+
+/*! Creates a new context that finds devices by reading sysfs directly and
+ * receives hotplug events from the kernel, without using libudev.  This is
+ * faster, and works on systems that do not run udev, but the devices it finds
+ * might not have been set up by udev rules yet, so opening them can fail with
+ * a permission error for a moment after they are plugged in.
+ *
+ * The sysfs_root argument is the directory where sysfs is mounted.  If it is
+ * NULL, "/sys" is used.  A different directory laid out the same way can be
+ * used for testing.  The context must later be freed with
+ * libusbp_context_free(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_context_create_sysfs(const char * sysfs_root,
+    libusbp_context ** context);
+
+/*! Frees the specified context.  Passing the NULL pointer to this function is
+ * OK. */
+LIBUSBP_API
+void libusbp_context_free(libusbp_context *);
+
+/*! Same as libusbp_list_connected_devices(), but uses the specified context.
+ * If the context is NULL, a temporary one is used. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_list_connected_devices_ctx(
+    libusbp_context *,
+    libusbp_device *** device_list,
+    size_t * device_count);
+
+/*! Same as libusbp_generic_interface_create(), but uses the specified
+ * context.  If the context is NULL, a temporary one is used. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_generic_interface_create_ctx(
+    libusbp_context *,
+    const libusbp_device *,
+    uint8_t interface_number,
+    bool composite,
+    libusbp_generic_interface **);
+
+/*! Same as libusbp_serial_port_create(), but uses the specified context.  If
+ * the context is NULL, a temporary one is used. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_serial_port_create_ctx(
+    libusbp_context *,
+    const libusbp_device *,
+    uint8_t interface_number,
+    bool composite,
+    libusbp_serial_port **);
+
+/*! A vendor ID and product ID pair, used in ::libusbp_device_filter. */
+typedef struct libusbp_vid_pid
+{
+    uint16_t vendor_id;
+    uint16_t product_id;
+} libusbp_vid_pid;
+
+/*! Describes which devices libusbp_list_devices_matching() should return.  A
+ * device must meet every condition in the filter.  A filter that was
+ * initialized to zero matches every device, so you can zero it and then set
+ * only the members you care about.  This structure is only available on
+ * Linux. */
+typedef struct libusbp_device_filter
+{
+    /*! If @a id_count is not zero, the device's vendor ID and product ID must
+     * match one of the pairs in this array. */
+    const libusbp_vid_pid * ids;
+
+    /*! The number of pairs in @a ids. */
+    size_t id_count;
+
+    /*! If this is not NULL, the device must have a serial number that starts
+     * with this string. */
+    const char * serial_number_prefix;
+
+    /*! If this is not zero, the device must be on the USB bus with this
+     * number. */
+    uint8_t bus_number;
+
+    /*! If this is true, the device's @a bDeviceClass must be equal to
+     * @a device_class. */
+    bool match_device_class;
+
+    /*! See @a match_device_class. */
+    uint8_t device_class;
+} libusbp_device_filter;
+
+/*! Same as libusbp_list_connected_devices(), but only returns devices that
+ * match the specified filter.  The filter is passed to udev where possible,
+ * so devices that do not match are skipped without reading all of their
+ * information.  A NULL filter matches every device.  If the context is NULL,
+ * a temporary one is used. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_list_devices_matching(
+    libusbp_context *,
+    const libusbp_device_filter *,
+    libusbp_device *** device_list,
+    size_t * device_count);
+
+/*! Finds the first device that matches the specified filter, and stops
+ * looking as soon as it is found.  If no device matches, the retrieved device
+ * pointer is NULL.  Otherwise, it must be freed with libusbp_device_free().
+ * The devices are checked in the same order that
+ * libusbp_list_connected_devices() returns them.  If the context is NULL, a
+ * temporary one is used. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_find_device_matching(
+    libusbp_context *,
+    const libusbp_device_filter *,
+    libusbp_device ** device);
+
+
+/** libusbp_hotplug_monitor ****************************************************/
+
+/*! The kinds of events reported by libusbp_hotplug_monitor_receive().  These
+ * values are only available on Linux. */
+enum libusbp_hotplug_event
+{
+    /*! A USB device was connected and is ready to use. */
+    LIBUSBP_HOTPLUG_DEVICE_ADDED = 1,
+
+    /*! A USB device was disconnected. */
+    LIBUSBP_HOTPLUG_DEVICE_REMOVED = 2,
+
+    /*! A serial port of a USB device is ready to use.  The device reported
+     * with this event is the USB device the port belongs to. */
+    LIBUSBP_HOTPLUG_SERIAL_PORT_ADDED = 3,
+
+    /*! A serial port of a USB device went away while the device stayed
+     * connected.  When a whole device is disconnected, this event might not
+     * be reported for its ports. */
+    LIBUSBP_HOTPLUG_SERIAL_PORT_REMOVED = 4,
+};
+
+/*! A libusbp_hotplug_monitor receives events from udev when USB devices and
+ * their serial ports are connected or disconnected.  This is more efficient
+ * than calling libusbp_list_connected_devices() in a loop, and it does not
+ * miss devices that are only connected briefly.  Events for a device are only
+ * reported once udev has finished initializing it, so the device is ready to
+ * be used as soon as its event is received.
+ *
+ * A monitor made with a context from libusbp_context_create_sysfs(), or any
+ * monitor if libusbp was built without libudev, receives the kernel's events
+ * instead, which arrive before udev has initialized the device.
+ *
+ * A monitor is not thread-safe.  This object is only available on Linux. */
+typedef struct libusbp_hotplug_monitor
+               libusbp_hotplug_monitor;
+
+/*! Creates a hotplug monitor.  Events that happen after this call are
+ * reported, so you should usually call libusbp_list_connected_devices() after
+ * this to find the devices that are already connected.  If the context is
+ * NULL, the monitor creates its own.  The monitor must later be freed with
+ * libusbp_hotplug_monitor_free(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_hotplug_monitor_create(
+    libusbp_context *,
+    libusbp_hotplug_monitor ** monitor);
+
+/*! Frees the specified hotplug monitor.  Passing the NULL pointer to this
+ * function is OK. */
+LIBUSBP_API
+void libusbp_hotplug_monitor_free(libusbp_hotplug_monitor *);
+
+/*! Gets a file descriptor that becomes readable when the monitor has events.
+ * You can add it to your own poll set, or to another event loop library, and
+ * call libusbp_hotplug_monitor_receive() when it is readable.  The file
+ * descriptor remains valid until the monitor is freed. */
+LIBUSBP_API
+int libusbp_hotplug_monitor_get_fd(libusbp_hotplug_monitor *);
+
+/*! Gets the next event without blocking.  The @a event output is set to a
+ * ::libusbp_hotplug_event value, and the @a device output is set to the device
+ * the event is about, which must be freed with libusbp_device_free().  If
+ * there are no events, the device is set to NULL and the event is set to 0.
+ *
+ * For a device that was removed, the vendor ID, product ID, and revision come
+ * from the kernel's event.  The serial number comes from udev's database,
+ * which might replace unusual characters in it.  A monitor that receives the
+ * kernel's events instead remembers the serial numbers of the devices that
+ * were connected when it was created, or that it reported as added, because
+ * the kernel's events do not include them.  Use the OS ID to match the device
+ * with one you found earlier. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_hotplug_monitor_receive(
+    libusbp_hotplug_monitor *,
+    uint32_t * event,
+    libusbp_device ** device);
+
+/*! Blocks until the monitor might have events or the timeout elapses.  The
+ * timeout is in milliseconds, and 0 means to wait forever.  This function does
+ * not report an error when the timeout elapses, so you should call
+ * libusbp_hotplug_monitor_receive() afterwards to get any events. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_hotplug_monitor_wait(
+    libusbp_hotplug_monitor *,
+    uint32_t timeout);
+
+
+/** libusbp_device_index *******************************************************/
+
+/*! A libusbp_device_index keeps track of the connected USB devices so that
+ * a device can be found by its OS ID, or by its vendor ID, product ID, and
+ * serial number, without listing all of the devices again.  It lists the
+ * devices once when it is created, and then updates itself from a hotplug
+ * monitor whenever libusbp_device_index_update() is called.  Lookups take
+ * constant time and do not allocate memory.
+ *
+ * An index is not thread-safe.  This object is only available on Linux. */
+typedef struct libusbp_device_index
+               libusbp_device_index;
+
+/*! Creates an index of the devices that are currently connected.  If the
+ * context is NULL, the index creates its own.  The index must later be freed
+ * with libusbp_device_index_free(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_device_index_create(
+    libusbp_context *,
+    libusbp_device_index ** index);
+
+/*! Frees the specified index, and all the devices in it.  Passing the NULL
+ * pointer to this function is OK. */
+LIBUSBP_API
+void libusbp_device_index_free(libusbp_device_index *);
+
+/*! Gets a file descriptor that becomes readable when devices have been
+ * connected or disconnected, and libusbp_device_index_update() should be
+ * called.  The file descriptor remains valid until the index is freed. */
+LIBUSBP_API
+int libusbp_device_index_get_fd(libusbp_device_index *);
+
+/*! Applies the hotplug events that have happened since the last update,
+ * without blocking.  The optional @a changed output is set to true if any
+ * devices were added or removed.  Device pointers retrieved from the index
+ * before this call might be invalid afterwards. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_device_index_update(
+    libusbp_device_index *,
+    bool * changed);
+
+/*! Gets the number of devices in the index. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_device_index_get_count(
+    libusbp_device_index *,
+    size_t * count);
+
+/*! Finds the device with the specified OS ID (see libusbp_device_get_os_id()).
+ * If there is no such device, the retrieved pointer is NULL.  The device is
+ * owned by the index, so you must not free it, and it is only valid until the
+ * next call to libusbp_device_index_update() or libusbp_device_index_free().
+ * Use libusbp_device_copy() to keep it for longer. */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_device_index_find_by_os_id(
+    libusbp_device_index *,
+    const char * id,
+    const libusbp_device ** device);
+
+/*! Finds a device with the specified vendor ID, product ID, and serial
+ * number.  A NULL serial number matches devices that do not have one.  If
+ * there is no such device, the retrieved pointer is NULL.  The retrieved
+ * device is owned by the index, in the same way as for
+ * libusbp_device_index_find_by_os_id(). */
+LIBUSBP_API LIBUSBP_WARN_UNUSED
+libusbp_error * libusbp_device_index_find(
+    libusbp_device_index *,
+    uint16_t vendor_id,
+    uint16_t product_id,
+    const char * serial_number,
+    const libusbp_device ** device);
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -46,6 +46,50 @@ namespace libusbp
         libusbp_async_in_pipe_close(p);
     }
 
+    #ifdef __linux__
+    /*! Wrapper for libusbp_async_out_pipe_close(). */
+    inline void pointer_free(libusbp_async_out_pipe * p) noexcept
+    {
+        libusbp_async_out_pipe_close(p);
+    }
+
+    /*! Wrapper for libusbp_async_control_pipe_close(). */
+    inline void pointer_free(libusbp_async_control_pipe * p) noexcept
+    {
+        libusbp_async_control_pipe_close(p);
+    }
+
+    /*! Wrapper for libusbp_iso_pipe_close(). */
+    inline void pointer_free(libusbp_iso_pipe * p) noexcept
+    {
+        libusbp_iso_pipe_close(p);
+    }
+
+    /*! Wrapper for libusbp_event_loop_free(). */
+    inline void pointer_free(libusbp_event_loop * p) noexcept
+    {
+        libusbp_event_loop_free(p);
+    }
+
+    /*! Wrapper for libusbp_context_free(). */
+    inline void pointer_free(libusbp_context * p) noexcept
+    {
+        libusbp_context_free(p);
+    }
+
+    /*! Wrapper for libusbp_hotplug_monitor_free(). */
+    inline void pointer_free(libusbp_hotplug_monitor * p) noexcept
+    {
+        libusbp_hotplug_monitor_free(p);
+    }
+
+    /*! Wrapper for libusbp_device_index_free(). */
+    inline void pointer_free(libusbp_device_index * p) noexcept
+    {
+        libusbp_device_index_free(p);
+    }
+    #endif
+
     /*! Wrapper for libusbp_device_free(). */
     inline void pointer_free(libusbp_device * p) noexcept
     {
@@ -280,6 +324,65 @@ namespace libusbp
                 pointer, transfer_count, transfer_size));
         }
 
+        #ifdef __linux__
+        /*! Wrapper for libusbp_async_in_pipe_enable_completion_queue(). */
+        void enable_completion_queue(size_t queue_length)
+        {
+            throw_if_needed(libusbp_async_in_pipe_enable_completion_queue(
+                pointer, queue_length));
+        }
+
+        /*! Wrapper for libusbp_async_in_pipe_enable_stream(). */
+        void enable_stream(size_t buffer_size)
+        {
+            throw_if_needed(libusbp_async_in_pipe_enable_stream(
+                pointer, buffer_size));
+        }
+
+        /*! Wrapper for libusbp_async_in_pipe_stream_peek(). */
+        size_t stream_peek(const uint8_t ** data, error * transfer_error)
+        {
+            libusbp_error ** error_out = NULL;
+            if (transfer_error != NULL)
+            {
+                transfer_error->pointer_reset();
+                error_out = transfer_error->pointer_to_pointer_get();
+            }
+
+            size_t size;
+            throw_if_needed(libusbp_async_in_pipe_stream_peek(
+                pointer, data, &size, error_out));
+            return size;
+        }
+
+        /*! Wrapper for libusbp_async_in_pipe_stream_consume(). */
+        void stream_consume(size_t size)
+        {
+            throw_if_needed(libusbp_async_in_pipe_stream_consume(pointer, size));
+        }
+
+        /*! Wrapper for libusbp_async_in_pipe_set_callback(). */
+        void set_callback(libusbp_async_in_callback * callback, void * context)
+        {
+            throw_if_needed(libusbp_async_in_pipe_set_callback(
+                pointer, callback, context));
+        }
+
+        /*! Wrapper for libusbp_async_in_pipe_enable_auto_tuning(). */
+        void enable_auto_tuning(const libusbp_async_in_tuning * settings)
+        {
+            throw_if_needed(libusbp_async_in_pipe_enable_auto_tuning(
+                pointer, settings));
+        }
+
+        /*! Wrapper for libusbp_async_in_pipe_get_transfer_info(). */
+        void get_transfer_info(size_t * transfer_count, size_t * transfer_size)
+        {
+            throw_if_needed(libusbp_async_in_pipe_get_transfer_info(
+                pointer, transfer_count, transfer_size));
+        }
+        #endif
+
         /*! Wrapper for libusbp_async_in_pipe_start_endless_transfers(). */
         void start_endless_transfers()
         {
@@ -292,6 +395,14 @@ namespace libusbp
             throw_if_needed(libusbp_async_in_pipe_handle_events(pointer));
         }
 
+        #ifdef __linux__
+        /*! Wrapper for libusbp_async_in_pipe_wait(). */
+        void wait(uint32_t timeout)
+        {
+            throw_if_needed(libusbp_async_in_pipe_wait(pointer, timeout));
+        }
+        #endif
+
         /*! Wrapper for libusbp_async_in_pipe_has_pending_transfers(). */
         bool has_pending_transfers()
         {
@@ -317,13 +428,319 @@ namespace libusbp
             return finished;
         }
 
+        #ifdef __linux__
+        /*! Wrapper for libusbp_async_in_pipe_handle_finished_transfer_v(). */
+        bool handle_finished_transfer_v(const libusbp_iovec * iov, size_t iov_count,
+            size_t * transferred, error * transfer_error)
+        {
+            libusbp_error ** error_out = NULL;
+            if (transfer_error != NULL)
+            {
+                transfer_error->pointer_reset();
+                error_out = transfer_error->pointer_to_pointer_get();
+            }
+
+            bool finished;
+            throw_if_needed(libusbp_async_in_pipe_handle_finished_transfer_v(
+                pointer, &finished, iov, iov_count, transferred, error_out));
+            return finished;
+        }
+
+        /*! Wrapper for libusbp_async_in_pipe_handle_finished_transfer_ex(). */
+        bool handle_finished_transfer_ex(void * buffer, size_t * transferred,
+            libusbp_transfer_times * times, error * transfer_error)
+        {
+            libusbp_error ** error_out = NULL;
+            if (transfer_error != NULL)
+            {
+                transfer_error->pointer_reset();
+                error_out = transfer_error->pointer_to_pointer_get();
+            }
+
+            bool finished;
+            throw_if_needed(libusbp_async_in_pipe_handle_finished_transfer_ex(
+                pointer, &finished, buffer, transferred, times, error_out));
+            return finished;
+        }
+
+        /*! Wrapper for libusbp_async_in_pipe_set_timestamp_clock(). */
+        void set_timestamp_clock(uint32_t clock)
+        {
+            throw_if_needed(libusbp_async_in_pipe_set_timestamp_clock(pointer, clock));
+        }
+        #endif
+
+        /*! Wrapper for libusbp_async_in_pipe_borrow_finished_transfer(). */
+        bool borrow_finished_transfer(const uint8_t ** data, size_t * transferred,
+            error * transfer_error)
+        {
+            libusbp_error ** error_out = NULL;
+            if (transfer_error != NULL)
+            {
+                transfer_error->pointer_reset();
+                error_out = transfer_error->pointer_to_pointer_get();
+            }
+
+            bool finished;
+            throw_if_needed(libusbp_async_in_pipe_borrow_finished_transfer(
+                pointer, &finished, data, transferred, error_out));
+            return finished;
+        }
+
+        /*! Wrapper for libusbp_async_in_pipe_release_transfer(). */
+        void release_transfer(const uint8_t * data)
+        {
+            throw_if_needed(libusbp_async_in_pipe_release_transfer(pointer, data));
+        }
+
         /*! Wrapper for libusbp_async_in_pipe_cancel_transfers(). */
         void cancel_transfers()
         {
             throw_if_needed(libusbp_async_in_pipe_cancel_transfers(pointer));
         }
+
+        #ifdef __linux__
+        /*! Wrapper for libusbp_async_in_pipe_cancel_transfers_and_drain(). */
+        void cancel_transfers_and_drain(uint32_t timeout)
+        {
+            throw_if_needed(libusbp_async_in_pipe_cancel_transfers_and_drain(
+                pointer, timeout));
+        }
+        #endif
+    };
+
+    #ifdef __linux__
+    /*! Wrapper for a ::libusbp_async_out_pipe pointer. */
+    class async_out_pipe : public unique_pointer_wrapper<libusbp_async_out_pipe>
+    {
+    public:
+        /*! Constructor that takes a pointer. */
+        explicit async_out_pipe(libusbp_async_out_pipe * pointer = NULL)
+            : unique_pointer_wrapper(pointer)
+        {
+        }
+
+        /*! Wrapper for libusbp_async_out_pipe_allocate_transfers(). */
+        void allocate_transfers(size_t transfer_count, size_t transfer_size)
+        {
+            throw_if_needed(libusbp_async_out_pipe_allocate_transfers(
+                pointer, transfer_count, transfer_size));
+        }
+
+        /*! Wrapper for libusbp_async_out_pipe_submit_transfer(). */
+        bool submit_transfer(const void * buffer, size_t size)
+        {
+            bool submitted;
+            throw_if_needed(libusbp_async_out_pipe_submit_transfer(
+                pointer, buffer, size, &submitted));
+            return submitted;
+        }
+
+        /*! Wrapper for libusbp_async_out_pipe_submit_transfer_with_flags(). */
+        bool submit_transfer_with_flags(const void * buffer, size_t size, uint32_t flags)
+        {
+            bool submitted;
+            throw_if_needed(libusbp_async_out_pipe_submit_transfer_with_flags(
+                pointer, buffer, size, flags, &submitted));
+            return submitted;
+        }
+
+        /*! Wrapper for libusbp_async_out_pipe_handle_events(). */
+        void handle_events()
+        {
+            throw_if_needed(libusbp_async_out_pipe_handle_events(pointer));
+        }
+
+        /*! Wrapper for libusbp_async_out_pipe_wait(). */
+        void wait(uint32_t timeout)
+        {
+            throw_if_needed(libusbp_async_out_pipe_wait(pointer, timeout));
+        }
+
+        /*! Wrapper for libusbp_async_out_pipe_has_pending_transfers(). */
+        bool has_pending_transfers()
+        {
+            bool result;
+            throw_if_needed(libusbp_async_out_pipe_has_pending_transfers(pointer, &result));
+            return result;
+        }
+
+        /*! Wrapper for libusbp_async_out_pipe_handle_finished_transfer(). */
+        bool handle_finished_transfer(size_t * transferred, error * transfer_error)
+        {
+            libusbp_error ** error_out = NULL;
+            if (transfer_error != NULL)
+            {
+                transfer_error->pointer_reset();
+                error_out = transfer_error->pointer_to_pointer_get();
+            }
+
+            bool finished;
+            throw_if_needed(libusbp_async_out_pipe_handle_finished_transfer(
+                pointer, &finished, transferred, error_out));
+            return finished;
+        }
+
+        /*! Wrapper for libusbp_async_out_pipe_cancel_transfers(). */
+        void cancel_transfers()
+        {
+            throw_if_needed(libusbp_async_out_pipe_cancel_transfers(pointer));
+        }
     };
 
+    /*! Wrapper for a ::libusbp_async_control_pipe pointer. */
+    class async_control_pipe : public unique_pointer_wrapper<libusbp_async_control_pipe>
+    {
+    public:
+        /*! Constructor that takes a pointer. */
+        explicit async_control_pipe(libusbp_async_control_pipe * pointer = NULL)
+            : unique_pointer_wrapper(pointer)
+        {
+        }
+
+        /*! Wrapper for libusbp_async_control_pipe_allocate_transfers(). */
+        void allocate_transfers(size_t transfer_count, size_t max_data_size)
+        {
+            throw_if_needed(libusbp_async_control_pipe_allocate_transfers(
+                pointer, transfer_count, max_data_size));
+        }
+
+        /*! Wrapper for libusbp_async_control_pipe_submit_transfer(). */
+        bool submit_transfer(uint8_t bmRequestType, uint8_t bRequest,
+            uint16_t wValue, uint16_t wIndex, const void * data = NULL,
+            uint16_t wLength = 0)
+        {
+            bool submitted;
+            throw_if_needed(libusbp_async_control_pipe_submit_transfer(
+                pointer, bmRequestType, bRequest, wValue, wIndex,
+                data, wLength, &submitted));
+            return submitted;
+        }
+
+        /*! Wrapper for libusbp_async_control_pipe_handle_events(). */
+        void handle_events()
+        {
+            throw_if_needed(libusbp_async_control_pipe_handle_events(pointer));
+        }
+
+        /*! Wrapper for libusbp_async_control_pipe_wait(). */
+        void wait(uint32_t timeout)
+        {
+            throw_if_needed(libusbp_async_control_pipe_wait(pointer, timeout));
+        }
+
+        /*! Wrapper for libusbp_async_control_pipe_has_pending_transfers(). */
+        bool has_pending_transfers()
+        {
+            bool result;
+            throw_if_needed(libusbp_async_control_pipe_has_pending_transfers(
+                pointer, &result));
+            return result;
+        }
+
+        /*! Wrapper for libusbp_async_control_pipe_handle_finished_transfer(). */
+        bool handle_finished_transfer(void * buffer, size_t * transferred,
+            error * transfer_error)
+        {
+            libusbp_error ** error_out = NULL;
+            if (transfer_error != NULL)
+            {
+                transfer_error->pointer_reset();
+                error_out = transfer_error->pointer_to_pointer_get();
+            }
+
+            bool finished;
+            throw_if_needed(libusbp_async_control_pipe_handle_finished_transfer(
+                pointer, &finished, buffer, transferred, error_out));
+            return finished;
+        }
+
+        /*! Wrapper for libusbp_async_control_pipe_cancel_transfers(). */
+        void cancel_transfers()
+        {
+            throw_if_needed(libusbp_async_control_pipe_cancel_transfers(pointer));
+        }
+    };
+
+    /*! Wrapper for a ::libusbp_iso_pipe pointer. */
+    class iso_pipe : public unique_pointer_wrapper<libusbp_iso_pipe>
+    {
+    public:
+        /*! Constructor that takes a pointer. */
+        explicit iso_pipe(libusbp_iso_pipe * pointer = NULL)
+            : unique_pointer_wrapper(pointer)
+        {
+        }
+
+        /*! Wrapper for libusbp_iso_pipe_allocate_transfers(). */
+        void allocate_transfers(size_t transfer_count,
+            size_t packets_per_transfer, size_t packet_size)
+        {
+            throw_if_needed(libusbp_iso_pipe_allocate_transfers(
+                pointer, transfer_count, packets_per_transfer, packet_size));
+        }
+
+        /*! Wrapper for libusbp_iso_pipe_start_endless_transfers(). */
+        void start_endless_transfers()
+        {
+            throw_if_needed(libusbp_iso_pipe_start_endless_transfers(pointer));
+        }
+
+        /*! Wrapper for libusbp_iso_pipe_submit_transfer(). */
+        bool submit_transfer(const void * buffer, const size_t * packet_lengths,
+            size_t packet_count)
+        {
+            bool submitted;
+            throw_if_needed(libusbp_iso_pipe_submit_transfer(
+                pointer, buffer, packet_lengths, packet_count, &submitted));
+            return submitted;
+        }
+
+        /*! Wrapper for libusbp_iso_pipe_handle_events(). */
+        void handle_events()
+        {
+            throw_if_needed(libusbp_iso_pipe_handle_events(pointer));
+        }
+
+        /*! Wrapper for libusbp_iso_pipe_wait(). */
+        void wait(uint32_t timeout)
+        {
+            throw_if_needed(libusbp_iso_pipe_wait(pointer, timeout));
+        }
+
+        /*! Wrapper for libusbp_iso_pipe_has_pending_transfers(). */
+        bool has_pending_transfers()
+        {
+            bool result;
+            throw_if_needed(libusbp_iso_pipe_has_pending_transfers(pointer, &result));
+            return result;
+        }
+
+        /*! Wrapper for libusbp_iso_pipe_handle_finished_transfer(). */
+        bool handle_finished_transfer(void * buffer, libusbp_iso_packet * packets,
+            size_t * packet_count, error * transfer_error)
+        {
+            libusbp_error ** error_out = NULL;
+            if (transfer_error != NULL)
+            {
+                transfer_error->pointer_reset();
+                error_out = transfer_error->pointer_to_pointer_get();
+            }
+
+            bool finished;
+            throw_if_needed(libusbp_iso_pipe_handle_finished_transfer(
+                pointer, &finished, buffer, packets, packet_count, error_out));
+            return finished;
+        }
+
+        /*! Wrapper for libusbp_iso_pipe_cancel_transfers(). */
+        void cancel_transfers()
+        {
+            throw_if_needed(libusbp_iso_pipe_cancel_transfers(pointer));
+        }
+    };
+    #endif
+
     /*! Wrapper for a ::libusbp_device pointer. */
     class device : public unique_pointer_wrapper_with_copy<libusbp_device>
     {
@@ -475,6 +892,35 @@ namespace libusbp
             return async_in_pipe(pipe);
         }
 
+        #ifdef __linux__
+        /*! Wrapper for libusbp_generic_handle_open_async_out_pipe(). */
+        async_out_pipe open_async_out_pipe(uint8_t pipe_id)
+        {
+            libusbp_async_out_pipe * pipe;
+            throw_if_needed(libusbp_generic_handle_open_async_out_pipe(
+                pointer, pipe_id, &pipe));
+            return async_out_pipe(pipe);
+        }
+
+        /*! Wrapper for libusbp_generic_handle_open_async_control_pipe(). */
+        async_control_pipe open_async_control_pipe()
+        {
+            libusbp_async_control_pipe * pipe;
+            throw_if_needed(libusbp_generic_handle_open_async_control_pipe(
+                pointer, &pipe));
+            return async_control_pipe(pipe);
+        }
+
+        /*! Wrapper for libusbp_generic_handle_open_iso_pipe(). */
+        iso_pipe open_iso_pipe(uint8_t pipe_id)
+        {
+            libusbp_iso_pipe * pipe;
+            throw_if_needed(libusbp_generic_handle_open_iso_pipe(
+                pointer, pipe_id, &pipe));
+            return iso_pipe(pipe);
+        }
+        #endif
+
         /*! Wrapper for libusbp_generic_handle_set_timeout(). */
         void set_timeout(uint8_t pipe_id, uint32_t timeout)
         {
@@ -526,6 +972,75 @@ namespace libusbp
         {
             return libusbp_generic_handle_get_fd(pointer);
         }
+
+        /*! Wrapper for libusbp_generic_handle_set_pipe_flags(). */
+        void set_pipe_flags(uint8_t pipe_id, uint32_t flags)
+        {
+            throw_if_needed(libusbp_generic_handle_set_pipe_flags(pointer, pipe_id, flags));
+        }
+
+        /*! Wrapper for libusbp_write_pipe_with_flags(). */
+        void write_pipe_with_flags(uint8_t pipe_id, const void * buffer,
+            size_t size, uint32_t flags, size_t * transferred)
+        {
+            throw_if_needed(libusbp_write_pipe_with_flags(pointer,
+                pipe_id, buffer, size, flags, transferred));
+        }
+
+        /*! Wrapper for libusbp_read_pipe_with_flags(). */
+        void read_pipe_with_flags(uint8_t pipe_id, void * buffer,
+            size_t size, uint32_t flags, size_t * transferred)
+        {
+            throw_if_needed(libusbp_read_pipe_with_flags(pointer,
+                pipe_id, buffer, size, flags, transferred));
+        }
+
+        /*! Wrapper for libusbp_write_pipe_v(). */
+        void write_pipe_v(uint8_t pipe_id, const libusbp_iovec * iov,
+            size_t iov_count, size_t * transferred)
+        {
+            throw_if_needed(libusbp_write_pipe_v(pointer,
+                pipe_id, iov, iov_count, transferred));
+        }
+
+        /*! Wrapper for libusbp_read_pipe_v(). */
+        void read_pipe_v(uint8_t pipe_id, const libusbp_iovec * iov,
+            size_t iov_count, size_t * transferred)
+        {
+            throw_if_needed(libusbp_read_pipe_v(pointer,
+                pipe_id, iov, iov_count, transferred));
+        }
+
+        /*! Wrapper for libusbp_generic_handle_wait(). */
+        void wait(uint32_t timeout)
+        {
+            throw_if_needed(libusbp_generic_handle_wait(pointer, timeout));
+        }
+
+        /*! Wrapper for libusbp_generic_handle_set_zero_copy(). */
+        void set_zero_copy(bool enabled)
+        {
+            throw_if_needed(libusbp_generic_handle_set_zero_copy(pointer, enabled));
+        }
+
+        /*! Wrapper for libusbp_generic_handle_set_alternate_setting(). */
+        void set_alternate_setting(uint8_t alternate_setting)
+        {
+            throw_if_needed(libusbp_generic_handle_set_alternate_setting(
+                pointer, alternate_setting));
+        }
+
+        /*! Wrapper for libusbp_generic_handle_start_reaper_thread(). */
+        void start_reaper_thread()
+        {
+            throw_if_needed(libusbp_generic_handle_start_reaper_thread(pointer));
+        }
+
+        /*! Wrapper for libusbp_generic_handle_stop_reaper_thread(). */
+        void stop_reaper_thread()
+        {
+            throw_if_needed(libusbp_generic_handle_stop_reaper_thread(pointer));
+        }
         #endif
 
         #ifdef __APPLE__
@@ -537,6 +1052,88 @@ namespace libusbp
         #endif
     };
 
+    #ifdef __linux__
+    /*! Wrapper for a ::libusbp_event_loop pointer. */
+    class event_loop : public unique_pointer_wrapper<libusbp_event_loop>
+    {
+    public:
+        /*! Constructor that takes a pointer.  This object will free the pointer
+         *  when it is destroyed. */
+        explicit event_loop(libusbp_event_loop * pointer = NULL) noexcept
+            : unique_pointer_wrapper(pointer)
+        {
+        }
+
+        /*! Wrapper for libusbp_event_loop_create(). */
+        static event_loop create()
+        {
+            libusbp_event_loop * loop;
+            throw_if_needed(libusbp_event_loop_create(&loop));
+            return event_loop(loop);
+        }
+
+        /*! Wrapper for libusbp_event_loop_add_handle(). */
+        void add_handle(const generic_handle & handle)
+        {
+            throw_if_needed(libusbp_event_loop_add_handle(
+                pointer, handle.pointer_get()));
+        }
+
+        /*! Wrapper for libusbp_event_loop_remove_handle(). */
+        void remove_handle(const generic_handle & handle)
+        {
+            throw_if_needed(libusbp_event_loop_remove_handle(
+                pointer, handle.pointer_get()));
+        }
+
+        /*! Wrapper for libusbp_event_loop_add_async_in_pipe(). */
+        void add_async_in_pipe(const async_in_pipe & pipe)
+        {
+            throw_if_needed(libusbp_event_loop_add_async_in_pipe(
+                pointer, pipe.pointer_get()));
+        }
+
+        /*! Wrapper for libusbp_event_loop_remove_async_in_pipe(). */
+        void remove_async_in_pipe(const async_in_pipe & pipe)
+        {
+            throw_if_needed(libusbp_event_loop_remove_async_in_pipe(
+                pointer, pipe.pointer_get()));
+        }
+
+        /*! Wrapper for libusbp_event_loop_add_async_out_pipe(). */
+        void add_async_out_pipe(const async_out_pipe & pipe)
+        {
+            throw_if_needed(libusbp_event_loop_add_async_out_pipe(
+                pointer, pipe.pointer_get()));
+        }
+
+        /*! Wrapper for libusbp_event_loop_remove_async_out_pipe(). */
+        void remove_async_out_pipe(const async_out_pipe & pipe)
+        {
+            throw_if_needed(libusbp_event_loop_remove_async_out_pipe(
+                pointer, pipe.pointer_get()));
+        }
+
+        /*! Wrapper for libusbp_event_loop_get_fd(). */
+        int get_fd()
+        {
+            return libusbp_event_loop_get_fd(pointer);
+        }
+
+        /*! Wrapper for libusbp_event_loop_handle_events(). */
+        void handle_events()
+        {
+            throw_if_needed(libusbp_event_loop_handle_events(pointer));
+        }
+
+        /*! Wrapper for libusbp_event_loop_wait(). */
+        void wait(uint32_t timeout)
+        {
+            throw_if_needed(libusbp_event_loop_wait(pointer, timeout));
+        }
+    };
+    #endif
+
     /*! Wrapper for a ::libusbp_serial_port pointer. */
     class serial_port : public unique_pointer_wrapper_with_copy<libusbp_serial_port>
     {
@@ -566,5 +1163,225 @@ namespace libusbp
             return id;
         }
     };
+
+    #ifdef __linux__
+    /*! Wrapper for a ::libusbp_context pointer. */
+    class context : public unique_pointer_wrapper<libusbp_context>
+    {
+    public:
+        /*! Constructor that takes a pointer.  This object will free the pointer
+         *  when it is destroyed. */
+        explicit context(libusbp_context * pointer = NULL) noexcept
+            : unique_pointer_wrapper(pointer)
+        {
+        }
+
+        /*! Wrapper for libusbp_context_create(). */
+        static context create()
+        {
+            libusbp_context * ctx;
+            throw_if_needed(libusbp_context_create(&ctx));
+            return context(ctx);
+        }
+
+        /*! Wrapper for libusbp_context_create_sysfs(). */
+        static context create_sysfs(const char * sysfs_root = NULL)
+        {
+            libusbp_context * ctx;
+            throw_if_needed(libusbp_context_create_sysfs(sysfs_root, &ctx));
+            return context(ctx);
+        }
+
+        /*! Wrapper for libusbp_list_connected_devices_ctx(). */
+        std::vector<libusbp::device> list_connected_devices()
+        {
+            libusbp_device ** device_list;
+            size_t size;
+            throw_if_needed(libusbp_list_connected_devices_ctx(
+                    pointer, &device_list, &size));
+            std::vector<device> vector;
+            for(size_t i = 0; i < size; i++)
+            {
+                vector.push_back(device(device_list[i]));
+            }
+            libusbp_list_free(device_list);
+            return vector;
+        }
+
+        /*! Wrapper for libusbp_generic_interface_create_ctx(). */
+        libusbp::generic_interface create_generic_interface(const device & device,
+            uint8_t interface_number = 0, bool composite = false)
+        {
+            libusbp_generic_interface * gi;
+            throw_if_needed(libusbp_generic_interface_create_ctx(pointer,
+                    device.pointer_get(), interface_number, composite, &gi));
+            return generic_interface(gi);
+        }
+
+        /*! Wrapper for libusbp_serial_port_create_ctx(). */
+        libusbp::serial_port create_serial_port(const device & device,
+            uint8_t interface_number = 0, bool composite = false)
+        {
+            libusbp_serial_port * port;
+            throw_if_needed(libusbp_serial_port_create_ctx(pointer,
+                    device.pointer_get(), interface_number, composite, &port));
+            return serial_port(port);
+        }
+
+        /*! Wrapper for libusbp_list_devices_matching(). */
+        std::vector<libusbp::device> list_devices_matching(
+            const libusbp_device_filter & filter)
+        {
+            libusbp_device ** device_list;
+            size_t size;
+            throw_if_needed(libusbp_list_devices_matching(
+                    pointer, &filter, &device_list, &size));
+            std::vector<device> vector;
+            for(size_t i = 0; i < size; i++)
+            {
+                vector.push_back(device(device_list[i]));
+            }
+            libusbp_list_free(device_list);
+            return vector;
+        }
+
+        /*! Wrapper for libusbp_find_device_matching(). */
+        libusbp::device find_device_matching(const libusbp_device_filter & filter)
+        {
+            libusbp_device * device_pointer;
+            throw_if_needed(libusbp_find_device_matching(
+                    pointer, &filter, &device_pointer));
+            return device(device_pointer);
+        }
+    };
+
+    /*! Wrapper for libusbp_list_devices_matching() with no context. */
+    inline std::vector<libusbp::device> list_devices_matching(
+        const libusbp_device_filter & filter)
+    {
+        return context().list_devices_matching(filter);
+    }
+
+    /*! Wrapper for libusbp_find_device_matching() with no context. */
+    inline libusbp::device find_device_matching(const libusbp_device_filter & filter)
+    {
+        return context().find_device_matching(filter);
+    }
+
+    /*! Wrapper for a ::libusbp_hotplug_monitor pointer. */
+    class hotplug_monitor : public unique_pointer_wrapper<libusbp_hotplug_monitor>
+    {
+    public:
+        /*! Constructor that takes a pointer.  This object will free the pointer
+         *  when it is destroyed. */
+        explicit hotplug_monitor(libusbp_hotplug_monitor * pointer = NULL) noexcept
+            : unique_pointer_wrapper(pointer)
+        {
+        }
+
+        /*! Wrapper for libusbp_hotplug_monitor_create(). */
+        static hotplug_monitor create(const context & ctx = context())
+        {
+            libusbp_hotplug_monitor * monitor;
+            throw_if_needed(libusbp_hotplug_monitor_create(
+                    ctx.pointer_get(), &monitor));
+            return hotplug_monitor(monitor);
+        }
+
+        /*! Wrapper for libusbp_hotplug_monitor_get_fd(). */
+        int get_fd()
+        {
+            return libusbp_hotplug_monitor_get_fd(pointer);
+        }
+
+        /*! Wrapper for libusbp_hotplug_monitor_receive().  Returns a null
+         * device if there are no events. */
+        libusbp::device receive(uint32_t * event = NULL)
+        {
+            libusbp_device * device_pointer;
+            throw_if_needed(libusbp_hotplug_monitor_receive(
+                    pointer, event, &device_pointer));
+            return device(device_pointer);
+        }
+
+        /*! Wrapper for libusbp_hotplug_monitor_wait(). */
+        void wait(uint32_t timeout)
+        {
+            throw_if_needed(libusbp_hotplug_monitor_wait(pointer, timeout));
+        }
+    };
+
+    /*! Wrapper for a ::libusbp_device_index pointer.  The find methods return
+     * copies of the devices, so they allocate memory, unlike the C functions
+     * they wrap. */
+    class device_index : public unique_pointer_wrapper<libusbp_device_index>
+    {
+    public:
+        /*! Constructor that takes a pointer.  This object will free the pointer
+         *  when it is destroyed. */
+        explicit device_index(libusbp_device_index * pointer = NULL) noexcept
+            : unique_pointer_wrapper(pointer)
+        {
+        }
+
+        /*! Wrapper for libusbp_device_index_create(). */
+        static device_index create(const context & ctx = context())
+        {
+            libusbp_device_index * index;
+            throw_if_needed(libusbp_device_index_create(ctx.pointer_get(), &index));
+            return device_index(index);
+        }
+
+        /*! Wrapper for libusbp_device_index_get_fd(). */
+        int get_fd()
+        {
+            return libusbp_device_index_get_fd(pointer);
+        }
+
+        /*! Wrapper for libusbp_device_index_update().  Returns true if any
+         * devices were added or removed. */
+        bool update()
+        {
+            bool changed;
+            throw_if_needed(libusbp_device_index_update(pointer, &changed));
+            return changed;
+        }
+
+        /*! Wrapper for libusbp_device_index_get_count(). */
+        size_t get_count()
+        {
+            size_t count;
+            throw_if_needed(libusbp_device_index_get_count(pointer, &count));
+            return count;
+        }
+
+        /*! Wrapper for libusbp_device_index_find_by_os_id(). */
+        libusbp::device find_by_os_id(const std::string & id)
+        {
+            const libusbp_device * found;
+            throw_if_needed(libusbp_device_index_find_by_os_id(
+                    pointer, id.c_str(), &found));
+            return copy(found);
+        }
+
+        /*! Wrapper for libusbp_device_index_find(). */
+        libusbp::device find(uint16_t vendor_id, uint16_t product_id,
+            const char * serial_number = NULL)
+        {
+            const libusbp_device * found;
+            throw_if_needed(libusbp_device_index_find(
+                    pointer, vendor_id, product_id, serial_number, &found));
+            return copy(found);
+        }
+
+    private:
+        static libusbp::device copy(const libusbp_device * found)
+        {
+            libusbp_device * device_copy;
+            throw_if_needed(libusbp_device_copy(found, &device_copy));
+            return device(device_copy);
+        }
+    };
+    #endif
 }
 
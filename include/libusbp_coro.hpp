@@ -0,0 +1,598 @@
+// Copyright (C) Pololu Corporation.  See www.pololu.com for details.
+
+/*! \file libusbp_coro.hpp
+ *
+ * This optional header lets C++20 coroutines wait for asynchronous transfers
+ * with co_await, instead of calling the handle_events() and
+ * handle_finished_transfer() functions of each pipe by hand.  It is built on
+ * top of libusbp.hpp, which does not need C++20.
+ *
+ * A libusbp::executor runs coroutines for one libusbp::generic_handle.  The
+ * coroutines are libusbp::task objects, and they wait for transfers by
+ * awaiting the objects returned by executor::next(), executor::write(), and
+ * executor::control():
+ *
+ *     libusbp::task<void> blink(libusbp::executor & exec,
+ *         libusbp::async_control_pipe & pipe)
+ *     {
+ *         for (int i = 0; i < 10; i++)
+ *         {
+ *             libusbp::transfer_result r = co_await exec.control(pipe,
+ *                 0x40, 0x90, i & 1, 0);
+ *             if (r.transfer_error) { throw r.transfer_error; }
+ *         }
+ *     }
+ *
+ *     exec.run(blink(exec, pipe));
+ *
+ * Everything runs on the thread that calls executor::run() or
+ * executor::run_once(); the executor itself is not thread-safe.  The
+ * executor works whether or not the handle has a reaper thread.  This header
+ * is only useful on Linux. */
+
+#pragma once
+
+#include "libusbp.hpp"
+
+#if !defined(__cpp_impl_coroutine) || __cplusplus < 202002L
+#error This header requires C++20 coroutines.
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+
+namespace libusbp
+{
+    template <class T> class task;
+
+    /*! \cond */
+    template <class T> class task_promise;
+
+    class task_promise_base
+    {
+    public:
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        // When the task finishes, we resume whatever was awaiting it.
+        struct final_awaiter
+        {
+            bool await_ready() noexcept { return false; }
+
+            template <class P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+            {
+                std::coroutine_handle<> continuation = h.promise().continuation;
+                if (continuation) { return continuation; }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        final_awaiter final_suspend() noexcept { return {}; }
+
+        void unhandled_exception() noexcept
+        {
+            exception = std::current_exception();
+        }
+
+        void rethrow_if_needed()
+        {
+            if (exception) { std::rethrow_exception(exception); }
+        }
+
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+    };
+
+    template <class T>
+    class task_promise : public task_promise_base
+    {
+    public:
+        task<T> get_return_object() noexcept;
+
+        template <class U>
+        void return_value(U && v)
+        {
+            value.emplace(std::forward<U>(v));
+        }
+
+        T result()
+        {
+            rethrow_if_needed();
+            return std::move(*value);
+        }
+
+    private:
+        std::optional<T> value;
+    };
+
+    template <>
+    class task_promise<void> : public task_promise_base
+    {
+    public:
+        task<void> get_return_object() noexcept;
+
+        void return_void() noexcept {}
+
+        void result()
+        {
+            rethrow_if_needed();
+        }
+    };
+    /*! \endcond */
+
+    /*! A coroutine that produces a value of type T.  A task does not start
+     * running until it is awaited by another task or passed to
+     * executor::run() or executor::spawn().  Exceptions thrown inside the
+     * task are rethrown to whatever awaits it. */
+    template <class T = void>
+    class task
+    {
+    public:
+        /*! \cond */
+        using promise_type = task_promise<T>;
+        /*! \endcond */
+
+        /*! Constructor that takes ownership of a coroutine handle. */
+        explicit task(std::coroutine_handle<promise_type> coroutine = nullptr) noexcept
+            : coroutine(coroutine)
+        {
+        }
+
+        /*! Move constructor. */
+        task(task && other) noexcept
+            : coroutine(std::exchange(other.coroutine, nullptr))
+        {
+        }
+
+        /*! Move assignment operator. */
+        task & operator=(task && other) noexcept
+        {
+            if (this != &other)
+            {
+                destroy();
+                coroutine = std::exchange(other.coroutine, nullptr);
+            }
+            return *this;
+        }
+
+        task(const task &) = delete;
+        task & operator=(const task &) = delete;
+
+        /*! Destroys the coroutine. */
+        ~task()
+        {
+            destroy();
+        }
+
+        /*! Returns true if the task has finished running. */
+        bool done() const noexcept
+        {
+            return !coroutine || coroutine.done();
+        }
+
+        /*! \cond */
+        bool await_ready() const noexcept
+        {
+            return done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            coroutine.promise().continuation = awaiting;
+            return coroutine;
+        }
+
+        T await_resume()
+        {
+            return coroutine.promise().result();
+        }
+
+        std::coroutine_handle<promise_type> handle_get() const noexcept
+        {
+            return coroutine;
+        }
+        /*! \endcond */
+
+    private:
+        void destroy() noexcept
+        {
+            if (coroutine) { coroutine.destroy(); }
+            coroutine = nullptr;
+        }
+
+        std::coroutine_handle<promise_type> coroutine;
+    };
+
+    /*! \cond */
+    template <class T>
+    inline task<T> task_promise<T>::get_return_object() noexcept
+    {
+        return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+    }
+
+    inline task<void> task_promise<void>::get_return_object() noexcept
+    {
+        return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+    }
+    /*! \endcond */
+
+    /*! The result of an asynchronous transfer awaited with an executor. */
+    struct transfer_result
+    {
+        /*! The number of bytes transferred. */
+        size_t transferred = 0;
+
+        /*! The error that the transfer had, if any.  A cancelled transfer
+         * has an error with the ::LIBUSBP_ERROR_CANCELLED code. */
+        error transfer_error;
+    };
+
+    class executor;
+
+    /*! \cond */
+    // The base class of the objects that coroutines await to wait for a
+    // transfer.  Transfers on the same pipe finish in the order they were
+    // submitted, so the executor only lets the oldest waiter on each pipe
+    // handle a finished transfer, and only lets a waiter submit its transfer
+    // after the waiters before it on the same pipe have submitted theirs.
+    class transfer_awaitable
+    {
+    public:
+        transfer_awaitable(executor & exec, void * pipe) noexcept
+            : exec(exec), pipe(pipe)
+        {
+        }
+
+        virtual ~transfer_awaitable() = default;
+
+        transfer_awaitable(const transfer_awaitable &) = delete;
+        transfer_awaitable & operator=(const transfer_awaitable &) = delete;
+
+        bool await_ready() const noexcept { return false; }
+
+        inline bool await_suspend(std::coroutine_handle<> h);
+
+        transfer_result await_resume()
+        {
+            if (exception) { std::rethrow_exception(exception); }
+            return std::move(result);
+        }
+
+    protected:
+        // Tries to submit the transfer.  Returns false if the pipe has no
+        // free transfers.
+        virtual bool try_submit() { return true; }
+
+        // Tries to retrieve the result of the transfer from the pipe.
+        // Returns true if the transfer finished.
+        virtual bool try_finish() = 0;
+
+        transfer_result result;
+
+    private:
+        friend class executor;
+
+        executor & exec;
+        void * pipe;
+        std::coroutine_handle<> coroutine;
+        bool submitted = false;
+        std::exception_ptr exception;
+    };
+    /*! \endcond */
+
+    /*! Runs coroutines that wait for transfers on one generic handle.  See
+     * libusbp_coro.hpp for an example. */
+    class executor
+    {
+    public:
+        /*! Constructor.  The handle must outlive the executor. */
+        explicit executor(generic_handle & handle) noexcept
+            : handle(handle)
+        {
+        }
+
+        executor(const executor &) = delete;
+        executor & operator=(const executor &) = delete;
+
+        /*! Starts a task and keeps it alive until it finishes.  If the task
+         * throws an exception, it is rethrown from run_once(). */
+        void spawn(task<void> t)
+        {
+            std::coroutine_handle<> h = t.handle_get();
+            spawned.push_back(std::move(t));
+            h.resume();
+            collect_spawned();
+        }
+
+        /*! Starts a task and runs the executor until that task finishes, and
+         * then returns the task's result or rethrows its exception.  Tasks
+         * started with spawn() keep running while this function runs. */
+        template <class T>
+        T run(task<T> t)
+        {
+            t.handle_get().resume();
+            while (!t.done())
+            {
+                if (waiting.empty())
+                {
+                    throw std::logic_error(
+                        "The task is waiting for something that is not a transfer.");
+                }
+                run_once(0);
+            }
+            return t.handle_get().promise().result();
+        }
+
+        /*! Waits for transfers to finish, up to the specified timeout in
+         * milliseconds (0 means to wait forever), and then resumes the
+         * coroutines whose transfers finished.  This returns right away
+         * without waiting if there was already something to resume. */
+        void run_once(uint32_t timeout)
+        {
+            if (!resume_ready())
+            {
+                handle.wait(timeout);
+                resume_ready();
+            }
+            collect_spawned();
+        }
+
+        /*! Returns true if no coroutines are waiting for transfers. */
+        bool idle() const noexcept
+        {
+            return waiting.empty();
+        }
+
+        /*! \cond */
+        class next_awaitable : public transfer_awaitable
+        {
+        public:
+            next_awaitable(executor & exec, async_in_pipe & pipe, void * buffer) noexcept
+                : transfer_awaitable(exec, pipe.pointer_get()), in_pipe(pipe), buffer(buffer)
+            {
+            }
+
+        protected:
+            bool try_finish() override
+            {
+                return in_pipe.handle_finished_transfer(buffer,
+                    &result.transferred, &result.transfer_error);
+            }
+
+        private:
+            async_in_pipe & in_pipe;
+            void * buffer;
+        };
+
+        class write_awaitable : public transfer_awaitable
+        {
+        public:
+            write_awaitable(executor & exec, async_out_pipe & pipe,
+                const void * data, size_t size) noexcept
+                : transfer_awaitable(exec, pipe.pointer_get()), out_pipe(pipe),
+                  data(data), size(size)
+            {
+            }
+
+        protected:
+            bool try_submit() override
+            {
+                return out_pipe.submit_transfer(data, size);
+            }
+
+            bool try_finish() override
+            {
+                return out_pipe.handle_finished_transfer(
+                    &result.transferred, &result.transfer_error);
+            }
+
+        private:
+            async_out_pipe & out_pipe;
+            const void * data;
+            size_t size;
+        };
+
+        class control_awaitable : public transfer_awaitable
+        {
+        public:
+            control_awaitable(executor & exec, async_control_pipe & pipe,
+                uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue,
+                uint16_t wIndex, void * data, uint16_t wLength) noexcept
+                : transfer_awaitable(exec, pipe.pointer_get()), control_pipe(pipe),
+                  bmRequestType(bmRequestType), bRequest(bRequest), wValue(wValue),
+                  wIndex(wIndex), data(data), wLength(wLength)
+            {
+            }
+
+        protected:
+            bool try_submit() override
+            {
+                return control_pipe.submit_transfer(bmRequestType, bRequest,
+                    wValue, wIndex, data, wLength);
+            }
+
+            bool try_finish() override
+            {
+                return control_pipe.handle_finished_transfer(data,
+                    &result.transferred, &result.transfer_error);
+            }
+
+        private:
+            async_control_pipe & control_pipe;
+            uint8_t bmRequestType;
+            uint8_t bRequest;
+            uint16_t wValue;
+            uint16_t wIndex;
+            void * data;
+            uint16_t wLength;
+        };
+        /*! \endcond */
+
+        /*! Returns an object that can be awaited to get the next finished
+         * transfer of an asynchronous IN pipe, copying its data into
+         * @a buffer.  The pipe's transfers should already be running (see
+         * async_in_pipe::start_endless_transfers()), and the buffer must be
+         * at least as large as the pipe's transfer size. */
+        next_awaitable next(async_in_pipe & pipe, void * buffer) noexcept
+        {
+            return next_awaitable(*this, pipe, buffer);
+        }
+
+        /*! Returns an object that can be awaited to send data on an
+         * asynchronous OUT pipe.  The data must stay valid until the transfer
+         * has been submitted, which might not be until the object is
+         * awaited. */
+        write_awaitable write(async_out_pipe & pipe, const void * data, size_t size) noexcept
+        {
+            return write_awaitable(*this, pipe, data, size);
+        }
+
+        /*! Returns an object that can be awaited to perform a control transfer
+         * on an asynchronous control pipe.  For a device-to-host request, the
+         * data received is written to @a data, which must stay valid until
+         * the object has been awaited. */
+        control_awaitable control(async_control_pipe & pipe,
+            uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue,
+            uint16_t wIndex, void * data = nullptr, uint16_t wLength = 0) noexcept
+        {
+            return control_awaitable(*this, pipe, bmRequestType, bRequest,
+                wValue, wIndex, data, wLength);
+        }
+
+    private:
+        friend class transfer_awaitable;
+
+        // Returns true if some awaitable that is waiting on the same pipe has
+        // not been able to submit its transfer yet.
+        bool submission_blocked(void * pipe) const noexcept
+        {
+            for (transfer_awaitable * a : waiting)
+            {
+                if (a->pipe == pipe && !a->submitted) { return true; }
+            }
+            return false;
+        }
+
+        // Returns false if the coroutine should not be suspended because
+        // submitting its transfer failed.
+        bool suspend(transfer_awaitable * a)
+        {
+            if (!submission_blocked(a->pipe))
+            {
+                try
+                {
+                    a->submitted = a->try_submit();
+                }
+                catch (...)
+                {
+                    // Let the coroutine get the exception when it resumes.
+                    a->exception = std::current_exception();
+                    return false;
+                }
+            }
+            waiting.push_back(a);
+            return true;
+        }
+
+        // Submits the transfers that can be submitted, retrieves the results
+        // of finished transfers, and resumes the coroutines that were
+        // waiting for them.  Returns true if any coroutines were resumed.
+        bool resume_ready()
+        {
+            // The pipes with an earlier waiter that has not finished, and the
+            // pipes with an earlier waiter that has not submitted its transfer.
+            std::vector<void *> unfinished_pipes;
+            std::vector<void *> unsubmitted_pipes;
+
+            std::vector<transfer_awaitable *> still_waiting;
+            std::vector<transfer_awaitable *> resuming;
+            for (transfer_awaitable * a : waiting)
+            {
+                bool finished = false;
+                try
+                {
+                    if (!a->submitted && !contains(unsubmitted_pipes, a->pipe))
+                    {
+                        a->submitted = a->try_submit();
+                    }
+                    finished = a->submitted && !contains(unfinished_pipes, a->pipe) &&
+                        a->try_finish();
+                }
+                catch (...)
+                {
+                    a->exception = std::current_exception();
+                    finished = true;
+                }
+
+                if (finished)
+                {
+                    resuming.push_back(a);
+                    continue;
+                }
+
+                still_waiting.push_back(a);
+                unfinished_pipes.push_back(a->pipe);
+                if (!a->submitted) { unsubmitted_pipes.push_back(a->pipe); }
+            }
+
+            // Resuming a coroutine can make it await another transfer, which
+            // adds to the waiting list, so we update the list first.
+            waiting = std::move(still_waiting);
+            for (transfer_awaitable * a : resuming)
+            {
+                a->coroutine.resume();
+            }
+            return !resuming.empty();
+        }
+
+        static bool contains(const std::vector<void *> & pipes, void * pipe) noexcept
+        {
+            for (void * p : pipes)
+            {
+                if (p == pipe) { return true; }
+            }
+            return false;
+        }
+
+        // Frees the spawned tasks that have finished and rethrows the first
+        // exception one of them had.
+        void collect_spawned()
+        {
+            for (size_t i = 0; i < spawned.size(); )
+            {
+                if (spawned[i].done())
+                {
+                    task<void> t = std::move(spawned[i]);
+                    spawned.erase(spawned.begin() + i);
+                    t.handle_get().promise().result();
+                }
+                else
+                {
+                    i++;
+                }
+            }
+        }
+
+        generic_handle & handle;
+        std::vector<transfer_awaitable *> waiting;
+        std::vector<task<void>> spawned;
+    };
+
+    /*! \cond */
+    inline bool transfer_awaitable::await_suspend(std::coroutine_handle<> h)
+    {
+        coroutine = h;
+        return exec.suspend(this);
+    }
+    /*! \endcond */
+}
+
+#endif
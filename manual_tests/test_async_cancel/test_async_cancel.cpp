@@ -0,0 +1,98 @@
+/* Measures how long it takes to cancel the transfers of an asynchronous IN
+ * pipe, for different numbers of transfers.  For each transfer count, it
+ * starts endless transfers, lets them run for a moment, and then prints the
+ * time spent in cancel_transfers() and the total time until
+ * cancel_transfers_and_drain() has gotten every transfer back from the
+ * kernel.
+ *
+ * This is designed to connect to Test Device A and read from endpoint 0x82.
+ * To use a different device, change the constants below. */
+
+#include <libusbp.hpp>
+#include <stdio.h>
+#include <iostream>
+#include <chrono>
+#include <unistd.h>
+
+const uint16_t vendor_id = 0x1FFB;
+const uint16_t product_id = 0xDA01;
+const uint8_t interface_number = 0;
+const bool composite = true;
+const uint8_t endpoint_address = 0x82;
+const size_t transfer_size = 5;
+const uint32_t drain_timeout_ms = 20000;
+const uint32_t run_time_us = 20000;
+const uint32_t repetitions = 5;
+
+typedef std::chrono::steady_clock test_clock;
+
+static uint32_t elapsed_us(test_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        test_clock::now() - start).count();
+}
+
+void test_cancel(libusbp::generic_handle & handle, size_t transfer_count)
+{
+    libusbp::async_in_pipe pipe = handle.open_async_in_pipe(endpoint_address);
+    pipe.allocate_transfers(transfer_count, transfer_size);
+
+    uint64_t cancel_us = 0;
+    uint64_t drain_us = 0;
+    for (uint32_t i = 0; i < repetitions; i++)
+    {
+        pipe.start_endless_transfers();
+        usleep(run_time_us);
+        pipe.handle_events();
+
+        test_clock::time_point start = test_clock::now();
+        pipe.cancel_transfers();
+        cancel_us += elapsed_us(start);
+        pipe.cancel_transfers_and_drain(drain_timeout_ms);
+        drain_us += elapsed_us(start);
+    }
+
+    printf("%5u transfers: cancel %8.1f us, cancel and drain %8.1f us\n",
+        (unsigned int)transfer_count,
+        (double)cancel_us / repetitions, (double)drain_us / repetitions);
+    fflush(stdout);
+}
+
+int main_with_exceptions()
+{
+    libusbp::device device = libusbp::find_device_with_vid_pid(vendor_id, product_id);
+    if (!device)
+    {
+        std::cerr << "Device not found." << std::endl;
+        return 1;
+    }
+
+    libusbp::generic_interface gi(device, interface_number, composite);
+    libusbp::generic_handle handle(gi);
+
+    test_cancel(handle, 1);
+    test_cancel(handle, 4);
+    test_cancel(handle, 16);
+    test_cancel(handle, 64);
+    test_cancel(handle, 256);
+    test_cancel(handle, 1024);
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    // Suppress unused parameter warnings.
+    (void)argc;
+    (void)argv;
+
+    try
+    {
+        return main_with_exceptions();
+    }
+    catch(const std::exception & error)
+    {
+        std::cerr << "Error: " << error.what() << std::endl;
+    }
+    return 1;
+}
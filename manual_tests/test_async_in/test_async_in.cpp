@@ -84,8 +84,12 @@ int main_with_exceptions()
             }
         }
 
+        #ifdef __linux__
+        pipe.wait(0);
+        #else
         pipe.handle_events();
         usleep(20000);
+        #endif
     }
 }
 
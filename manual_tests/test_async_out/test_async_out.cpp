@@ -0,0 +1,127 @@
+/* Measures how fast libusbp can write data to an OUT endpoint, first with
+ * synchronous writes (libusbp_write_pipe), then with an asynchronous OUT pipe
+ * with different numbers of transfers queued up at once.  It prints the
+ * throughput of each method to the standard output.
+ *
+ * This is designed to connect to Test Device A and write to endpoint 0x03,
+ * which discards any packet that does not start with a command byte.  To
+ * benchmark against a different device, such as a dummy_hcd gadget with a
+ * FunctionFS bulk sink, change the constants below. */
+
+#include <libusbp.hpp>
+#include <stdio.h>
+#include <iostream>
+#include <chrono>
+#include <vector>
+
+const uint16_t vendor_id = 0x1FFB;
+const uint16_t product_id = 0xDA01;
+const uint8_t interface_number = 0;
+const bool composite = true;
+const uint8_t endpoint_address = 0x03;
+const size_t packet_size = 32;
+const size_t transfer_size = packet_size * 16;
+const uint32_t test_duration_ms = 2000;
+
+typedef std::chrono::steady_clock test_clock;
+
+static uint32_t elapsed_ms(test_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        test_clock::now() - start).count();
+}
+
+static void print_result(const char * name, uint64_t byte_count, uint32_t ms)
+{
+    printf("%-24s %10llu bytes in %5u ms: %8.1f kB/s\n", name,
+        (unsigned long long)byte_count, ms, (double)byte_count / ms);
+    fflush(stdout);
+}
+
+void test_sync(libusbp::generic_handle & handle)
+{
+    std::vector<uint8_t> buffer(transfer_size, 0);
+    uint64_t byte_count = 0;
+    test_clock::time_point start = test_clock::now();
+    while (elapsed_ms(start) < test_duration_ms)
+    {
+        size_t transferred;
+        handle.write_pipe(endpoint_address, buffer.data(), buffer.size(), &transferred);
+        byte_count += transferred;
+    }
+    print_result("write_pipe", byte_count, elapsed_ms(start));
+}
+
+void test_async(libusbp::generic_handle & handle, size_t transfer_count)
+{
+    libusbp::async_out_pipe pipe = handle.open_async_out_pipe(endpoint_address);
+    pipe.allocate_transfers(transfer_count, transfer_size);
+
+    std::vector<uint8_t> buffer(transfer_size, 0);
+    uint64_t byte_count = 0;
+    test_clock::time_point start = test_clock::now();
+    while (true)
+    {
+        bool time_is_up = elapsed_ms(start) >= test_duration_ms;
+
+        // Keep every transfer busy until the time is up.
+        while (!time_is_up && pipe.submit_transfer(buffer.data(), buffer.size()))
+        {
+        }
+
+        pipe.handle_events();
+
+        size_t transferred;
+        libusbp::error transfer_error;
+        while (pipe.handle_finished_transfer(&transferred, &transfer_error))
+        {
+            if (transfer_error) { throw transfer_error; }
+            byte_count += transferred;
+        }
+
+        if (time_is_up && !pipe.has_pending_transfers()) { break; }
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "async_out_pipe x%u", (unsigned int)transfer_count);
+    print_result(name, byte_count, elapsed_ms(start));
+}
+
+int main_with_exceptions()
+{
+    libusbp::device device = libusbp::find_device_with_vid_pid(vendor_id, product_id);
+    if (!device)
+    {
+        std::cerr << "Device not found." << std::endl;
+        return 1;
+    }
+
+    libusbp::generic_interface gi(device, interface_number, composite);
+    libusbp::generic_handle handle(gi);
+
+    test_sync(handle);
+    test_async(handle, 1);
+    test_async(handle, 2);
+    test_async(handle, 4);
+    test_async(handle, 16);
+    test_async(handle, 64);
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    // Suppress unused parameter warnings.
+    (void)argc;
+    (void)argv;
+
+    try
+    {
+        return main_with_exceptions();
+    }
+    catch(const std::exception & error)
+    {
+        std::cerr << "Error: " << error.what() << std::endl;
+    }
+    return 1;
+}
@@ -0,0 +1,171 @@
+/* Compares two ways of waiting for asynchronous transfers to finish: calling
+ * handle_events() in a loop with usleep(), and blocking in wait().  For each
+ * method, it measures the average time from submitting a transfer to learning
+ * that it finished (the wake-up latency), and the CPU time used while reading
+ * a stream of data from an IN endpoint.
+ *
+ * This is designed to connect to Test Device A, writing to endpoint 0x03 and
+ * reading from endpoint 0x82.  To use a different device, change the constants
+ * below. */
+
+#include <libusbp.hpp>
+#include <stdio.h>
+#include <iostream>
+#include <chrono>
+#include <unistd.h>
+#include <sys/resource.h>
+
+const uint16_t vendor_id = 0x1FFB;
+const uint16_t product_id = 0xDA01;
+const uint8_t interface_number = 0;
+const bool composite = true;
+const uint8_t out_endpoint_address = 0x03;
+const uint8_t in_endpoint_address = 0x82;
+const size_t in_transfer_size = 5;
+const size_t in_transfer_count = 250;
+const uint32_t latency_iterations = 1000;
+const uint32_t stream_duration_ms = 4000;
+const uint32_t poll_interval_us = 500;
+
+typedef std::chrono::steady_clock test_clock;
+
+static uint32_t elapsed_us(test_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        test_clock::now() - start).count();
+}
+
+// Returns the user and system CPU time used by this process, in microseconds.
+static uint64_t cpu_time_us()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+        usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+void test_latency(libusbp::generic_handle & handle, bool use_wait)
+{
+    libusbp::async_out_pipe pipe = handle.open_async_out_pipe(out_endpoint_address);
+    pipe.allocate_transfers(1, 32);
+
+    // Each packet just stores a byte in the device.
+    uint8_t buffer[32] = { 0x92, 0x11 };
+
+    uint64_t total_us = 0;
+    for (uint32_t i = 0; i < latency_iterations; i++)
+    {
+        test_clock::time_point start = test_clock::now();
+        pipe.submit_transfer(buffer, sizeof(buffer));
+
+        while (true)
+        {
+            if (use_wait)
+            {
+                pipe.wait(0);
+            }
+            else
+            {
+                pipe.handle_events();
+            }
+
+            libusbp::error transfer_error;
+            if (pipe.handle_finished_transfer(NULL, &transfer_error))
+            {
+                if (transfer_error) { throw transfer_error; }
+                break;
+            }
+
+            if (!use_wait) { usleep(poll_interval_us); }
+        }
+        total_us += elapsed_us(start);
+    }
+
+    printf("%-14s latency: %8.1f us per transfer\n",
+        use_wait ? "wait" : "usleep loop", (double)total_us / latency_iterations);
+    fflush(stdout);
+}
+
+void test_stream_cpu(libusbp::generic_handle & handle, bool use_wait)
+{
+    libusbp::async_in_pipe pipe = handle.open_async_in_pipe(in_endpoint_address);
+    pipe.allocate_transfers(in_transfer_count, in_transfer_size);
+
+    uint64_t transfer_count = 0;
+    uint64_t cpu_start = cpu_time_us();
+    test_clock::time_point start = test_clock::now();
+
+    pipe.start_endless_transfers();
+    while (elapsed_us(start) < stream_duration_ms * 1000)
+    {
+        if (use_wait)
+        {
+            pipe.wait(100);
+        }
+        else
+        {
+            pipe.handle_events();
+            usleep(poll_interval_us);
+        }
+
+        uint8_t buffer[in_transfer_size];
+        libusbp::error transfer_error;
+        while (pipe.handle_finished_transfer(buffer, NULL, &transfer_error))
+        {
+            if (transfer_error) { throw transfer_error; }
+            transfer_count++;
+        }
+    }
+
+    uint64_t cpu_us = cpu_time_us() - cpu_start;
+
+    pipe.cancel_transfers();
+    while (pipe.has_pending_transfers())
+    {
+        pipe.handle_events();
+        while (pipe.handle_finished_transfer(NULL, NULL, NULL)) { }
+        usleep(1000);
+    }
+
+    printf("%-14s stream: %8llu transfers, %8.1f ms CPU in %u ms\n",
+        use_wait ? "wait" : "usleep loop", (unsigned long long)transfer_count,
+        cpu_us / 1000.0, stream_duration_ms);
+    fflush(stdout);
+}
+
+int main_with_exceptions()
+{
+    libusbp::device device = libusbp::find_device_with_vid_pid(vendor_id, product_id);
+    if (!device)
+    {
+        std::cerr << "Device not found." << std::endl;
+        return 1;
+    }
+
+    libusbp::generic_interface gi(device, interface_number, composite);
+    libusbp::generic_handle handle(gi);
+
+    test_latency(handle, false);
+    test_latency(handle, true);
+    test_stream_cpu(handle, false);
+    test_stream_cpu(handle, true);
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    // Suppress unused parameter warnings.
+    (void)argc;
+    (void)argv;
+
+    try
+    {
+        return main_with_exceptions();
+    }
+    catch(const std::exception & error)
+    {
+        std::cerr << "Error: " << error.what() << std::endl;
+    }
+    return 1;
+}
@@ -0,0 +1,136 @@
+/* Measures how the number of control transfers per second changes when
+ * several threads share one generic handle, each with its own asynchronous
+ * control pipe.  Every thread submits a transfer, waits for it with
+ * libusbp_async_control_pipe_wait, and repeats, so the threads are constantly
+ * reaping each other's URBs.  If waiting on a shared handle scales, the total
+ * rate should go up with the number of threads until the bus is saturated,
+ * instead of staying flat or dropping.
+ *
+ * The same test is then repeated with the reaper thread running.
+ *
+ * This is designed to connect to Test Device A. */
+
+#include <libusbp.hpp>
+#include <stdio.h>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+const uint16_t vendor_id = 0x1FFB;
+const uint16_t product_id = 0xDA01;
+const uint8_t interface_number = 0;
+const bool composite = true;
+const size_t max_thread_count = 8;
+const uint32_t test_duration_ms = 2000;
+
+typedef std::chrono::steady_clock test_clock;
+
+static uint32_t elapsed_ms(test_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        test_clock::now() - start).count();
+}
+
+static void run_thread(libusbp::async_control_pipe & pipe,
+    test_clock::time_point start, uint64_t & count)
+{
+    try
+    {
+        uint16_t led = 0;
+        while (elapsed_ms(start) < test_duration_ms)
+        {
+            led ^= 1;
+            pipe.submit_transfer(0x40, 0x90, led, 0);
+
+            libusbp::error transfer_error;
+            while (!pipe.handle_finished_transfer(NULL, NULL, &transfer_error))
+            {
+                pipe.wait(0);
+            }
+            if (transfer_error) { throw transfer_error; }
+            count++;
+        }
+    }
+    catch(const std::exception & error)
+    {
+        std::cerr << "Error: " << error.what() << std::endl;
+    }
+}
+
+static void test_threads(libusbp::generic_handle & handle,
+    const char * name, size_t thread_count)
+{
+    std::vector<libusbp::async_control_pipe> pipes;
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        pipes.push_back(handle.open_async_control_pipe());
+        pipes.back().allocate_transfers(1, 0);
+    }
+
+    std::vector<uint64_t> counts(thread_count, 0);
+    std::vector<std::thread> threads;
+    test_clock::time_point start = test_clock::now();
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        threads.emplace_back(run_thread, std::ref(pipes[i]), start,
+            std::ref(counts[i]));
+    }
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        threads[i].join();
+        total += counts[i];
+    }
+    uint32_t ms = elapsed_ms(start);
+
+    printf("%-9s %u threads: %8llu transfers in %5u ms: %8.1f transfers/s\n",
+        name, (unsigned int)thread_count, (unsigned long long)total, ms,
+        (double)total * 1000 / ms);
+    fflush(stdout);
+}
+
+int main_with_exceptions()
+{
+    libusbp::device device = libusbp::find_device_with_vid_pid(vendor_id, product_id);
+    if (!device)
+    {
+        std::cerr << "Device not found." << std::endl;
+        return 1;
+    }
+
+    libusbp::generic_interface gi(device, interface_number, composite);
+    libusbp::generic_handle handle(gi);
+
+    for (size_t n = 1; n <= max_thread_count; n *= 2)
+    {
+        test_threads(handle, "polling", n);
+    }
+
+    handle.start_reaper_thread();
+    for (size_t n = 1; n <= max_thread_count; n *= 2)
+    {
+        test_threads(handle, "reaper", n);
+    }
+    handle.stop_reaper_thread();
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    // Suppress unused parameter warnings.
+    (void)argc;
+    (void)argv;
+
+    try
+    {
+        return main_with_exceptions();
+    }
+    catch(const std::exception & error)
+    {
+        std::cerr << "Error: " << error.what() << std::endl;
+    }
+    return 1;
+}
@@ -0,0 +1,124 @@
+/* Measures how long it takes to find devices and create generic interfaces
+ * and serial ports, both with a new udev context for every call and with one
+ * libusbp_context that is reused.  This simulates a program that looks for
+ * its devices several times per second.
+ *
+ * The results depend heavily on how many USB devices the computer has.  To
+ * get repeatable numbers, you can run this against a recorded device tree with
+ * umockdev instead of the real one:
+ *
+ *   umockdev-record --all > tree.umockdev
+ *   umockdev-run --device tree.umockdev -- ./test_discovery_speed
+ *
+ * If Test Device A is connected (or recorded), the generic interface and
+ * serial port lookups are measured too.  Those look up the interface directly
+ * by its syspath, so their time should not depend on the number of devices.
+ * (Older versions of libusbp enumerated the whole "usb" subsystem to find an
+ * interface, which took about as long as list_connected_devices_ctx.)
+ *
+ * The same calls are also measured with a sysfs context, which reads sysfs
+ * directly instead of using libudev.  You can pass a sysfs root as an
+ * argument to measure it against a copy of a device tree:
+ *
+ *   ./test_discovery_speed /path/to/fixture/sys */
+
+#include <libusbp.hpp>
+#include <stdio.h>
+#include <iostream>
+#include <chrono>
+#include <functional>
+
+const uint16_t vendor_id = 0x1FFB;
+const uint16_t product_id = 0xDA01;
+const uint8_t interface_number = 0;
+const uint8_t serial_interface_number = 2;
+const bool composite = true;
+const uint32_t iteration_count = 200;
+
+typedef std::chrono::steady_clock test_clock;
+
+static void measure(const char * name, std::function<void()> operation)
+{
+    test_clock::time_point start = test_clock::now();
+    for (uint32_t i = 0; i < iteration_count; i++)
+    {
+        operation();
+    }
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+        test_clock::now() - start).count();
+    printf("%-40s %8.1f us per call\n", name, (double)us / iteration_count);
+    fflush(stdout);
+}
+
+int main_with_exceptions(const char * sysfs_root)
+{
+    libusbp::context context = libusbp::context::create();
+    libusbp::context sysfs_context = libusbp::context::create_sysfs(sysfs_root);
+
+    printf("Devices found: %u\n",
+        (unsigned int)libusbp::list_connected_devices().size());
+
+    measure("list_connected_devices", []{
+        libusbp::list_connected_devices();
+    });
+
+    measure("list_connected_devices_ctx", [&]{
+        context.list_connected_devices();
+    });
+
+    printf("Devices found with sysfs: %u\n",
+        (unsigned int)sysfs_context.list_connected_devices().size());
+
+    measure("list_connected_devices_ctx (sysfs)", [&]{
+        sysfs_context.list_connected_devices();
+    });
+
+    libusbp::device device = libusbp::find_device_with_vid_pid(vendor_id, product_id);
+    if (!device)
+    {
+        std::cout << "Test Device A not found, so interfaces were not tested."
+            << std::endl;
+        return 0;
+    }
+
+    measure("generic_interface_create", [&]{
+        libusbp::generic_interface gi(device, interface_number, composite);
+    });
+
+    measure("generic_interface_create_ctx", [&]{
+        context.create_generic_interface(device, interface_number, composite);
+    });
+
+    measure("generic_interface_create_ctx (sysfs)", [&]{
+        sysfs_context.create_generic_interface(device, interface_number, composite);
+    });
+
+    measure("serial_port_create", [&]{
+        libusbp::serial_port port(device, serial_interface_number, composite);
+    });
+
+    measure("serial_port_create_ctx", [&]{
+        context.create_serial_port(device, serial_interface_number, composite);
+    });
+
+    measure("serial_port_create_ctx (sysfs)", [&]{
+        sysfs_context.create_serial_port(device, serial_interface_number, composite);
+    });
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    const char * sysfs_root = argc > 1 ? argv[1] : NULL;
+
+    try
+    {
+        return main_with_exceptions(sysfs_root);
+    }
+    catch(const std::exception & error)
+    {
+        std::cerr << "Error: " << error.what() << std::endl;
+    }
+    return 1;
+}
@@ -0,0 +1,99 @@
+/* Prints the events reported by a libusbp_hotplug_monitor, and checks that a
+ * generic interface or serial port can be opened as soon as its event arrives.
+ * Connect and disconnect Test Device A (or any other device) while this runs.
+ * Unlike test_transitions, this does not poll, so it should report every
+ * connection even if the device is only connected briefly.
+ *
+ * To test without hardware, you can run this under umockdev and generate
+ * events with umockdev_testbed_uevent, or replay a recording made with
+ * umockdev-record --ioctl. */
+
+#include <libusbp.hpp>
+#include <stdio.h>
+#include <iostream>
+
+static const char * event_name(uint32_t event)
+{
+    switch (event)
+    {
+    case LIBUSBP_HOTPLUG_DEVICE_ADDED: return "Device added";
+    case LIBUSBP_HOTPLUG_DEVICE_REMOVED: return "Device removed";
+    case LIBUSBP_HOTPLUG_SERIAL_PORT_ADDED: return "Serial port added";
+    case LIBUSBP_HOTPLUG_SERIAL_PORT_REMOVED: return "Serial port removed";
+    default: return "Unknown event";
+    }
+}
+
+static void check_test_device_a(const libusbp::device & device, uint32_t event)
+{
+    if (device.get_vendor_id() != 0x1FFB || device.get_product_id() != 0xDA01)
+    {
+        return;
+    }
+
+    try
+    {
+        if (event == LIBUSBP_HOTPLUG_DEVICE_ADDED)
+        {
+            libusbp::generic_interface gi(device, 0, true);
+            libusbp::generic_handle handle(gi);
+            std::cout << "  Interface 0 works." << std::endl;
+        }
+        if (event == LIBUSBP_HOTPLUG_SERIAL_PORT_ADDED)
+        {
+            libusbp::serial_port port(device, 2, true);
+            std::cout << "  Serial port: " << port.get_name() << std::endl;
+        }
+    }
+    catch(const libusbp::error & error)
+    {
+        std::cout << "  Error: " << error.message() << std::endl;
+    }
+}
+
+int main_with_exceptions()
+{
+    libusbp::hotplug_monitor monitor = libusbp::hotplug_monitor::create();
+
+    for (const libusbp::device & device : libusbp::list_connected_devices())
+    {
+        printf("Already connected: %04x:%04x %s\n",
+            device.get_vendor_id(), device.get_product_id(),
+            device.get_os_id().c_str());
+    }
+    fflush(stdout);
+
+    while (1)
+    {
+        monitor.wait(0);
+
+        uint32_t event;
+        libusbp::device device;
+        while ((device = monitor.receive(&event)))
+        {
+            printf("%s: %04x:%04x %s\n", event_name(event),
+                device.get_vendor_id(), device.get_product_id(),
+                device.get_os_id().c_str());
+            fflush(stdout);
+            check_test_device_a(device, event);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    // Suppress unused parameter warnings.
+    (void)argc;
+    (void)argv;
+
+    try
+    {
+        return main_with_exceptions();
+    }
+    catch(const std::exception & error)
+    {
+        std::cerr << "Error: " << error.what() << std::endl;
+    }
+    return 1;
+}
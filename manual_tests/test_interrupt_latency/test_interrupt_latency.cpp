@@ -0,0 +1,135 @@
+/* Measures how regularly data arrives from an interrupt IN endpoint.  It reads
+ * from the endpoint with an asynchronous IN pipe (which submits interrupt URBs
+ * on Linux) and with synchronous reads (libusbp_read_pipe), records the time
+ * between consecutive transfers, and prints the minimum, average, and maximum
+ * interval for each method.  With correct interrupt scheduling, the intervals
+ * should stay close to the endpoint's polling interval.
+ *
+ * This is designed to connect to Test Device A and read from endpoint 0x82,
+ * which has a 1 ms polling interval.  To benchmark against a different device,
+ * such as a dummy_hcd gadget with a FunctionFS interrupt source, change the
+ * constants below. */
+
+#include <libusbp.hpp>
+#include <stdio.h>
+#include <iostream>
+#include <chrono>
+#include <vector>
+
+const uint16_t vendor_id = 0x1FFB;
+const uint16_t product_id = 0xDA01;
+const uint8_t interface_number = 0;
+const bool composite = true;
+const uint8_t endpoint_address = 0x82;
+const size_t transfer_size = 5;
+const size_t async_transfer_count = 8;
+const size_t sample_count = 2000;
+
+typedef std::chrono::steady_clock test_clock;
+
+class interval_stats
+{
+public:
+    void add(test_clock::time_point now)
+    {
+        if (started)
+        {
+            uint32_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+                now - last).count();
+            if (count == 0 || us < min_us) { min_us = us; }
+            if (count == 0 || us > max_us) { max_us = us; }
+            total_us += us;
+            count++;
+        }
+        started = true;
+        last = now;
+    }
+
+    void print(const char * name)
+    {
+        printf("%-16s %6u intervals: min %6u us, avg %8.1f us, max %6u us\n",
+            name, (unsigned int)count, min_us,
+            count ? (double)total_us / count : 0.0, max_us);
+        fflush(stdout);
+    }
+
+    size_t count = 0;
+
+private:
+    bool started = false;
+    test_clock::time_point last;
+    uint32_t min_us = 0;
+    uint32_t max_us = 0;
+    uint64_t total_us = 0;
+};
+
+void test_async(libusbp::generic_handle & handle)
+{
+    libusbp::async_in_pipe pipe = handle.open_async_in_pipe(endpoint_address);
+    pipe.allocate_transfers(async_transfer_count, transfer_size);
+    pipe.start_endless_transfers();
+
+    interval_stats stats;
+    while (stats.count < sample_count)
+    {
+        pipe.wait(0);
+
+        uint8_t buffer[transfer_size];
+        libusbp::error transfer_error;
+        while (pipe.handle_finished_transfer(buffer, NULL, &transfer_error))
+        {
+            if (transfer_error) { throw transfer_error; }
+            stats.add(test_clock::now());
+        }
+    }
+
+    pipe.cancel_transfers_and_drain(1000);
+    stats.print("async_in_pipe");
+}
+
+void test_sync(libusbp::generic_handle & handle)
+{
+    interval_stats stats;
+    while (stats.count < sample_count)
+    {
+        uint8_t buffer[transfer_size];
+        handle.read_pipe(endpoint_address, buffer, sizeof(buffer), NULL);
+        stats.add(test_clock::now());
+    }
+    stats.print("read_pipe");
+}
+
+int main_with_exceptions()
+{
+    libusbp::device device = libusbp::find_device_with_vid_pid(vendor_id, product_id);
+    if (!device)
+    {
+        std::cerr << "Device not found." << std::endl;
+        return 1;
+    }
+
+    libusbp::generic_interface gi(device, interface_number, composite);
+    libusbp::generic_handle handle(gi);
+
+    test_async(handle);
+    test_sync(handle);
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    // Suppress unused parameter warnings.
+    (void)argc;
+    (void)argv;
+
+    try
+    {
+        return main_with_exceptions();
+    }
+    catch(const std::exception & error)
+    {
+        std::cerr << "Error: " << error.what() << std::endl;
+    }
+    return 1;
+}
@@ -0,0 +1,159 @@
+/* Streams data from an isochronous IN endpoint for a few seconds and prints
+ * the throughput along with how many packets succeeded, failed, or were
+ * empty.  If an OUT endpoint is specified, it also streams full packets to
+ * that endpoint at the same time.
+ *
+ * None of the Pololu test devices have isochronous endpoints, so this is
+ * meant to be used with a gadget such as a dummy_hcd/FunctionFS device that
+ * has an isochronous source and sink.  Isochronous endpoints usually live in a
+ * non-zero alternate setting of their interface, so the test selects that
+ * setting before opening the pipes.  Change the constants below to match your
+ * device. */
+
+#include <libusbp.hpp>
+#include <stdio.h>
+#include <iostream>
+#include <chrono>
+#include <vector>
+
+const uint16_t vendor_id = 0x1D6B;
+const uint16_t product_id = 0x0104;
+const uint8_t interface_number = 0;
+const uint8_t alternate_setting = 1;
+const bool composite = false;
+const uint8_t in_endpoint_address = 0x81;
+const uint8_t out_endpoint_address = 0x02;  // 0 to disable
+const size_t packet_size = 1024;
+const size_t packets_per_transfer = 8;
+const size_t transfer_count = 8;
+const uint32_t test_duration_ms = 3000;
+
+typedef std::chrono::steady_clock test_clock;
+
+static uint32_t elapsed_ms(test_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        test_clock::now() - start).count();
+}
+
+struct packet_stats
+{
+    uint64_t bytes = 0;
+    uint64_t good = 0;
+    uint64_t empty = 0;
+    uint64_t failed = 0;
+
+    void add(const libusbp_iso_packet * packets, size_t packet_count)
+    {
+        for (size_t i = 0; i < packet_count; i++)
+        {
+            if (packets[i].status) { failed++; continue; }
+            if (packets[i].transferred == 0) { empty++; }
+            else { good++; }
+            bytes += packets[i].transferred;
+        }
+    }
+
+    void print(const char * name, uint32_t ms)
+    {
+        printf("%-4s %10llu bytes in %5u ms: %8.1f kB/s, "
+            "%llu good, %llu empty, %llu failed packets\n",
+            name, (unsigned long long)bytes, ms, (double)bytes / ms,
+            (unsigned long long)good, (unsigned long long)empty,
+            (unsigned long long)failed);
+        fflush(stdout);
+    }
+};
+
+int main_with_exceptions()
+{
+    libusbp::device device = libusbp::find_device_with_vid_pid(vendor_id, product_id);
+    if (!device)
+    {
+        std::cerr << "Device not found." << std::endl;
+        return 1;
+    }
+
+    libusbp::generic_interface gi(device, interface_number, composite);
+    libusbp::generic_handle handle(gi);
+    handle.set_alternate_setting(alternate_setting);
+
+    libusbp::iso_pipe in_pipe = handle.open_iso_pipe(in_endpoint_address);
+    in_pipe.allocate_transfers(transfer_count, packets_per_transfer, packet_size);
+
+    libusbp::iso_pipe out_pipe;
+    if (out_endpoint_address)
+    {
+        out_pipe = handle.open_iso_pipe(out_endpoint_address);
+        out_pipe.allocate_transfers(transfer_count, packets_per_transfer, packet_size);
+    }
+
+    std::vector<uint8_t> buffer(packets_per_transfer * packet_size, 0x55);
+    std::vector<size_t> lengths(packets_per_transfer, packet_size);
+    libusbp_iso_packet packets[packets_per_transfer];
+    packet_stats in_stats, out_stats;
+
+    test_clock::time_point start = test_clock::now();
+    in_pipe.start_endless_transfers();
+    while (elapsed_ms(start) < test_duration_ms)
+    {
+        if (out_pipe)
+        {
+            while (out_pipe.submit_transfer(buffer.data(), lengths.data(),
+                packets_per_transfer))
+            {
+            }
+        }
+
+        in_pipe.wait(100);
+
+        size_t packet_count;
+        libusbp::error transfer_error;
+        while (in_pipe.handle_finished_transfer(NULL, packets, &packet_count,
+            &transfer_error))
+        {
+            if (transfer_error) { throw transfer_error; }
+            in_stats.add(packets, packet_count);
+        }
+
+        while (out_pipe && out_pipe.handle_finished_transfer(NULL, packets,
+            &packet_count, &transfer_error))
+        {
+            if (transfer_error) { throw transfer_error; }
+            out_stats.add(packets, packet_count);
+        }
+    }
+    uint32_t ms = elapsed_ms(start);
+
+    in_pipe.cancel_transfers();
+    if (out_pipe) { out_pipe.cancel_transfers(); }
+    while (in_pipe.has_pending_transfers() ||
+        (out_pipe && out_pipe.has_pending_transfers()))
+    {
+        handle.wait(100);
+        while (in_pipe.handle_finished_transfer(NULL, NULL, NULL, NULL)) { }
+        while (out_pipe && out_pipe.handle_finished_transfer(NULL, NULL, NULL, NULL)) { }
+    }
+
+    in_stats.print("IN", ms);
+    if (out_pipe) { out_stats.print("OUT", ms); }
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    // Suppress unused parameter warnings.
+    (void)argc;
+    (void)argv;
+
+    try
+    {
+        return main_with_exceptions();
+    }
+    catch(const std::exception & error)
+    {
+        std::cerr << "Error: " << error.what() << std::endl;
+    }
+    return 1;
+}
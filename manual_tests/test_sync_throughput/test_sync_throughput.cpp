@@ -0,0 +1,123 @@
+/* Measures how fast libusbp_write_pipe and libusbp_read_pipe can move data
+ * when they are called with different transfer sizes.  On Linux, transfers
+ * larger than 16 KiB on bulk endpoints are split into several URBs that are
+ * queued at once, so the larger sizes should approach the throughput of an
+ * asynchronous pipe.
+ *
+ * This is designed to connect to Test Device A and write to endpoint 0x03,
+ * which discards any packet that does not start with a command byte.  Test
+ * Device A has no bulk IN endpoint, so reading is disabled by default.  To
+ * benchmark against a different device, such as a dummy_hcd gadget with a
+ * FunctionFS bulk source and sink, change the constants below. */
+
+#include <libusbp.hpp>
+#include <stdio.h>
+#include <iostream>
+#include <chrono>
+#include <vector>
+
+const uint16_t vendor_id = 0x1FFB;
+const uint16_t product_id = 0xDA01;
+const uint8_t interface_number = 0;
+const bool composite = true;
+const uint8_t out_endpoint_address = 0x03;
+const uint8_t in_endpoint_address = 0;  // 0 to disable
+const size_t transfer_sizes[] = { 512, 4096, 16384, 65536, 262144, 1048576 };
+const uint32_t test_duration_ms = 2000;
+
+typedef std::chrono::steady_clock test_clock;
+
+static uint32_t elapsed_ms(test_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        test_clock::now() - start).count();
+}
+
+static void print_result(const char * name, size_t transfer_size,
+    uint64_t byte_count, uint32_t ms)
+{
+    printf("%-6s %8u-byte transfers: %10llu bytes in %5u ms: %8.1f kB/s\n",
+        name, (unsigned int)transfer_size, (unsigned long long)byte_count,
+        ms, (double)byte_count / ms);
+    fflush(stdout);
+}
+
+static void test_write(libusbp::generic_handle & handle, size_t transfer_size)
+{
+    std::vector<uint8_t> buffer(transfer_size, 0);
+    uint64_t byte_count = 0;
+    test_clock::time_point start = test_clock::now();
+    while (elapsed_ms(start) < test_duration_ms)
+    {
+        size_t transferred;
+        handle.write_pipe(out_endpoint_address, buffer.data(), buffer.size(),
+            &transferred);
+        byte_count += transferred;
+    }
+    print_result("write", transfer_size, byte_count, elapsed_ms(start));
+}
+
+static void test_read(libusbp::generic_handle & handle, size_t transfer_size)
+{
+    std::vector<uint8_t> buffer(transfer_size);
+    uint64_t byte_count = 0;
+    test_clock::time_point start = test_clock::now();
+    while (elapsed_ms(start) < test_duration_ms)
+    {
+        size_t transferred;
+        handle.read_pipe(in_endpoint_address, buffer.data(), buffer.size(),
+            &transferred);
+        byte_count += transferred;
+    }
+    print_result("read", transfer_size, byte_count, elapsed_ms(start));
+}
+
+int main_with_exceptions()
+{
+    libusbp::device device = libusbp::find_device_with_vid_pid(vendor_id, product_id);
+    if (!device)
+    {
+        std::cerr << "Device not found." << std::endl;
+        return 1;
+    }
+
+    libusbp::generic_interface gi(device, interface_number, composite);
+    libusbp::generic_handle handle(gi);
+    handle.set_timeout(out_endpoint_address, 5000);
+    if (in_endpoint_address)
+    {
+        handle.set_timeout(in_endpoint_address, 5000);
+    }
+
+    for (size_t transfer_size : transfer_sizes)
+    {
+        test_write(handle, transfer_size);
+    }
+
+    if (in_endpoint_address)
+    {
+        for (size_t transfer_size : transfer_sizes)
+        {
+            test_read(handle, transfer_size);
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    // Suppress unused parameter warnings.
+    (void)argc;
+    (void)argv;
+
+    try
+    {
+        return main_with_exceptions();
+    }
+    catch(const std::exception & error)
+    {
+        std::cerr << "Error: " << error.what() << std::endl;
+    }
+    return 1;
+}
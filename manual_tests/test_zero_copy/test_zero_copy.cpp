@@ -0,0 +1,124 @@
+/* Measures how much CPU time libusbp uses per megabyte when reading from an IN
+ * endpoint with an asynchronous pipe, first with transfer buffers allocated by
+ * mmap() on the usbfs device file (zero-copy), then with buffers allocated by
+ * malloc().  It prints the throughput and the CPU time per MB of each method to
+ * the standard output.
+ *
+ * This is designed to connect to Test Device A and read from endpoint 0x82,
+ * but that endpoint is slow, so the results are only meaningful with a faster
+ * device, such as a dummy_hcd gadget with a FunctionFS bulk source.  To use a
+ * different device, change the constants below. */
+
+#include <libusbp.hpp>
+#include <stdio.h>
+#include <iostream>
+#include <chrono>
+#include <unistd.h>
+#include <sys/resource.h>
+
+const uint16_t vendor_id = 0x1FFB;
+const uint16_t product_id = 0xDA01;
+const uint8_t interface_number = 0;
+const bool composite = true;
+const uint8_t endpoint_address = 0x82;
+const size_t packet_size = 5;
+const size_t transfer_size = packet_size;
+const size_t transfer_count = 64;
+const uint32_t test_duration_ms = 4000;
+
+typedef std::chrono::steady_clock test_clock;
+
+static uint32_t elapsed_ms(test_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        test_clock::now() - start).count();
+}
+
+// Returns the user and system CPU time used by this process, in microseconds.
+static uint64_t cpu_time_us()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+        usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+void test_read(libusbp::generic_handle & handle, bool zero_copy)
+{
+    handle.set_zero_copy(zero_copy);
+    libusbp::async_in_pipe pipe = handle.open_async_in_pipe(endpoint_address);
+    pipe.allocate_transfers(transfer_count, transfer_size);
+
+    uint64_t byte_count = 0;
+    uint64_t cpu_start = cpu_time_us();
+    test_clock::time_point start = test_clock::now();
+
+    pipe.start_endless_transfers();
+    while (elapsed_ms(start) < test_duration_ms)
+    {
+        pipe.handle_events();
+
+        const uint8_t * data;
+        size_t transferred;
+        libusbp::error transfer_error;
+        while (pipe.borrow_finished_transfer(&data, &transferred, &transfer_error))
+        {
+            if (transfer_error) { throw transfer_error; }
+            byte_count += transferred;
+            pipe.release_transfer(data);
+        }
+
+        usleep(1000);
+    }
+
+    pipe.cancel_transfers();
+    while (pipe.has_pending_transfers())
+    {
+        pipe.handle_events();
+        while (pipe.handle_finished_transfer(NULL, NULL, NULL)) { }
+        usleep(1000);
+    }
+
+    uint32_t ms = elapsed_ms(start);
+    uint64_t cpu_us = cpu_time_us() - cpu_start;
+    double mb = (double)byte_count / 1000000;
+    printf("%-10s %10llu bytes in %5u ms: %8.1f kB/s, %8.1f ms CPU per MB\n",
+        zero_copy ? "mmap" : "malloc", (unsigned long long)byte_count, ms,
+        (double)byte_count / ms, mb > 0 ? cpu_us / 1000.0 / mb : 0.0);
+    fflush(stdout);
+}
+
+int main_with_exceptions()
+{
+    libusbp::device device = libusbp::find_device_with_vid_pid(vendor_id, product_id);
+    if (!device)
+    {
+        std::cerr << "Device not found." << std::endl;
+        return 1;
+    }
+
+    libusbp::generic_interface gi(device, interface_number, composite);
+    libusbp::generic_handle handle(gi);
+
+    test_read(handle, true);
+    test_read(handle, false);
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    // Suppress unused parameter warnings.
+    (void)argc;
+    (void)argv;
+
+    try
+    {
+        return main_with_exceptions();
+    }
+    catch(const std::exception & error)
+    {
+        std::cerr << "Error: " << error.what() << std::endl;
+    }
+    return 1;
+}
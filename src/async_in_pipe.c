@@ -18,22 +18,38 @@ struct libusbp_async_in_pipe
     // than the definition of pending in the async_in_transfer struct.
     size_t pending_count;
 
-    // The index of the transfer that should finish next.  That transfer will be
-    // pending (and thus able to be checked) if pending_count > 0.
+    // A ring holding the indices of the pending transfers in the order they
+    // were submitted, which is the order they finish in.  The transfer that
+    // should finish next is at position next_finish.
+    size_t * pending_order;
     size_t next_finish;
 
-    // The index of the transfer that will be submitted next when we need to
-    // submit more transfers.  That transfer can be submitted if pending_count <
-    // transfer_count.
+    // A ring holding the indices of the transfers that can be submitted,
+    // meaning they are neither pending nor borrowed, in the order they became
+    // free.  The transfer that will be submitted next is at position
+    // next_submit.
+    size_t * free_order;
     size_t next_submit;
+    size_t free_count;
+
+    // For each transfer, a pointer to its buffer if the transfer has been
+    // lent to the user of the pipe by
+    // libusbp_async_in_pipe_borrow_finished_transfer, or NULL otherwise.
+    // Borrowed transfers are not pending and cannot be submitted again until
+    // they are released, but the other transfers keep going around without
+    // them.
+    const uint8_t ** borrowed_array;
+
+    // The mode that changes how the transfers are handled, like a completion
+    // queue or a stream, or NULL if they are handled by the functions in this
+    // file.  Modes are only available on Linux; see async_in_pipe_linux.c.
+    async_in_mode * mode;
+
+    // The LIBUSBP_CLOCK_* value for the transfers' timestamps, which are only
+    // available on Linux.
+    uint32_t timestamp_clock;
 };
 
-static inline size_t increment_and_wrap_size(size_t n, size_t bound)
-{
-    n++;
-    return n >= bound ? 0 : n;
-}
-
 static void async_in_transfer_array_free(async_in_transfer ** array, size_t transfer_count)
 {
     if (array == NULL) { return; }
@@ -49,7 +65,17 @@ void libusbp_async_in_pipe_close(libusbp_async_in_pipe * pipe)
 {
     if (pipe != NULL)
     {
+        if (pipe->mode != NULL && !pipe->mode->ops->free(pipe->mode))
+        {
+            // The thread that reaps the transfers might still use them, so we
+            // leak them along with the mode.  See async_in_transfer_free.
+            pipe->transfer_array = NULL;
+        }
+
         async_in_transfer_array_free(pipe->transfer_array, pipe->transfer_count);
+        free(pipe->borrowed_array);
+        free(pipe->pending_order);
+        free(pipe->free_order);
         free(pipe);
     }
 }
@@ -110,6 +136,94 @@ libusbp_error * async_in_pipe_create(libusbp_generic_handle * handle,
     return error;
 }
 
+libusbp_generic_handle * async_in_pipe_get_handle(libusbp_async_in_pipe * pipe)
+{
+    assert(pipe != NULL);
+    return pipe->handle;
+}
+
+// Allocates transfers for the pipe and puts them in the pipe, replacing any
+// transfers it had.  The old transfers must not be pending or borrowed.
+static libusbp_error * async_in_pipe_create_transfers(libusbp_async_in_pipe * pipe,
+    size_t transfer_count, size_t transfer_size)
+{
+    libusbp_error * error = NULL;
+
+    async_in_transfer ** new_transfer_array = NULL;
+    if (error == NULL)
+    {
+        new_transfer_array = calloc(transfer_count, sizeof(async_in_transfer *));
+        if (new_transfer_array == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    const uint8_t ** new_borrowed_array = NULL;
+    if (error == NULL)
+    {
+        new_borrowed_array = calloc(transfer_count, sizeof(const uint8_t *));
+        if (new_borrowed_array == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    size_t * new_pending_order = NULL;
+    size_t * new_free_order = NULL;
+    if (error == NULL)
+    {
+        new_pending_order = calloc(transfer_count, sizeof(size_t));
+        new_free_order = calloc(transfer_count, sizeof(size_t));
+        if (new_pending_order == NULL || new_free_order == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    for(size_t i = 0; error == NULL && i < transfer_count; i++)
+    {
+        new_free_order[i] = i;
+        error = async_in_transfer_create(pipe->handle, pipe->pipe_id,
+            transfer_size, &new_transfer_array[i]);
+
+        #ifdef __linux__
+        if (error == NULL)
+        {
+            async_in_transfer_set_clock(new_transfer_array[i], pipe->timestamp_clock);
+        }
+        #endif
+    }
+
+    // Put the new arrays and the information about them into the pipe.
+    if (error == NULL)
+    {
+        async_in_transfer_array_free(pipe->transfer_array, pipe->transfer_count);
+        free(pipe->borrowed_array);
+        free(pipe->pending_order);
+        free(pipe->free_order);
+        pipe->transfer_array = new_transfer_array;
+        pipe->borrowed_array = new_borrowed_array;
+        pipe->pending_order = new_pending_order;
+        pipe->free_order = new_free_order;
+        pipe->transfer_count = transfer_count;
+        pipe->transfer_size = transfer_size;
+        pipe->next_finish = 0;
+        pipe->next_submit = 0;
+        pipe->free_count = transfer_count;
+        new_transfer_array = NULL;
+        new_borrowed_array = NULL;
+        new_pending_order = NULL;
+        new_free_order = NULL;
+    }
+
+    async_in_transfer_array_free(new_transfer_array, transfer_count);
+    free(new_borrowed_array);
+    free(new_pending_order);
+    free(new_free_order);
+    return error;
+}
+
 libusbp_error * libusbp_async_in_pipe_allocate_transfers(
     libusbp_async_in_pipe * pipe,
     size_t transfer_count,
@@ -135,53 +249,220 @@ libusbp_error * libusbp_async_in_pipe_allocate_transfers(
         return error_create("Transfer size cannot be zero.");
     }
 
-    libusbp_error * error = NULL;
+    libusbp_error * error = async_in_pipe_create_transfers(pipe,
+        transfer_count, transfer_size);
 
-    async_in_transfer ** new_transfer_array = NULL;
-    if (error == NULL)
+    if (error != NULL)
     {
-        new_transfer_array = calloc(transfer_count, sizeof(async_in_transfer *));
-        if (new_transfer_array == NULL)
-        {
-            error = &error_no_memory;
-        }
+        error = error_add(error, "Failed to allocate transfers for asynchronous IN pipe.");
     }
+    return error;
+}
 
-    for(size_t i = 0; error == NULL && i < transfer_count; i++)
+async_in_mode * async_in_pipe_get_mode(libusbp_async_in_pipe * pipe)
+{
+    assert(pipe != NULL);
+    return pipe->mode;
+}
+
+// Returns true if the pipe's mode takes over its transfers, so the pipe does
+// not submit or finish them itself.
+static bool async_in_pipe_mode_has_transfers(libusbp_async_in_pipe * pipe)
+{
+    return pipe->mode != NULL && pipe->mode->ops->start != NULL;
+}
+
+bool async_in_pipe_is_idle(libusbp_async_in_pipe * pipe)
+{
+    assert(pipe != NULL);
+
+    if (pipe->pending_count != 0) { return false; }
+    for (size_t i = 0; i < pipe->transfer_count; i++)
     {
-        error = async_in_transfer_create(pipe->handle, pipe->pipe_id,
-            transfer_size, &new_transfer_array[i]);
+        if (pipe->borrowed_array[i] != NULL) { return false; }
     }
+    return true;
+}
 
-    // Put the new array and the information about it into the pipe.
-    if (error == NULL)
+libusbp_error * async_in_pipe_check_mode(libusbp_async_in_pipe * pipe,
+    const async_in_mode_ops * ops)
+{
+    assert(pipe != NULL);
+    assert(ops != NULL);
+
+    if (pipe->transfer_array == NULL)
     {
-        pipe->transfer_array = new_transfer_array;
-        pipe->transfer_count = transfer_count;
-        pipe->transfer_size = transfer_size;
-        new_transfer_array = NULL;
+        return error_create("Pipe transfers have not been allocated yet.");
     }
 
-    async_in_transfer_array_free(new_transfer_array, transfer_count);
+    if (pipe->mode != NULL && pipe->mode->ops != ops)
+    {
+        return error_create("A pipe with %s cannot have %s.",
+            pipe->mode->ops->name, ops->name);
+    }
 
-    if (error != NULL)
+    // Only a mode that lets the pipe handle its transfers can be changed while
+    // the transfers are in use.
+    if (ops->start == NULL) { return NULL; }
+
+    if (pipe->mode != NULL && !ops->replaceable)
     {
-        error = error_add(error, "Failed to allocate transfers for asynchronous IN pipe.");
+        return error_create("This pipe already has %s.", ops->name);
     }
-    return error;
+
+    if (pipe->mode != NULL && pipe->mode->ops->has_pending(pipe->mode))
+    {
+        return error_create("Cannot change %s while transfers are pending.",
+            ops->name);
+    }
+
+    if (pipe->pending_count != 0)
+    {
+        return error_create("Cannot enable %s while transfers are pending.",
+            ops->name);
+    }
+
+    if (!async_in_pipe_is_idle(pipe))
+    {
+        return error_create("Cannot enable %s while transfers are borrowed.",
+            ops->name);
+    }
+
+    return NULL;
+}
+
+void async_in_pipe_get_transfers(libusbp_async_in_pipe * pipe,
+    async_in_transfer *** transfer_array, size_t * transfer_count,
+    size_t * transfer_size)
+{
+    assert(pipe != NULL);
+
+    if (transfer_array != NULL) { *transfer_array = pipe->transfer_array; }
+    if (transfer_count != NULL) { *transfer_count = pipe->transfer_count; }
+    if (transfer_size != NULL) { *transfer_size = pipe->transfer_size; }
+}
+
+libusbp_error * async_in_pipe_replace_transfers(libusbp_async_in_pipe * pipe,
+    size_t transfer_count, size_t transfer_size)
+{
+    assert(pipe != NULL);
+    assert(async_in_pipe_is_idle(pipe));
+    return async_in_pipe_create_transfers(pipe, transfer_count, transfer_size);
+}
+
+void async_in_pipe_set_clock(libusbp_async_in_pipe * pipe, uint32_t clock)
+{
+    assert(pipe != NULL);
+    pipe->timestamp_clock = clock;
+}
+
+// Returns the transfer that should finish next.  There must be a pending
+// transfer.
+static async_in_transfer * async_in_pipe_get_next_finish(libusbp_async_in_pipe * pipe)
+{
+    assert(pipe->pending_count != 0);
+    return pipe->transfer_array[pipe->pending_order[pipe->next_finish]];
+}
+
+async_in_transfer * async_in_pipe_get_finished_transfer(libusbp_async_in_pipe * pipe)
+{
+    assert(pipe != NULL);
+
+    if (pipe->pending_count == 0)
+    {
+        // There are no pending transfers that we could check for completion.
+        return NULL;
+    }
+
+    async_in_transfer * transfer = async_in_pipe_get_next_finish(pipe);
+
+    if (async_in_transfer_pending(transfer))
+    {
+        // The next transfer we expect to finish is still pending;
+        // the kernel has not told us that it is done.
+        return NULL;
+    }
+
+    return transfer;
+}
+
+// Puts a transfer that is no longer pending or borrowed at the end of the
+// free ring.
+static void async_in_pipe_add_free_transfer(libusbp_async_in_pipe * pipe, size_t index)
+{
+    assert(pipe->free_count < pipe->transfer_count);
+    size_t position = (pipe->next_submit + pipe->free_count) % pipe->transfer_count;
+    pipe->free_order[position] = index;
+    pipe->free_count++;
+}
+
+// Removes the transfer that should finish next from the pending ring and
+// returns its index.
+static size_t async_in_pipe_remove_next_finish(libusbp_async_in_pipe * pipe)
+{
+    assert(pipe->pending_count != 0);
+    size_t index = pipe->pending_order[pipe->next_finish];
+    pipe->pending_count--;
+    pipe->next_finish = increment_and_wrap_size(pipe->next_finish, pipe->transfer_count);
+    return index;
 }
 
 static void async_in_pipe_submit_next_transfer(libusbp_async_in_pipe * pipe)
 {
     assert(pipe != NULL);
-    assert(pipe->pending_count < pipe->transfer_count);
+    assert(pipe->free_count != 0);
 
-    // Submit the next transfer.
-    async_in_transfer_submit(pipe->transfer_array[pipe->next_submit]);
+    size_t index = pipe->free_order[pipe->next_submit];
+    assert(pipe->borrowed_array[index] == NULL);
+    pipe->next_submit = increment_and_wrap_size(pipe->next_submit, pipe->transfer_count);
+    pipe->free_count--;
 
-    // Update the counts and indices.
+    // Submit the transfer.
+    async_in_transfer_submit(pipe->transfer_array[index]);
+
+    // Add it to the end of the pending ring.
+    size_t position = (pipe->next_finish + pipe->pending_count) % pipe->transfer_count;
+    pipe->pending_order[position] = index;
     pipe->pending_count++;
-    pipe->next_submit = increment_and_wrap_size(pipe->next_submit, pipe->transfer_count);
+}
+
+// Submits every transfer that is not pending or borrowed.  Borrowed transfers
+// are left out until they are released, so the others keep the endpoint busy.
+static void async_in_pipe_submit_available_transfers(libusbp_async_in_pipe * pipe)
+{
+    assert(pipe != NULL);
+
+    if (pipe->mode != NULL && pipe->mode->ops->ready_to_submit != NULL &&
+        !pipe->mode->ops->ready_to_submit(pipe->mode, pipe))
+    {
+        return;
+    }
+
+    while(pipe->free_count != 0)
+    {
+        async_in_pipe_submit_next_transfer(pipe);
+    }
+}
+
+void async_in_pipe_set_mode(libusbp_async_in_pipe * pipe, async_in_mode * mode)
+{
+    assert(pipe != NULL);
+
+    bool had_transfers = async_in_pipe_mode_has_transfers(pipe);
+    if (pipe->mode != NULL)
+    {
+        bool freed = pipe->mode->ops->free(pipe->mode);
+        assert(freed);
+        LIBUSBP_UNUSED(freed);
+    }
+    pipe->mode = mode;
+
+    // If the old mode was holding back transfers, start submitting them again.
+    if (pipe->endless_transfers_enabled && !had_transfers &&
+        !async_in_pipe_mode_has_transfers(pipe))
+    {
+        async_in_pipe_submit_available_transfers(pipe);
+    }
 }
 
 libusbp_error * libusbp_async_in_pipe_start_endless_transfers(
@@ -199,11 +480,13 @@ libusbp_error * libusbp_async_in_pipe_start_endless_transfers(
 
     pipe->endless_transfers_enabled = true;
 
-    while(pipe->pending_count < pipe->transfer_count)
+    if (async_in_pipe_mode_has_transfers(pipe))
     {
-        async_in_pipe_submit_next_transfer(pipe);
+        return pipe->mode->ops->start(pipe->mode);
     }
 
+    async_in_pipe_submit_available_transfers(pipe);
+
     return NULL;
 }
 
@@ -217,6 +500,24 @@ libusbp_error * libusbp_async_in_pipe_handle_events(libusbp_async_in_pipe * pipe
     return generic_handle_events(pipe->handle);
 }
 
+void async_in_pipe_finish_transfer(libusbp_async_in_pipe * pipe)
+{
+    assert(pipe != NULL);
+
+    if (pipe->mode != NULL && pipe->mode->ops->transfer_finished != NULL)
+    {
+        pipe->mode->ops->transfer_finished(pipe->mode,
+            async_in_pipe_get_next_finish(pipe));
+    }
+
+    async_in_pipe_add_free_transfer(pipe, async_in_pipe_remove_next_finish(pipe));
+
+    if (pipe->endless_transfers_enabled)
+    {
+        async_in_pipe_submit_available_transfers(pipe);
+    }
+}
+
 libusbp_error * libusbp_async_in_pipe_has_pending_transfers(
     libusbp_async_in_pipe * pipe,
     bool * result)
@@ -241,6 +542,11 @@ libusbp_error * libusbp_async_in_pipe_has_pending_transfers(
     if (error == NULL)
     {
         *result = pipe->pending_count ? 1 : 0;
+
+        if (async_in_pipe_mode_has_transfers(pipe))
+        {
+            *result = pipe->mode->ops->has_pending(pipe->mode);
+        }
     }
 
     return error;
@@ -273,18 +579,15 @@ libusbp_error * libusbp_async_in_pipe_handle_finished_transfer(
         return error_create("Pipe argument is null.");
     }
 
-    if (pipe->pending_count == 0)
+    if (async_in_pipe_mode_has_transfers(pipe))
     {
-        // There are no pending transfers that we could check for completion.
-        return NULL;
+        return pipe->mode->ops->handle_finished_transfer(pipe->mode,
+            finished, buffer, transferred, transfer_error);
     }
 
-    async_in_transfer * transfer = pipe->transfer_array[pipe->next_finish];
-
-    if (async_in_transfer_pending(transfer))
+    async_in_transfer * transfer = async_in_pipe_get_finished_transfer(pipe);
+    if (transfer == NULL)
     {
-        // The next transfer we expect to finish is still pending;
-        // the kernel has not told us that it is done.
         return NULL;
     }
 
@@ -298,18 +601,118 @@ libusbp_error * libusbp_async_in_pipe_handle_finished_transfer(
             *finished = true;
         }
 
-        pipe->pending_count--;
-        pipe->next_finish = increment_and_wrap_size(pipe->next_finish, pipe->transfer_count);
+        async_in_pipe_finish_transfer(pipe);
     }
 
-    if (error == NULL && pipe->endless_transfers_enabled)
+    return error;
+}
+
+libusbp_error * libusbp_async_in_pipe_borrow_finished_transfer(
+    libusbp_async_in_pipe * pipe,
+    bool * finished,
+    const uint8_t ** data,
+    size_t * transferred,
+    libusbp_error ** transfer_error)
+{
+    if (finished != NULL)
     {
-        async_in_pipe_submit_next_transfer(pipe);
+        *finished = false;
+    }
+
+    if (data != NULL)
+    {
+        *data = NULL;
+    }
+
+    if (transferred != NULL)
+    {
+        *transferred = 0;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = NULL;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (data == NULL)
+    {
+        return error_create("Data output pointer is null.");
+    }
+
+    if (async_in_pipe_mode_has_transfers(pipe))
+    {
+        return error_create("Transfers cannot be borrowed from a pipe with %s.",
+            pipe->mode->ops->name);
+    }
+
+    async_in_transfer * transfer = async_in_pipe_get_finished_transfer(pipe);
+    if (transfer == NULL)
+    {
+        return NULL;
+    }
+
+    const uint8_t * buffer = NULL;
+    libusbp_error * error = async_in_transfer_peek_results(transfer, &buffer,
+        transferred, transfer_error);
+
+    if (error == NULL)
+    {
+        if (finished != NULL)
+        {
+            *finished = true;
+        }
+
+        *data = buffer;
+
+        // The transfer is lent to the caller and will not be submitted again
+        // until it is released.
+        pipe->borrowed_array[async_in_pipe_remove_next_finish(pipe)] = buffer;
     }
 
     return error;
 }
 
+libusbp_error * libusbp_async_in_pipe_release_transfer(
+    libusbp_async_in_pipe * pipe,
+    const uint8_t * data)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (data == NULL)
+    {
+        return error_create("Data pointer is null.");
+    }
+
+    size_t index = 0;
+    for (; index < pipe->transfer_count; index++)
+    {
+        if (pipe->borrowed_array[index] == data) { break; }
+    }
+
+    if (index == pipe->transfer_count)
+    {
+        return error_create("Data pointer does not belong to a borrowed transfer.");
+    }
+
+    pipe->borrowed_array[index] = NULL;
+    async_in_pipe_add_free_transfer(pipe, index);
+
+    if (pipe->endless_transfers_enabled)
+    {
+        async_in_pipe_submit_available_transfers(pipe);
+    }
+
+    return NULL;
+}
+
 libusbp_error * libusbp_async_in_pipe_cancel_transfers(libusbp_async_in_pipe * pipe)
 {
     if (pipe == NULL)
@@ -319,16 +722,25 @@ libusbp_error * libusbp_async_in_pipe_cancel_transfers(libusbp_async_in_pipe * p
 
     pipe->endless_transfers_enabled = false;
 
+    if (async_in_pipe_mode_has_transfers(pipe))
+    {
+        return pipe->mode->ops->cancel(pipe->mode);
+    }
+
     libusbp_error * error = NULL;
 
     #ifdef __linux__
-    // In Linux, transfers need to be cancelled individually.
-    for (size_t i = 0; error == NULL && i < pipe->transfer_count; i++)
-    {
-        error = async_in_transfer_cancel(pipe->transfer_array[i]);
-
-        // This doesn't help the performance issue in this function:
-        //if (error == NULL) { error = generic_handle_events(pipe->handle); }
+    // In Linux, transfers need to be cancelled individually.  We cancel the
+    // newest ones first, for the reason explained in
+    // async_in_transfer_cancel_pending.
+    for (size_t i = pipe->pending_count; error == NULL && i > 0; i--)
+    {
+        size_t position = (pipe->next_finish + i - 1) % pipe->transfer_count;
+        async_in_transfer * transfer = pipe->transfer_array[pipe->pending_order[position]];
+        if (async_in_transfer_pending(transfer))
+        {
+            error = async_in_transfer_cancel(transfer);
+        }
     }
 
     #else
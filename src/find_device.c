@@ -1,5 +1,21 @@
 #include <libusbp_internal.h>
 
+#ifdef __linux__
+
+libusbp_error * libusbp_find_device_with_vid_pid(
+    uint16_t vendor_id, uint16_t product_id, libusbp_device ** device)
+{
+    // udev can skip the devices that do not match, so we do not need to make
+    // a list of every device like the code below does.
+    libusbp_vid_pid id = { vendor_id, product_id };
+    libusbp_device_filter filter = { 0 };
+    filter.ids = &id;
+    filter.id_count = 1;
+    return libusbp_find_device_matching(NULL, &filter, device);
+}
+
+#else
+
 static libusbp_error * check_device_vid_pid(const libusbp_device * device,
     uint16_t vendor_id, uint16_t product_id, bool * matches)
 {
@@ -71,3 +87,5 @@ libusbp_error * libusbp_find_device_with_vid_pid(
     libusbp_list_free(new_list);
     return error;
 }
+
+#endif
@@ -46,10 +46,24 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#ifdef LIBUSBP_USE_UDEV
 #include <libudev.h>
+#endif
 #include <linux/usbdevice_fs.h>
 #include <linux/usb/ch9.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 #endif
 
 #ifdef __APPLE__
@@ -84,8 +98,19 @@
 // Suppresses unused parameter warnings.
 #define LIBUSBP_UNUSED(param_name) (void)param_name;
 
+// Advances an index in a ring of transfers, wrapping around to 0.
+static inline size_t increment_and_wrap_size(size_t n, size_t bound)
+{
+    n++;
+    return n >= bound ? 0 : n;
+}
+
 #define MAX_ENDPOINT_NUMBER 15
 
+// Used for endpoints whose transfer type could not be found in the
+// descriptors.
+#define ENDPOINT_TYPE_UNKNOWN 0xFF
+
 typedef struct libusbp_setup_packet
 {
     uint8_t bmRequestType;
@@ -160,6 +185,13 @@ LIBUSBP_WARN_UNUSED
 libusbp_error * async_in_transfer_get_results(async_in_transfer * transfer,
     void * buffer, size_t * transferred, libusbp_error ** transfer_error);
 
+// Gets the results of a finished transfer without copying its data: the
+// retrieved buffer pointer points to memory owned by the transfer, which stays
+// valid until the transfer is submitted again or freed.
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_transfer_peek_results(async_in_transfer * transfer,
+    const uint8_t ** buffer, size_t * transferred, libusbp_error ** transfer_error);
+
 LIBUSBP_WARN_UNUSED
 libusbp_error * async_in_transfer_cancel(async_in_transfer * transfer);
 
@@ -168,6 +200,103 @@ bool async_in_transfer_pending(async_in_transfer * transfer);
 LIBUSBP_WARN_UNUSED
 libusbp_error * generic_handle_events(libusbp_generic_handle * handle);
 
+// Records that the handle was added to an event loop, or returns an error if
+// the handle has a reaper thread.  Each successful call must be matched by a
+// call to generic_handle_leave_event_loop.
+LIBUSBP_WARN_UNUSED
+libusbp_error * generic_handle_join_event_loop(libusbp_generic_handle * handle);
+
+void generic_handle_leave_event_loop(libusbp_generic_handle * handle);
+
+libusbp_generic_handle * async_in_pipe_get_handle(libusbp_async_in_pipe * pipe);
+
+/** async_in_mode **************************************************************/
+
+// A mode changes how an asynchronous IN pipe handles its transfers: it can
+// pass them through a completion queue, a stream, or a callback, or tune their
+// count and size.  A pipe has at most one mode, and without one, the functions
+// in async_in_pipe.c hand the transfers to the user one at a time.  Modes are
+// only available on Linux; see async_in_pipe_linux.c.
+typedef struct async_in_mode
+               async_in_mode;
+
+typedef struct async_in_mode_ops
+{
+    // Describes the mode in error messages, for example "a stream".
+    const char * name;
+
+    // True if the mode can be replaced by another one of the same kind.
+    bool replaceable;
+
+    // Frees the mode.  Returns false if another thread might still use the
+    // pipe's transfers, in which case they must not be freed either.
+    bool (* free)(async_in_mode * mode);
+
+    // Modes that take over the pipe's transfers, so the pipe does not submit
+    // or finish them itself, have these functions.  Other modes leave them
+    // NULL.
+    libusbp_error * (* start)(async_in_mode * mode);
+    libusbp_error * (* cancel)(async_in_mode * mode);
+    bool (* has_pending)(async_in_mode * mode);
+    libusbp_error * (* handle_finished_transfer)(async_in_mode * mode,
+        bool * finished, void * buffer, size_t * transferred,
+        libusbp_error ** transfer_error);
+
+    // Modes that let the pipe handle its transfers can have these functions.
+    // ready_to_submit returns false if the pipe should hold its transfers back
+    // for now, and transfer_finished is called before the pipe hands a
+    // finished transfer to the user.
+    bool (* ready_to_submit)(async_in_mode * mode, libusbp_async_in_pipe * pipe);
+    void (* transfer_finished)(async_in_mode * mode, async_in_transfer * transfer);
+} async_in_mode_ops;
+
+// Each kind of mode has this as its first member.
+struct async_in_mode
+{
+    const async_in_mode_ops * ops;
+};
+
+async_in_mode * async_in_pipe_get_mode(libusbp_async_in_pipe * pipe);
+
+// Checks whether the pipe can switch to a mode with the specified operations.
+// The pipe's transfers must be allocated, it cannot switch between different
+// kinds of modes, and switching to a mode that takes over the transfers can
+// only happen while none of them are in use.
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_pipe_check_mode(libusbp_async_in_pipe * pipe,
+    const async_in_mode_ops * ops);
+
+// Frees the pipe's mode and replaces it with the specified one, which can be
+// NULL.  The change must have been checked with async_in_pipe_check_mode.
+void async_in_pipe_set_mode(libusbp_async_in_pipe * pipe, async_in_mode * mode);
+
+// Gets the pipe's transfers.  Any of the output pointers can be NULL.
+void async_in_pipe_get_transfers(libusbp_async_in_pipe * pipe,
+    async_in_transfer *** transfer_array, size_t * transfer_count,
+    size_t * transfer_size);
+
+// Returns true if none of the pipe's transfers are pending or borrowed.
+bool async_in_pipe_is_idle(libusbp_async_in_pipe * pipe);
+
+// Replaces the pipe's transfers with new ones.  The pipe must be idle.
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_pipe_replace_transfers(libusbp_async_in_pipe * pipe,
+    size_t transfer_count, size_t transfer_size);
+
+// Sets the LIBUSBP_CLOCK_* value used for the timestamps of transfers that
+// are created later.
+void async_in_pipe_set_clock(libusbp_async_in_pipe * pipe, uint32_t clock);
+
+// Returns the transfer that the pipe should hand to the user next, if the
+// kernel is done with it, or NULL.
+async_in_transfer * async_in_pipe_get_finished_transfer(
+    libusbp_async_in_pipe * pipe);
+
+// Hands the transfer returned by async_in_pipe_get_finished_transfer to the
+// user after its results were retrieved, and submits it again if endless
+// transfers are enabled.
+void async_in_pipe_finish_transfer(libusbp_async_in_pipe * pipe);
+
 #ifdef _WIN32
 
 LIBUSBP_WARN_UNUSED libusbp_error * create_device(HDEVINFO list,
@@ -204,26 +333,545 @@ LIBUSBP_WARN_UNUSED libusbp_error * get_filename_from_devinst_and_guid(
 LIBUSBP_TEST_API LIBUSBP_WARN_UNUSED LIBUSBP_PRINTF(1, 2)
 libusbp_error * error_create_errno(const char * format, ...);
 
+#ifdef LIBUSBP_USE_UDEV
 LIBUSBP_TEST_API LIBUSBP_WARN_UNUSED LIBUSBP_PRINTF(2, 3)
 libusbp_error * error_create_udev(int error_code, const char * format, ...);
+#endif
 
 LIBUSBP_TEST_API LIBUSBP_WARN_UNUSED
 libusbp_error * error_from_urb_status(struct usbdevfs_urb * urb);
 
+#ifdef LIBUSBP_USE_UDEV
 LIBUSBP_WARN_UNUSED
 libusbp_error * device_create(struct udev_device * dev, libusbp_device ** device);
+#endif
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * device_create_from_properties(const char * syspath,
+    const char * product, const char * serial_number, libusbp_device ** device);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * device_create_from_values(const char * syspath,
+    uint16_t vendor_id, uint16_t product_id, uint16_t revision,
+    const char * serial_number, libusbp_device ** device);
+
+// Gets the syspath and serial number of a device without copying them.  The
+// serial number can be NULL.  The strings are owned by the device.
+void device_peek_strings(const libusbp_device * device,
+    const char ** syspath, const char ** serial_number);
+
+// Returns an error if an interface is attached to a kernel driver that
+// libusbp cannot work with.  The driver name can be NULL.
+LIBUSBP_WARN_UNUSED
+libusbp_error * check_driver_name(const char * driver_name);
 
 LIBUSBP_WARN_UNUSED
 libusbp_error * generic_interface_get_device_copy(
     const libusbp_generic_interface * gi, libusbp_device ** device);
 
+// Gets the interface number of a generic interface and, from sysfs, the
+// bConfigurationValue of the configuration it belongs to and its current
+// alternate setting.  The configuration is 0 if it could not be found, and the
+// alternate setting is 0 if it could not be read.
+void generic_interface_get_setting(const libusbp_generic_interface * gi,
+    uint8_t * interface_number, uint8_t * configuration,
+    uint8_t * alternate_setting);
+
+// Returns the value of CLOCK_MONOTONIC in milliseconds.
+uint64_t get_time_ms(void);
+
+// Returns the value of the specified clock in nanoseconds.
+uint64_t get_time_ns(clockid_t clock);
+
+// Waits for URBs to complete and handles them, until done(context) returns
+// true or the timeout elapses.  A timeout of 0 means to wait forever.  If done
+// is NULL, this returns after the first batch of completed URBs is handled.
+LIBUSBP_WARN_UNUSED
+libusbp_error * generic_handle_wait_until(libusbp_generic_handle * handle,
+    uint32_t timeout, bool (* done)(void * context), void * context);
+
+// Reaps URBs until done(context) returns true, even if reaping fails or the
+// reaper thread stopped because of an error.  This is for code that cannot
+// return while the kernel still has its URBs, after generic_handle_wait_until
+// failed.
+void generic_handle_drain(libusbp_generic_handle * handle,
+    bool (* done)(void * context), void * context);
+
+// Returns the usbfs capabilities that should be used when allocating buffers
+// for the handle's transfers.  See usbfd_alloc_buffer.
+uint32_t generic_handle_get_buffer_capabilities(const libusbp_generic_handle * handle);
+
+// Returns all of the USBDEVFS_CAP_* flags reported for the handle's device file.
+uint32_t generic_handle_get_capabilities(const libusbp_generic_handle * handle);
+
+// Reads the endpoint types and maximum packet sizes from the descriptors of the
+// handle's interface when it uses the specified alternate setting.  This is
+// done when the handle is opened and when the alternate setting changes.
+LIBUSBP_WARN_UNUSED
+libusbp_error * generic_handle_update_endpoint_info(
+    libusbp_generic_handle * handle, uint8_t alternate_setting);
+
+// Returns the transfer type of the specified endpoint (a USB_ENDPOINT_XFER_*
+// value) from the device's descriptors, or ENDPOINT_TYPE_UNKNOWN.
+uint8_t generic_handle_get_endpoint_type(const libusbp_generic_handle * handle,
+    uint8_t pipe_id);
+
+// Checks that the libusbp_transfer_flag values are valid for the endpoint and
+// supported by the kernel.
+LIBUSBP_WARN_UNUSED
+libusbp_error * generic_handle_check_transfer_flags(
+    const libusbp_generic_handle * handle, uint8_t pipe_id, uint32_t flags);
+
+// Returns the flags set with libusbp_generic_handle_set_pipe_flags.
+uint32_t generic_handle_get_pipe_flags(const libusbp_generic_handle * handle,
+    uint8_t pipe_id);
+
+// Converts libusbp_transfer_flag values to USBDEVFS_URB_* flags.
+unsigned int transfer_flags_to_urb_flags(uint32_t flags);
+
+// Returns the maximum packet size of the specified endpoint from the device's
+// descriptors, or 0 if it is not known.
+uint16_t generic_handle_get_max_packet_size(const libusbp_generic_handle * handle,
+    uint8_t pipe_id);
+
+// Returns the usbfs URB type to use for bulk or interrupt transfers on the
+// specified endpoint.
+uint8_t generic_handle_get_urb_type(const libusbp_generic_handle * handle,
+    uint8_t pipe_id);
+
+/** async_in_queue *************************************************************/
+
+// Data that is written by one thread and read by another is kept in separate
+// cache lines so the threads don't slow each other down.
+#define LIBUSBP_CACHE_LINE_SIZE 64
+
+typedef struct async_in_queue
+               async_in_queue;
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_queue_create(async_in_transfer ** transfer_array,
+    size_t transfer_count, size_t transfer_size, size_t capacity,
+    async_in_queue ** queue);
+
+// Returns false if the queue could not be freed because some of its transfers
+// were still pending.
+bool async_in_queue_free(async_in_queue * queue);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_queue_start(async_in_queue * queue);
+
+void async_in_queue_handle_completion(async_in_queue * queue,
+    async_in_transfer * transfer);
+
+// Copies the data of the oldest finished transfer into the pieces of memory
+// described by iov, which can be empty.
+bool async_in_queue_pop(async_in_queue * queue,
+    const libusbp_iovec * iov, size_t iov_count, size_t * transferred,
+    libusbp_transfer_times * times, libusbp_error ** transfer_error);
+
+bool async_in_queue_has_pending(async_in_queue * queue);
+
+bool async_in_queue_can_pop(async_in_queue * queue);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_queue_cancel(async_in_queue * queue);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_transfer_submit_checked(async_in_transfer * transfer);
+
+void async_in_transfer_set_queue(async_in_transfer * transfer,
+    async_in_queue * queue);
+
+// Sets the clock used for the transfer's submission and completion timestamps
+// to a LIBUSBP_CLOCK_* value.
+void async_in_transfer_set_clock(async_in_transfer * transfer, uint32_t clock);
+
+// Gets the timestamps of a transfer that is not pending.
+void async_in_transfer_get_times(async_in_transfer * transfer,
+    libusbp_transfer_times * times);
+
+/** async_in_stream ************************************************************/
+
+typedef struct async_in_stream
+               async_in_stream;
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_stream_create(async_in_transfer ** transfer_array,
+    size_t transfer_count, size_t transfer_size, size_t buffer_size,
+    async_in_stream ** stream);
+
+// Returns false if the stream could not be freed because some of its
+// transfers were still pending.
+bool async_in_stream_free(async_in_stream * stream);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_stream_start(async_in_stream * stream);
+
+void async_in_stream_handle_completion(async_in_stream * stream,
+    async_in_transfer * transfer);
+
+// Gets the span of data that is ready to be read.  If there is none, this
+// retrieves the next transfer error, if there is one.
+void async_in_stream_peek(async_in_stream * stream, const uint8_t ** data,
+    size_t * size, libusbp_error ** transfer_error);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_stream_consume(async_in_stream * stream, size_t size);
+
+bool async_in_stream_has_pending(async_in_stream * stream);
+
+bool async_in_stream_can_peek(async_in_stream * stream);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_stream_cancel(async_in_stream * stream);
+
+void async_in_transfer_set_stream(async_in_transfer * transfer,
+    async_in_stream * stream);
+
+/** async_in_dispatch **********************************************************/
+
+typedef struct async_in_dispatch
+               async_in_dispatch;
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_dispatch_create(async_in_transfer ** transfer_array,
+    size_t transfer_count, libusbp_async_in_callback * callback, void * context,
+    async_in_dispatch ** dispatch);
+
+// Returns false if the dispatcher could not be freed because some of its
+// transfers were still active.
+bool async_in_dispatch_free(async_in_dispatch * dispatch);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_dispatch_start(async_in_dispatch * dispatch);
+
+void async_in_dispatch_handle_completion(async_in_dispatch * dispatch,
+    async_in_transfer * transfer);
+
+bool async_in_dispatch_has_pending(async_in_dispatch * dispatch);
+
+// Gets the number of times the callback has been called.
+size_t async_in_dispatch_get_callback_count(async_in_dispatch * dispatch);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_dispatch_cancel(async_in_dispatch * dispatch);
+
+void async_in_transfer_set_dispatch(async_in_transfer * transfer,
+    async_in_dispatch * dispatch);
+
+// Makes the transfer's URB use the specified memory instead of the transfer's
+// own buffer.
+void async_in_transfer_set_buffer(async_in_transfer * transfer, uint8_t * buffer);
+
+/** async_in_tuner *************************************************************/
+
+typedef struct async_in_tuner
+               async_in_tuner;
+
+LIBUSBP_TEST_API LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_tuner_create(const libusbp_async_in_tuning * settings,
+    size_t transfer_count, size_t transfer_size, async_in_tuner ** tuner);
+
+LIBUSBP_TEST_API
+void async_in_tuner_free(async_in_tuner * tuner);
+
+// Records a finished transfer.  Returns true if the tuner wants the pipe to
+// switch to the new transfer count and size that it retrieved.
+LIBUSBP_TEST_API
+bool async_in_tuner_record(async_in_tuner * tuner, size_t transferred,
+    const libusbp_transfer_times * times, size_t * new_count, size_t * new_size);
+
+// Tells the tuner that the pipe switched to new transfers.
+LIBUSBP_TEST_API
+void async_in_tuner_set_transfers(async_in_tuner * tuner,
+    size_t transfer_count, size_t transfer_size);
+
+// Cancels the pending transfers in the array, starting with the one at index
+// newest and going backwards.  See async_in_transfer_linux.c.
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_in_transfer_cancel_pending(async_in_transfer ** array,
+    size_t count, size_t newest);
+
+/** async_out ******************************************************************/
+
+typedef struct async_out_transfer
+               async_out_transfer;
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_out_pipe_create(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    libusbp_async_out_pipe ** pipe);
+
+libusbp_generic_handle * async_out_pipe_get_handle(libusbp_async_out_pipe * pipe);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_out_transfer_create(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    size_t transfer_size,
+    async_out_transfer ** transfer);
+
+void async_out_transfer_free(async_out_transfer * transfer);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_out_transfer_submit(async_out_transfer * transfer,
+    const void * buffer, size_t size, unsigned int urb_flags);
+
+void async_out_transfer_handle_completion(async_out_transfer * transfer);
+
+void async_out_transfer_get_results(async_out_transfer * transfer,
+    size_t * transferred, libusbp_error ** transfer_error);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_out_transfer_cancel(async_out_transfer * transfer);
+
+bool async_out_transfer_pending(async_out_transfer * transfer);
+
+/** async_control **************************************************************/
+
+typedef struct async_control_transfer
+               async_control_transfer;
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_control_pipe_create(
+    libusbp_generic_handle * handle,
+    libusbp_async_control_pipe ** pipe);
+
+libusbp_generic_handle * async_control_pipe_get_handle(
+    libusbp_async_control_pipe * pipe);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_control_transfer_create(
+    libusbp_generic_handle * handle,
+    size_t max_data_size,
+    async_control_transfer ** transfer);
+
+void async_control_transfer_free(async_control_transfer * transfer);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_control_transfer_submit(async_control_transfer * transfer,
+    libusbp_setup_packet setup, const void * data);
+
+void async_control_transfer_handle_completion(async_control_transfer * transfer);
+
+void async_control_transfer_get_results(async_control_transfer * transfer,
+    void * buffer, size_t * transferred, libusbp_error ** transfer_error);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * async_control_transfer_cancel(async_control_transfer * transfer);
+
+bool async_control_transfer_pending(async_control_transfer * transfer);
+
+/** chunked_transfer ***********************************************************/
+
+typedef struct chunked_transfer
+               chunked_transfer;
+
+// Returns true if a synchronous transfer of the specified size should be
+// split into several URBs with chunked_transfer_run.
+bool chunked_transfer_is_suitable(libusbp_generic_handle * handle,
+    uint8_t pipe_id, size_t size);
+
+// Returns true if a synchronous transfer into or out of the specified pieces
+// of memory can be done with chunked_transfer_run, without copying them into
+// one buffer.
+bool chunked_transfer_can_map(libusbp_generic_handle * handle,
+    uint8_t pipe_id, const libusbp_iovec * iov, size_t iov_count);
+
+// Performs a synchronous bulk transfer with several URBs in flight.  The
+// timeout applies to the whole transfer, and the flags are
+// libusbp_transfer_flag values.
+LIBUSBP_WARN_UNUSED
+libusbp_error * chunked_transfer_run(libusbp_generic_handle * handle,
+    uint8_t pipe_id, uint32_t timeout, uint32_t flags,
+    const libusbp_iovec * iov, size_t iov_count, size_t * transferred);
+
+void chunked_transfer_handle_completion(chunked_transfer * transfer,
+    struct usbdevfs_urb * urb);
+
+// Tells the handle which URBs belong to the chunked transfer in progress on
+// the specified pipe.
+void generic_handle_set_chunked_transfer(libusbp_generic_handle * handle,
+    uint8_t pipe_id, chunked_transfer * transfer);
+
+/** context ********************************************************************/
+
+#ifdef LIBUSBP_USE_UDEV
+// Gets a udev context for a function that was passed the specified
+// libusbp_context, which may be NULL.  If it is NULL, a new udev context is
+// created.  If there is no error, the caller must call udev_unref on the
+// returned context when it is done.
+LIBUSBP_WARN_UNUSED
+libusbp_error * context_get_udev(libusbp_context * context, struct udev ** udev);
+#endif
+
+// Gets the sysfs root of a context that reads sysfs directly.  Returns NULL
+// if the context uses libudev.  A NULL context uses libudev, unless libusbp
+// was built without it (LIBUSBP_USE_UDEV), in which case its root is "/sys".
+const char * context_get_sysfs_root(const libusbp_context * context);
+
+/** iovec **********************************************************************/
+
+// Adds up the sizes of the pieces and checks that they are valid.
+LIBUSBP_WARN_UNUSED
+libusbp_error * iovec_total_size(const libusbp_iovec * iov, size_t iov_count,
+    size_t * size);
+
+// Copies up to size bytes from the pieces into one buffer.
+void iovec_gather(const libusbp_iovec * iov, size_t iov_count,
+    void * buffer, size_t size);
+
+// Copies size bytes from one buffer into the pieces.
+void iovec_scatter(const libusbp_iovec * iov, size_t iov_count,
+    const void * buffer, size_t size);
+
+/** iso ************************************************************************/
+
+typedef struct iso_transfer
+               iso_transfer;
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * iso_pipe_create(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    libusbp_iso_pipe ** pipe);
+
+libusbp_generic_handle * iso_pipe_get_handle(libusbp_iso_pipe * pipe);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * iso_transfer_create(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    size_t packet_count,
+    size_t packet_size,
+    iso_transfer ** transfer);
+
+void iso_transfer_free(iso_transfer * transfer);
+
+void iso_transfer_submit_in(iso_transfer * transfer);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * iso_transfer_submit_out(iso_transfer * transfer,
+    const void * buffer, const size_t * packet_lengths, size_t packet_count);
+
+void iso_transfer_handle_completion(iso_transfer * transfer);
+
+void iso_transfer_get_results(iso_transfer * transfer, void * buffer,
+    libusbp_iso_packet * packets, size_t * packet_count,
+    libusbp_error ** transfer_error);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * iso_transfer_cancel(iso_transfer * transfer);
+
+bool iso_transfer_pending(iso_transfer * transfer);
+
+/** hotplug_monitor ************************************************************/
+
+// The parts of a uevent that hotplug_uevent_convert looks at.  Events from
+// udev and events read straight from the kernel are both described this way.
+typedef struct hotplug_uevent
+{
+    const char * action;     // like "add" or "remove"
+    const char * subsystem;  // like "usb" or "tty"
+    const char * devtype;    // like "usb_device", or NULL
+    const char * syspath;
+
+    // False if udev has not finished initializing an added device.
+    bool initialized;
+
+    // Gets a property of the event, like "PRODUCT", or returns NULL.
+    const char * (* get_property)(void * context, const char * key);
+
+    // Creates the device that the event is about.  This is only used for
+    // added devices, because removed devices have no sysattrs left to read.
+    libusbp_error * (* create_device)(void * context, libusbp_device ** device);
+
+    // Creates the USB device that the event's tty belongs to, or sets the
+    // device to NULL if there is none.
+    libusbp_error * (* create_parent_device)(void * context, libusbp_device ** device);
+
+    void * context;
+} hotplug_uevent;
+
+// Converts a uevent into one of the LIBUSBP_HOTPLUG_* events and a
+// libusbp_device.  If the event is not one that we report, this returns a
+// NULL device and no error.
+LIBUSBP_TEST_API LIBUSBP_WARN_UNUSED
+libusbp_error * hotplug_uevent_convert(const hotplug_uevent * uevent,
+    uint32_t * event, libusbp_device ** device);
+
+// The kernel's remove events do not say what the serial number of a USB
+// device was, so a monitor that reads them remembers the serial numbers of the
+// devices it has seen in a list of these.  An empty list is NULL.
+typedef struct hotplug_serial_number hotplug_serial_number;
+
+// Adds the devices that are currently connected to the list.
+LIBUSBP_TEST_API LIBUSBP_WARN_UNUSED
+libusbp_error * hotplug_serial_numbers_fill(const char * sysfs_root,
+    hotplug_serial_number ** list);
+
+LIBUSBP_TEST_API
+void hotplug_serial_numbers_free(hotplug_serial_number * list);
+
+// Converts a uevent message from the kernel's netlink socket, which looks like
+// "add@/devices/..." followed by null-separated properties like
+// "SUBSYSTEM=usb", using the specified sysfs root to find the device.  Added
+// devices are remembered in the list of serial numbers, and removed devices
+// get their serial number from it.
+LIBUSBP_TEST_API LIBUSBP_WARN_UNUSED
+libusbp_error * hotplug_kernel_uevent_convert(const char * sysfs_root,
+    hotplug_serial_number ** serial_numbers, const char * message, size_t size,
+    uint32_t * event, libusbp_device ** device);
+
+/** sysfs **********************************************************************/
+
+// These functions read sysfs directly instead of using libudev.  A sysfs root
+// is a directory like "/sys".
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * sysfs_list_devices(const char * root,
+    const libusbp_device_filter * filter, size_t max_count,
+    libusbp_device *** device_list, size_t * device_count);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * sysfs_device_create(const char * syspath, libusbp_device ** device);
+
+// Finds the closest USB device above the specified directory.  Sets
+// device_syspath to NULL if there is none.
+LIBUSBP_WARN_UNUSED
+libusbp_error * sysfs_find_parent_device(const char * syspath, char ** device_syspath);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * sysfs_find_generic_interface(const char * device_syspath,
+    uint8_t interface_number, char ** interface_syspath, char ** filename);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * sysfs_find_serial_port(const char * device_syspath,
+    uint8_t interface_number, char ** tty_syspath, char ** port_name);
+
+// Gets a value from null-separated "KEY=value" strings, like a uevent file or
+// a netlink uevent message.
+LIBUSBP_TEST_API
+const char * sysfs_uevent_get(const char * buffer, size_t size, const char * key);
+
+// Makes the syspath where the kernel puts an interface of a USB device, for
+// example "<device_syspath>/1-2:1.0".
+LIBUSBP_WARN_UNUSED
+libusbp_error * interface_syspath_create(const char * device_syspath,
+    const char * sysname, unsigned int config, uint8_t interface_number,
+    char ** syspath);
+
 /** udevw **********************************************************************/
 
+#ifdef LIBUSBP_USE_UDEV
+
 LIBUSBP_WARN_UNUSED
 libusbp_error * udevw_create_context(struct udev **);
 
 LIBUSBP_WARN_UNUSED
-libusbp_error * udevw_create_usb_list(struct udev * context, struct udev_enumerate ** list);
+libusbp_error * udevw_create_usb_list(struct udev * context,
+    const libusbp_device_filter * filter, struct udev_enumerate ** list);
 
 LIBUSBP_WARN_UNUSED
 libusbp_error * udevw_get_device_from_syspath(struct udev *,
@@ -240,6 +888,10 @@ LIBUSBP_WARN_UNUSED
 libusbp_error * udevw_get_sysattr_uint16(
     struct udev_device * dev, const char * name, uint16_t * value);
 
+LIBUSBP_WARN_UNUSED
+libusbp_error * udevw_get_sysattr_dec_uint8(
+    struct udev_device * dev, const char * name, uint8_t * value);
+
 LIBUSBP_WARN_UNUSED
 libusbp_error * udevw_get_sysattr_if_exists_copy(
   struct udev_device * dev, const char * name, char ** value);
@@ -270,8 +922,10 @@ LIBUSBP_WARN_UNUSED
 libusbp_error * udevw_get_devnode_copy(struct udev_device * device, char ** devnode);
 
 LIBUSBP_WARN_UNUSED
-libusbp_error * udevw_get_devnode_copy_from_syspath(const char * syspath, char ** devnode);
+libusbp_error * udevw_get_devnode_copy_from_syspath(struct udev * udev,
+    const char * syspath, char ** devnode);
 
+#endif
 
 /** usbfd **********************************************************************/
 
@@ -281,16 +935,35 @@ libusbp_error * usbfd_check_existence(const char * filename);
 LIBUSBP_WARN_UNUSED
 libusbp_error * usbfd_open(const char * path, int * fd);
 
+LIBUSBP_WARN_UNUSED
+libusbp_error * usbfd_get_capabilities(int fd, uint32_t * capabilities);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * usbfd_alloc_buffer(int fd, uint32_t capabilities,
+    size_t size, void ** buffer, bool * mapped);
+
+void usbfd_free_buffer(void * buffer, size_t size, bool mapped);
+
 LIBUSBP_WARN_UNUSED
 libusbp_error * usbfd_get_device_descriptor(int fd, struct usb_device_descriptor * desc);
 
+LIBUSBP_TEST_API LIBUSBP_WARN_UNUSED
+libusbp_error * usbfd_get_endpoint_info(int fd,
+    uint8_t configuration, uint8_t interface_number, uint8_t alternate_setting,
+    uint8_t * in_types, uint8_t * out_types,
+    uint16_t * in_max_packet_sizes, uint16_t * out_max_packet_sizes);
+
+LIBUSBP_WARN_UNUSED
+libusbp_error * usbfd_set_interface(int fd, uint8_t interface_number,
+    uint8_t alternate_setting);
+
 LIBUSBP_WARN_UNUSED
 libusbp_error * usbfd_control_transfer(int fd, libusbp_setup_packet setup,
     uint32_t timeout, void * data, size_t * transferred);
 
 LIBUSBP_WARN_UNUSED
-libusbp_error * usbfd_control_transfer_async(int fd, void * combined_buffer,
-    size_t size, uint32_t timeout, void * user_context);
+libusbp_error * usbfd_control_transfer_async(int fd, struct usbdevfs_urb * urb,
+    void * combined_buffer, size_t size, void * user_context);
 
 LIBUSBP_WARN_UNUSED
 libusbp_error * usbfd_bulk_or_interrupt_transfer(int fd, uint8_t pipe, uint32_t timeout,
@@ -305,6 +978,9 @@ libusbp_error * usbfd_reap_urb(int fd, struct usbdevfs_urb ** urb);
 LIBUSBP_WARN_UNUSED
 libusbp_error * usbfd_discard_urb(int fd, struct usbdevfs_urb * urb);
 
+LIBUSBP_WARN_UNUSED
+libusbp_error * usbfd_wait(int fd, int timeout, bool * ready);
+
 #endif
 
 #ifdef __APPLE__
@@ -0,0 +1,339 @@
+#include <libusbp_internal.h>
+
+struct libusbp_async_control_pipe
+{
+    libusbp_generic_handle * handle;
+    async_control_transfer ** transfer_array;
+    size_t max_data_size;
+    size_t transfer_count;
+
+    // The number of transfers that have been submitted but not finished
+    // (handed back to the user of the pipe) yet.  This uses the same
+    // definition of pending as libusbp_async_in_pipe.
+    size_t pending_count;
+
+    // The index of the transfer that should finish next.  That transfer will be
+    // pending if pending_count > 0.
+    size_t next_finish;
+
+    // The index of the transfer that will be used for the next request
+    // submitted by the user.  That transfer is available if pending_count <
+    // transfer_count.
+    size_t next_submit;
+};
+
+static void async_control_transfer_array_free(async_control_transfer ** array,
+    size_t transfer_count)
+{
+    if (array == NULL) { return; }
+
+    for (size_t i = 0; i < transfer_count; i++)
+    {
+        async_control_transfer_free(array[i]);
+    }
+    free(array);
+}
+
+void libusbp_async_control_pipe_close(libusbp_async_control_pipe * pipe)
+{
+    if (pipe != NULL)
+    {
+        async_control_transfer_array_free(pipe->transfer_array, pipe->transfer_count);
+        free(pipe);
+    }
+}
+
+libusbp_error * async_control_pipe_create(libusbp_generic_handle * handle,
+    libusbp_async_control_pipe ** pipe)
+{
+    // Check the pipe output pointer.
+    if (pipe == NULL)
+    {
+        return error_create("Pipe output pointer is null.");
+    }
+
+    *pipe = NULL;
+
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    libusbp_async_control_pipe * new_pipe = calloc(1, sizeof(libusbp_async_control_pipe));
+    if (new_pipe == NULL)
+    {
+        return &error_no_memory;
+    }
+
+    new_pipe->handle = handle;
+    *pipe = new_pipe;
+    return NULL;
+}
+
+libusbp_generic_handle * async_control_pipe_get_handle(
+    libusbp_async_control_pipe * pipe)
+{
+    assert(pipe != NULL);
+    return pipe->handle;
+}
+
+libusbp_error * libusbp_async_control_pipe_allocate_transfers(
+    libusbp_async_control_pipe * pipe,
+    size_t transfer_count,
+    size_t max_data_size)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (pipe->transfer_array != NULL)
+    {
+        return error_create("Transfers were already allocated for this pipe.");
+    }
+
+    if (transfer_count == 0)
+    {
+        return error_create("Transfer count cannot be zero.");
+    }
+
+    libusbp_error * error = NULL;
+
+    async_control_transfer ** new_transfer_array = NULL;
+    if (error == NULL)
+    {
+        new_transfer_array = calloc(transfer_count, sizeof(async_control_transfer *));
+        if (new_transfer_array == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    for(size_t i = 0; error == NULL && i < transfer_count; i++)
+    {
+        error = async_control_transfer_create(pipe->handle,
+            max_data_size, &new_transfer_array[i]);
+    }
+
+    // Put the new array and the information about it into the pipe.
+    if (error == NULL)
+    {
+        pipe->transfer_array = new_transfer_array;
+        pipe->transfer_count = transfer_count;
+        pipe->max_data_size = max_data_size;
+        new_transfer_array = NULL;
+    }
+
+    async_control_transfer_array_free(new_transfer_array, transfer_count);
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to allocate transfers for asynchronous control pipe.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_async_control_pipe_submit_transfer(
+    libusbp_async_control_pipe * pipe,
+    uint8_t bmRequestType,
+    uint8_t bRequest,
+    uint16_t wValue,
+    uint16_t wIndex,
+    const void * data,
+    uint16_t wLength,
+    bool * submitted)
+{
+    if (submitted != NULL)
+    {
+        *submitted = false;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (pipe->transfer_array == NULL)
+    {
+        return error_create("Pipe transfers have not been allocated yet.");
+    }
+
+    if (wLength > pipe->max_data_size)
+    {
+        return error_create("Data size is larger than the transfer size.");
+    }
+
+    if (pipe->pending_count >= pipe->transfer_count)
+    {
+        // All of the transfers are in use, so the caller needs to handle some
+        // finished transfers before submitting more requests.
+        return NULL;
+    }
+
+    libusbp_setup_packet setup;
+    setup.bmRequestType = bmRequestType;
+    setup.bRequest = bRequest;
+    setup.wValue = wValue;
+    setup.wIndex = wIndex;
+    setup.wLength = wLength;
+
+    libusbp_error * error = async_control_transfer_submit(
+        pipe->transfer_array[pipe->next_submit], setup, data);
+
+    if (error == NULL)
+    {
+        if (submitted != NULL)
+        {
+            *submitted = true;
+        }
+
+        pipe->pending_count++;
+        pipe->next_submit = increment_and_wrap_size(pipe->next_submit, pipe->transfer_count);
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to submit asynchronous control transfer.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_async_control_pipe_handle_events(libusbp_async_control_pipe * pipe)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    return generic_handle_events(pipe->handle);
+}
+
+static bool async_control_pipe_can_finish_transfer(void * context)
+{
+    libusbp_async_control_pipe * pipe = context;
+    return pipe->pending_count == 0 ||
+        !async_control_transfer_pending(pipe->transfer_array[pipe->next_finish]);
+}
+
+libusbp_error * libusbp_async_control_pipe_wait(
+    libusbp_async_control_pipe * pipe,
+    uint32_t timeout)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    return generic_handle_wait_until(pipe->handle, timeout,
+        async_control_pipe_can_finish_transfer, pipe);
+}
+
+libusbp_error * libusbp_async_control_pipe_has_pending_transfers(
+    libusbp_async_control_pipe * pipe,
+    bool * result)
+{
+    libusbp_error * error = NULL;
+
+    if (error == NULL && result == NULL)
+    {
+        error = error_create("Boolean output pointer is null.");
+    }
+
+    if (error == NULL)
+    {
+        *result = false;
+    }
+
+    if (error == NULL && pipe == NULL)
+    {
+        error = error_create("Pipe argument is null.");
+    }
+
+    if (error == NULL)
+    {
+        *result = pipe->pending_count ? 1 : 0;
+    }
+
+    return error;
+}
+
+libusbp_error * libusbp_async_control_pipe_handle_finished_transfer(
+    libusbp_async_control_pipe * pipe,
+    bool * finished,
+    void * buffer,
+    size_t * transferred,
+    libusbp_error ** transfer_error)
+{
+    if (finished != NULL)
+    {
+        *finished = false;
+    }
+
+    if (transferred != NULL)
+    {
+        *transferred = 0;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = NULL;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (pipe->pending_count == 0)
+    {
+        // There are no pending transfers that we could check for completion.
+        return NULL;
+    }
+
+    async_control_transfer * transfer = pipe->transfer_array[pipe->next_finish];
+
+    if (async_control_transfer_pending(transfer))
+    {
+        // The next transfer we expect to finish is still pending;
+        // the kernel has not told us that it is done.
+        return NULL;
+    }
+
+    async_control_transfer_get_results(transfer, buffer, transferred, transfer_error);
+
+    if (finished != NULL)
+    {
+        *finished = true;
+    }
+
+    pipe->pending_count--;
+    pipe->next_finish = increment_and_wrap_size(pipe->next_finish, pipe->transfer_count);
+
+    return NULL;
+}
+
+libusbp_error * libusbp_async_control_pipe_cancel_transfers(libusbp_async_control_pipe * pipe)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    libusbp_error * error = NULL;
+
+    // Transfers need to be cancelled individually.  Like
+    // async_in_transfer_cancel_pending, we start with the newest one and skip
+    // the ones that were already reaped.
+    for (size_t i = 0; error == NULL && i < pipe->pending_count; i++)
+    {
+        size_t index = (pipe->next_submit + pipe->transfer_count - 1 - i) %
+            pipe->transfer_count;
+        async_control_transfer * transfer = pipe->transfer_array[index];
+        if (async_control_transfer_pending(transfer))
+        {
+            error = async_control_transfer_cancel(transfer);
+        }
+    }
+
+    return error;
+}
@@ -0,0 +1,193 @@
+#include <libusbp_internal.h>
+
+// The size of the setup packet at the beginning of the buffer of a control
+// URB.
+#define SETUP_PACKET_SIZE 8
+
+struct async_control_transfer
+{
+    struct usbdevfs_urb urb;
+    size_t buffer_size;  // Includes the setup packet.
+    bool buffer_mapped;  // See usbfd_alloc_buffer.
+
+    // This is accessed with atomic operations because the transfer might be
+    // completed by a reaper thread.
+    bool pending;
+    libusbp_error * error;
+    int fd;
+};
+
+libusbp_error * async_control_transfer_create(
+    libusbp_generic_handle * handle, size_t max_data_size,
+    async_control_transfer ** transfer)
+{
+    assert(transfer != NULL);
+
+    if (max_data_size > UINT16_MAX)
+    {
+        // The wLength field of the setup packet is 16 bits.
+        return error_create("Transfer size is too large.");
+    }
+
+    libusbp_error * error = NULL;
+
+    // Allocate the transfer struct.
+    async_control_transfer * new_transfer = NULL;
+    if (error == NULL)
+    {
+        new_transfer = calloc(1, sizeof(async_control_transfer));
+        if (new_transfer == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    // Allocate the buffer for the setup packet and the data.
+    int fd = libusbp_generic_handle_get_fd(handle);
+    size_t buffer_size = SETUP_PACKET_SIZE + max_data_size;
+    void * new_buffer = NULL;
+    bool new_buffer_mapped = false;
+    if (error == NULL)
+    {
+        error = usbfd_alloc_buffer(fd,
+            generic_handle_get_buffer_capabilities(handle),
+            buffer_size, &new_buffer, &new_buffer_mapped);
+    }
+
+    // Assemble the transfer and pass it to the caller.
+    if (error == NULL)
+    {
+        new_transfer->fd = fd;
+        new_transfer->buffer_size = buffer_size;
+
+        new_transfer->urb.buffer = new_buffer;
+        new_transfer->buffer_mapped = new_buffer_mapped;
+        new_buffer = NULL;
+
+        *transfer = new_transfer;
+        new_transfer = NULL;
+    }
+
+    usbfd_free_buffer(new_buffer, buffer_size, new_buffer_mapped);
+    free(new_transfer);
+    return error;
+}
+
+void async_control_transfer_free(async_control_transfer * transfer)
+{
+    if (transfer == NULL) { return; }
+
+    if (async_control_transfer_pending(transfer))
+    {
+        // The kernel might still write to this transfer's buffer and URB, so
+        // we leak it instead of freeing it.  See async_in_transfer_free.
+        return;
+    }
+
+    libusbp_error_free(transfer->error);
+    usbfd_free_buffer(transfer->urb.buffer,
+        transfer->buffer_size, transfer->buffer_mapped);
+    free(transfer);
+}
+
+// Writes the setup packet and any data for the OUT stage into the transfer's
+// buffer and submits it.  Like async_out_transfer_submit, an error from the
+// kernel is returned directly and the transfer is left idle.
+libusbp_error * async_control_transfer_submit(async_control_transfer * transfer,
+    libusbp_setup_packet setup, const void * data)
+{
+    assert(transfer != NULL);
+    assert(!async_control_transfer_pending(transfer));
+    assert(SETUP_PACKET_SIZE + (size_t)setup.wLength <= transfer->buffer_size);
+
+    bool out = !(setup.bmRequestType & 0x80);
+    if (out && data == NULL && setup.wLength)
+    {
+        return error_create("Buffer is null.");
+    }
+
+    // The setup packet is little-endian.
+    uint8_t * buffer = transfer->urb.buffer;
+    buffer[0] = setup.bmRequestType;
+    buffer[1] = setup.bRequest;
+    buffer[2] = setup.wValue & 0xFF;
+    buffer[3] = setup.wValue >> 8;
+    buffer[4] = setup.wIndex & 0xFF;
+    buffer[5] = setup.wIndex >> 8;
+    buffer[6] = setup.wLength & 0xFF;
+    buffer[7] = setup.wLength >> 8;
+    if (out && setup.wLength)
+    {
+        memcpy(buffer + SETUP_PACKET_SIZE, data, setup.wLength);
+    }
+
+    libusbp_error_free(transfer->error);
+    transfer->error = NULL;
+    __atomic_store_n(&transfer->pending, true, __ATOMIC_RELEASE);
+
+    libusbp_error * error = usbfd_control_transfer_async(transfer->fd,
+        &transfer->urb, buffer, SETUP_PACKET_SIZE + setup.wLength, transfer);
+    if (error != NULL)
+    {
+        __atomic_store_n(&transfer->pending, false, __ATOMIC_RELEASE);
+    }
+    return error;
+}
+
+void async_control_transfer_handle_completion(async_control_transfer * transfer)
+{
+    assert(transfer != NULL);
+
+    #ifdef LIBUSBP_LOG
+    fprintf(stderr, "Control URB completed: %p, status=%d, actual_length=%d\n",
+        transfer, transfer->urb.status, transfer->urb.actual_length);
+    #endif
+
+    libusbp_error * error = error_from_urb_status(&transfer->urb);
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Asynchronous control transfer failed.");
+    }
+
+    transfer->error = error;
+    __atomic_store_n(&transfer->pending, false, __ATOMIC_RELEASE);
+}
+
+void async_control_transfer_get_results(async_control_transfer * transfer,
+    void * buffer, size_t * transferred, libusbp_error ** transfer_error)
+{
+    assert(transfer != NULL);
+    assert(!async_control_transfer_pending(transfer));
+
+    // The kernel does not count the setup packet in actual_length.
+    size_t tmp_transferred = transfer->urb.actual_length;
+    const uint8_t * urb_buffer = transfer->urb.buffer;
+    if (buffer != NULL && (urb_buffer[0] & 0x80) && tmp_transferred)
+    {
+        memcpy(buffer, urb_buffer + SETUP_PACKET_SIZE, tmp_transferred);
+    }
+
+    if (transferred != NULL)
+    {
+        *transferred = tmp_transferred;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = libusbp_error_copy(transfer->error);
+    }
+}
+
+libusbp_error * async_control_transfer_cancel(async_control_transfer * transfer)
+{
+    if (transfer == NULL) { return NULL; }
+
+    return usbfd_discard_urb(transfer->fd, &transfer->urb);
+}
+
+bool async_control_transfer_pending(async_control_transfer * transfer)
+{
+    assert(transfer != NULL);
+    return __atomic_load_n(&transfer->pending, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,193 @@
+/* A dispatcher passes each finished transfer of an asynchronous IN pipe to a
+ * callback supplied by the user, on whichever thread reaped the transfer, and
+ * then submits the transfer again.  The callback reads the data straight out
+ * of the transfer's buffer, so nothing is copied and nothing has to be polled.
+ *
+ * The transfers are submitted by the pipe's owner when it starts them and by
+ * the reaping thread after that, so like the completion queue (see
+ * async_in_queue_linux.c), the shared state is only accessed with atomic
+ * operations. */
+
+#include <libusbp_internal.h>
+
+struct async_in_dispatch
+{
+    libusbp_async_in_callback * callback;
+    void * context;
+
+    async_in_transfer ** transfer_array;
+    size_t transfer_count;
+
+    // True if finished transfers should be submitted again.
+    bool resubmit;
+
+    // The number of transfers that are submitted.
+    size_t active_count;
+
+    // The number of times the callback has been called, which lets
+    // libusbp_async_in_pipe_wait tell when something happened.
+    size_t callback_count;
+};
+
+libusbp_error * async_in_dispatch_create(async_in_transfer ** transfer_array,
+    size_t transfer_count, libusbp_async_in_callback * callback, void * context,
+    async_in_dispatch ** dispatch)
+{
+    assert(transfer_array != NULL);
+    assert(callback != NULL);
+    assert(dispatch != NULL);
+
+    async_in_dispatch * new_dispatch = calloc(1, sizeof(async_in_dispatch));
+    if (new_dispatch == NULL)
+    {
+        *dispatch = NULL;
+        return &error_no_memory;
+    }
+
+    new_dispatch->callback = callback;
+    new_dispatch->context = context;
+    new_dispatch->transfer_array = transfer_array;
+    new_dispatch->transfer_count = transfer_count;
+
+    for (size_t i = 0; i < transfer_count; i++)
+    {
+        async_in_transfer_set_dispatch(transfer_array[i], new_dispatch);
+    }
+
+    *dispatch = new_dispatch;
+    return NULL;
+}
+
+bool async_in_dispatch_free(async_in_dispatch * dispatch)
+{
+    if (dispatch == NULL) { return true; }
+
+    if (__atomic_load_n(&dispatch->active_count, __ATOMIC_ACQUIRE))
+    {
+        // The transfers could still complete and call into the dispatcher, so
+        // we leak it.  See async_in_transfer_free.
+        return false;
+    }
+
+    for (size_t i = 0; i < dispatch->transfer_count; i++)
+    {
+        async_in_transfer_set_dispatch(dispatch->transfer_array[i], NULL);
+    }
+    free(dispatch);
+    return true;
+}
+
+// Submits a transfer that is not pending.  If the submission fails, we stop
+// resubmitting transfers and pass the error to the callback without any data.
+// Returns true if the transfer was submitted.
+static bool async_in_dispatch_submit(async_in_dispatch * dispatch,
+    async_in_transfer * transfer)
+{
+    libusbp_error * error = async_in_transfer_submit_checked(transfer);
+    if (error == NULL)
+    {
+        return true;
+    }
+
+    __atomic_store_n(&dispatch->resubmit, false, __ATOMIC_SEQ_CST);
+
+    dispatch->callback(dispatch->context, NULL, 0, error, NULL);
+    __atomic_add_fetch(&dispatch->callback_count, 1, __ATOMIC_ACQ_REL);
+    libusbp_error_free(error);
+    return false;
+}
+
+void async_in_dispatch_handle_completion(async_in_dispatch * dispatch,
+    async_in_transfer * transfer)
+{
+    assert(dispatch != NULL);
+    assert(transfer != NULL);
+
+    const uint8_t * data;
+    size_t transferred;
+    libusbp_error * transfer_error = NULL;
+    libusbp_transfer_times times;
+    libusbp_error * error = async_in_transfer_peek_results(transfer, &data,
+        &transferred, &transfer_error);
+    assert(error == NULL);
+    LIBUSBP_UNUSED(error);
+    async_in_transfer_get_times(transfer, &times);
+
+    dispatch->callback(dispatch->context, data, transferred, transfer_error, &times);
+    __atomic_add_fetch(&dispatch->callback_count, 1, __ATOMIC_ACQ_REL);
+    libusbp_error_free(transfer_error);
+
+    if (__atomic_load_n(&dispatch->resubmit, __ATOMIC_SEQ_CST) &&
+        async_in_dispatch_submit(dispatch, transfer))
+    {
+        // If the pipe was cancelled while we were submitting, the cancel
+        // might have missed this transfer, so cancel it here.
+        if (!__atomic_load_n(&dispatch->resubmit, __ATOMIC_SEQ_CST))
+        {
+            libusbp_error_free(async_in_transfer_cancel(transfer));
+        }
+        return;
+    }
+
+    __atomic_sub_fetch(&dispatch->active_count, 1, __ATOMIC_ACQ_REL);
+}
+
+libusbp_error * async_in_dispatch_start(async_in_dispatch * dispatch)
+{
+    assert(dispatch != NULL);
+
+    if (__atomic_load_n(&dispatch->active_count, __ATOMIC_ACQUIRE))
+    {
+        return error_create("Cannot start transfers while the callback "
+            "still has pending transfers.");
+    }
+
+    __atomic_store_n(&dispatch->resubmit, true, __ATOMIC_SEQ_CST);
+
+    for (size_t i = 0; i < dispatch->transfer_count; i++)
+    {
+        __atomic_add_fetch(&dispatch->active_count, 1, __ATOMIC_ACQ_REL);
+        if (!async_in_dispatch_submit(dispatch, dispatch->transfer_array[i]))
+        {
+            __atomic_sub_fetch(&dispatch->active_count, 1, __ATOMIC_ACQ_REL);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+bool async_in_dispatch_has_pending(async_in_dispatch * dispatch)
+{
+    assert(dispatch != NULL);
+    return __atomic_load_n(&dispatch->active_count, __ATOMIC_ACQUIRE) != 0;
+}
+
+size_t async_in_dispatch_get_callback_count(async_in_dispatch * dispatch)
+{
+    assert(dispatch != NULL);
+    return __atomic_load_n(&dispatch->callback_count, __ATOMIC_ACQUIRE);
+}
+
+libusbp_error * async_in_dispatch_cancel(async_in_dispatch * dispatch)
+{
+    assert(dispatch != NULL);
+
+    __atomic_store_n(&dispatch->resubmit, false, __ATOMIC_SEQ_CST);
+
+    // Transfers are resubmitted in the order they complete, so the newest
+    // pending transfer is found the same way as in async_in_queue_cancel.
+    size_t count = dispatch->transfer_count;
+    size_t newest = count - 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (async_in_transfer_pending(dispatch->transfer_array[i]) &&
+            !async_in_transfer_pending(dispatch->transfer_array[(i + 1) % count]))
+        {
+            newest = i;
+            break;
+        }
+    }
+
+    return async_in_transfer_cancel_pending(dispatch->transfer_array, count, newest);
+}
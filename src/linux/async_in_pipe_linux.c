@@ -0,0 +1,891 @@
+/* The Linux-only parts of asynchronous IN pipes.  Most of them are modes (see
+ * async_in_mode in libusbp_internal.h) that change how the pipe handles its
+ * transfers:
+ *
+ * - A completion queue (async_in_queue_linux.c) lets the thread that reaps
+ *   the transfers resubmit them and passes their data through a ring.
+ * - A stream (async_in_stream_linux.c) puts the data of all the transfers
+ *   into one continuous ring.
+ * - A callback (async_in_dispatch_linux.c) is called with each transfer on
+ *   the thread that reaps it.
+ * - Auto-tuning (async_in_tuner_linux.c) leaves the transfers to the pipe but
+ *   changes their count and size while it runs.
+ *
+ * Each mode here wraps the object that implements it so async_in_pipe.c can
+ * use it through its async_in_mode_ops. */
+
+#include <libusbp_internal.h>
+
+/** completion queue **********************************************************/
+
+typedef struct queue_mode
+{
+    async_in_mode mode;
+    async_in_queue * queue;
+    size_t transfer_size;
+} queue_mode;
+
+static bool queue_mode_free(async_in_mode * mode)
+{
+    queue_mode * m = (queue_mode *)mode;
+    bool freed = async_in_queue_free(m->queue);
+    free(m);
+    return freed;
+}
+
+static libusbp_error * queue_mode_start(async_in_mode * mode)
+{
+    return async_in_queue_start(((queue_mode *)mode)->queue);
+}
+
+static libusbp_error * queue_mode_cancel(async_in_mode * mode)
+{
+    return async_in_queue_cancel(((queue_mode *)mode)->queue);
+}
+
+static bool queue_mode_has_pending(async_in_mode * mode)
+{
+    return async_in_queue_has_pending(((queue_mode *)mode)->queue);
+}
+
+static libusbp_error * queue_mode_handle_finished_transfer(async_in_mode * mode,
+    bool * finished, void * buffer, size_t * transferred,
+    libusbp_error ** transfer_error)
+{
+    queue_mode * m = (queue_mode *)mode;
+    libusbp_iovec iov = { buffer, m->transfer_size };
+    bool tmp_finished = async_in_queue_pop(m->queue,
+        &iov, buffer ? 1 : 0, transferred, NULL, transfer_error);
+    if (finished != NULL)
+    {
+        *finished = tmp_finished;
+    }
+    return NULL;
+}
+
+static const async_in_mode_ops queue_mode_ops = {
+    .name = "a completion queue",
+    .free = queue_mode_free,
+    .start = queue_mode_start,
+    .cancel = queue_mode_cancel,
+    .has_pending = queue_mode_has_pending,
+    .handle_finished_transfer = queue_mode_handle_finished_transfer,
+};
+
+// Returns the pipe's completion queue, or NULL if it does not have one.
+static async_in_queue * async_in_pipe_get_queue(libusbp_async_in_pipe * pipe)
+{
+    async_in_mode * mode = async_in_pipe_get_mode(pipe);
+    if (mode == NULL || mode->ops != &queue_mode_ops) { return NULL; }
+    return ((queue_mode *)mode)->queue;
+}
+
+/** stream ********************************************************************/
+
+typedef struct stream_mode
+{
+    async_in_mode mode;
+    async_in_stream * stream;
+} stream_mode;
+
+static bool stream_mode_free(async_in_mode * mode)
+{
+    stream_mode * m = (stream_mode *)mode;
+    bool freed = async_in_stream_free(m->stream);
+    free(m);
+    return freed;
+}
+
+static libusbp_error * stream_mode_start(async_in_mode * mode)
+{
+    return async_in_stream_start(((stream_mode *)mode)->stream);
+}
+
+static libusbp_error * stream_mode_cancel(async_in_mode * mode)
+{
+    return async_in_stream_cancel(((stream_mode *)mode)->stream);
+}
+
+static bool stream_mode_has_pending(async_in_mode * mode)
+{
+    return async_in_stream_has_pending(((stream_mode *)mode)->stream);
+}
+
+static libusbp_error * stream_mode_handle_finished_transfer(async_in_mode * mode,
+    bool * finished, void * buffer, size_t * transferred,
+    libusbp_error ** transfer_error)
+{
+    LIBUSBP_UNUSED(mode);
+    LIBUSBP_UNUSED(finished);
+    LIBUSBP_UNUSED(buffer);
+    LIBUSBP_UNUSED(transferred);
+    LIBUSBP_UNUSED(transfer_error);
+    return error_create("Transfers cannot be handled one at a time for a "
+        "pipe with a stream.");
+}
+
+static const async_in_mode_ops stream_mode_ops = {
+    .name = "a stream",
+    .free = stream_mode_free,
+    .start = stream_mode_start,
+    .cancel = stream_mode_cancel,
+    .has_pending = stream_mode_has_pending,
+    .handle_finished_transfer = stream_mode_handle_finished_transfer,
+};
+
+// Returns the pipe's stream, or NULL if it does not have one.
+static async_in_stream * async_in_pipe_get_stream(libusbp_async_in_pipe * pipe)
+{
+    async_in_mode * mode = async_in_pipe_get_mode(pipe);
+    if (mode == NULL || mode->ops != &stream_mode_ops) { return NULL; }
+    return ((stream_mode *)mode)->stream;
+}
+
+/** callback ******************************************************************/
+
+typedef struct callback_mode
+{
+    async_in_mode mode;
+    async_in_dispatch * dispatch;
+} callback_mode;
+
+static bool callback_mode_free(async_in_mode * mode)
+{
+    callback_mode * m = (callback_mode *)mode;
+    bool freed = async_in_dispatch_free(m->dispatch);
+    free(m);
+    return freed;
+}
+
+static libusbp_error * callback_mode_start(async_in_mode * mode)
+{
+    return async_in_dispatch_start(((callback_mode *)mode)->dispatch);
+}
+
+static libusbp_error * callback_mode_cancel(async_in_mode * mode)
+{
+    return async_in_dispatch_cancel(((callback_mode *)mode)->dispatch);
+}
+
+static bool callback_mode_has_pending(async_in_mode * mode)
+{
+    return async_in_dispatch_has_pending(((callback_mode *)mode)->dispatch);
+}
+
+static libusbp_error * callback_mode_handle_finished_transfer(async_in_mode * mode,
+    bool * finished, void * buffer, size_t * transferred,
+    libusbp_error ** transfer_error)
+{
+    LIBUSBP_UNUSED(mode);
+    LIBUSBP_UNUSED(finished);
+    LIBUSBP_UNUSED(buffer);
+    LIBUSBP_UNUSED(transferred);
+    LIBUSBP_UNUSED(transfer_error);
+    return error_create("Transfers are passed to the callback for a "
+        "pipe with a callback.");
+}
+
+static const async_in_mode_ops callback_mode_ops = {
+    .name = "a callback",
+    .replaceable = true,
+    .free = callback_mode_free,
+    .start = callback_mode_start,
+    .cancel = callback_mode_cancel,
+    .has_pending = callback_mode_has_pending,
+    .handle_finished_transfer = callback_mode_handle_finished_transfer,
+};
+
+// Returns the pipe's dispatcher, or NULL if it does not have a callback.
+static async_in_dispatch * async_in_pipe_get_dispatch(libusbp_async_in_pipe * pipe)
+{
+    async_in_mode * mode = async_in_pipe_get_mode(pipe);
+    if (mode == NULL || mode->ops != &callback_mode_ops) { return NULL; }
+    return ((callback_mode *)mode)->dispatch;
+}
+
+/** auto-tuning ***************************************************************/
+
+typedef struct tuning_mode
+{
+    async_in_mode mode;
+    async_in_tuner * tuner;
+
+    // The transfer count and size picked by the tuner, which will be used
+    // once all of the current transfers have been handled.  If resize_count is
+    // 0, no change is waiting.
+    size_t resize_count;
+    size_t resize_size;
+} tuning_mode;
+
+static bool tuning_mode_free(async_in_mode * mode)
+{
+    tuning_mode * m = (tuning_mode *)mode;
+    async_in_tuner_free(m->tuner);
+    free(m);
+    return true;
+}
+
+// Switches to the transfer count and size picked by the tuner once all of the
+// current transfers have been handled.  Returns false if we are still waiting
+// for that, in which case no transfers should be submitted.
+static bool tuning_mode_ready_to_submit(async_in_mode * mode,
+    libusbp_async_in_pipe * pipe)
+{
+    tuning_mode * m = (tuning_mode *)mode;
+
+    if (m->resize_count == 0) { return true; }
+
+    if (!async_in_pipe_is_idle(pipe)) { return false; }
+
+    // If we cannot allocate the new transfers, we just keep the old ones.
+    libusbp_error_free(async_in_pipe_replace_transfers(pipe,
+        m->resize_count, m->resize_size));
+
+    size_t transfer_count, transfer_size;
+    async_in_pipe_get_transfers(pipe, NULL, &transfer_count, &transfer_size);
+    async_in_tuner_set_transfers(m->tuner, transfer_count, transfer_size);
+    m->resize_count = 0;
+    return true;
+}
+
+// Gives a transfer that is about to be finished to the tuner.
+static void tuning_mode_transfer_finished(async_in_mode * mode,
+    async_in_transfer * transfer)
+{
+    tuning_mode * m = (tuning_mode *)mode;
+
+    if (m->resize_count != 0)
+    {
+        // We are already waiting to resize, and the transfers finishing now
+        // were held back on purpose, so they say nothing useful.
+        return;
+    }
+
+    size_t transferred = 0;
+    libusbp_transfer_times times;
+    libusbp_error_free(async_in_transfer_peek_results(transfer, NULL, &transferred, NULL));
+    async_in_transfer_get_times(transfer, &times);
+
+    size_t new_count, new_size;
+    if (async_in_tuner_record(m->tuner, transferred, &times, &new_count, &new_size))
+    {
+        m->resize_count = new_count;
+        m->resize_size = new_size;
+    }
+}
+
+static const async_in_mode_ops tuning_mode_ops = {
+    .name = "auto-tuning",
+    .replaceable = true,
+    .free = tuning_mode_free,
+    .ready_to_submit = tuning_mode_ready_to_submit,
+    .transfer_finished = tuning_mode_transfer_finished,
+};
+
+/** enabling modes ************************************************************/
+
+libusbp_error * libusbp_async_in_pipe_enable_completion_queue(
+    libusbp_async_in_pipe * pipe,
+    size_t queue_length)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    libusbp_error * error = async_in_pipe_check_mode(pipe, &queue_mode_ops);
+
+    queue_mode * new_mode = NULL;
+    if (error == NULL)
+    {
+        new_mode = calloc(1, sizeof(queue_mode));
+        if (new_mode == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    if (error == NULL)
+    {
+        async_in_transfer ** transfer_array;
+        size_t transfer_count;
+        new_mode->mode.ops = &queue_mode_ops;
+        async_in_pipe_get_transfers(pipe, &transfer_array, &transfer_count,
+            &new_mode->transfer_size);
+        error = async_in_queue_create(transfer_array, transfer_count,
+            new_mode->transfer_size, queue_length, &new_mode->queue);
+    }
+
+    if (error == NULL)
+    {
+        async_in_pipe_set_mode(pipe, &new_mode->mode);
+        new_mode = NULL;
+    }
+
+    free(new_mode);
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to enable completion queue.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_async_in_pipe_enable_stream(
+    libusbp_async_in_pipe * pipe,
+    size_t buffer_size)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    libusbp_error * error = async_in_pipe_check_mode(pipe, &stream_mode_ops);
+
+    stream_mode * new_mode = NULL;
+    if (error == NULL)
+    {
+        new_mode = calloc(1, sizeof(stream_mode));
+        if (new_mode == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    if (error == NULL)
+    {
+        async_in_transfer ** transfer_array;
+        size_t transfer_count, transfer_size;
+        new_mode->mode.ops = &stream_mode_ops;
+        async_in_pipe_get_transfers(pipe, &transfer_array, &transfer_count,
+            &transfer_size);
+        error = async_in_stream_create(transfer_array, transfer_count,
+            transfer_size, buffer_size, &new_mode->stream);
+    }
+
+    if (error == NULL)
+    {
+        async_in_pipe_set_mode(pipe, &new_mode->mode);
+        new_mode = NULL;
+    }
+
+    free(new_mode);
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to enable stream.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_async_in_pipe_set_callback(
+    libusbp_async_in_pipe * pipe,
+    libusbp_async_in_callback * callback,
+    void * context)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    libusbp_error * error = async_in_pipe_check_mode(pipe, &callback_mode_ops);
+    if (error != NULL || callback == NULL)
+    {
+        if (error == NULL)
+        {
+            async_in_pipe_set_mode(pipe, NULL);
+        }
+        return error;
+    }
+
+    async_in_transfer ** transfer_array;
+    size_t transfer_count;
+    async_in_pipe_get_transfers(pipe, &transfer_array, &transfer_count, NULL);
+
+    callback_mode * new_mode = calloc(1, sizeof(callback_mode));
+    if (new_mode == NULL)
+    {
+        error = &error_no_memory;
+    }
+
+    if (error == NULL)
+    {
+        new_mode->mode.ops = &callback_mode_ops;
+        error = async_in_dispatch_create(transfer_array, transfer_count,
+            callback, context, &new_mode->dispatch);
+    }
+
+    if (error == NULL)
+    {
+        async_in_pipe_set_mode(pipe, &new_mode->mode);
+
+        // Freeing the old dispatcher cleared it from the transfers, so point
+        // them at the new one again.
+        for (size_t i = 0; i < transfer_count; i++)
+        {
+            async_in_transfer_set_dispatch(transfer_array[i], new_mode->dispatch);
+        }
+        new_mode = NULL;
+    }
+
+    free(new_mode);
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to set callback.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_async_in_pipe_enable_auto_tuning(
+    libusbp_async_in_pipe * pipe,
+    const libusbp_async_in_tuning * settings)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    libusbp_error * error = async_in_pipe_check_mode(pipe, &tuning_mode_ops);
+    if (error != NULL || settings == NULL)
+    {
+        if (error == NULL)
+        {
+            async_in_pipe_set_mode(pipe, NULL);
+        }
+        return error;
+    }
+
+    tuning_mode * new_mode = calloc(1, sizeof(tuning_mode));
+    if (new_mode == NULL)
+    {
+        error = &error_no_memory;
+    }
+
+    if (error == NULL)
+    {
+        size_t transfer_count, transfer_size;
+        async_in_pipe_get_transfers(pipe, NULL, &transfer_count, &transfer_size);
+        new_mode->mode.ops = &tuning_mode_ops;
+        error = async_in_tuner_create(settings, transfer_count, transfer_size,
+            &new_mode->tuner);
+    }
+
+    if (error == NULL)
+    {
+        // This forgets any change picked by the old tuner.
+        async_in_pipe_set_mode(pipe, &new_mode->mode);
+        new_mode = NULL;
+    }
+
+    free(new_mode);
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to enable auto-tuning.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_async_in_pipe_get_transfer_info(
+    libusbp_async_in_pipe * pipe,
+    size_t * transfer_count,
+    size_t * transfer_size)
+{
+    if (transfer_count != NULL)
+    {
+        *transfer_count = 0;
+    }
+
+    if (transfer_size != NULL)
+    {
+        *transfer_size = 0;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    async_in_pipe_get_transfers(pipe, NULL, transfer_count, transfer_size);
+    return NULL;
+}
+
+/** waiting and handling transfers ********************************************/
+
+static bool async_in_pipe_has_pending(libusbp_async_in_pipe * pipe)
+{
+    bool pending = false;
+    libusbp_error_free(libusbp_async_in_pipe_has_pending_transfers(pipe, &pending));
+    return pending;
+}
+
+static bool async_in_pipe_can_finish_transfer(void * context)
+{
+    libusbp_async_in_pipe * pipe = context;
+
+    async_in_queue * queue = async_in_pipe_get_queue(pipe);
+    if (queue != NULL)
+    {
+        return async_in_queue_can_pop(queue) || !async_in_queue_has_pending(queue);
+    }
+
+    async_in_stream * stream = async_in_pipe_get_stream(pipe);
+    if (stream != NULL)
+    {
+        return async_in_stream_can_peek(stream) || !async_in_stream_has_pending(stream);
+    }
+
+    return async_in_pipe_get_finished_transfer(pipe) != NULL ||
+        !async_in_pipe_has_pending(pipe);
+}
+
+typedef struct async_in_pipe_callback_wait
+{
+    async_in_dispatch * dispatch;
+    size_t callback_count;
+} async_in_pipe_callback_wait;
+
+// For a pipe with a callback, waiting finishes when the callback has been
+// called or there is nothing left to call it.
+static bool async_in_pipe_callback_called(void * context)
+{
+    async_in_pipe_callback_wait * wait = context;
+    return async_in_dispatch_get_callback_count(wait->dispatch) != wait->callback_count ||
+        !async_in_dispatch_has_pending(wait->dispatch);
+}
+
+libusbp_error * libusbp_async_in_pipe_wait(
+    libusbp_async_in_pipe * pipe,
+    uint32_t timeout)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    libusbp_generic_handle * handle = async_in_pipe_get_handle(pipe);
+
+    async_in_dispatch * dispatch = async_in_pipe_get_dispatch(pipe);
+    if (dispatch != NULL)
+    {
+        async_in_pipe_callback_wait wait = { dispatch,
+            async_in_dispatch_get_callback_count(dispatch) };
+        return generic_handle_wait_until(handle, timeout,
+            async_in_pipe_callback_called, &wait);
+    }
+
+    return generic_handle_wait_until(handle, timeout,
+        async_in_pipe_can_finish_transfer, pipe);
+}
+
+// Does the work of libusbp_async_in_pipe_handle_finished_transfer_v and
+// libusbp_async_in_pipe_handle_finished_transfer_ex after their arguments are
+// checked and their outputs are cleared.
+static libusbp_error * async_in_pipe_handle_finished_transfer_iov(
+    libusbp_async_in_pipe * pipe,
+    bool * finished,
+    const libusbp_iovec * iov,
+    size_t iov_count,
+    size_t * transferred,
+    libusbp_transfer_times * times,
+    libusbp_error ** transfer_error)
+{
+    async_in_queue * queue = async_in_pipe_get_queue(pipe);
+    if (queue != NULL)
+    {
+        bool tmp_finished = async_in_queue_pop(queue,
+            iov, iov_count, transferred, times, transfer_error);
+        if (finished != NULL)
+        {
+            *finished = tmp_finished;
+        }
+        return NULL;
+    }
+
+    async_in_mode * mode = async_in_pipe_get_mode(pipe);
+    if (mode != NULL && mode->ops->handle_finished_transfer != NULL)
+    {
+        // The other modes that take over the transfers do not hand them out,
+        // so this just reports that.
+        return mode->ops->handle_finished_transfer(mode, finished, NULL,
+            transferred, transfer_error);
+    }
+
+    async_in_transfer * transfer = async_in_pipe_get_finished_transfer(pipe);
+    if (transfer == NULL)
+    {
+        return NULL;
+    }
+
+    // Copy the data straight from the transfer's buffer into the pieces.
+    const uint8_t * data = NULL;
+    size_t tmp_transferred = 0;
+    libusbp_error * error = async_in_transfer_peek_results(transfer, &data,
+        &tmp_transferred, transfer_error);
+
+    if (error == NULL)
+    {
+        iovec_scatter(iov, iov_count, data, tmp_transferred);
+
+        if (transferred != NULL)
+        {
+            *transferred = tmp_transferred;
+        }
+
+        if (times != NULL)
+        {
+            async_in_transfer_get_times(transfer, times);
+        }
+
+        if (finished != NULL)
+        {
+            *finished = true;
+        }
+
+        async_in_pipe_finish_transfer(pipe);
+    }
+
+    return error;
+}
+
+libusbp_error * libusbp_async_in_pipe_handle_finished_transfer_v(
+    libusbp_async_in_pipe * pipe,
+    bool * finished,
+    const libusbp_iovec * iov,
+    size_t iov_count,
+    size_t * transferred,
+    libusbp_error ** transfer_error)
+{
+    if (finished != NULL)
+    {
+        *finished = false;
+    }
+
+    if (transferred != NULL)
+    {
+        *transferred = 0;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = NULL;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    size_t total_size;
+    libusbp_error * error = iovec_total_size(iov, iov_count, &total_size);
+    if (error != NULL)
+    {
+        return error;
+    }
+
+    size_t transfer_size;
+    async_in_pipe_get_transfers(pipe, NULL, NULL, &transfer_size);
+    if (total_size < transfer_size)
+    {
+        return error_create("Buffers are smaller than the transfer size.");
+    }
+
+    return async_in_pipe_handle_finished_transfer_iov(pipe, finished,
+        iov, iov_count, transferred, NULL, transfer_error);
+}
+
+libusbp_error * libusbp_async_in_pipe_handle_finished_transfer_ex(
+    libusbp_async_in_pipe * pipe,
+    bool * finished,
+    void * buffer,
+    size_t * transferred,
+    libusbp_transfer_times * times,
+    libusbp_error ** transfer_error)
+{
+    if (finished != NULL)
+    {
+        *finished = false;
+    }
+
+    if (transferred != NULL)
+    {
+        *transferred = 0;
+    }
+
+    if (times != NULL)
+    {
+        times->submit_time_ns = 0;
+        times->complete_time_ns = 0;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = NULL;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    size_t transfer_size;
+    async_in_pipe_get_transfers(pipe, NULL, NULL, &transfer_size);
+    libusbp_iovec iov = { buffer, transfer_size };
+    return async_in_pipe_handle_finished_transfer_iov(pipe, finished,
+        &iov, buffer ? 1 : 0, transferred, times, transfer_error);
+}
+
+libusbp_error * libusbp_async_in_pipe_set_timestamp_clock(
+    libusbp_async_in_pipe * pipe,
+    uint32_t clock)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (clock != LIBUSBP_CLOCK_MONOTONIC && clock != LIBUSBP_CLOCK_MONOTONIC_RAW)
+    {
+        return error_create("Invalid timestamp clock: %u.", clock);
+    }
+
+    async_in_pipe_set_clock(pipe, clock);
+
+    async_in_transfer ** transfer_array;
+    size_t transfer_count;
+    async_in_pipe_get_transfers(pipe, &transfer_array, &transfer_count, NULL);
+    for (size_t i = 0; i < transfer_count; i++)
+    {
+        async_in_transfer_set_clock(transfer_array[i], clock);
+    }
+    return NULL;
+}
+
+/** streams *******************************************************************/
+
+libusbp_error * libusbp_async_in_pipe_stream_peek(
+    libusbp_async_in_pipe * pipe,
+    const uint8_t ** data,
+    size_t * size,
+    libusbp_error ** transfer_error)
+{
+    if (data != NULL)
+    {
+        *data = NULL;
+    }
+
+    if (size != NULL)
+    {
+        *size = 0;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = NULL;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (data == NULL)
+    {
+        return error_create("Data output pointer is null.");
+    }
+
+    if (size == NULL)
+    {
+        return error_create("Size output pointer is null.");
+    }
+
+    async_in_stream * stream = async_in_pipe_get_stream(pipe);
+    if (stream == NULL)
+    {
+        return error_create("A stream has not been enabled for this pipe.");
+    }
+
+    async_in_stream_peek(stream, data, size, transfer_error);
+    return NULL;
+}
+
+libusbp_error * libusbp_async_in_pipe_stream_consume(
+    libusbp_async_in_pipe * pipe,
+    size_t size)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    async_in_stream * stream = async_in_pipe_get_stream(pipe);
+    if (stream == NULL)
+    {
+        return error_create("A stream has not been enabled for this pipe.");
+    }
+
+    return async_in_stream_consume(stream, size);
+}
+
+/** draining ******************************************************************/
+
+// Finishes and discards every transfer that has been reaped, and returns true
+// if there are no pending transfers left.
+static bool async_in_pipe_discard_finished_transfers(void * context)
+{
+    libusbp_async_in_pipe * pipe = context;
+
+    async_in_stream * stream = async_in_pipe_get_stream(pipe);
+    while (stream != NULL)
+    {
+        const uint8_t * data;
+        size_t size;
+        libusbp_error * transfer_error;
+        async_in_stream_peek(stream, &data, &size, &transfer_error);
+        libusbp_error_free(transfer_error);
+        if (size == 0 && transfer_error == NULL) { break; }
+        libusbp_error_free(async_in_stream_consume(stream, size));
+    }
+
+    while (stream == NULL && async_in_pipe_get_dispatch(pipe) == NULL)
+    {
+        bool finished;
+        libusbp_error * error = libusbp_async_in_pipe_handle_finished_transfer(
+            pipe, &finished, NULL, NULL, NULL);
+        libusbp_error_free(error);
+        if (error != NULL || !finished) { break; }
+    }
+
+    return !async_in_pipe_has_pending(pipe);
+}
+
+libusbp_error * libusbp_async_in_pipe_cancel_transfers_and_drain(
+    libusbp_async_in_pipe * pipe,
+    uint32_t timeout)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    libusbp_error * error = libusbp_async_in_pipe_cancel_transfers(pipe);
+
+    if (error == NULL)
+    {
+        error = generic_handle_wait_until(async_in_pipe_get_handle(pipe),
+            timeout, async_in_pipe_discard_finished_transfers, pipe);
+    }
+
+    if (error == NULL && !async_in_pipe_discard_finished_transfers(pipe))
+    {
+        error = error_create("Timed out waiting for transfers to be cancelled.");
+        error = error_add_code(error, LIBUSBP_ERROR_TIMEOUT);
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to cancel and drain transfers.");
+    }
+    return error;
+}
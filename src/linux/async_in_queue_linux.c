@@ -0,0 +1,442 @@
+/* A completion queue lets the thread that reaps URBs for an asynchronous IN
+ * pipe resubmit each transfer as soon as it completes.  The data from the
+ * transfer is copied into a single-producer, single-consumer ring buffer, and
+ * the thread that owns the pipe takes it from there when it calls
+ * libusbp_async_in_pipe_handle_finished_transfer.
+ *
+ * The producer is whichever thread reaps the URBs: the handle's reaper thread
+ * if it is running, or the pipe's owner otherwise.  If the ring is full, the
+ * producer parks completed transfers (without resubmitting them) in a FIFO
+ * protected by a mutex, and they are moved into the ring by whichever thread
+ * next sees that there is room.  While anything is parked, all ring insertions
+ * happen with that mutex held, so there is still only one producer at a
+ * time. */
+
+#include <libusbp_internal.h>
+
+struct async_in_queue
+{
+    // Written by the producer, read by the consumer.
+    size_t head __attribute__((aligned(LIBUSBP_CACHE_LINE_SIZE)));
+
+    // Written by the consumer, read by the producer.
+    size_t tail __attribute__((aligned(LIBUSBP_CACHE_LINE_SIZE)));
+
+    // The number of transfers that are submitted or parked.  Changed by both
+    // threads.
+    size_t active_count __attribute__((aligned(LIBUSBP_CACHE_LINE_SIZE)));
+
+    // True if completed transfers should be submitted again.
+    bool resubmit;
+
+    // An error from submitting a transfer, which will be reported to the
+    // consumer after the data in the ring.
+    libusbp_error * submit_error;
+
+    // The number of transfers in parked_array.  Only changed with the mutex
+    // held, but read without it.
+    size_t parked_count;
+
+    // Everything below is only changed when the queue is created, or with the
+    // mutex held.
+    pthread_mutex_t mutex __attribute__((aligned(LIBUSBP_CACHE_LINE_SIZE)));
+    async_in_transfer ** parked_array;
+    size_t parked_first;
+
+    async_in_transfer ** transfer_array;
+    size_t transfer_count;
+    size_t transfer_size;
+
+    size_t capacity;
+    size_t * transferred_array;
+    libusbp_transfer_times * times_array;
+    libusbp_error ** error_array;
+    uint8_t * data;
+};
+
+libusbp_error * async_in_queue_create(async_in_transfer ** transfer_array,
+    size_t transfer_count, size_t transfer_size, size_t capacity,
+    async_in_queue ** queue)
+{
+    assert(transfer_array != NULL);
+    assert(queue != NULL);
+
+    *queue = NULL;
+
+    if (capacity == 0)
+    {
+        return error_create("Queue length cannot be zero.");
+    }
+
+    if (capacity > SIZE_MAX / transfer_size)
+    {
+        return error_create("Queue length is too large.");
+    }
+
+    libusbp_error * error = NULL;
+
+    async_in_queue * new_queue = NULL;
+    if (error == NULL)
+    {
+        void * memory = NULL;
+        if (posix_memalign(&memory, LIBUSBP_CACHE_LINE_SIZE, sizeof(async_in_queue)))
+        {
+            error = &error_no_memory;
+        }
+        else
+        {
+            new_queue = memory;
+            memset(new_queue, 0, sizeof(async_in_queue));
+        }
+    }
+
+    bool mutex_initialized = false;
+    if (error == NULL)
+    {
+        if (pthread_mutex_init(&new_queue->mutex, NULL))
+        {
+            error = error_create("Failed to initialize mutex.");
+        }
+        else
+        {
+            mutex_initialized = true;
+        }
+    }
+
+    if (error == NULL)
+    {
+        new_queue->parked_array = calloc(transfer_count, sizeof(async_in_transfer *));
+        new_queue->transferred_array = calloc(capacity, sizeof(size_t));
+        new_queue->times_array = calloc(capacity, sizeof(libusbp_transfer_times));
+        new_queue->error_array = calloc(capacity, sizeof(libusbp_error *));
+        new_queue->data = malloc(capacity * transfer_size);
+        if (new_queue->parked_array == NULL || new_queue->transferred_array == NULL ||
+            new_queue->times_array == NULL || new_queue->error_array == NULL ||
+            new_queue->data == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    if (error == NULL)
+    {
+        new_queue->transfer_array = transfer_array;
+        new_queue->transfer_count = transfer_count;
+        new_queue->transfer_size = transfer_size;
+        new_queue->capacity = capacity;
+
+        for (size_t i = 0; i < transfer_count; i++)
+        {
+            async_in_transfer_set_queue(transfer_array[i], new_queue);
+        }
+
+        *queue = new_queue;
+        new_queue = NULL;
+    }
+
+    if (new_queue != NULL)
+    {
+        if (mutex_initialized) { pthread_mutex_destroy(&new_queue->mutex); }
+        free(new_queue->parked_array);
+        free(new_queue->transferred_array);
+        free(new_queue->times_array);
+        free(new_queue->error_array);
+        free(new_queue->data);
+        free(new_queue);
+    }
+    return error;
+}
+
+bool async_in_queue_free(async_in_queue * queue)
+{
+    if (queue == NULL) { return true; }
+
+    if (__atomic_load_n(&queue->active_count, __ATOMIC_ACQUIRE))
+    {
+        // Some transfers are still pending and could complete at any time,
+        // which would write to this queue.  Like async_in_transfer_free, we
+        // leak the memory instead of freeing it.
+        return false;
+    }
+
+    for (size_t i = 0; i < queue->capacity; i++)
+    {
+        libusbp_error_free(queue->error_array[i]);
+    }
+    libusbp_error_free(queue->submit_error);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->parked_array);
+    free(queue->transferred_array);
+    free(queue->times_array);
+    free(queue->error_array);
+    free(queue->data);
+    free(queue);
+    return true;
+}
+
+// Copies the results of a completed transfer into the ring.  Returns false if
+// the ring is full.  Only one thread at a time may call this (see the comment
+// at the top of this file).
+static bool async_in_queue_push(async_in_queue * queue, async_in_transfer * transfer)
+{
+    size_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= queue->capacity)
+    {
+        return false;
+    }
+
+    size_t index = head % queue->capacity;
+
+    const uint8_t * buffer;
+    size_t transferred;
+    libusbp_error * error = async_in_transfer_peek_results(transfer, &buffer,
+        &transferred, &queue->error_array[index]);
+    assert(error == NULL);
+    LIBUSBP_UNUSED(error);
+
+    memcpy(queue->data + index * queue->transfer_size, buffer, transferred);
+    queue->transferred_array[index] = transferred;
+    async_in_transfer_get_times(transfer, &queue->times_array[index]);
+
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Submits a transfer that is not pending.  If the submission fails, we stop
+// resubmitting transfers and save the error so the consumer will get it after
+// all the data before it.  Returns true if the transfer was submitted.
+static bool async_in_queue_submit(async_in_queue * queue, async_in_transfer * transfer)
+{
+    libusbp_error * error = async_in_transfer_submit_checked(transfer);
+    if (error == NULL)
+    {
+        return true;
+    }
+
+    __atomic_store_n(&queue->resubmit, false, __ATOMIC_SEQ_CST);
+
+    libusbp_error * old_error = __atomic_exchange_n(&queue->submit_error,
+        error, __ATOMIC_ACQ_REL);
+    libusbp_error_free(old_error);
+    return false;
+}
+
+// Called after a transfer's results are in the ring, so the transfer can be
+// used again.
+static void async_in_queue_recycle(async_in_queue * queue, async_in_transfer * transfer)
+{
+    if (__atomic_load_n(&queue->resubmit, __ATOMIC_SEQ_CST) &&
+        async_in_queue_submit(queue, transfer))
+    {
+        // If the pipe was cancelled while we were submitting, the cancel
+        // might have missed this transfer, so cancel it here.
+        if (!__atomic_load_n(&queue->resubmit, __ATOMIC_SEQ_CST))
+        {
+            libusbp_error_free(async_in_transfer_cancel(transfer));
+        }
+        return;
+    }
+
+    __atomic_sub_fetch(&queue->active_count, 1, __ATOMIC_ACQ_REL);
+}
+
+// Moves parked transfers into the ring while there is room.  Must be called
+// with the mutex held.
+static void async_in_queue_unpark_locked(async_in_queue * queue)
+{
+    while (queue->parked_count)
+    {
+        async_in_transfer * transfer = queue->parked_array[queue->parked_first];
+        if (!async_in_queue_push(queue, transfer)) { break; }
+
+        queue->parked_first = increment_and_wrap_size(
+            queue->parked_first, queue->transfer_count);
+        __atomic_store_n(&queue->parked_count, queue->parked_count - 1, __ATOMIC_RELEASE);
+
+        async_in_queue_recycle(queue, transfer);
+    }
+}
+
+void async_in_queue_handle_completion(async_in_queue * queue, async_in_transfer * transfer)
+{
+    assert(queue != NULL);
+    assert(transfer != NULL);
+
+    // The fast path: nothing is parked and the ring has room.
+    if (__atomic_load_n(&queue->parked_count, __ATOMIC_ACQUIRE) == 0 &&
+        async_in_queue_push(queue, transfer))
+    {
+        async_in_queue_recycle(queue, transfer);
+        return;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+
+    // Transfers must go into the ring in the order they completed, so this
+    // one can only go in if nothing is parked ahead of it.
+    async_in_queue_unpark_locked(queue);
+    if (queue->parked_count == 0 && async_in_queue_push(queue, transfer))
+    {
+        pthread_mutex_unlock(&queue->mutex);
+        async_in_queue_recycle(queue, transfer);
+        return;
+    }
+
+    size_t index = (queue->parked_first + queue->parked_count) % queue->transfer_count;
+    queue->parked_array[index] = transfer;
+    __atomic_store_n(&queue->parked_count, queue->parked_count + 1, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+libusbp_error * async_in_queue_start(async_in_queue * queue)
+{
+    assert(queue != NULL);
+
+    if (__atomic_load_n(&queue->active_count, __ATOMIC_ACQUIRE))
+    {
+        return error_create("Cannot start transfers while the completion "
+            "queue still has pending transfers.");
+    }
+
+    __atomic_store_n(&queue->resubmit, true, __ATOMIC_SEQ_CST);
+
+    for (size_t i = 0; i < queue->transfer_count; i++)
+    {
+        __atomic_add_fetch(&queue->active_count, 1, __ATOMIC_ACQ_REL);
+        if (!async_in_queue_submit(queue, queue->transfer_array[i]))
+        {
+            __atomic_sub_fetch(&queue->active_count, 1, __ATOMIC_ACQ_REL);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+bool async_in_queue_pop(async_in_queue * queue,
+    const libusbp_iovec * iov, size_t iov_count, size_t * transferred,
+    libusbp_transfer_times * times, libusbp_error ** transfer_error)
+{
+    assert(queue != NULL);
+
+    // If the ring was full, the producer might have parked some transfers
+    // that can go into the ring now.
+    if (__atomic_load_n(&queue->parked_count, __ATOMIC_ACQUIRE))
+    {
+        pthread_mutex_lock(&queue->mutex);
+        async_in_queue_unpark_locked(queue);
+        pthread_mutex_unlock(&queue->mutex);
+    }
+
+    size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (tail == head)
+    {
+        if (__atomic_load_n(&queue->parked_count, __ATOMIC_ACQUIRE))
+        {
+            return false;
+        }
+
+        // All of the data is handled, so report a submission error if there
+        // was one.
+        libusbp_error * error = __atomic_exchange_n(&queue->submit_error,
+            NULL, __ATOMIC_ACQ_REL);
+        if (error == NULL)
+        {
+            return false;
+        }
+
+        if (transferred != NULL)
+        {
+            *transferred = 0;
+        }
+
+        if (transfer_error != NULL)
+        {
+            *transfer_error = error;
+        }
+        else
+        {
+            libusbp_error_free(error);
+        }
+        return true;
+    }
+
+    size_t index = tail % queue->capacity;
+
+    iovec_scatter(iov, iov_count, queue->data + index * queue->transfer_size,
+        queue->transferred_array[index]);
+
+    if (transferred != NULL)
+    {
+        *transferred = queue->transferred_array[index];
+    }
+
+    if (times != NULL)
+    {
+        *times = queue->times_array[index];
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = queue->error_array[index];
+    }
+    else
+    {
+        libusbp_error_free(queue->error_array[index]);
+    }
+    queue->error_array[index] = NULL;
+
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool async_in_queue_has_pending(async_in_queue * queue)
+{
+    assert(queue != NULL);
+
+    size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    return head != tail ||
+        __atomic_load_n(&queue->active_count, __ATOMIC_ACQUIRE) != 0 ||
+        __atomic_load_n(&queue->submit_error, __ATOMIC_ACQUIRE) != NULL;
+}
+
+bool async_in_queue_can_pop(async_in_queue * queue)
+{
+    assert(queue != NULL);
+
+    size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    return head != tail ||
+        __atomic_load_n(&queue->parked_count, __ATOMIC_ACQUIRE) != 0 ||
+        __atomic_load_n(&queue->submit_error, __ATOMIC_ACQUIRE) != NULL;
+}
+
+libusbp_error * async_in_queue_cancel(async_in_queue * queue)
+{
+    assert(queue != NULL);
+
+    __atomic_store_n(&queue->resubmit, false, __ATOMIC_SEQ_CST);
+
+    // Transfers are resubmitted in the order they complete, so the pending
+    // ones form a contiguous run (wrapping around the end of the array).  The
+    // newest one is the pending transfer that comes before a transfer that is
+    // not pending.  This can change while we look, but we only use it to pick
+    // a good order for cancelling.
+    size_t count = queue->transfer_count;
+    size_t newest = count - 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (async_in_transfer_pending(queue->transfer_array[i]) &&
+            !async_in_transfer_pending(queue->transfer_array[(i + 1) % count]))
+        {
+            newest = i;
+            break;
+        }
+    }
+
+    return async_in_transfer_cancel_pending(queue->transfer_array, count, newest);
+}
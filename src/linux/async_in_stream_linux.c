@@ -0,0 +1,504 @@
+/* A stream lets an asynchronous IN pipe deliver its data as one continuous
+ * sequence of bytes instead of one transfer at a time.  The data goes into a
+ * ring buffer that is mapped twice, back to back, so any part of the ring
+ * that is waiting to be read can be returned as a single contiguous span,
+ * even if it wraps around the end.
+ *
+ * Each transfer's URB points directly into the ring, at the place where its
+ * data would go if every transfer before it were full, so the kernel copies
+ * the data straight into the ring.  When a transfer comes back short, the
+ * transfers after it have to move their data backwards to close the gap,
+ * until no transfers are in flight and the next one can be put right after
+ * the data.
+ *
+ * Transfers are resubmitted by whichever thread reaps them, like with a
+ * completion queue (see async_in_queue_linux.c).  The thread that owns the
+ * pipe reads from the ring and advances the tail.  Everything except the tail
+ * is protected by a mutex; the head is also read without it. */
+
+#include <libusbp_internal.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 1
+#endif
+
+typedef struct stream_slot
+{
+    async_in_transfer * transfer;
+    size_t position;
+    bool done;
+} stream_slot;
+
+struct async_in_stream
+{
+    // Written by the producer, read by the consumer.
+    size_t head __attribute__((aligned(LIBUSBP_CACHE_LINE_SIZE)));
+
+    // Written by the consumer, read by the producer.
+    size_t tail __attribute__((aligned(LIBUSBP_CACHE_LINE_SIZE)));
+
+    // The number of transfers that are submitted.  Changed with the mutex
+    // held, but read without it.
+    size_t active_count __attribute__((aligned(LIBUSBP_CACHE_LINE_SIZE)));
+
+    // The number of transfers that are waiting for room in the ring.  Changed
+    // with the mutex held, but read without it.
+    size_t idle_count;
+
+    // Everything below is only changed when the stream is created, or with
+    // the mutex held.
+    pthread_mutex_t mutex __attribute__((aligned(LIBUSBP_CACHE_LINE_SIZE)));
+
+    bool resubmit;
+
+    // The submitted transfers in the order they were submitted, with the
+    // place in the ring where each one's URB points.
+    stream_slot * slot_array;
+    size_t slot_first;
+
+    async_in_transfer ** idle_array;
+
+    size_t transfer_count;
+    size_t transfer_size;
+
+    // Where the next transfer will be put, as a position in the stream like
+    // head and tail.
+    size_t submit_position;
+
+    // The first error from a transfer, which the consumer gets when it reaches
+    // error_position in the stream.
+    libusbp_error * error;
+    size_t error_position;
+
+    // An error from submitting a transfer, which the consumer gets after all
+    // of the data.
+    libusbp_error * submit_error;
+
+    uint8_t * ring;
+    size_t capacity;
+};
+
+// Maps a memory file twice in a row so the ring can be read past its end.
+static libusbp_error * async_in_stream_map_ring(size_t capacity, uint8_t ** ring)
+{
+    int fd = syscall(SYS_memfd_create, "libusbp_stream", MFD_CLOEXEC);
+    if (fd == -1)
+    {
+        return error_create_errno("Failed to create a memory file for the stream.");
+    }
+
+    libusbp_error * error = NULL;
+
+    if (error == NULL && ftruncate(fd, capacity) == -1)
+    {
+        error = error_create_errno("Failed to set the size of the stream's memory file.");
+    }
+
+    uint8_t * area = MAP_FAILED;
+    if (error == NULL)
+    {
+        area = mmap(NULL, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (area == MAP_FAILED)
+        {
+            error = error_create_errno("Failed to reserve memory for the stream.");
+        }
+    }
+
+    for (size_t i = 0; error == NULL && i < 2; i++)
+    {
+        void * r = mmap(area + i * capacity, capacity, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, fd, 0);
+        if (r == MAP_FAILED)
+        {
+            error = error_create_errno("Failed to map the stream's memory file.");
+        }
+    }
+
+    close(fd);
+
+    if (error == NULL)
+    {
+        *ring = area;
+    }
+    else if (area != MAP_FAILED)
+    {
+        munmap(area, 2 * capacity);
+    }
+    return error;
+}
+
+libusbp_error * async_in_stream_create(async_in_transfer ** transfer_array,
+    size_t transfer_count, size_t transfer_size, size_t buffer_size,
+    async_in_stream ** stream)
+{
+    assert(transfer_array != NULL);
+    assert(stream != NULL);
+
+    *stream = NULL;
+
+    // The ring has to be a whole number of pages so it can be mapped twice.
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    if (buffer_size > SIZE_MAX / 2 - page_size)
+    {
+        return error_create("Stream buffer size is too large.");
+    }
+    size_t capacity = (buffer_size + page_size - 1) / page_size * page_size;
+
+    if (transfer_count > capacity / transfer_size)
+    {
+        return error_create("Stream buffer size must be at least the transfer "
+            "count times the transfer size.");
+    }
+
+    libusbp_error * error = NULL;
+
+    async_in_stream * new_stream = NULL;
+    if (error == NULL)
+    {
+        void * memory = NULL;
+        if (posix_memalign(&memory, LIBUSBP_CACHE_LINE_SIZE, sizeof(async_in_stream)))
+        {
+            error = &error_no_memory;
+        }
+        else
+        {
+            new_stream = memory;
+            memset(new_stream, 0, sizeof(async_in_stream));
+        }
+    }
+
+    bool mutex_initialized = false;
+    if (error == NULL)
+    {
+        if (pthread_mutex_init(&new_stream->mutex, NULL))
+        {
+            error = error_create("Failed to initialize mutex.");
+        }
+        else
+        {
+            mutex_initialized = true;
+        }
+    }
+
+    if (error == NULL)
+    {
+        new_stream->slot_array = calloc(transfer_count, sizeof(stream_slot));
+        new_stream->idle_array = calloc(transfer_count, sizeof(async_in_transfer *));
+        if (new_stream->slot_array == NULL || new_stream->idle_array == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    if (error == NULL)
+    {
+        error = async_in_stream_map_ring(capacity, &new_stream->ring);
+    }
+
+    if (error == NULL)
+    {
+        new_stream->capacity = capacity;
+        new_stream->transfer_count = transfer_count;
+        new_stream->transfer_size = transfer_size;
+
+        for (size_t i = 0; i < transfer_count; i++)
+        {
+            async_in_transfer_set_stream(transfer_array[i], new_stream);
+            new_stream->idle_array[i] = transfer_array[i];
+        }
+        new_stream->idle_count = transfer_count;
+
+        *stream = new_stream;
+        new_stream = NULL;
+    }
+
+    if (new_stream != NULL)
+    {
+        if (mutex_initialized) { pthread_mutex_destroy(&new_stream->mutex); }
+        free(new_stream->slot_array);
+        free(new_stream->idle_array);
+        free(new_stream);
+    }
+    return error;
+}
+
+bool async_in_stream_free(async_in_stream * stream)
+{
+    if (stream == NULL) { return true; }
+
+    if (__atomic_load_n(&stream->active_count, __ATOMIC_ACQUIRE))
+    {
+        // Some transfers are still pending and could complete at any time,
+        // which would write to the ring.  Like async_in_transfer_free, we leak
+        // the memory instead of freeing it.
+        return false;
+    }
+
+    libusbp_error_free(stream->error);
+    libusbp_error_free(stream->submit_error);
+    pthread_mutex_destroy(&stream->mutex);
+    munmap(stream->ring, 2 * stream->capacity);
+    free(stream->slot_array);
+    free(stream->idle_array);
+    free(stream);
+    return true;
+}
+
+// Submits idle transfers while there is room for them in the ring.  Must be
+// called with the mutex held.
+static void async_in_stream_submit_locked(async_in_stream * stream)
+{
+    if (stream->active_count == 0)
+    {
+        // Nothing is in flight, so the next transfer can go right after the
+        // data and close any gap left by short transfers.
+        stream->submit_position = stream->head;
+    }
+
+    while (stream->resubmit && stream->idle_count)
+    {
+        size_t tail = __atomic_load_n(&stream->tail, __ATOMIC_ACQUIRE);
+        if (stream->submit_position + stream->transfer_size - tail > stream->capacity)
+        {
+            break;
+        }
+
+        async_in_transfer * transfer = stream->idle_array[stream->idle_count - 1];
+        async_in_transfer_set_buffer(transfer,
+            stream->ring + stream->submit_position % stream->capacity);
+
+        size_t index = (stream->slot_first + stream->active_count) % stream->transfer_count;
+        stream->slot_array[index].transfer = transfer;
+        stream->slot_array[index].position = stream->submit_position;
+        stream->slot_array[index].done = false;
+
+        libusbp_error * error = async_in_transfer_submit_checked(transfer);
+        if (error != NULL)
+        {
+            // Stop submitting transfers and save the error so the consumer
+            // gets it after all the data before it.
+            stream->resubmit = false;
+            libusbp_error * old_error = __atomic_exchange_n(&stream->submit_error,
+                error, __ATOMIC_ACQ_REL);
+            libusbp_error_free(old_error);
+            break;
+        }
+
+        __atomic_store_n(&stream->idle_count, stream->idle_count - 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&stream->active_count, stream->active_count + 1, __ATOMIC_RELEASE);
+        stream->submit_position += stream->transfer_size;
+    }
+}
+
+// Moves the data of finished transfers into place, in the order they were
+// submitted.  Must be called with the mutex held.
+static void async_in_stream_collect_locked(async_in_stream * stream)
+{
+    while (stream->active_count && stream->slot_array[stream->slot_first].done)
+    {
+        stream_slot * slot = &stream->slot_array[stream->slot_first];
+
+        const uint8_t * data;
+        size_t transferred;
+        libusbp_error * transfer_error = NULL;
+        libusbp_error * error = async_in_transfer_peek_results(slot->transfer,
+            &data, &transferred, &transfer_error);
+        assert(error == NULL);
+        LIBUSBP_UNUSED(error);
+
+        size_t head = stream->head;
+        if (slot->position != head)
+        {
+            // An earlier transfer was short, so this data has to move back.
+            // The URB might point into the other copy of the ring than the
+            // one we write to, so we find the source relative to the
+            // destination.  That way both are in the same mapping, and
+            // memmove can tell how they overlap.
+            uint8_t * dest = stream->ring + head % stream->capacity;
+            const uint8_t * src = dest + (slot->position - head);
+            memmove(dest, src, transferred);
+        }
+        __atomic_store_n(&stream->head, head + transferred, __ATOMIC_RELEASE);
+
+        if (transfer_error != NULL)
+        {
+            if (stream->error == NULL)
+            {
+                stream->error_position = head + transferred;
+                __atomic_store_n(&stream->error, transfer_error, __ATOMIC_RELEASE);
+                stream->resubmit = false;
+            }
+            else
+            {
+                libusbp_error_free(transfer_error);
+            }
+        }
+
+        stream->idle_array[stream->idle_count] = slot->transfer;
+        __atomic_store_n(&stream->idle_count, stream->idle_count + 1, __ATOMIC_RELEASE);
+        stream->slot_first = increment_and_wrap_size(stream->slot_first, stream->transfer_count);
+        __atomic_store_n(&stream->active_count, stream->active_count - 1, __ATOMIC_RELEASE);
+    }
+}
+
+void async_in_stream_handle_completion(async_in_stream * stream, async_in_transfer * transfer)
+{
+    assert(stream != NULL);
+    assert(transfer != NULL);
+
+    pthread_mutex_lock(&stream->mutex);
+
+    // Cancelled transfers can complete out of order, so find this one.
+    for (size_t i = 0; i < stream->active_count; i++)
+    {
+        stream_slot * slot = &stream->slot_array[(stream->slot_first + i) % stream->transfer_count];
+        if (slot->transfer == transfer)
+        {
+            slot->done = true;
+            break;
+        }
+    }
+
+    async_in_stream_collect_locked(stream);
+    async_in_stream_submit_locked(stream);
+
+    pthread_mutex_unlock(&stream->mutex);
+}
+
+libusbp_error * async_in_stream_start(async_in_stream * stream)
+{
+    assert(stream != NULL);
+
+    pthread_mutex_lock(&stream->mutex);
+
+    libusbp_error * error = NULL;
+    if (stream->active_count)
+    {
+        error = error_create("Cannot start transfers while the stream still "
+            "has pending transfers.");
+    }
+    else
+    {
+        stream->resubmit = true;
+        async_in_stream_submit_locked(stream);
+    }
+
+    pthread_mutex_unlock(&stream->mutex);
+    return error;
+}
+
+void async_in_stream_peek(async_in_stream * stream, const uint8_t ** data,
+    size_t * size, libusbp_error ** transfer_error)
+{
+    assert(stream != NULL);
+
+    size_t tail = __atomic_load_n(&stream->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE);
+
+    // Stop at a transfer error until the data before it has been consumed.
+    libusbp_error * error = __atomic_load_n(&stream->error, __ATOMIC_ACQUIRE);
+    if (error != NULL && stream->error_position < head)
+    {
+        head = stream->error_position;
+    }
+
+    *data = stream->ring + tail % stream->capacity;
+    *size = head - tail;
+
+    if (head != tail) { return; }
+
+    // There is no data, so report an error if there is one.
+    pthread_mutex_lock(&stream->mutex);
+    libusbp_error * tmp_error = NULL;
+    if (stream->error != NULL && stream->error_position == tail)
+    {
+        tmp_error = stream->error;
+        __atomic_store_n(&stream->error, NULL, __ATOMIC_RELEASE);
+    }
+    else if (stream->submit_error != NULL && stream->head == tail &&
+        stream->active_count == 0)
+    {
+        tmp_error = stream->submit_error;
+        __atomic_store_n(&stream->submit_error, NULL, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&stream->mutex);
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = tmp_error;
+    }
+    else
+    {
+        libusbp_error_free(tmp_error);
+    }
+}
+
+libusbp_error * async_in_stream_consume(async_in_stream * stream, size_t size)
+{
+    assert(stream != NULL);
+
+    size_t tail = __atomic_load_n(&stream->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE);
+    if (size > head - tail)
+    {
+        return error_create("Cannot consume more data than is available.");
+    }
+
+    __atomic_store_n(&stream->tail, tail + size, __ATOMIC_RELEASE);
+
+    // There might be room for transfers that were waiting now.
+    if (size && __atomic_load_n(&stream->idle_count, __ATOMIC_ACQUIRE))
+    {
+        pthread_mutex_lock(&stream->mutex);
+        async_in_stream_submit_locked(stream);
+        pthread_mutex_unlock(&stream->mutex);
+    }
+    return NULL;
+}
+
+bool async_in_stream_has_pending(async_in_stream * stream)
+{
+    assert(stream != NULL);
+
+    size_t tail = __atomic_load_n(&stream->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE);
+    return head != tail ||
+        __atomic_load_n(&stream->active_count, __ATOMIC_ACQUIRE) != 0 ||
+        __atomic_load_n(&stream->error, __ATOMIC_ACQUIRE) != NULL ||
+        __atomic_load_n(&stream->submit_error, __ATOMIC_ACQUIRE) != NULL;
+}
+
+bool async_in_stream_can_peek(async_in_stream * stream)
+{
+    assert(stream != NULL);
+
+    size_t tail = __atomic_load_n(&stream->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE);
+    return head != tail ||
+        __atomic_load_n(&stream->error, __ATOMIC_ACQUIRE) != NULL ||
+        (__atomic_load_n(&stream->submit_error, __ATOMIC_ACQUIRE) != NULL &&
+        __atomic_load_n(&stream->active_count, __ATOMIC_ACQUIRE) == 0);
+}
+
+libusbp_error * async_in_stream_cancel(async_in_stream * stream)
+{
+    assert(stream != NULL);
+
+    pthread_mutex_lock(&stream->mutex);
+
+    stream->resubmit = false;
+
+    // Cancel the newest transfers first.  See async_in_transfer_cancel_pending.
+    libusbp_error * error = NULL;
+    for (size_t i = stream->active_count; error == NULL && i > 0; i--)
+    {
+        stream_slot * slot = &stream->slot_array[(stream->slot_first + i - 1) % stream->transfer_count];
+        if (!slot->done && async_in_transfer_pending(slot->transfer))
+        {
+            error = async_in_transfer_cancel(slot->transfer);
+        }
+    }
+
+    pthread_mutex_unlock(&stream->mutex);
+    return error;
+}
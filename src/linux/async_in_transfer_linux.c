@@ -3,15 +3,44 @@
 struct async_in_transfer
 {
     struct usbdevfs_urb urb;
+
+    // This is accessed with atomic operations because the transfer might be
+    // completed by a reaper thread.
     bool pending;
+
     libusbp_error * error;
     int fd;
+
+    // The completion queue that receives the transfer's results, or NULL.
+    async_in_queue * queue;
+
+    // The stream that receives the transfer's results, or NULL.  If this is
+    // set, the URB points into the stream's ring instead of into buffer.
+    async_in_stream * stream;
+
+    // The dispatcher that passes the transfer's results to a callback, or NULL.
+    async_in_dispatch * dispatch;
+
+    // The clock used for the timestamps below, in nanoseconds.  The clock is
+    // accessed with atomic operations because it can be changed while a
+    // reaper thread is completing the transfer.
+    clockid_t clock;
+    uint64_t submit_time;
+    uint64_t complete_time;
+
+    // The buffer allocated for the transfer, its size, and whether it was
+    // allocated with mmap.  See usbfd_alloc_buffer.
+    void * buffer;
+    size_t buffer_allocated_size;
+    bool buffer_mapped;
 };
 
 libusbp_error * async_in_pipe_setup(libusbp_generic_handle * handle, uint8_t pipe_id)
 {
-    LIBUSBP_UNUSED(handle);
-    LIBUSBP_UNUSED(pipe_id);
+    if (generic_handle_get_endpoint_type(handle, pipe_id) == USB_ENDPOINT_XFER_ISOC)
+    {
+        return error_create("Asynchronous pipes for isochronous endpoints are not supported.");
+    }
     return NULL;
 }
 
@@ -42,34 +71,45 @@ libusbp_error * async_in_transfer_create(
     }
 
     // Allocate the buffer for the transfer.
+    int fd = libusbp_generic_handle_get_fd(handle);
     void * new_buffer = NULL;
+    bool new_buffer_mapped = false;
     if (error == NULL)
     {
-        new_buffer = malloc(transfer_size);
-        if (new_buffer == NULL)
-        {
-            error = &error_no_memory;
-        }
+        error = usbfd_alloc_buffer(fd,
+            generic_handle_get_buffer_capabilities(handle),
+            transfer_size, &new_buffer, &new_buffer_mapped);
     }
 
     // Assemble the transfer and pass it to the caller.
     if (error == NULL)
     {
-        new_transfer->fd = libusbp_generic_handle_get_fd(handle);
+        new_transfer->fd = fd;
+        new_transfer->clock = CLOCK_MONOTONIC;
 
         new_transfer->urb.usercontext = new_transfer;
         new_transfer->urb.buffer_length = transfer_size;
-        new_transfer->urb.type = USBDEVFS_URB_TYPE_BULK;
+        new_transfer->urb.type = generic_handle_get_urb_type(handle, pipe_id);
         new_transfer->urb.endpoint = pipe_id;
 
+        // BULK_CONTINUATION is left out because every transfer would be
+        // refused after the first short packet; see
+        // libusbp_generic_handle_set_pipe_flags.
+        new_transfer->urb.flags = transfer_flags_to_urb_flags(
+            generic_handle_get_pipe_flags(handle, pipe_id) &
+            ~(uint32_t)LIBUSBP_TRANSFER_BULK_CONTINUATION);
+
         new_transfer->urb.buffer = new_buffer;
+        new_transfer->buffer = new_buffer;
+        new_transfer->buffer_allocated_size = transfer_size;
+        new_transfer->buffer_mapped = new_buffer_mapped;
         new_buffer = NULL;
 
         *transfer = new_transfer;
         new_transfer = NULL;
     }
 
-    free(new_buffer);
+    usbfd_free_buffer(new_buffer, transfer_size, new_buffer_mapped);
     free(new_transfer);
     return error;
 }
@@ -78,7 +118,7 @@ void async_in_transfer_free(async_in_transfer * transfer)
 {
     if (transfer == NULL) { return; }
 
-    if (transfer->pending)
+    if (async_in_transfer_pending(transfer))
     {
         // Unfortunately, this transfer is still pending, so we cannot free it;
         // the kernel needs to be able to write to this transfer's memory when
@@ -89,31 +129,87 @@ void async_in_transfer_free(async_in_transfer * transfer)
     }
 
     libusbp_error_free(transfer->error);
-    free(transfer->urb.buffer);
+    usbfd_free_buffer(transfer->buffer,
+        transfer->buffer_allocated_size, transfer->buffer_mapped);
     free(transfer);
 }
 
-void async_in_transfer_submit(async_in_transfer * transfer)
+// Submits the transfer and returns an error if that failed.  Unlike
+// async_in_transfer_submit, this does not save the error in the transfer, so
+// it is safe to use when another thread might complete the transfer as soon
+// as it is submitted.
+libusbp_error * async_in_transfer_submit_checked(async_in_transfer * transfer)
 {
     assert(transfer != NULL);
-    assert(transfer->pending == false);
+    assert(!async_in_transfer_pending(transfer));
 
     libusbp_error_free(transfer->error);
     transfer->error = NULL;
-    transfer->pending = true;
+    transfer->submit_time = get_time_ns(
+        __atomic_load_n(&transfer->clock, __ATOMIC_RELAXED));
+    transfer->complete_time = 0;
+    __atomic_store_n(&transfer->pending, true, __ATOMIC_RELEASE);
 
     libusbp_error * error = usbfd_submit_urb(transfer->fd, &transfer->urb);
     if (error != NULL)
     {
-        transfer->pending = false;
+        __atomic_store_n(&transfer->pending, false, __ATOMIC_RELEASE);
+    }
+    return error;
+}
+
+void async_in_transfer_submit(async_in_transfer * transfer)
+{
+    libusbp_error * error = async_in_transfer_submit_checked(transfer);
+    if (error != NULL)
+    {
         transfer->error = error;
     }
 }
 
+void async_in_transfer_set_queue(async_in_transfer * transfer, async_in_queue * queue)
+{
+    assert(transfer != NULL);
+    transfer->queue = queue;
+}
+
+void async_in_transfer_set_stream(async_in_transfer * transfer, async_in_stream * stream)
+{
+    assert(transfer != NULL);
+    transfer->stream = stream;
+}
+
+void async_in_transfer_set_dispatch(async_in_transfer * transfer,
+    async_in_dispatch * dispatch)
+{
+    assert(transfer != NULL);
+    transfer->dispatch = dispatch;
+}
+
+void async_in_transfer_set_buffer(async_in_transfer * transfer, uint8_t * buffer)
+{
+    assert(transfer != NULL);
+    assert(!async_in_transfer_pending(transfer));
+    transfer->urb.buffer = buffer;
+}
+
+void async_in_transfer_set_clock(async_in_transfer * transfer, uint32_t clock)
+{
+    assert(transfer != NULL);
+    clockid_t clock_id = clock == LIBUSBP_CLOCK_MONOTONIC_RAW ?
+        CLOCK_MONOTONIC_RAW : CLOCK_MONOTONIC;
+    __atomic_store_n(&transfer->clock, clock_id, __ATOMIC_RELAXED);
+}
+
 void async_in_transfer_handle_completion(async_in_transfer * transfer)
 {
     assert(transfer != NULL);
 
+    // Record the time first so it is as close as possible to when the kernel
+    // handed us the URB.
+    transfer->complete_time = get_time_ns(
+        __atomic_load_n(&transfer->clock, __ATOMIC_RELAXED));
+
     #ifdef LIBUSBP_LOG
     fprintf(stderr, "URB completed: %p, status=%d, actual_length=%d\n",
         transfer, transfer->urb.status, transfer->urb.actual_length);
@@ -137,15 +233,28 @@ void async_in_transfer_handle_completion(async_in_transfer * transfer)
         error = error_add(error, "Asynchronous IN transfer failed.");
     }
 
-    transfer->pending = false;
     transfer->error = error;
+    __atomic_store_n(&transfer->pending, false, __ATOMIC_RELEASE);
+
+    if (transfer->queue != NULL)
+    {
+        async_in_queue_handle_completion(transfer->queue, transfer);
+    }
+    else if (transfer->stream != NULL)
+    {
+        async_in_stream_handle_completion(transfer->stream, transfer);
+    }
+    else if (transfer->dispatch != NULL)
+    {
+        async_in_dispatch_handle_completion(transfer->dispatch, transfer);
+    }
 }
 
 libusbp_error * async_in_transfer_get_results(async_in_transfer * transfer,
     void * buffer, size_t * transferred, libusbp_error ** transfer_error)
 {
     assert(transfer != NULL);
-    assert(!transfer->pending);
+    assert(!async_in_transfer_pending(transfer));
 
     size_t tmp_transferred = transfer->urb.actual_length;
 
@@ -173,6 +282,49 @@ libusbp_error * async_in_transfer_get_results(async_in_transfer * transfer,
     return NULL;
 }
 
+libusbp_error * async_in_transfer_peek_results(async_in_transfer * transfer,
+    const uint8_t ** buffer, size_t * transferred, libusbp_error ** transfer_error)
+{
+    assert(transfer != NULL);
+    assert(!async_in_transfer_pending(transfer));
+
+    size_t tmp_transferred = transfer->urb.actual_length;
+
+    // Make sure we don't report more data than the buffer holds.
+    if (tmp_transferred > (size_t)transfer->urb.buffer_length)
+    {
+        tmp_transferred = transfer->urb.buffer_length;
+    }
+
+    if (buffer != NULL)
+    {
+        *buffer = transfer->urb.buffer;
+    }
+
+    if (transferred != NULL)
+    {
+        *transferred = tmp_transferred;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = libusbp_error_copy(transfer->error);
+    }
+
+    return NULL;
+}
+
+void async_in_transfer_get_times(async_in_transfer * transfer,
+    libusbp_transfer_times * times)
+{
+    assert(transfer != NULL);
+    assert(times != NULL);
+    assert(!async_in_transfer_pending(transfer));
+
+    times->submit_time_ns = transfer->submit_time;
+    times->complete_time_ns = transfer->complete_time;
+}
+
 libusbp_error * async_in_transfer_cancel(async_in_transfer * transfer)
 {
     if (transfer == NULL) { return NULL; }
@@ -180,8 +332,32 @@ libusbp_error * async_in_transfer_cancel(async_in_transfer * transfer)
     return usbfd_discard_urb(transfer->fd, &transfer->urb);
 }
 
+// Each USBDEVFS_DISCARDURB ioctl searches the list of URBs that the kernel
+// has for the file, so calling it for transfers that were already reaped just
+// wastes time.  Transfers on an endpoint are executed in the order they were
+// submitted, so we cancel the newest ones first: otherwise, the host controller
+// would start working on each transfer as soon as the one before it was
+// cancelled, and might even complete it before we got to it.
+libusbp_error * async_in_transfer_cancel_pending(async_in_transfer ** array,
+    size_t count, size_t newest)
+{
+    assert(array != NULL);
+    assert(newest < count);
+
+    libusbp_error * error = NULL;
+    for (size_t i = 0; error == NULL && i < count; i++)
+    {
+        async_in_transfer * transfer = array[(newest + count - i) % count];
+        if (async_in_transfer_pending(transfer))
+        {
+            error = async_in_transfer_cancel(transfer);
+        }
+    }
+    return error;
+}
+
 bool async_in_transfer_pending(async_in_transfer * transfer)
 {
     assert(transfer != NULL);
-    return transfer->pending;
+    return __atomic_load_n(&transfer->pending, __ATOMIC_ACQUIRE);
 }
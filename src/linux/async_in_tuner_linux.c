@@ -0,0 +1,228 @@
+/* An auto-tuner watches the transfers that finish on an asynchronous IN pipe
+ * and picks a new transfer count and size for the pipe when the current ones
+ * do not suit the data coming from the device.
+ *
+ * The tuner looks at the transfers in windows of at least MIN_WINDOW_NS and
+ * at least two full turns of the transfer ring.  At the end of each window:
+ *
+ * - If there was an underrun, meaning that a transfer was submitted after the
+ *   one before it completed, the kernel had no transfers queued for a while
+ *   and the device might have been ignored, so the transfer count is doubled.
+ * - If most of the transfers were filled completely, the device has more data
+ *   than we are asking for, so the transfer size is doubled to reduce the
+ *   number of completions.  With a target latency, this only happens if a
+ *   transfer of the new size would still fill up quickly enough.
+ * - If the transfers are mostly short, or take longer than the target latency
+ *   to fill, the transfer size is halved.
+ *
+ * Sizes are always the original transfer size times a power of two, so if the
+ * original size was a multiple of the maximum packet size, every size is.
+ * Nothing grows past the limits in libusbp_async_in_tuning. */
+
+#include <libusbp_internal.h>
+
+#define MIN_WINDOW_NS 50000000
+
+struct async_in_tuner
+{
+    libusbp_async_in_tuning settings;
+
+    size_t transfer_count;
+    size_t transfer_size;
+
+    // The completion time of the previous transfer, or 0 if there was none
+    // since the transfers were last resized.
+    uint64_t last_complete_time;
+
+    // Statistics for the current window.
+    uint64_t window_start;
+    size_t completion_count;
+    size_t short_count;
+    size_t underrun_count;
+    uint64_t byte_count;
+};
+
+libusbp_error * async_in_tuner_create(const libusbp_async_in_tuning * settings,
+    size_t transfer_count, size_t transfer_size, async_in_tuner ** tuner)
+{
+    assert(tuner != NULL);
+
+    *tuner = NULL;
+
+    if (settings == NULL)
+    {
+        return error_create("Tuning settings pointer is null.");
+    }
+
+    if (settings->min_transfer_count == 0 || settings->min_transfer_size == 0)
+    {
+        return error_create("Minimum transfer count and size cannot be zero.");
+    }
+
+    if (settings->max_transfer_count < settings->min_transfer_count ||
+        settings->max_transfer_size < settings->min_transfer_size)
+    {
+        return error_create("Maximum transfer count and size cannot be less "
+            "than the minimums.");
+    }
+
+    if (transfer_count < settings->min_transfer_count ||
+        transfer_count > settings->max_transfer_count ||
+        transfer_size < settings->min_transfer_size ||
+        transfer_size > settings->max_transfer_size)
+    {
+        return error_create("The current transfer count and size are not "
+            "within the tuning limits.");
+    }
+
+    if (settings->max_memory != 0 && transfer_count > settings->max_memory / transfer_size)
+    {
+        return error_create("The current transfers use more memory than the "
+            "tuning limit.");
+    }
+
+    async_in_tuner * new_tuner = calloc(1, sizeof(async_in_tuner));
+    if (new_tuner == NULL)
+    {
+        return &error_no_memory;
+    }
+
+    new_tuner->settings = *settings;
+    new_tuner->transfer_count = transfer_count;
+    new_tuner->transfer_size = transfer_size;
+    *tuner = new_tuner;
+    return NULL;
+}
+
+void async_in_tuner_free(async_in_tuner * tuner)
+{
+    free(tuner);
+}
+
+static void async_in_tuner_reset_window(async_in_tuner * tuner, uint64_t start)
+{
+    tuner->window_start = start;
+    tuner->completion_count = 0;
+    tuner->short_count = 0;
+    tuner->underrun_count = 0;
+    tuner->byte_count = 0;
+}
+
+static bool async_in_tuner_fits(const async_in_tuner * tuner, size_t count, size_t size)
+{
+    const libusbp_async_in_tuning * s = &tuner->settings;
+    if (count < s->min_transfer_count || count > s->max_transfer_count) { return false; }
+    if (size < s->min_transfer_size || size > s->max_transfer_size) { return false; }
+    if (s->max_memory != 0 && count > s->max_memory / size) { return false; }
+    return true;
+}
+
+// Looks at the statistics for the window that just ended and picks the
+// transfer count and size for the next one.
+static void async_in_tuner_decide(const async_in_tuner * tuner, uint64_t elapsed,
+    size_t * new_count, size_t * new_size)
+{
+    size_t count = tuner->transfer_count;
+    size_t size = tuner->transfer_size;
+    uint64_t target_ns = (uint64_t)tuner->settings.target_latency_ms * 1000000;
+
+    // Transfers are "full" if fewer than 1 in 8 of them were short.
+    bool full = tuner->short_count * 8 < tuner->completion_count;
+    bool mostly_short = tuner->short_count * 2 > tuner->completion_count;
+
+    // The time it would take the device to fill one transfer, at the rate it
+    // sent data during the window.
+    uint64_t fill_ns = UINT64_MAX;
+    if (tuner->byte_count != 0)
+    {
+        fill_ns = (uint64_t)((double)elapsed * size / tuner->byte_count);
+    }
+
+    bool grow_size = false;
+    bool shrink_size = false;
+    if (target_ns != 0)
+    {
+        shrink_size = fill_ns > target_ns;
+        grow_size = full && fill_ns < target_ns / 4;
+    }
+    else
+    {
+        grow_size = full;
+        shrink_size = mostly_short &&
+            tuner->byte_count < (uint64_t)tuner->completion_count * size / 4;
+    }
+
+    if (tuner->underrun_count != 0 && async_in_tuner_fits(tuner, count * 2, size))
+    {
+        count *= 2;
+    }
+
+    if (grow_size && size <= SIZE_MAX / 2 &&
+        async_in_tuner_fits(tuner, count, size * 2))
+    {
+        size *= 2;
+    }
+    else if (shrink_size && size % 2 == 0 &&
+        async_in_tuner_fits(tuner, count, size / 2))
+    {
+        size /= 2;
+    }
+
+    *new_count = count;
+    *new_size = size;
+}
+
+bool async_in_tuner_record(async_in_tuner * tuner, size_t transferred,
+    const libusbp_transfer_times * times, size_t * new_count, size_t * new_size)
+{
+    assert(tuner != NULL);
+    assert(times != NULL);
+    assert(new_count != NULL);
+    assert(new_size != NULL);
+
+    *new_count = tuner->transfer_count;
+    *new_size = tuner->transfer_size;
+
+    if (tuner->last_complete_time == 0)
+    {
+        // This is the first transfer since the tuner started or the transfers
+        // were resized, so it cannot be compared to anything.
+        tuner->last_complete_time = times->complete_time_ns;
+        async_in_tuner_reset_window(tuner, times->complete_time_ns);
+        return false;
+    }
+
+    tuner->completion_count++;
+    tuner->byte_count += transferred;
+    if (transferred < tuner->transfer_size)
+    {
+        tuner->short_count++;
+    }
+    if (times->submit_time_ns > tuner->last_complete_time)
+    {
+        tuner->underrun_count++;
+    }
+    tuner->last_complete_time = times->complete_time_ns;
+
+    uint64_t elapsed = times->complete_time_ns - tuner->window_start;
+    if (elapsed < MIN_WINDOW_NS ||
+        tuner->completion_count < 2 * tuner->transfer_count)
+    {
+        return false;
+    }
+
+    async_in_tuner_decide(tuner, elapsed, new_count, new_size);
+    async_in_tuner_reset_window(tuner, times->complete_time_ns);
+    return *new_count != tuner->transfer_count || *new_size != tuner->transfer_size;
+}
+
+void async_in_tuner_set_transfers(async_in_tuner * tuner,
+    size_t transfer_count, size_t transfer_size)
+{
+    assert(tuner != NULL);
+
+    tuner->transfer_count = transfer_count;
+    tuner->transfer_size = transfer_size;
+    tuner->last_complete_time = 0;
+    async_in_tuner_reset_window(tuner, 0);
+}
@@ -0,0 +1,398 @@
+#include <libusbp_internal.h>
+
+struct libusbp_async_out_pipe
+{
+    libusbp_generic_handle * handle;
+    uint8_t pipe_id;
+    async_out_transfer ** transfer_array;
+    size_t transfer_size;
+    size_t transfer_count;
+
+    // The number of transfers that have been submitted but not finished
+    // (handed back to the user of the pipe) yet.  This uses the same
+    // definition of pending as libusbp_async_in_pipe.
+    size_t pending_count;
+
+    // The index of the transfer that should finish next.  That transfer will be
+    // pending if pending_count > 0.
+    size_t next_finish;
+
+    // The index of the transfer that will be used for the next data submitted
+    // by the user.  That transfer is available if pending_count <
+    // transfer_count.
+    size_t next_submit;
+};
+
+static void async_out_transfer_array_free(async_out_transfer ** array, size_t transfer_count)
+{
+    if (array == NULL) { return; }
+
+    for (size_t i = 0; i < transfer_count; i++)
+    {
+        async_out_transfer_free(array[i]);
+    }
+    free(array);
+}
+
+void libusbp_async_out_pipe_close(libusbp_async_out_pipe * pipe)
+{
+    if (pipe != NULL)
+    {
+        async_out_transfer_array_free(pipe->transfer_array, pipe->transfer_count);
+        free(pipe);
+    }
+}
+
+libusbp_error * async_out_pipe_create(libusbp_generic_handle * handle,
+    uint8_t pipe_id, libusbp_async_out_pipe ** pipe)
+{
+    // Check the pipe output pointer.
+    if (pipe == NULL)
+    {
+        return error_create("Pipe output pointer is null.");
+    }
+
+    *pipe = NULL;
+
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    libusbp_error * error = NULL;
+
+    // Check the pipe_id parameter.
+    if (error == NULL)
+    {
+        error = check_pipe_id_out(pipe_id);
+    }
+    if (error == NULL && pipe_id == 0)
+    {
+        error = error_create("Asynchronous pipes for endpoint 0 are not supported.");
+    }
+    if (error == NULL &&
+        generic_handle_get_endpoint_type(handle, pipe_id) == USB_ENDPOINT_XFER_ISOC)
+    {
+        error = error_create("Asynchronous pipes for isochronous endpoints are not supported.");
+    }
+
+    libusbp_async_out_pipe * new_pipe = NULL;
+    if (error == NULL)
+    {
+        new_pipe = calloc(1, sizeof(libusbp_async_out_pipe));
+        if (new_pipe == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    if (error == NULL)
+    {
+        new_pipe->handle = handle;
+        new_pipe->pipe_id = pipe_id;
+        *pipe = new_pipe;
+        new_pipe = NULL;
+    }
+
+    free(new_pipe);
+    return error;
+}
+
+libusbp_generic_handle * async_out_pipe_get_handle(libusbp_async_out_pipe * pipe)
+{
+    assert(pipe != NULL);
+    return pipe->handle;
+}
+
+libusbp_error * libusbp_async_out_pipe_allocate_transfers(
+    libusbp_async_out_pipe * pipe,
+    size_t transfer_count,
+    size_t transfer_size)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (pipe->transfer_array != NULL)
+    {
+        return error_create("Transfers were already allocated for this pipe.");
+    }
+
+    if (transfer_count == 0)
+    {
+        return error_create("Transfer count cannot be zero.");
+    }
+
+    if (transfer_size == 0)
+    {
+        return error_create("Transfer size cannot be zero.");
+    }
+
+    libusbp_error * error = NULL;
+
+    async_out_transfer ** new_transfer_array = NULL;
+    if (error == NULL)
+    {
+        new_transfer_array = calloc(transfer_count, sizeof(async_out_transfer *));
+        if (new_transfer_array == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    for(size_t i = 0; error == NULL && i < transfer_count; i++)
+    {
+        error = async_out_transfer_create(pipe->handle, pipe->pipe_id,
+            transfer_size, &new_transfer_array[i]);
+    }
+
+    // Put the new array and the information about it into the pipe.
+    if (error == NULL)
+    {
+        pipe->transfer_array = new_transfer_array;
+        pipe->transfer_count = transfer_count;
+        pipe->transfer_size = transfer_size;
+        new_transfer_array = NULL;
+    }
+
+    async_out_transfer_array_free(new_transfer_array, transfer_count);
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to allocate transfers for asynchronous OUT pipe.");
+    }
+    return error;
+}
+
+static libusbp_error * async_out_pipe_submit(
+    libusbp_async_out_pipe * pipe,
+    const void * buffer,
+    size_t size,
+    uint32_t flags,
+    bool * submitted)
+{
+    if (pipe->transfer_array == NULL)
+    {
+        return error_create("Pipe transfers have not been allocated yet.");
+    }
+
+    if (size > pipe->transfer_size)
+    {
+        return error_create("Data size is larger than the transfer size.");
+    }
+
+    if (pipe->pending_count >= pipe->transfer_count)
+    {
+        // All of the transfers are in use, so the caller needs to handle some
+        // finished transfers before submitting more data.
+        return NULL;
+    }
+
+    libusbp_error * error = async_out_transfer_submit(
+        pipe->transfer_array[pipe->next_submit], buffer, size,
+        transfer_flags_to_urb_flags(flags));
+
+    if (error == NULL)
+    {
+        if (submitted != NULL)
+        {
+            *submitted = true;
+        }
+
+        pipe->pending_count++;
+        pipe->next_submit = increment_and_wrap_size(pipe->next_submit, pipe->transfer_count);
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to submit asynchronous OUT transfer.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_async_out_pipe_submit_transfer(
+    libusbp_async_out_pipe * pipe,
+    const void * buffer,
+    size_t size,
+    bool * submitted)
+{
+    if (submitted != NULL)
+    {
+        *submitted = false;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    return async_out_pipe_submit(pipe, buffer, size,
+        generic_handle_get_pipe_flags(pipe->handle, pipe->pipe_id), submitted);
+}
+
+libusbp_error * libusbp_async_out_pipe_submit_transfer_with_flags(
+    libusbp_async_out_pipe * pipe,
+    const void * buffer,
+    size_t size,
+    uint32_t flags,
+    bool * submitted)
+{
+    if (submitted != NULL)
+    {
+        *submitted = false;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    libusbp_error * error = generic_handle_check_transfer_flags(
+        pipe->handle, pipe->pipe_id, flags);
+    if (error != NULL)
+    {
+        return error_add(error, "Failed to submit asynchronous OUT transfer.");
+    }
+
+    return async_out_pipe_submit(pipe, buffer, size, flags, submitted);
+}
+
+libusbp_error * libusbp_async_out_pipe_handle_events(libusbp_async_out_pipe * pipe)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    return generic_handle_events(pipe->handle);
+}
+
+static bool async_out_pipe_can_finish_transfer(void * context)
+{
+    libusbp_async_out_pipe * pipe = context;
+    return pipe->pending_count == 0 ||
+        !async_out_transfer_pending(pipe->transfer_array[pipe->next_finish]);
+}
+
+libusbp_error * libusbp_async_out_pipe_wait(
+    libusbp_async_out_pipe * pipe,
+    uint32_t timeout)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    return generic_handle_wait_until(pipe->handle, timeout,
+        async_out_pipe_can_finish_transfer, pipe);
+}
+
+libusbp_error * libusbp_async_out_pipe_has_pending_transfers(
+    libusbp_async_out_pipe * pipe,
+    bool * result)
+{
+    libusbp_error * error = NULL;
+
+    if (error == NULL && result == NULL)
+    {
+        error = error_create("Boolean output pointer is null.");
+    }
+
+    if (error == NULL)
+    {
+        *result = false;
+    }
+
+    if (error == NULL && pipe == NULL)
+    {
+        error = error_create("Pipe argument is null.");
+    }
+
+    if (error == NULL)
+    {
+        *result = pipe->pending_count ? 1 : 0;
+    }
+
+    return error;
+}
+
+libusbp_error * libusbp_async_out_pipe_handle_finished_transfer(
+    libusbp_async_out_pipe * pipe,
+    bool * finished,
+    size_t * transferred,
+    libusbp_error ** transfer_error)
+{
+    if (finished != NULL)
+    {
+        *finished = false;
+    }
+
+    if (transferred != NULL)
+    {
+        *transferred = 0;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = NULL;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (pipe->pending_count == 0)
+    {
+        // There are no pending transfers that we could check for completion.
+        return NULL;
+    }
+
+    async_out_transfer * transfer = pipe->transfer_array[pipe->next_finish];
+
+    if (async_out_transfer_pending(transfer))
+    {
+        // The next transfer we expect to finish is still pending;
+        // the kernel has not told us that it is done.
+        return NULL;
+    }
+
+    async_out_transfer_get_results(transfer, transferred, transfer_error);
+
+    if (finished != NULL)
+    {
+        *finished = true;
+    }
+
+    pipe->pending_count--;
+    pipe->next_finish = increment_and_wrap_size(pipe->next_finish, pipe->transfer_count);
+
+    return NULL;
+}
+
+libusbp_error * libusbp_async_out_pipe_cancel_transfers(libusbp_async_out_pipe * pipe)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    libusbp_error * error = NULL;
+
+    // Transfers need to be cancelled individually.  Like
+    // async_in_transfer_cancel_pending, we start with the newest one and skip
+    // the ones that were already reaped.
+    for (size_t i = 0; error == NULL && i < pipe->pending_count; i++)
+    {
+        size_t index = (pipe->next_submit + pipe->transfer_count - 1 - i) %
+            pipe->transfer_count;
+        async_out_transfer * transfer = pipe->transfer_array[index];
+        if (async_out_transfer_pending(transfer))
+        {
+            error = async_out_transfer_cancel(transfer);
+        }
+    }
+
+    return error;
+}
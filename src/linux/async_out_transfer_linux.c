@@ -0,0 +1,188 @@
+#include <libusbp_internal.h>
+
+struct async_out_transfer
+{
+    struct usbdevfs_urb urb;
+    size_t buffer_size;
+    bool buffer_mapped;  // See usbfd_alloc_buffer.
+
+    // This is accessed with atomic operations because the transfer might be
+    // completed by a reaper thread.
+    bool pending;
+    libusbp_error * error;
+    int fd;
+};
+
+libusbp_error * async_out_transfer_create(
+    libusbp_generic_handle * handle, uint8_t pipe_id, size_t transfer_size,
+    async_out_transfer ** transfer)
+{
+    assert(transfer_size != 0);
+    assert(transfer != NULL);
+
+    if (transfer_size > INT_MAX)
+    {
+        // usbdevfs_urb uses ints to represent sizes.
+        return error_create("Transfer size is too large.");
+    }
+
+    libusbp_error * error = NULL;
+
+    // Allocate the transfer struct.
+    async_out_transfer * new_transfer = NULL;
+    if (error == NULL)
+    {
+        new_transfer = calloc(1, sizeof(async_out_transfer));
+        if (new_transfer == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    // Allocate the buffer for the transfer.
+    int fd = libusbp_generic_handle_get_fd(handle);
+    void * new_buffer = NULL;
+    bool new_buffer_mapped = false;
+    if (error == NULL)
+    {
+        error = usbfd_alloc_buffer(fd,
+            generic_handle_get_buffer_capabilities(handle),
+            transfer_size, &new_buffer, &new_buffer_mapped);
+    }
+
+    // Assemble the transfer and pass it to the caller.
+    if (error == NULL)
+    {
+        new_transfer->fd = fd;
+        new_transfer->buffer_size = transfer_size;
+
+        new_transfer->urb.usercontext = new_transfer;
+        new_transfer->urb.type = generic_handle_get_urb_type(handle, pipe_id);
+        new_transfer->urb.endpoint = pipe_id;
+
+        new_transfer->urb.buffer = new_buffer;
+        new_transfer->buffer_mapped = new_buffer_mapped;
+        new_buffer = NULL;
+
+        *transfer = new_transfer;
+        new_transfer = NULL;
+    }
+
+    usbfd_free_buffer(new_buffer, transfer_size, new_buffer_mapped);
+    free(new_transfer);
+    return error;
+}
+
+void async_out_transfer_free(async_out_transfer * transfer)
+{
+    if (transfer == NULL) { return; }
+
+    if (async_out_transfer_pending(transfer))
+    {
+        // The kernel might still read from this transfer's buffer and write
+        // to its URB, so we leak it instead of freeing it.  See
+        // async_in_transfer_free.
+        return;
+    }
+
+    libusbp_error_free(transfer->error);
+    usbfd_free_buffer(transfer->urb.buffer,
+        transfer->buffer_size, transfer->buffer_mapped);
+    free(transfer);
+}
+
+// Copies the data into the transfer's buffer and submits it.  Unlike
+// async_in_transfer_submit, an error from the kernel is returned directly,
+// and the transfer is left in its idle state so it can be used again.
+libusbp_error * async_out_transfer_submit(async_out_transfer * transfer,
+    const void * buffer, size_t size, unsigned int urb_flags)
+{
+    assert(transfer != NULL);
+    assert(!async_out_transfer_pending(transfer));
+    assert(size <= transfer->buffer_size);
+
+    if (buffer == NULL && size)
+    {
+        return error_create("Buffer is null.");
+    }
+
+    if (size)
+    {
+        memcpy(transfer->urb.buffer, buffer, size);
+    }
+
+    libusbp_error_free(transfer->error);
+    transfer->error = NULL;
+    transfer->urb.buffer_length = size;
+    transfer->urb.actual_length = 0;
+    transfer->urb.flags = urb_flags;
+    __atomic_store_n(&transfer->pending, true, __ATOMIC_RELEASE);
+
+    libusbp_error * error = usbfd_submit_urb(transfer->fd, &transfer->urb);
+    if (error != NULL)
+    {
+        __atomic_store_n(&transfer->pending, false, __ATOMIC_RELEASE);
+    }
+    return error;
+}
+
+void async_out_transfer_handle_completion(async_out_transfer * transfer)
+{
+    assert(transfer != NULL);
+
+    #ifdef LIBUSBP_LOG
+    fprintf(stderr, "OUT URB completed: %p, status=%d, actual_length=%d\n",
+        transfer, transfer->urb.status, transfer->urb.actual_length);
+    #endif
+
+    libusbp_error * error = NULL;
+
+    if (error == NULL)
+    {
+        error = error_from_urb_status(&transfer->urb);
+    }
+
+    if (error == NULL && transfer->urb.error_count != 0)
+    {
+        error = error_create("Non-zero error count for USB request: %d.",
+            transfer->urb.error_count);
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Asynchronous OUT transfer failed.");
+    }
+
+    transfer->error = error;
+    __atomic_store_n(&transfer->pending, false, __ATOMIC_RELEASE);
+}
+
+void async_out_transfer_get_results(async_out_transfer * transfer,
+    size_t * transferred, libusbp_error ** transfer_error)
+{
+    assert(transfer != NULL);
+    assert(!async_out_transfer_pending(transfer));
+
+    if (transferred != NULL)
+    {
+        *transferred = transfer->urb.actual_length;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = libusbp_error_copy(transfer->error);
+    }
+}
+
+libusbp_error * async_out_transfer_cancel(async_out_transfer * transfer)
+{
+    if (transfer == NULL) { return NULL; }
+
+    return usbfd_discard_urb(transfer->fd, &transfer->urb);
+}
+
+bool async_out_transfer_pending(async_out_transfer * transfer)
+{
+    assert(transfer != NULL);
+    return __atomic_load_n(&transfer->pending, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,340 @@
+/* Large synchronous transfers on bulk endpoints are split into chunks, and
+ * several chunks are submitted as URBs at the same time, so the host controller
+ * can move on to the next chunk without waiting for us.  A single USBDEVFS_BULK
+ * ioctl would make the kernel allocate one big buffer (which counts against
+ * usbfs_memory_mb) and would leave a gap on the bus between calls.
+ *
+ * The same mechanism handles vectored transfers: every piece of the caller's
+ * buffer gets its own chunks, so the URBs point straight into the pieces.  On
+ * the bus, each URB ends with a short packet unless its length is a multiple
+ * of the maximum packet size, so this is only done if every piece except the
+ * last one has such a length (see chunked_transfer_can_map).
+ *
+ * For reads, every chunk except the last has USBDEVFS_URB_SHORT_NOT_OK and
+ * every chunk except the first has USBDEVFS_URB_BULK_CONTINUATION.  When a
+ * short packet ends the transfer early, the kernel completes that chunk with
+ * -EREMOTEIO and cancels the chunks after it before the host controller
+ * touches them, so no data is lost or read into the wrong place.  Kernels that
+ * do not support this get the old single ioctl.
+ *
+ * The URBs are reaped by whichever thread reaps URBs for the handle, so the
+ * handle keeps a pointer to the transfer in progress on each endpoint (see
+ * generic_handle_set_chunked_transfer) to recognize them.  Transfers on
+ * different endpoints can run on different threads at the same time. */
+
+#include <libusbp_internal.h>
+
+#define CHUNK_SIZE 16384
+#define MAX_CHUNKS_IN_FLIGHT 16
+
+struct chunked_transfer
+{
+    libusbp_generic_handle * handle;
+    int fd;
+    uint8_t pipe_id;
+    bool in;
+    uint32_t flags;  // libusbp_transfer_flag values from the caller
+
+    // The pieces of the caller's buffer, and the position in them where the
+    // next chunk starts.
+    const libusbp_iovec * iov;
+    size_t iov_count;
+    size_t iov_index;
+    size_t iov_offset;
+
+    // The index of the next chunk to submit and the index of the next chunk
+    // we expect to finish.  Chunk i uses urbs[i % MAX_CHUNKS_IN_FLIGHT].
+    size_t next_submit;
+    size_t next_finish;
+
+    struct usbdevfs_urb urbs[MAX_CHUNKS_IN_FLIGHT];
+
+    // Accessed with atomic operations because the URBs might be reaped by a
+    // reaper thread.
+    bool pending[MAX_CHUNKS_IN_FLIGHT];
+};
+
+// Returns true if the endpoint is one where we can split transfers, and
+// stores its maximum packet size.
+static bool chunked_transfer_supported(libusbp_generic_handle * handle,
+    uint8_t pipe_id, size_t * max_packet_size)
+{
+    if (generic_handle_get_endpoint_type(handle, pipe_id) != USB_ENDPOINT_XFER_BULK)
+    {
+        return false;
+    }
+
+    if ((pipe_id & 0x80) &&
+        !(generic_handle_get_capabilities(handle) & USBDEVFS_CAP_BULK_CONTINUATION))
+    {
+        return false;
+    }
+
+    // Chunk boundaries must fall between packets.
+    *max_packet_size = generic_handle_get_max_packet_size(handle, pipe_id);
+    return *max_packet_size != 0 && CHUNK_SIZE % *max_packet_size == 0;
+}
+
+bool chunked_transfer_is_suitable(libusbp_generic_handle * handle,
+    uint8_t pipe_id, size_t size)
+{
+    if (size <= CHUNK_SIZE) { return false; }
+
+    // Let usbfd_bulk_or_interrupt_transfer report that this is too large.
+    if (size > UINT_MAX) { return false; }
+
+    size_t max_packet_size;
+    return chunked_transfer_supported(handle, pipe_id, &max_packet_size);
+}
+
+bool chunked_transfer_can_map(libusbp_generic_handle * handle,
+    uint8_t pipe_id, const libusbp_iovec * iov, size_t iov_count)
+{
+    size_t max_packet_size;
+    if (!chunked_transfer_supported(handle, pipe_id, &max_packet_size))
+    {
+        return false;
+    }
+
+    // Find the last piece with data in it; it can have any length.
+    size_t last = iov_count;
+    while (last > 0 && iov[last - 1].size == 0) { last--; }
+    if (last == 0) { return false; }
+
+    for (size_t i = 0; i < last - 1; i++)
+    {
+        if (iov[i].size % max_packet_size != 0) { return false; }
+    }
+    return true;
+}
+
+// Moves the position past pieces of the buffer that have no data left.
+static void chunked_transfer_skip_empty(chunked_transfer * transfer)
+{
+    while (transfer->iov_index < transfer->iov_count &&
+        transfer->iov_offset == transfer->iov[transfer->iov_index].size)
+    {
+        transfer->iov_index++;
+        transfer->iov_offset = 0;
+    }
+}
+
+static bool chunked_transfer_all_submitted(chunked_transfer * transfer)
+{
+    return transfer->iov_index == transfer->iov_count;
+}
+
+static libusbp_error * chunked_transfer_submit_next(chunked_transfer * transfer)
+{
+    size_t index = transfer->next_submit;
+    size_t slot = index % MAX_CHUNKS_IN_FLIGHT;
+    const libusbp_iovec * piece = &transfer->iov[transfer->iov_index];
+    size_t length = piece->size - transfer->iov_offset;
+    if (length > CHUNK_SIZE) { length = CHUNK_SIZE; }
+
+    struct usbdevfs_urb * urb = &transfer->urbs[slot];
+    memset(urb, 0, sizeof(*urb));
+    urb->type = USBDEVFS_URB_TYPE_BULK;
+    urb->endpoint = transfer->pipe_id;
+    urb->buffer = (uint8_t *)piece->base + transfer->iov_offset;
+    urb->buffer_length = length;
+    urb->usercontext = transfer;
+
+    transfer->iov_offset += length;
+    chunked_transfer_skip_empty(transfer);
+
+    bool last = chunked_transfer_all_submitted(transfer);
+    if (transfer->in)
+    {
+        if (!last || (transfer->flags & LIBUSBP_TRANSFER_SHORT_NOT_OK))
+        {
+            urb->flags |= USBDEVFS_URB_SHORT_NOT_OK;
+        }
+        if (index != 0 || (transfer->flags & LIBUSBP_TRANSFER_BULK_CONTINUATION))
+        {
+            urb->flags |= USBDEVFS_URB_BULK_CONTINUATION;
+        }
+    }
+    else if (last && (transfer->flags & LIBUSBP_TRANSFER_ZERO_PACKET))
+    {
+        urb->flags |= USBDEVFS_URB_ZERO_PACKET;
+    }
+
+    __atomic_store_n(&transfer->pending[slot], true, __ATOMIC_RELEASE);
+    libusbp_error * error = usbfd_submit_urb(transfer->fd, urb);
+    if (error != NULL)
+    {
+        __atomic_store_n(&transfer->pending[slot], false, __ATOMIC_RELEASE);
+        return error;
+    }
+
+    transfer->next_submit++;
+    return NULL;
+}
+
+void chunked_transfer_handle_completion(chunked_transfer * transfer,
+    struct usbdevfs_urb * urb)
+{
+    assert(transfer != NULL);
+    assert(urb >= transfer->urbs && urb < transfer->urbs + MAX_CHUNKS_IN_FLIGHT);
+
+    size_t slot = urb - transfer->urbs;
+    __atomic_store_n(&transfer->pending[slot], false, __ATOMIC_RELEASE);
+}
+
+static bool chunked_transfer_oldest_done(void * context)
+{
+    chunked_transfer * transfer = context;
+    size_t slot = transfer->next_finish % MAX_CHUNKS_IN_FLIGHT;
+    return !__atomic_load_n(&transfer->pending[slot], __ATOMIC_ACQUIRE);
+}
+
+static bool chunked_transfer_all_done(void * context)
+{
+    chunked_transfer * transfer = context;
+    for (size_t i = 0; i < MAX_CHUNKS_IN_FLIGHT; i++)
+    {
+        if (__atomic_load_n(&transfer->pending[i], __ATOMIC_ACQUIRE))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void chunked_transfer_cancel(chunked_transfer * transfer)
+{
+    // Cancel the newest chunks first.  See async_in_transfer_cancel_pending.
+    for (size_t i = transfer->next_submit; i > transfer->next_finish; i--)
+    {
+        size_t slot = (i - 1) % MAX_CHUNKS_IN_FLIGHT;
+        if (__atomic_load_n(&transfer->pending[slot], __ATOMIC_ACQUIRE))
+        {
+            libusbp_error_free(usbfd_discard_urb(transfer->fd, &transfer->urbs[slot]));
+        }
+    }
+}
+
+libusbp_error * chunked_transfer_run(libusbp_generic_handle * handle,
+    uint8_t pipe_id, uint32_t timeout, uint32_t flags,
+    const libusbp_iovec * iov, size_t iov_count, size_t * transferred)
+{
+    assert(handle != NULL);
+
+    if (transferred != NULL)
+    {
+        *transferred = 0;
+    }
+
+    for (size_t i = 0; i < iov_count; i++)
+    {
+        if (iov[i].base == NULL && iov[i].size)
+        {
+            return error_create("Buffer is null.");
+        }
+    }
+
+    chunked_transfer transfer;
+    memset(&transfer, 0, sizeof(transfer));
+    transfer.handle = handle;
+    transfer.fd = libusbp_generic_handle_get_fd(handle);
+    transfer.pipe_id = pipe_id;
+    transfer.in = pipe_id & 0x80;
+    transfer.flags = flags;
+    transfer.iov = iov;
+    transfer.iov_count = iov_count;
+    chunked_transfer_skip_empty(&transfer);
+
+    generic_handle_set_chunked_transfer(handle, pipe_id, &transfer);
+
+    uint64_t start = get_time_ms();
+    size_t total = 0;
+    bool short_packet = false;
+    libusbp_error * error = NULL;
+
+    while (error == NULL && !short_packet &&
+        !(chunked_transfer_all_submitted(&transfer) &&
+        transfer.next_finish == transfer.next_submit))
+    {
+        // Keep as many chunks in flight as we can.
+        while (error == NULL && !chunked_transfer_all_submitted(&transfer) &&
+            transfer.next_submit - transfer.next_finish < MAX_CHUNKS_IN_FLIGHT)
+        {
+            error = chunked_transfer_submit_next(&transfer);
+        }
+        if (error != NULL) { break; }
+
+        uint32_t remaining = 0;
+        if (timeout != 0)
+        {
+            uint64_t elapsed = get_time_ms() - start;
+            if (elapsed >= timeout)
+            {
+                errno = ETIMEDOUT;
+                error = error_create_errno("");
+                break;
+            }
+            remaining = timeout - elapsed;
+        }
+
+        error = generic_handle_wait_until(handle, remaining,
+            chunked_transfer_oldest_done, &transfer);
+        if (error != NULL) { break; }
+
+        // Handle the chunks that finished, in order.
+        while (error == NULL && !short_packet &&
+            transfer.next_finish < transfer.next_submit &&
+            chunked_transfer_oldest_done(&transfer))
+        {
+            struct usbdevfs_urb * urb =
+                &transfer.urbs[transfer.next_finish % MAX_CHUNKS_IN_FLIGHT];
+            total += urb->actual_length;
+            transfer.next_finish++;
+
+            if (urb->status == -EREMOTEIO && transfer.in &&
+                !(flags & LIBUSBP_TRANSFER_SHORT_NOT_OK))
+            {
+                // A short packet ended the read.
+                short_packet = true;
+            }
+            else if (urb->status != 0)
+            {
+                error = error_from_urb_status(urb);
+            }
+            else if (urb->actual_length < urb->buffer_length)
+            {
+                // The last chunk of a read was short.
+                short_packet = true;
+            }
+        }
+    }
+
+    // Make sure the kernel is done with every URB before we return, because
+    // they live on our stack and point into the caller's buffer.  We must not
+    // return early even if waiting fails: once the slot below is cleared, an
+    // URB that is still submitted would be reaped as if it belonged to an
+    // asynchronous pipe.
+    chunked_transfer_cancel(&transfer);
+    libusbp_error * drain_error = generic_handle_wait_until(handle, 0,
+        chunked_transfer_all_done, &transfer);
+    if (drain_error != NULL)
+    {
+        generic_handle_drain(handle, chunked_transfer_all_done, &transfer);
+    }
+    if (error == NULL)
+    {
+        error = drain_error;
+    }
+    else
+    {
+        libusbp_error_free(drain_error);
+    }
+
+    generic_handle_set_chunked_transfer(handle, pipe_id, NULL);
+
+    if (transferred != NULL)
+    {
+        *transferred = total;
+    }
+    return error;
+}
@@ -0,0 +1,159 @@
+/* A libusbp_context holds a udev context so that the functions that look up
+ * devices can share it instead of creating and destroying one on every call.
+ * Creating a udev context reads the udev configuration, which is a noticeable
+ * part of the cost of listing devices when it is done many times per second.
+ *
+ * A context made with libusbp_context_create_sysfs holds a sysfs root instead,
+ * and the functions that use it read sysfs and receive kernel uevents
+ * directly, without libudev.
+ *
+ * If libusbp was built without libudev (LIBUSBP_USE_UDEV), every context reads
+ * sysfs directly, and so do the functions that are not passed a context.
+ *
+ * Like the udev context it holds, a libusbp_context is not thread-safe. */
+
+#include <libusbp_internal.h>
+
+struct libusbp_context
+{
+    #ifdef LIBUSBP_USE_UDEV
+    // NULL for contexts that read sysfs directly.
+    struct udev * udev;
+    #endif
+
+    // NULL for contexts that use udev.
+    char * sysfs_root;
+};
+
+libusbp_error * libusbp_context_create(libusbp_context ** context)
+{
+    if (context == NULL)
+    {
+        return error_create("Context output pointer is null.");
+    }
+
+    *context = NULL;
+
+    #ifndef LIBUSBP_USE_UDEV
+    return libusbp_context_create_sysfs(NULL, context);
+    #else
+
+    libusbp_error * error = NULL;
+
+    libusbp_context * new_context = NULL;
+    if (error == NULL)
+    {
+        new_context = calloc(1, sizeof(libusbp_context));
+        if (new_context == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    if (error == NULL)
+    {
+        error = udevw_create_context(&new_context->udev);
+    }
+
+    if (error == NULL)
+    {
+        *context = new_context;
+        new_context = NULL;
+    }
+
+    libusbp_context_free(new_context);
+    return error;
+    #endif
+}
+
+void libusbp_context_free(libusbp_context * context)
+{
+    if (context == NULL) { return; }
+
+    #ifdef LIBUSBP_USE_UDEV
+    if (context->udev != NULL) { udev_unref(context->udev); }
+    #endif
+    free(context->sysfs_root);
+    free(context);
+}
+
+libusbp_error * libusbp_context_create_sysfs(const char * sysfs_root,
+    libusbp_context ** context)
+{
+    if (context == NULL)
+    {
+        return error_create("Context output pointer is null.");
+    }
+
+    *context = NULL;
+
+    if (sysfs_root == NULL)
+    {
+        sysfs_root = "/sys";
+    }
+
+    libusbp_error * error = NULL;
+
+    libusbp_context * new_context = NULL;
+    if (error == NULL)
+    {
+        new_context = calloc(1, sizeof(libusbp_context));
+        if (new_context == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    // Resolve the root the same way we resolve the links to devices, so the
+    // syspaths we report do not depend on how the root was written.
+    if (error == NULL)
+    {
+        new_context->sysfs_root = realpath(sysfs_root, NULL);
+        if (new_context->sysfs_root == NULL)
+        {
+            error = error_create_errno("Failed to find sysfs root %s.", sysfs_root);
+        }
+    }
+
+    if (error == NULL)
+    {
+        *context = new_context;
+        new_context = NULL;
+    }
+
+    libusbp_context_free(new_context);
+    return error;
+}
+
+#ifdef LIBUSBP_USE_UDEV
+libusbp_error * context_get_udev(libusbp_context * context, struct udev ** udev)
+{
+    assert(udev != NULL);
+
+    if (context == NULL)
+    {
+        return udevw_create_context(udev);
+    }
+
+    if (context->udev == NULL)
+    {
+        return error_create("The context does not use udev.");
+    }
+
+    *udev = udev_ref(context->udev);
+    return NULL;
+}
+#endif
+
+const char * context_get_sysfs_root(const libusbp_context * context)
+{
+    if (context == NULL)
+    {
+        #ifdef LIBUSBP_USE_UDEV
+        return NULL;
+        #else
+        return "/sys";
+        #endif
+    }
+    return context->sysfs_root;
+}
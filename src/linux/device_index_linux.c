@@ -0,0 +1,458 @@
+/* A device index holds the set of connected USB devices in two hash tables,
+ * one keyed by syspath and one keyed by vendor ID, product ID, and serial
+ * number.  It lists the devices once when it is created, and after that it
+ * keeps itself up to date with the events from a hotplug monitor, so looking
+ * up a device never needs to scan the system or allocate memory.
+ *
+ * Each entry is in one chain of each table.  The tables always have the same
+ * number of buckets, which is a power of two, and they grow when the average
+ * chain would be longer than one entry. */
+
+#include <libusbp_internal.h>
+
+typedef struct index_entry
+{
+    libusbp_device * device;
+
+    // These point into the device.
+    const char * syspath;
+    const char * serial_number;  // may be NULL
+
+    uint16_t vendor_id;
+    uint16_t product_id;
+
+    uint32_t syspath_hash;
+    uint32_t id_hash;
+
+    struct index_entry * next_by_syspath;
+    struct index_entry * next_by_id;
+} index_entry;
+
+struct libusbp_device_index
+{
+    libusbp_hotplug_monitor * monitor;
+
+    index_entry ** syspath_buckets;
+    index_entry ** id_buckets;
+    size_t bucket_count;
+    size_t entry_count;
+};
+
+#define INITIAL_BUCKET_COUNT 64
+
+// FNV-1a, which is simple and good enough for short strings like these.
+static uint32_t hash_bytes(uint32_t hash, const void * data, size_t size)
+{
+    const uint8_t * bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static uint32_t hash_syspath(const char * syspath)
+{
+    return hash_bytes(2166136261, syspath, strlen(syspath));
+}
+
+static uint32_t hash_id(uint16_t vendor_id, uint16_t product_id,
+    const char * serial_number)
+{
+    uint16_t ids[2] = { vendor_id, product_id };
+    uint32_t hash = hash_bytes(2166136261, ids, sizeof(ids));
+    if (serial_number != NULL)
+    {
+        hash = hash_bytes(hash, serial_number, strlen(serial_number));
+    }
+    return hash;
+}
+
+static bool serial_numbers_equal(const char * a, const char * b)
+{
+    if (a == NULL || b == NULL) { return a == b; }
+    return strcmp(a, b) == 0;
+}
+
+static void entry_free(index_entry * entry)
+{
+    if (entry == NULL) { return; }
+    libusbp_device_free(entry->device);
+    free(entry);
+}
+
+// Makes an entry that takes ownership of the device.
+static libusbp_error * entry_create(libusbp_device * device, index_entry ** entry)
+{
+    assert(device != NULL);
+    assert(entry != NULL);
+
+    index_entry * new_entry = calloc(1, sizeof(index_entry));
+    if (new_entry == NULL)
+    {
+        libusbp_device_free(device);
+        return &error_no_memory;
+    }
+
+    new_entry->device = device;
+    device_peek_strings(device, &new_entry->syspath, &new_entry->serial_number);
+
+    libusbp_error * error = libusbp_device_get_vendor_id(device, &new_entry->vendor_id);
+    assert(error == NULL);
+    error = libusbp_device_get_product_id(device, &new_entry->product_id);
+    assert(error == NULL);
+    LIBUSBP_UNUSED(error);
+
+    new_entry->syspath_hash = hash_syspath(new_entry->syspath);
+    new_entry->id_hash = hash_id(new_entry->vendor_id, new_entry->product_id,
+        new_entry->serial_number);
+
+    *entry = new_entry;
+    return NULL;
+}
+
+static index_entry ** syspath_bucket(libusbp_device_index * index, uint32_t hash)
+{
+    return &index->syspath_buckets[hash & (index->bucket_count - 1)];
+}
+
+static index_entry ** id_bucket(libusbp_device_index * index, uint32_t hash)
+{
+    return &index->id_buckets[hash & (index->bucket_count - 1)];
+}
+
+// Puts an entry at the front of its chains.  The tables must be big enough.
+static void index_link(libusbp_device_index * index, index_entry * entry)
+{
+    index_entry ** bucket = syspath_bucket(index, entry->syspath_hash);
+    entry->next_by_syspath = *bucket;
+    *bucket = entry;
+
+    bucket = id_bucket(index, entry->id_hash);
+    entry->next_by_id = *bucket;
+    *bucket = entry;
+}
+
+// Makes both tables bigger and moves the entries into the new buckets.
+static libusbp_error * index_grow(libusbp_device_index * index)
+{
+    size_t new_count = index->bucket_count * 2;
+    index_entry ** new_syspath_buckets = calloc(new_count, sizeof(index_entry *));
+    index_entry ** new_id_buckets = calloc(new_count, sizeof(index_entry *));
+    if (new_syspath_buckets == NULL || new_id_buckets == NULL)
+    {
+        free(new_syspath_buckets);
+        free(new_id_buckets);
+        return &error_no_memory;
+    }
+
+    index_entry ** old_buckets = index->syspath_buckets;
+    size_t old_count = index->bucket_count;
+
+    free(index->id_buckets);
+    index->syspath_buckets = new_syspath_buckets;
+    index->id_buckets = new_id_buckets;
+    index->bucket_count = new_count;
+
+    for (size_t i = 0; i < old_count; i++)
+    {
+        index_entry * entry = old_buckets[i];
+        while (entry != NULL)
+        {
+            index_entry * next = entry->next_by_syspath;
+            index_link(index, entry);
+            entry = next;
+        }
+    }
+    free(old_buckets);
+    return NULL;
+}
+
+static index_entry * index_find_syspath(libusbp_device_index * index,
+    const char * syspath)
+{
+    uint32_t hash = hash_syspath(syspath);
+    for (index_entry * entry = *syspath_bucket(index, hash); entry != NULL;
+        entry = entry->next_by_syspath)
+    {
+        if (entry->syspath_hash == hash && strcmp(entry->syspath, syspath) == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Removes the entry with the specified syspath, if there is one.
+static void index_remove(libusbp_device_index * index, const char * syspath)
+{
+    index_entry * entry = index_find_syspath(index, syspath);
+    if (entry == NULL) { return; }
+
+    index_entry ** link = syspath_bucket(index, entry->syspath_hash);
+    while (*link != entry) { link = &(*link)->next_by_syspath; }
+    *link = entry->next_by_syspath;
+
+    link = id_bucket(index, entry->id_hash);
+    while (*link != entry) { link = &(*link)->next_by_id; }
+    *link = entry->next_by_id;
+
+    index->entry_count--;
+    entry_free(entry);
+}
+
+// Adds a device to the index, replacing any entry with the same syspath.  The
+// index takes ownership of the device.
+static libusbp_error * index_add(libusbp_device_index * index,
+    libusbp_device * device)
+{
+    index_entry * entry;
+    libusbp_error * error = entry_create(device, &entry);
+    if (error != NULL) { return error; }
+
+    index_remove(index, entry->syspath);
+
+    if (index->entry_count >= index->bucket_count)
+    {
+        error = index_grow(index);
+        if (error != NULL)
+        {
+            entry_free(entry);
+            return error;
+        }
+    }
+
+    index_link(index, entry);
+    index->entry_count++;
+    return NULL;
+}
+
+libusbp_error * libusbp_device_index_create(libusbp_context * context,
+    libusbp_device_index ** index)
+{
+    if (index == NULL)
+    {
+        return error_create("Device index output pointer is null.");
+    }
+
+    *index = NULL;
+
+    libusbp_error * error = NULL;
+
+    libusbp_device_index * new_index = NULL;
+    if (error == NULL)
+    {
+        new_index = calloc(1, sizeof(libusbp_device_index));
+        if (new_index == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    if (error == NULL)
+    {
+        new_index->bucket_count = INITIAL_BUCKET_COUNT;
+        new_index->syspath_buckets = calloc(INITIAL_BUCKET_COUNT, sizeof(index_entry *));
+        new_index->id_buckets = calloc(INITIAL_BUCKET_COUNT, sizeof(index_entry *));
+        if (new_index->syspath_buckets == NULL || new_index->id_buckets == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    // Start monitoring before listing the devices, so that no changes are
+    // missed in between.  Events for devices that were already listed are
+    // harmless.
+    if (error == NULL)
+    {
+        error = libusbp_hotplug_monitor_create(context, &new_index->monitor);
+    }
+
+    libusbp_device ** list = NULL;
+    size_t count = 0;
+    if (error == NULL)
+    {
+        error = libusbp_list_connected_devices_ctx(context, &list, &count);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // index_add takes ownership of the device even if it fails.
+        if (error == NULL)
+        {
+            error = index_add(new_index, list[i]);
+        }
+        else
+        {
+            libusbp_device_free(list[i]);
+        }
+    }
+    libusbp_list_free(list);
+
+    if (error == NULL)
+    {
+        *index = new_index;
+        new_index = NULL;
+    }
+
+    libusbp_device_index_free(new_index);
+    return error;
+}
+
+void libusbp_device_index_free(libusbp_device_index * index)
+{
+    if (index == NULL) { return; }
+
+    if (index->syspath_buckets != NULL)
+    {
+        for (size_t i = 0; i < index->bucket_count; i++)
+        {
+            index_entry * entry = index->syspath_buckets[i];
+            while (entry != NULL)
+            {
+                index_entry * next = entry->next_by_syspath;
+                entry_free(entry);
+                entry = next;
+            }
+        }
+    }
+
+    free(index->syspath_buckets);
+    free(index->id_buckets);
+    libusbp_hotplug_monitor_free(index->monitor);
+    free(index);
+}
+
+int libusbp_device_index_get_fd(libusbp_device_index * index)
+{
+    if (index == NULL) { return -1; }
+    return libusbp_hotplug_monitor_get_fd(index->monitor);
+}
+
+libusbp_error * libusbp_device_index_update(libusbp_device_index * index,
+    bool * changed)
+{
+    if (changed != NULL)
+    {
+        *changed = false;
+    }
+
+    if (index == NULL)
+    {
+        return error_create("Device index argument is null.");
+    }
+
+    while (true)
+    {
+        uint32_t event;
+        libusbp_device * device;
+        libusbp_error * error = libusbp_hotplug_monitor_receive(index->monitor,
+            &event, &device);
+        if (error != NULL) { return error; }
+        if (device == NULL) { return NULL; }
+
+        if (event == LIBUSBP_HOTPLUG_DEVICE_ADDED)
+        {
+            error = index_add(index, device);
+            if (error != NULL) { return error; }
+            if (changed != NULL) { *changed = true; }
+        }
+        else if (event == LIBUSBP_HOTPLUG_DEVICE_REMOVED)
+        {
+            const char * syspath;
+            const char * serial_number;
+            device_peek_strings(device, &syspath, &serial_number);
+            if (index_find_syspath(index, syspath) != NULL)
+            {
+                index_remove(index, syspath);
+                if (changed != NULL) { *changed = true; }
+            }
+            libusbp_device_free(device);
+        }
+        else
+        {
+            // Serial ports coming and going do not change the set of devices.
+            libusbp_device_free(device);
+        }
+    }
+}
+
+libusbp_error * libusbp_device_index_get_count(libusbp_device_index * index,
+    size_t * count)
+{
+    if (count == NULL)
+    {
+        return error_create("Count output pointer is null.");
+    }
+
+    *count = 0;
+
+    if (index == NULL)
+    {
+        return error_create("Device index argument is null.");
+    }
+
+    *count = index->entry_count;
+    return NULL;
+}
+
+libusbp_error * libusbp_device_index_find_by_os_id(libusbp_device_index * index,
+    const char * id, const libusbp_device ** device)
+{
+    if (device == NULL)
+    {
+        return error_create("Device output pointer is null.");
+    }
+
+    *device = NULL;
+
+    if (index == NULL)
+    {
+        return error_create("Device index argument is null.");
+    }
+
+    if (id == NULL)
+    {
+        return error_create("Device OS ID is null.");
+    }
+
+    index_entry * entry = index_find_syspath(index, id);
+    if (entry != NULL)
+    {
+        *device = entry->device;
+    }
+    return NULL;
+}
+
+libusbp_error * libusbp_device_index_find(libusbp_device_index * index,
+    uint16_t vendor_id, uint16_t product_id, const char * serial_number,
+    const libusbp_device ** device)
+{
+    if (device == NULL)
+    {
+        return error_create("Device output pointer is null.");
+    }
+
+    *device = NULL;
+
+    if (index == NULL)
+    {
+        return error_create("Device index argument is null.");
+    }
+
+    uint32_t hash = hash_id(vendor_id, product_id, serial_number);
+    for (index_entry * entry = *id_bucket(index, hash); entry != NULL;
+        entry = entry->next_by_id)
+    {
+        if (entry->id_hash == hash &&
+            entry->vendor_id == vendor_id &&
+            entry->product_id == product_id &&
+            serial_numbers_equal(entry->serial_number, serial_number))
+        {
+            *device = entry->device;
+            return NULL;
+        }
+    }
+    return NULL;
+}
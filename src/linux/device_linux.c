@@ -9,6 +9,7 @@ struct libusbp_device
     uint16_t revision;
 };
 
+#ifdef LIBUSBP_USE_UDEV
 libusbp_error * device_create(struct udev_device * dev, libusbp_device ** device)
 {
     assert(dev != NULL);
@@ -82,6 +83,76 @@ libusbp_error * device_create(struct udev_device * dev, libusbp_device ** device
     free(new_device);
     return error;
 }
+#endif
+
+// Creates a device from the properties in a uevent instead of its sysattrs.
+// This is for devices that were just removed, whose sysattrs cannot be read
+// anymore.  The kernel's PRODUCT property, like "1ffb/da01/100", holds the
+// vendor ID, product ID, and revision.  The serial number can be NULL; udev
+// gets it from its database and replaces unusual characters, so it might not
+// match what the device reported.
+libusbp_error * device_create_from_properties(const char * syspath,
+    const char * product, const char * serial_number, libusbp_device ** device)
+{
+    assert(syspath != NULL);
+    assert(device != NULL);
+
+    uint16_t vendor_id, product_id, revision;
+    if (product == NULL || sscanf(product, "%hx/%hx/%hx",
+        &vendor_id, &product_id, &revision) != 3)
+    {
+        return error_create("Failed to get the PRODUCT property of the device.");
+    }
+
+    return device_create_from_values(syspath, vendor_id, product_id,
+        revision, serial_number, device);
+}
+
+// Creates a device from values that were already read, for example from sysfs
+// without libudev.  The serial number can be NULL.
+libusbp_error * device_create_from_values(const char * syspath,
+    uint16_t vendor_id, uint16_t product_id, uint16_t revision,
+    const char * serial_number, libusbp_device ** device)
+{
+    assert(syspath != NULL);
+    assert(device != NULL);
+
+    libusbp_error * error = NULL;
+
+    // Allocate memory for the device.
+    libusbp_device * new_device = NULL;
+    if (error == NULL)
+    {
+        new_device = calloc(1, sizeof(libusbp_device));
+        if (new_device == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    if (error == NULL)
+    {
+        error = string_copy(syspath, &new_device->syspath);
+    }
+
+    if (error == NULL && serial_number != NULL)
+    {
+        error = string_copy(serial_number, &new_device->serial_number);
+    }
+
+    // Give the device to the caller.
+    if (error == NULL)
+    {
+        new_device->vendor_id = vendor_id;
+        new_device->product_id = product_id;
+        new_device->revision = revision;
+        *device = new_device;
+        new_device = NULL;
+    }
+
+    libusbp_device_free(new_device);
+    return error;
+}
 
 void libusbp_device_free(libusbp_device * device)
 {
@@ -254,3 +325,14 @@ libusbp_error * libusbp_device_get_os_id(
 
     return string_copy(device->syspath, id);
 }
+
+void device_peek_strings(const libusbp_device * device,
+    const char ** syspath, const char ** serial_number)
+{
+    assert(device != NULL);
+    assert(syspath != NULL);
+    assert(serial_number != NULL);
+
+    *syspath = device->syspath;
+    *serial_number = device->serial_number;
+}
@@ -53,6 +53,12 @@ libusbp_error * error_create_errno(const char * format, ...)
         error = error_add(error, "The transfer overflowed.");
         break;
 
+    case EREMOTEIO:
+        skip_standard_message = true;
+        error = error_add(error, "The device sent a short packet.");
+        error = error_add_code(error, LIBUSBP_ERROR_SHORT_PACKET);
+        break;
+
     case EILSEQ:
         skip_standard_message = true;
         error = error_add(error,
@@ -110,6 +116,7 @@ libusbp_error * error_from_urb_status(struct usbdevfs_urb * urb)
     return error;
 }
 
+#ifdef LIBUSBP_USE_UDEV
 libusbp_error * error_create_udev(int error_code, const char * format, ...)
 {
     libusbp_error * error = error_create("Error from libudev: %d.", error_code);
@@ -121,3 +128,4 @@ libusbp_error * error_create_udev(int error_code, const char * format, ...)
 
     return error;
 }
+#endif
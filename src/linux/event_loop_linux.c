@@ -0,0 +1,360 @@
+/* An event loop lets one thread wait for asynchronous transfers on many
+ * generic handles at once, using an epoll set that contains the usbfs file
+ * descriptor of each handle. */
+
+#include <libusbp_internal.h>
+
+typedef struct event_loop_entry
+{
+    libusbp_generic_handle * handle;
+
+    // The number of times the handle was added to the loop, directly or by
+    // adding one of its pipes, minus the number of times it was removed.
+    size_t ref_count;
+
+    // True if the handle's file descriptor is currently in the epoll set.
+    bool polled;
+} event_loop_entry;
+
+struct libusbp_event_loop
+{
+    int epoll_fd;
+    event_loop_entry * entries;
+    size_t entry_count;
+    size_t entry_capacity;
+};
+
+// The maximum number of handles we get from each call to epoll_wait().  If
+// more handles are ready, the rest will be handled on the next call.
+#define EVENT_LOOP_MAX_EVENTS 64
+
+libusbp_error * libusbp_event_loop_create(libusbp_event_loop ** loop)
+{
+    if (loop == NULL)
+    {
+        return error_create("Event loop output pointer is null.");
+    }
+
+    *loop = NULL;
+
+    libusbp_error * error = NULL;
+
+    libusbp_event_loop * new_loop = NULL;
+    if (error == NULL)
+    {
+        new_loop = calloc(1, sizeof(libusbp_event_loop));
+        if (new_loop == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    int new_epoll_fd = -1;
+    if (error == NULL)
+    {
+        new_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (new_epoll_fd == -1)
+        {
+            error = error_create_errno("Failed to create epoll instance.");
+        }
+    }
+
+    if (error == NULL)
+    {
+        new_loop->epoll_fd = new_epoll_fd;
+        new_epoll_fd = -1;
+
+        *loop = new_loop;
+        new_loop = NULL;
+    }
+
+    if (new_epoll_fd != -1) { close(new_epoll_fd); }
+    free(new_loop);
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to create event loop.");
+    }
+    return error;
+}
+
+void libusbp_event_loop_free(libusbp_event_loop * loop)
+{
+    if (loop != NULL)
+    {
+        for (size_t i = 0; i < loop->entry_count; i++)
+        {
+            generic_handle_leave_event_loop(loop->entries[i].handle);
+        }
+        close(loop->epoll_fd);
+        free(loop->entries);
+        free(loop);
+    }
+}
+
+static event_loop_entry * event_loop_find_entry(
+    libusbp_event_loop * loop, libusbp_generic_handle * handle)
+{
+    for (size_t i = 0; i < loop->entry_count; i++)
+    {
+        if (loop->entries[i].handle == handle)
+        {
+            return &loop->entries[i];
+        }
+    }
+    return NULL;
+}
+
+libusbp_error * libusbp_event_loop_add_handle(
+    libusbp_event_loop * loop,
+    libusbp_generic_handle * handle)
+{
+    if (loop == NULL)
+    {
+        return error_create("Event loop argument is null.");
+    }
+
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    event_loop_entry * entry = event_loop_find_entry(loop, handle);
+    if (entry != NULL)
+    {
+        entry->ref_count++;
+        return NULL;
+    }
+
+    libusbp_error * error = generic_handle_join_event_loop(handle);
+    bool joined = error == NULL;
+
+    // Make room for the new entry.
+    if (error == NULL && loop->entry_count == loop->entry_capacity)
+    {
+        size_t new_capacity = loop->entry_capacity ? loop->entry_capacity * 2 : 8;
+        event_loop_entry * new_entries = realloc(loop->entries,
+            new_capacity * sizeof(event_loop_entry));
+        if (new_entries == NULL)
+        {
+            error = &error_no_memory;
+        }
+        else
+        {
+            loop->entries = new_entries;
+            loop->entry_capacity = new_capacity;
+        }
+    }
+
+    // The kernel reports POLLOUT on a usbfs file descriptor when there are
+    // URBs to reap.  POLLERR and POLLHUP (for disconnection) are always
+    // reported.
+    if (error == NULL)
+    {
+        struct epoll_event event = {0};
+        event.events = EPOLLOUT;
+        event.data.ptr = handle;
+        int result = epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD,
+            libusbp_generic_handle_get_fd(handle), &event);
+        if (result == -1)
+        {
+            error = error_create_errno("Failed to add file descriptor to epoll set.");
+        }
+    }
+
+    if (error == NULL)
+    {
+        entry = &loop->entries[loop->entry_count++];
+        entry->handle = handle;
+        entry->ref_count = 1;
+        entry->polled = true;
+    }
+
+    if (error != NULL && joined)
+    {
+        generic_handle_leave_event_loop(handle);
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to add generic handle to event loop.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_event_loop_remove_handle(
+    libusbp_event_loop * loop,
+    libusbp_generic_handle * handle)
+{
+    if (loop == NULL)
+    {
+        return error_create("Event loop argument is null.");
+    }
+
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    event_loop_entry * entry = event_loop_find_entry(loop, handle);
+    if (entry == NULL)
+    {
+        return error_create("Generic handle is not in the event loop.");
+    }
+
+    if (--entry->ref_count)
+    {
+        return NULL;
+    }
+
+    libusbp_error * error = NULL;
+
+    if (entry->polled)
+    {
+        int result = epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL,
+            libusbp_generic_handle_get_fd(handle), NULL);
+        if (result == -1)
+        {
+            error = error_create_errno(
+                "Failed to remove generic handle from event loop.");
+        }
+    }
+
+    generic_handle_leave_event_loop(handle);
+
+    // Move the last entry into the place of the one we removed.
+    *entry = loop->entries[--loop->entry_count];
+
+    return error;
+}
+
+libusbp_error * libusbp_event_loop_add_async_in_pipe(
+    libusbp_event_loop * loop,
+    libusbp_async_in_pipe * pipe)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    return libusbp_event_loop_add_handle(loop, async_in_pipe_get_handle(pipe));
+}
+
+libusbp_error * libusbp_event_loop_remove_async_in_pipe(
+    libusbp_event_loop * loop,
+    libusbp_async_in_pipe * pipe)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    return libusbp_event_loop_remove_handle(loop, async_in_pipe_get_handle(pipe));
+}
+
+libusbp_error * libusbp_event_loop_add_async_out_pipe(
+    libusbp_event_loop * loop,
+    libusbp_async_out_pipe * pipe)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    return libusbp_event_loop_add_handle(loop, async_out_pipe_get_handle(pipe));
+}
+
+libusbp_error * libusbp_event_loop_remove_async_out_pipe(
+    libusbp_event_loop * loop,
+    libusbp_async_out_pipe * pipe)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    return libusbp_event_loop_remove_handle(loop, async_out_pipe_get_handle(pipe));
+}
+
+int libusbp_event_loop_get_fd(libusbp_event_loop * loop)
+{
+    if (loop == NULL)
+    {
+        return -1;
+    }
+    return loop->epoll_fd;
+}
+
+// Handles events on every generic handle that epoll reports as ready.  A
+// handle that fails (usually because the device was disconnected) would be
+// reported as ready forever, so it is taken out of the epoll set; it stays in
+// the loop until the caller removes it.
+static libusbp_error * event_loop_dispatch(libusbp_event_loop * loop,
+    int timeout)
+{
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    int count = epoll_wait(loop->epoll_fd, events, EVENT_LOOP_MAX_EVENTS, timeout);
+    if (count == -1)
+    {
+        if (errno == EINTR)
+        {
+            // A signal interrupted us, so just return early.
+            return NULL;
+        }
+
+        return error_create_errno("Failed to wait for events.");
+    }
+
+    libusbp_error * error = NULL;
+    for (int i = 0; i < count; i++)
+    {
+        libusbp_generic_handle * handle = events[i].data.ptr;
+        libusbp_error * handle_error = generic_handle_events(handle);
+        if (handle_error == NULL) { continue; }
+
+        event_loop_entry * entry = event_loop_find_entry(loop, handle);
+        assert(entry != NULL);
+        entry->polled = false;
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL,
+            libusbp_generic_handle_get_fd(handle), NULL);
+
+        // Report the first error and discard the others.
+        if (error == NULL)
+        {
+            error = error_add(handle_error,
+                "A generic handle was removed from the event loop because of an error.");
+        }
+        else
+        {
+            libusbp_error_free(handle_error);
+        }
+    }
+    return error;
+}
+
+libusbp_error * libusbp_event_loop_handle_events(libusbp_event_loop * loop)
+{
+    if (loop == NULL)
+    {
+        return error_create("Event loop argument is null.");
+    }
+
+    return event_loop_dispatch(loop, 0);
+}
+
+libusbp_error * libusbp_event_loop_wait(libusbp_event_loop * loop,
+    uint32_t timeout)
+{
+    if (loop == NULL)
+    {
+        return error_create("Event loop argument is null.");
+    }
+
+    int epoll_timeout = -1;
+    if (timeout != 0)
+    {
+        epoll_timeout = timeout > INT_MAX ? INT_MAX : (int)timeout;
+    }
+
+    return event_loop_dispatch(loop, epoll_timeout);
+}
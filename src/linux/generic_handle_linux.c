@@ -5,9 +5,65 @@ struct libusbp_generic_handle
     libusbp_device * device;
     int fd;
 
-    // Timeouts are stored in milliseconds.  0 is forever.
+    // Timeouts are stored in milliseconds.  0 is forever.  The timeouts and
+    // flags are accessed with atomic operations so they can be changed while
+    // other threads are doing transfers.
     uint32_t in_timeout[MAX_ENDPOINT_NUMBER + 1];
     uint32_t out_timeout[MAX_ENDPOINT_NUMBER + 1];
+
+    // libusbp_transfer_flag values set with
+    // libusbp_generic_handle_set_pipe_flags.
+    uint32_t in_flags[MAX_ENDPOINT_NUMBER + 1];
+    uint32_t out_flags[MAX_ENDPOINT_NUMBER + 1];
+
+    // The interface this handle is for, the bConfigurationValue of its
+    // configuration (0 if unknown), and its current alternate setting.
+    uint8_t interface_number;
+    uint8_t configuration;
+    uint8_t alternate_setting;
+
+    // USB_ENDPOINT_XFER_* values from the endpoint descriptors, indexed by
+    // endpoint number, and the maximum packet sizes from the same descriptors.
+    // See generic_handle_update_endpoint_info.
+    uint8_t in_endpoint_type[MAX_ENDPOINT_NUMBER + 1];
+    uint8_t out_endpoint_type[MAX_ENDPOINT_NUMBER + 1];
+    uint16_t in_max_packet_size[MAX_ENDPOINT_NUMBER + 1];
+    uint16_t out_max_packet_size[MAX_ENDPOINT_NUMBER + 1];
+
+    // USBDEVFS_CAP_* flags reported by the kernel for this device file.
+    uint32_t capabilities;
+
+    // True if transfer buffers should be allocated with malloc even though
+    // the kernel supports allocating them with mmap.
+    bool zero_copy_disabled;
+
+    // State for the reaper thread, which reaps URBs for this handle while it
+    // is running.  See libusbp_generic_handle_start_reaper_thread.
+    bool reaper_running;
+    pthread_t reaper_thread;
+    int reaper_stop_fd;    // eventfd that tells the thread to stop
+    libusbp_error * reaper_error;  // accessed with atomic operations
+
+    // The number of event loops the handle is in.  A handle in an event loop
+    // cannot have a reaper thread.  See generic_handle_join_event_loop.
+    size_t event_loop_count;
+
+    // Several threads can wait for transfers on the handle at once, but only
+    // one of them polls the device file and reaps URBs at a time; the others
+    // sleep on wake_count, which is incremented when URBs are reaped or when
+    // the polling thread stops polling.  reap_count only counts the batches of
+    // URBs that were reaped.  See generic_handle_wait_until.  These are
+    // accessed with atomic operations.
+    bool reaping;
+    uint32_t wake_count;
+    uint32_t reap_count;
+    uint32_t sleepers;
+
+    // The synchronous transfer that is currently split into several URBs on
+    // each endpoint, or NULL.  Accessed with atomic operations.  See
+    // chunked_transfer_run.
+    chunked_transfer * in_chunked_transfer[MAX_ENDPOINT_NUMBER + 1];
+    chunked_transfer * out_chunked_transfer[MAX_ENDPOINT_NUMBER + 1];
 };
 
 // Allocates memory structures and opens the device file, but does read or write
@@ -59,6 +115,9 @@ static libusbp_error * generic_handle_setup(
         new_handle->device = new_device;
         new_device = NULL;
 
+        generic_interface_get_setting(gi, &new_handle->interface_number,
+            &new_handle->configuration, &new_handle->alternate_setting);
+
         *handle = new_handle;
         new_handle = NULL;
     }
@@ -154,6 +213,20 @@ libusbp_error * libusbp_generic_handle_open(
         error = check_device_descriptor(new_handle);
     }
 
+    // Find out which optional usbfs features we can use.
+    if (error == NULL)
+    {
+        error = usbfd_get_capabilities(new_handle->fd, &new_handle->capabilities);
+    }
+
+    // Find out which endpoints are interrupt endpoints and how large their
+    // packets are.
+    if (error == NULL)
+    {
+        error = generic_handle_update_endpoint_info(new_handle,
+            new_handle->alternate_setting);
+    }
+
     // Pass the handle to the caller.
     if (error == NULL)
     {
@@ -169,6 +242,7 @@ void libusbp_generic_handle_close(libusbp_generic_handle * handle)
 {
     if (handle != NULL)
     {
+        libusbp_error_free(libusbp_generic_handle_stop_reaper_thread(handle));
         close(handle->fd);
         libusbp_device_free(handle->device);
         free(handle);
@@ -183,6 +257,29 @@ libusbp_error * libusbp_generic_handle_open_async_in_pipe(
     return async_in_pipe_create(handle, pipe_id, pipe);
 }
 
+libusbp_error * libusbp_generic_handle_open_async_out_pipe(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    libusbp_async_out_pipe ** pipe)
+{
+    return async_out_pipe_create(handle, pipe_id, pipe);
+}
+
+libusbp_error * libusbp_generic_handle_open_async_control_pipe(
+    libusbp_generic_handle * handle,
+    libusbp_async_control_pipe ** pipe)
+{
+    return async_control_pipe_create(handle, pipe);
+}
+
+libusbp_error * libusbp_generic_handle_open_iso_pipe(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    libusbp_iso_pipe ** pipe)
+{
+    return iso_pipe_create(handle, pipe_id, pipe);
+}
+
 libusbp_error * libusbp_generic_handle_set_timeout(
     libusbp_generic_handle * handle,
     uint8_t pipe_id,
@@ -206,17 +303,279 @@ libusbp_error * libusbp_generic_handle_set_timeout(
 
         if (pipe_id & 0x80)
         {
-            handle->in_timeout[endpoint_number] = timeout;
+            __atomic_store_n(&handle->in_timeout[endpoint_number], timeout,
+                __ATOMIC_RELAXED);
+        }
+        else
+        {
+            __atomic_store_n(&handle->out_timeout[endpoint_number], timeout,
+                __ATOMIC_RELAXED);
+        }
+    }
+
+    return error;
+}
+
+libusbp_error * generic_handle_check_transfer_flags(
+    const libusbp_generic_handle * handle, uint8_t pipe_id, uint32_t flags)
+{
+    assert(handle != NULL);
+
+    const uint32_t in_flags = LIBUSBP_TRANSFER_SHORT_NOT_OK |
+        LIBUSBP_TRANSFER_BULK_CONTINUATION;
+    const uint32_t out_flags = LIBUSBP_TRANSFER_ZERO_PACKET;
+
+    if (flags == 0) { return NULL; }
+
+    if (flags & ~(in_flags | out_flags))
+    {
+        return error_create("Invalid transfer flags: 0x%x.", flags);
+    }
+
+    if ((pipe_id & 0x80) && (flags & out_flags))
+    {
+        return error_create("The zero packet flag is only valid for OUT pipes.");
+    }
+
+    if (!(pipe_id & 0x80) && (flags & in_flags))
+    {
+        return error_create("The short-not-OK and bulk continuation flags "
+            "are only valid for IN pipes.");
+    }
+
+    if (generic_handle_get_endpoint_type(handle, pipe_id) != USB_ENDPOINT_XFER_BULK)
+    {
+        return error_create("Transfer flags are only supported for bulk endpoints.");
+    }
+
+    uint32_t required = (flags & in_flags) ? USBDEVFS_CAP_BULK_CONTINUATION
+        : USBDEVFS_CAP_ZERO_PACKET;
+    if (!(handle->capabilities & required))
+    {
+        return error_create("The kernel does not support the requested transfer flags.");
+    }
+
+    return NULL;
+}
+
+uint32_t generic_handle_get_pipe_flags(const libusbp_generic_handle * handle,
+    uint8_t pipe_id)
+{
+    assert(handle != NULL);
+
+    uint8_t endpoint_number = pipe_id & MAX_ENDPOINT_NUMBER;
+    if (pipe_id & 0x80)
+    {
+        return __atomic_load_n(&handle->in_flags[endpoint_number], __ATOMIC_RELAXED);
+    }
+    else
+    {
+        return __atomic_load_n(&handle->out_flags[endpoint_number], __ATOMIC_RELAXED);
+    }
+}
+
+unsigned int transfer_flags_to_urb_flags(uint32_t flags)
+{
+    unsigned int urb_flags = 0;
+    if (flags & LIBUSBP_TRANSFER_ZERO_PACKET)
+    {
+        urb_flags |= USBDEVFS_URB_ZERO_PACKET;
+    }
+    if (flags & LIBUSBP_TRANSFER_SHORT_NOT_OK)
+    {
+        urb_flags |= USBDEVFS_URB_SHORT_NOT_OK;
+    }
+    if (flags & LIBUSBP_TRANSFER_BULK_CONTINUATION)
+    {
+        urb_flags |= USBDEVFS_URB_BULK_CONTINUATION;
+    }
+    return urb_flags;
+}
+
+libusbp_error * libusbp_generic_handle_set_pipe_flags(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    uint32_t flags)
+{
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    libusbp_error * error = NULL;
+
+    if (error == NULL)
+    {
+        error = check_pipe_id(pipe_id);
+    }
+
+    if (error == NULL)
+    {
+        error = generic_handle_check_transfer_flags(handle, pipe_id, flags);
+    }
+
+    if (error == NULL)
+    {
+        uint8_t endpoint_number = pipe_id & MAX_ENDPOINT_NUMBER;
+
+        if (pipe_id & 0x80)
+        {
+            __atomic_store_n(&handle->in_flags[endpoint_number], flags,
+                __ATOMIC_RELAXED);
         }
         else
         {
-            handle->out_timeout[endpoint_number] = timeout;
+            __atomic_store_n(&handle->out_flags[endpoint_number], flags,
+                __ATOMIC_RELAXED);
         }
     }
 
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to set pipe flags.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_generic_handle_set_zero_copy(
+    libusbp_generic_handle * handle,
+    bool enabled)
+{
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    __atomic_store_n(&handle->zero_copy_disabled, !enabled, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+libusbp_error * libusbp_generic_handle_set_alternate_setting(
+    libusbp_generic_handle * handle,
+    uint8_t alternate_setting)
+{
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    libusbp_error * error = usbfd_set_interface(handle->fd,
+        handle->interface_number, alternate_setting);
+
+    if (error == NULL)
+    {
+        error = generic_handle_update_endpoint_info(handle, alternate_setting);
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to select alternate setting %u.",
+            alternate_setting);
+    }
+    return error;
+}
+
+uint32_t generic_handle_get_buffer_capabilities(const libusbp_generic_handle * handle)
+{
+    assert(handle != NULL);
+
+    uint32_t capabilities = handle->capabilities;
+    if (__atomic_load_n(&handle->zero_copy_disabled, __ATOMIC_RELAXED))
+    {
+        capabilities &= ~USBDEVFS_CAP_MMAP;
+    }
+    return capabilities;
+}
+
+static chunked_transfer ** generic_handle_chunked_transfer_slot(
+    libusbp_generic_handle * handle, uint8_t pipe_id)
+{
+    uint8_t endpoint_number = pipe_id & MAX_ENDPOINT_NUMBER;
+    if (pipe_id & 0x80)
+    {
+        return &handle->in_chunked_transfer[endpoint_number];
+    }
+    else
+    {
+        return &handle->out_chunked_transfer[endpoint_number];
+    }
+}
+
+void generic_handle_set_chunked_transfer(libusbp_generic_handle * handle,
+    uint8_t pipe_id, chunked_transfer * transfer)
+{
+    assert(handle != NULL);
+    __atomic_store_n(generic_handle_chunked_transfer_slot(handle, pipe_id),
+        transfer, __ATOMIC_RELEASE);
+}
+
+uint32_t generic_handle_get_capabilities(const libusbp_generic_handle * handle)
+{
+    assert(handle != NULL);
+    return handle->capabilities;
+}
+
+libusbp_error * generic_handle_update_endpoint_info(
+    libusbp_generic_handle * handle, uint8_t alternate_setting)
+{
+    assert(handle != NULL);
+
+    libusbp_error * error = usbfd_get_endpoint_info(handle->fd,
+        handle->configuration, handle->interface_number, alternate_setting,
+        handle->in_endpoint_type, handle->out_endpoint_type,
+        handle->in_max_packet_size, handle->out_max_packet_size);
+    if (error == NULL)
+    {
+        handle->alternate_setting = alternate_setting;
+    }
     return error;
 }
 
+uint8_t generic_handle_get_endpoint_type(const libusbp_generic_handle * handle,
+    uint8_t pipe_id)
+{
+    assert(handle != NULL);
+
+    uint8_t endpoint_number = pipe_id & MAX_ENDPOINT_NUMBER;
+    if (pipe_id & 0x80)
+    {
+        return handle->in_endpoint_type[endpoint_number];
+    }
+    else
+    {
+        return handle->out_endpoint_type[endpoint_number];
+    }
+}
+
+uint16_t generic_handle_get_max_packet_size(const libusbp_generic_handle * handle,
+    uint8_t pipe_id)
+{
+    assert(handle != NULL);
+
+    uint8_t endpoint_number = pipe_id & MAX_ENDPOINT_NUMBER;
+    if (pipe_id & 0x80)
+    {
+        return handle->in_max_packet_size[endpoint_number];
+    }
+    else
+    {
+        return handle->out_max_packet_size[endpoint_number];
+    }
+}
+
+uint8_t generic_handle_get_urb_type(const libusbp_generic_handle * handle,
+    uint8_t pipe_id)
+{
+    // The kernel would turn a bulk URB for an interrupt endpoint into an
+    // interrupt URB anyway, but we say what we mean.  Endpoints we know
+    // nothing about are treated as bulk endpoints, like before.
+    if (generic_handle_get_endpoint_type(handle, pipe_id) == USB_ENDPOINT_XFER_INT)
+    {
+        return USBDEVFS_URB_TYPE_INTERRUPT;
+    }
+    return USBDEVFS_URB_TYPE_BULK;
+}
+
 libusbp_error * libusbp_control_transfer(
     libusbp_generic_handle * handle,
     uint8_t bmRequestType,
@@ -245,7 +604,105 @@ libusbp_error * libusbp_control_transfer(
     setup.wLength = wLength;
 
     return usbfd_control_transfer(handle->fd, setup,
-        handle->out_timeout[0], data, transferred);
+        __atomic_load_n(&handle->out_timeout[0], __ATOMIC_RELAXED), data, transferred);
+}
+
+static uint32_t generic_handle_get_timeout(libusbp_generic_handle * handle,
+    uint8_t pipe_id)
+{
+    uint8_t endpoint_number = pipe_id & MAX_ENDPOINT_NUMBER;
+    if (pipe_id & 0x80)
+    {
+        return __atomic_load_n(&handle->in_timeout[endpoint_number], __ATOMIC_RELAXED);
+    }
+    else
+    {
+        return __atomic_load_n(&handle->out_timeout[endpoint_number], __ATOMIC_RELAXED);
+    }
+}
+
+// Performs a synchronous transfer on a bulk or interrupt endpoint, splitting
+// it into several URBs if that is possible.  The USBDEVFS_BULK ioctl cannot
+// take flags, so transfers with flags always use URBs.
+static libusbp_error * generic_handle_transfer(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    void * data,
+    size_t size,
+    uint32_t flags,
+    size_t * transferred)
+{
+    uint32_t timeout = generic_handle_get_timeout(handle, pipe_id);
+
+    if (size && (flags || chunked_transfer_is_suitable(handle, pipe_id, size)))
+    {
+        libusbp_iovec iov = { data, size };
+        return chunked_transfer_run(handle, pipe_id, timeout, flags,
+            &iov, 1, transferred);
+    }
+
+    return usbfd_bulk_or_interrupt_transfer(
+        handle->fd, pipe_id, timeout, data, size, transferred);
+}
+
+// Performs a synchronous transfer into or out of several pieces of memory.
+// If the pieces cannot be used directly, they are copied to or from a
+// temporary buffer.
+static libusbp_error * generic_handle_transfer_v(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    const libusbp_iovec * iov,
+    size_t iov_count,
+    size_t * transferred)
+{
+    size_t size;
+    libusbp_error * error = iovec_total_size(iov, iov_count, &size);
+    if (error != NULL)
+    {
+        return error;
+    }
+
+    uint32_t flags = generic_handle_get_pipe_flags(handle, pipe_id);
+
+    if (chunked_transfer_can_map(handle, pipe_id, iov, iov_count))
+    {
+        return chunked_transfer_run(handle, pipe_id,
+            generic_handle_get_timeout(handle, pipe_id), flags,
+            iov, iov_count, transferred);
+    }
+
+    uint8_t * new_buffer = NULL;
+    if (size)
+    {
+        new_buffer = malloc(size);
+        if (new_buffer == NULL)
+        {
+            return &error_no_memory;
+        }
+    }
+
+    if (!(pipe_id & 0x80))
+    {
+        iovec_gather(iov, iov_count, new_buffer, size);
+    }
+
+    size_t tmp_transferred = 0;
+    error = generic_handle_transfer(handle, pipe_id, new_buffer, size,
+        flags, &tmp_transferred);
+
+    // Data might have been transferred even if there was an error.
+    if (pipe_id & 0x80)
+    {
+        iovec_scatter(iov, iov_count, new_buffer, tmp_transferred);
+    }
+
+    if (transferred != NULL)
+    {
+        *transferred = tmp_transferred;
+    }
+
+    free(new_buffer);
+    return error;
 }
 
 libusbp_error * libusbp_read_pipe(
@@ -274,10 +731,8 @@ libusbp_error * libusbp_read_pipe(
 
     if (error == NULL)
     {
-        uint8_t endpoint_number = pipe_id & MAX_ENDPOINT_NUMBER;
-        uint32_t timeout = handle->in_timeout[endpoint_number];
-        error = usbfd_bulk_or_interrupt_transfer(
-            handle->fd, pipe_id, timeout, data, size, transferred);
+        error = generic_handle_transfer(handle, pipe_id, data, size,
+            generic_handle_get_pipe_flags(handle, pipe_id), transferred);
     }
 
     if (error != NULL)
@@ -313,10 +768,8 @@ libusbp_error * libusbp_write_pipe(
 
     if (error == NULL)
     {
-        uint8_t endpoint_number = pipe_id & MAX_ENDPOINT_NUMBER;
-        uint32_t timeout = handle->out_timeout[endpoint_number];
-        error = usbfd_bulk_or_interrupt_transfer(
-            handle->fd, pipe_id, timeout, (void *)data, size, transferred);
+        error = generic_handle_transfer(handle, pipe_id, (void *)data, size,
+            generic_handle_get_pipe_flags(handle, pipe_id), transferred);
     }
 
     if (error != NULL)
@@ -326,57 +779,674 @@ libusbp_error * libusbp_write_pipe(
     return error;
 }
 
-LIBUSBP_WARN_UNUSED
-static libusbp_error * handle_completed_urb(struct usbdevfs_urb * urb)
+libusbp_error * libusbp_read_pipe_with_flags(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    void * data,
+    size_t size,
+    uint32_t flags,
+    size_t * transferred)
 {
-    if (urb->usercontext == NULL)
+    if (transferred != NULL)
+    {
+        *transferred = 0;
+    }
+
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    libusbp_error * error = NULL;
+
+    if (error == NULL)
+    {
+        error = check_pipe_id_in(pipe_id);
+    }
+
+    if (error == NULL)
+    {
+        error = generic_handle_check_transfer_flags(handle, pipe_id, flags);
+    }
+
+    if (error == NULL)
+    {
+        error = generic_handle_transfer(handle, pipe_id, data, size, flags, transferred);
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to read from pipe.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_write_pipe_with_flags(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    const void * data,
+    size_t size,
+    uint32_t flags,
+    size_t * transferred)
+{
+    if (transferred != NULL)
+    {
+        *transferred = 0;
+    }
+
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    libusbp_error * error = NULL;
+
+    if (error == NULL)
+    {
+        error = check_pipe_id_out(pipe_id);
+    }
+
+    if (error == NULL)
+    {
+        error = generic_handle_check_transfer_flags(handle, pipe_id, flags);
+    }
+
+    if (error == NULL)
+    {
+        error = generic_handle_transfer(handle, pipe_id, (void *)data, size,
+            flags, transferred);
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to write to pipe.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_read_pipe_v(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    const libusbp_iovec * iov,
+    size_t iov_count,
+    size_t * transferred)
+{
+    if (transferred != NULL)
+    {
+        *transferred = 0;
+    }
+
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    libusbp_error * error = NULL;
+
+    if (error == NULL)
+    {
+        error = check_pipe_id_in(pipe_id);
+    }
+
+    if (error == NULL)
+    {
+        error = generic_handle_transfer_v(handle, pipe_id, iov, iov_count, transferred);
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to read from pipe.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_write_pipe_v(
+    libusbp_generic_handle * handle,
+    uint8_t pipe_id,
+    const libusbp_iovec * iov,
+    size_t iov_count,
+    size_t * transferred)
+{
+    if (transferred != NULL)
+    {
+        *transferred = 0;
+    }
+
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    libusbp_error * error = NULL;
+
+    if (error == NULL)
+    {
+        error = check_pipe_id_out(pipe_id);
+    }
+
+    if (error == NULL)
+    {
+        error = generic_handle_transfer_v(handle, pipe_id, iov, iov_count, transferred);
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to write to pipe.");
+    }
+    return error;
+}
+
+LIBUSBP_WARN_UNUSED
+static libusbp_error * handle_completed_urb(libusbp_generic_handle * handle,
+    struct usbdevfs_urb * urb)
+{
+    if (urb->usercontext == NULL)
     {
         return error_create("A completed USB request block has a NULL usercontext.");
     }
 
-    if (urb->type == USBDEVFS_URB_TYPE_BULK && (urb->endpoint & 0x80))
+    bool bulk_or_interrupt = urb->type == USBDEVFS_URB_TYPE_BULK ||
+        urb->type == USBDEVFS_URB_TYPE_INTERRUPT;
+
+    // Each endpoint has its own chunked transfer, so synchronous transfers on
+    // different endpoints can run at the same time.
+    chunked_transfer * chunked = NULL;
+    if (urb->type == USBDEVFS_URB_TYPE_BULK)
+    {
+        chunked = __atomic_load_n(
+            generic_handle_chunked_transfer_slot(handle, urb->endpoint),
+            __ATOMIC_ACQUIRE);
+    }
+
+    if (chunked != NULL && urb->usercontext == chunked)
+    {
+        chunked_transfer_handle_completion(chunked, urb);
+        return NULL;
+    }
+    else if (bulk_or_interrupt && (urb->endpoint & 0x80))
     {
         async_in_transfer * transfer = urb->usercontext;
         async_in_transfer_handle_completion(transfer);
         return NULL;
     }
+    else if (bulk_or_interrupt)
+    {
+        async_out_transfer * transfer = urb->usercontext;
+        async_out_transfer_handle_completion(transfer);
+        return NULL;
+    }
+    else if (urb->type == USBDEVFS_URB_TYPE_CONTROL)
+    {
+        async_control_transfer * transfer = urb->usercontext;
+        async_control_transfer_handle_completion(transfer);
+        return NULL;
+    }
+    else if (urb->type == USBDEVFS_URB_TYPE_ISO)
+    {
+        iso_transfer * transfer = urb->usercontext;
+        iso_transfer_handle_completion(transfer);
+        return NULL;
+    }
     else
     {
         return error_create("A completed USB request block was unrecognized.");
     }
 }
 
-libusbp_error * generic_handle_events(libusbp_generic_handle * handle)
+static long futex(uint32_t * word, int op, uint32_t value,
+    const struct timespec * timeout)
 {
-    if (handle == NULL)
+    return syscall(SYS_futex, word, op, value, timeout, NULL, 0);
+}
+
+// Tells the threads sleeping in generic_handle_wait_until that URBs were
+// reaped, or that the thread that was reaping URBs has stopped.
+static void generic_handle_wake_sleepers(libusbp_generic_handle * handle)
+{
+    __atomic_add_fetch(&handle->wake_count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&handle->sleepers, __ATOMIC_SEQ_CST))
     {
-        return error_create("Generic handle argument is null.");
+        futex(&handle->wake_count, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+    }
+}
+
+// Sleeps until generic_handle_wake_sleepers is called or the timeout (in
+// milliseconds, -1 for forever) elapses.  wake_count is the value the caller
+// read before deciding to sleep, so we return right away if anything happened
+// since then.
+static void generic_handle_sleep(libusbp_generic_handle * handle,
+    uint32_t wake_count, int timeout)
+{
+    struct timespec ts;
+    if (timeout >= 0)
+    {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (long)(timeout % 1000) * 1000000;
     }
 
+    __atomic_add_fetch(&handle->sleepers, 1, __ATOMIC_SEQ_CST);
+    futex(&handle->wake_count, FUTEX_WAIT_PRIVATE, wake_count,
+        timeout >= 0 ? &ts : NULL);
+    __atomic_sub_fetch(&handle->sleepers, 1, __ATOMIC_SEQ_CST);
+}
+
+static libusbp_error * generic_handle_reap_urbs(libusbp_generic_handle * handle)
+{
+    assert(handle != NULL);
+
+    libusbp_error * error = NULL;
+    size_t reaped = 0;
     while(true)
     {
         struct usbdevfs_urb * urb;
-        libusbp_error * error = usbfd_reap_urb(handle->fd, &urb);
+        error = usbfd_reap_urb(handle->fd, &urb);
         if (error != NULL)
         {
             // There was some problem, like the device being disconnected.
-            return error;
+            break;
         }
 
         if (urb == NULL)
         {
             // No more URBs left to reap.
+            break;
+        }
+
+        reaped++;
+        error = handle_completed_urb(handle, urb);
+        if (error != NULL)
+        {
+            break;
+        }
+    }
+
+    if (reaped)
+    {
+        // Some of the URBs might belong to transfers that other threads are
+        // waiting for.
+        __atomic_add_fetch(&handle->reap_count, 1, __ATOMIC_RELEASE);
+        generic_handle_wake_sleepers(handle);
+    }
+    return error;
+}
+
+libusbp_error * generic_handle_events(libusbp_generic_handle * handle)
+{
+    if (handle == NULL)
+    {
+        return error_create("Generic handle argument is null.");
+    }
+
+    if (handle->reaper_running)
+    {
+        // The reaper thread reaps the URBs, so we just need to report the
+        // error that made it stop, if there was one.
+        libusbp_error * error = __atomic_load_n(&handle->reaper_error, __ATOMIC_ACQUIRE);
+        return libusbp_error_copy(error);
+    }
+
+    bool expected = false;
+    if (!__atomic_compare_exchange_n(&handle->reaping, &expected, true,
+        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        // Another thread is reaping URBs right now, in
+        // generic_handle_wait_until, and it will handle them soon.  If we
+        // reaped them instead, it could keep waiting for URBs that are gone.
+        return NULL;
+    }
+
+    libusbp_error * error = generic_handle_reap_urbs(handle);
+    __atomic_store_n(&handle->reaping, false, __ATOMIC_SEQ_CST);
+    generic_handle_wake_sleepers(handle);
+    return error;
+}
+
+libusbp_error * generic_handle_join_event_loop(libusbp_generic_handle * handle)
+{
+    assert(handle != NULL);
+
+    // The event loop is told that the device file is ready whenever there are
+    // URBs to reap, so if another thread reaps them instead, the loop would
+    // keep waking up without making progress.
+    if (handle->reaper_running)
+    {
+        return error_create("A handle with a reaper thread cannot be added to "
+            "an event loop.");
+    }
+
+    handle->event_loop_count++;
+    return NULL;
+}
+
+void generic_handle_leave_event_loop(libusbp_generic_handle * handle)
+{
+    assert(handle != NULL);
+    assert(handle->event_loop_count != 0);
+    handle->event_loop_count--;
+}
+
+static void * reaper_thread_main(void * context)
+{
+    libusbp_generic_handle * handle = context;
+
+    struct pollfd fds[2] = {
+        { .fd = handle->fd, .events = POLLOUT },
+        { .fd = handle->reaper_stop_fd, .events = POLLIN },
+    };
+
+    while(true)
+    {
+        libusbp_error * error = NULL;
+
+        int result = poll(fds, 2, -1);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result < 0)
+        {
+            error = error_create_errno("Failed to wait for asynchronous transfers.");
+        }
+
+        if (error == NULL && fds[1].revents)
+        {
+            // We were asked to stop.
+            return NULL;
+        }
+
+        if (error == NULL && fds[0].revents)
+        {
+            error = generic_handle_reap_urbs(handle);
+        }
+
+        if (error != NULL)
+        {
+            error = error_add(error, "The reaper thread stopped because of an error.");
+            __atomic_store_n(&handle->reaper_error, error, __ATOMIC_RELEASE);
+        }
+
+        if (error != NULL)
+        {
+            // Wake up the threads waiting for transfers so they can report
+            // the error.
+            generic_handle_wake_sleepers(handle);
+            return NULL;
+        }
+    }
+}
+
+libusbp_error * libusbp_generic_handle_start_reaper_thread(
+    libusbp_generic_handle * handle)
+{
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    if (handle->reaper_running)
+    {
+        return error_create("The reaper thread is already running.");
+    }
+
+    if (handle->event_loop_count != 0)
+    {
+        return error_create("A handle in an event loop cannot have a reaper thread.");
+    }
+
+    libusbp_error * error = NULL;
+
+    int new_stop_fd = -1;
+    if (error == NULL)
+    {
+        new_stop_fd = eventfd(0, EFD_CLOEXEC);
+        if (new_stop_fd == -1)
+        {
+            error = error_create_errno("Failed to create eventfd.");
+        }
+    }
+
+    if (error == NULL)
+    {
+        handle->reaper_stop_fd = new_stop_fd;
+        handle->reaper_error = NULL;
+
+        int result = pthread_create(&handle->reaper_thread, NULL,
+            reaper_thread_main, handle);
+        if (result != 0)
+        {
+            error = error_create("Error code %d.", result);
+        }
+    }
+
+    if (error == NULL)
+    {
+        handle->reaper_running = true;
+        new_stop_fd = -1;
+    }
+
+    if (new_stop_fd != -1) { close(new_stop_fd); }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to start reaper thread.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_generic_handle_stop_reaper_thread(
+    libusbp_generic_handle * handle)
+{
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    if (!handle->reaper_running)
+    {
+        return NULL;
+    }
+
+    libusbp_error * error = NULL;
+
+    if (eventfd_write(handle->reaper_stop_fd, 1) == -1)
+    {
+        error = error_create_errno("Failed to stop reaper thread.");
+    }
+
+    if (error == NULL)
+    {
+        pthread_join(handle->reaper_thread, NULL);
+
+        close(handle->reaper_stop_fd);
+        libusbp_error_free(handle->reaper_error);
+        handle->reaper_error = NULL;
+        handle->reaper_running = false;
+    }
+
+    return error;
+}
+
+uint64_t get_time_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+uint64_t get_time_ns(clockid_t clock)
+{
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+typedef struct reap_wait
+{
+    libusbp_generic_handle * handle;
+    uint32_t reap_count;
+} reap_wait;
+
+static bool generic_handle_reaped_since(void * context)
+{
+    reap_wait * wait = context;
+    return __atomic_load_n(&wait->handle->reap_count, __ATOMIC_ACQUIRE) !=
+        wait->reap_count;
+}
+
+// Waits until the done function returns true or the timeout elapses, reaping
+// URBs in the meantime.  If done is NULL, this returns after the next batch of
+// URBs is reaped.
+//
+// Any number of threads can call this at once.  One of them polls the device
+// file and reaps the URBs, which might include URBs that the other threads are
+// waiting for, so it wakes them up afterwards.  When the reaper thread is
+// running, it does the reaping and every caller just sleeps.
+libusbp_error * generic_handle_wait_until(libusbp_generic_handle * handle,
+    uint32_t timeout, bool (* done)(void * context), void * context)
+{
+    assert(handle != NULL);
+
+    reap_wait wait;
+    if (done == NULL)
+    {
+        wait.handle = handle;
+        wait.reap_count = __atomic_load_n(&handle->reap_count, __ATOMIC_ACQUIRE);
+        done = generic_handle_reaped_since;
+        context = &wait;
+    }
+
+    uint64_t start = get_time_ms();
+
+    while(true)
+    {
+        // Read the count before checking whether we are done so that we do not
+        // sleep through URBs that are reaped after the check.
+        uint32_t wake_count = __atomic_load_n(&handle->wake_count, __ATOMIC_SEQ_CST);
+
+        if (done(context))
+        {
             return NULL;
         }
 
-        error = handle_completed_urb(urb);
+        if (handle->reaper_running)
+        {
+            // Report the error that stopped the reaper thread, if any.
+            libusbp_error * error = generic_handle_events(handle);
+            if (error != NULL)
+            {
+                return error;
+            }
+        }
+
+        int poll_timeout = -1;
+        if (timeout != 0)
+        {
+            uint64_t elapsed = get_time_ms() - start;
+            if (elapsed >= timeout)
+            {
+                return NULL;
+            }
+            uint64_t remaining = timeout - elapsed;
+            poll_timeout = remaining > INT_MAX ? INT_MAX : (int)remaining;
+        }
+
+        bool expected = false;
+        if (handle->reaper_running ||
+            !__atomic_compare_exchange_n(&handle->reaping, &expected, true,
+                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            generic_handle_sleep(handle, wake_count, poll_timeout);
+            continue;
+        }
+
+        bool ready;
+        libusbp_error * error = usbfd_wait(handle->fd, poll_timeout, &ready);
+        if (error == NULL && ready)
+        {
+            error = generic_handle_reap_urbs(handle);
+        }
+
+        // Let a sleeping thread take over the polling if it still needs to.
+        __atomic_store_n(&handle->reaping, false, __ATOMIC_SEQ_CST);
+        generic_handle_wake_sleepers(handle);
+
         if (error != NULL)
         {
             return error;
         }
     }
+}
 
-    return NULL;
+void generic_handle_drain(libusbp_generic_handle * handle,
+    bool (* done)(void * context), void * context)
+{
+    assert(handle != NULL);
+    assert(done != NULL);
+
+    while(true)
+    {
+        uint32_t wake_count = __atomic_load_n(&handle->wake_count, __ATOMIC_SEQ_CST);
+
+        if (done(context))
+        {
+            return;
+        }
+
+        // A reaper thread that has not reported an error is still reaping, but
+        // one that has is gone, so we reap the URBs ourselves.  We still take
+        // turns with other threads calling generic_handle_wait_until so that
+        // URBs are only handled by one thread at a time.
+        bool reaper_working = handle->reaper_running &&
+            __atomic_load_n(&handle->reaper_error, __ATOMIC_ACQUIRE) == NULL;
+        bool expected = false;
+        if (reaper_working ||
+            !__atomic_compare_exchange_n(&handle->reaping, &expected, true,
+                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            generic_handle_sleep(handle, wake_count, 100);
+            continue;
+        }
+
+        bool ready;
+        libusbp_error * error = usbfd_wait(handle->fd, 100, &ready);
+        if (error == NULL && ready)
+        {
+            error = generic_handle_reap_urbs(handle);
+        }
+
+        __atomic_store_n(&handle->reaping, false, __ATOMIC_SEQ_CST);
+        generic_handle_wake_sleepers(handle);
+
+        if (error != NULL)
+        {
+            // The kernel only writes to an URB when it is reaped, and it
+            // throws away the URBs of a device that was removed, so if the
+            // device is gone, nothing will touch the URBs any more.
+            bool removed = libusbp_error_has_code(error,
+                LIBUSBP_ERROR_DEVICE_DISCONNECTED);
+            libusbp_error_free(error);
+            if (removed)
+            {
+                return;
+            }
+
+            // Do not spin if the error keeps happening.
+            wake_count = __atomic_load_n(&handle->wake_count, __ATOMIC_SEQ_CST);
+            generic_handle_sleep(handle, wake_count, 10);
+        }
+    }
+}
+
+libusbp_error * libusbp_generic_handle_wait(
+    libusbp_generic_handle * handle,
+    uint32_t timeout)
+{
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    return generic_handle_wait_until(handle, timeout, NULL, NULL);
 }
 
 int libusbp_generic_handle_get_fd(libusbp_generic_handle * handle)
@@ -13,10 +13,8 @@ struct libusbp_generic_interface
     char * filename;
 };
 
-libusbp_error * check_driver_installation(struct udev_device * device)
+libusbp_error * check_driver_name(const char * driver_name)
 {
-    assert(device != NULL);
-    const char * driver_name = udev_device_get_driver(device);
     if (driver_name != NULL && strcmp(driver_name, "usbfs") && strcmp(driver_name, "cp210x"))
     {
         return error_create("Device is attached to an incorrect driver: %s.", driver_name);
@@ -24,7 +22,87 @@ libusbp_error * check_driver_installation(struct udev_device * device)
     return NULL;
 }
 
+#ifdef LIBUSBP_USE_UDEV
+static libusbp_error * check_driver_installation(struct udev_device * device)
+{
+    assert(device != NULL);
+    return check_driver_name(udev_device_get_driver(device));
+}
+
+// Finds the syspath of an interface and the filename of its device using udev.
+static libusbp_error * find_interface_with_udev(libusbp_context * context,
+    const char * device_syspath, uint8_t interface_number,
+    char ** interface_syspath, char ** filename)
+{
+    libusbp_error * error = NULL;
+
+    // Get a udev context.
+    struct udev * new_udev = NULL;
+    if (error == NULL)
+    {
+        error = context_get_udev(context, &new_udev);
+    }
+
+    // Get the device for the interface.
+    struct udev_device * new_dev = NULL;
+    if (error == NULL)
+    {
+        error = udevw_get_interface(new_udev, device_syspath,
+            interface_number, &new_dev);
+    }
+
+    // Make sure it is not attached to a kernel driver.
+    // Note: This step might be inappropriate, since libusbp can operate
+    // on some devices that are attached to a kernel driver, like the cp210x
+    // driver.
+    if (error == NULL)
+    {
+        error = check_driver_installation(new_dev);
+    }
+
+    // Get the syspath of the interface.
+    char * new_interface_syspath = NULL;
+    if (error == NULL)
+    {
+        error = udevw_get_syspath_copy(new_dev, &new_interface_syspath);
+    }
+
+    // Get the filename.
+    char * new_filename = NULL;
+    if (error == NULL)
+    {
+        error = udevw_get_devnode_copy_from_syspath(new_udev,
+            device_syspath, &new_filename);
+    }
+
+    if (error == NULL)
+    {
+        *interface_syspath = new_interface_syspath;
+        *filename = new_filename;
+        new_interface_syspath = NULL;
+        new_filename = NULL;
+    }
+
+    libusbp_string_free(new_filename);
+    libusbp_string_free(new_interface_syspath);
+    if (new_dev != NULL) { udev_device_unref(new_dev); }
+    if (new_udev != NULL) { udev_unref(new_udev); }
+    return error;
+}
+#endif
+
 libusbp_error * libusbp_generic_interface_create(
+    const libusbp_device * device,
+    uint8_t interface_number,
+    bool composite,
+    libusbp_generic_interface ** gi)
+{
+    return libusbp_generic_interface_create_ctx(NULL, device,
+        interface_number, composite, gi);
+}
+
+libusbp_error * libusbp_generic_interface_create_ctx(
+    libusbp_context * context,
     const libusbp_device * device,
     uint8_t interface_number,
     bool composite __attribute__((unused)),
@@ -67,42 +145,23 @@ libusbp_error * libusbp_generic_interface_create(
         error = libusbp_device_get_os_id(new_device, &new_device_syspath);
     }
 
-    // Get a udev context.
-    struct udev * new_udev = NULL;
-    if (error == NULL)
-    {
-        error = udevw_create_context(&new_udev);
-    }
-
-    // Get the device for the interface.
-    struct udev_device * new_dev = NULL;
-    if (error == NULL)
-    {
-        error = udevw_get_interface(new_udev, new_device_syspath,
-            interface_number, &new_dev);
-    }
-
-    // Make sure it is not attached to a kernel driver.
-    // Note: This step might be inappropriate, since libusbp can operate
-    // on some devices that are attached to a kernel driver, like the cp210x
-    // driver.
-    if (error == NULL)
-    {
-        error = check_driver_installation(new_dev);
-    }
-
-    // Get the syspath of the interface.
+    // Find the interface and the filename of the device.
     char * new_interface_syspath = NULL;
-    if (error == NULL)
-    {
-        error = udevw_get_syspath_copy(new_dev, &new_interface_syspath);
-    }
-
-    // Get the filename.
     char * new_filename = NULL;
     if (error == NULL)
     {
-        error = udevw_get_devnode_copy_from_syspath(new_device_syspath, &new_filename);
+        if (context_get_sysfs_root(context) != NULL)
+        {
+            error = sysfs_find_generic_interface(new_device_syspath,
+                interface_number, &new_interface_syspath, &new_filename);
+        }
+        #ifdef LIBUSBP_USE_UDEV
+        else
+        {
+            error = find_interface_with_udev(context, new_device_syspath,
+                interface_number, &new_interface_syspath, &new_filename);
+        }
+        #endif
     }
 
     // Check that the file exists yet, but don't check to see if we have permission
@@ -141,8 +200,6 @@ libusbp_error * libusbp_generic_interface_create(
     libusbp_string_free(new_device_syspath);
     libusbp_device_free(new_device);
     free(new_gi);
-    if (new_dev != NULL) { udev_device_unref(new_dev); }
-    if (new_udev != NULL) { udev_unref(new_udev); }
     return error;
 }
 
@@ -274,3 +331,40 @@ libusbp_error * generic_interface_get_device_copy(
     assert(device != NULL);
     return libusbp_device_copy(gi->device, device);
 }
+
+void generic_interface_get_setting(const libusbp_generic_interface * gi,
+    uint8_t * interface_number, uint8_t * configuration,
+    uint8_t * alternate_setting)
+{
+    assert(gi != NULL);
+    assert(interface_number != NULL);
+    assert(configuration != NULL);
+    assert(alternate_setting != NULL);
+
+    *interface_number = gi->interface_number;
+    *configuration = 0;
+    *alternate_setting = 0;
+
+    // The kernel names interfaces like "1-2:1.0", where the number after the
+    // colon is the configuration.
+    const char * name = strrchr(gi->syspath, ':');
+    if (name != NULL)
+    {
+        sscanf(name + 1, "%hhu.", configuration);
+    }
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/bAlternateSetting", gi->syspath);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd != -1)
+    {
+        char str[8];
+        ssize_t length = read(fd, str, sizeof(str) - 1);
+        close(fd);
+        if (length > 0)
+        {
+            str[length] = 0;
+            sscanf(str, "%hhu", alternate_setting);
+        }
+    }
+}
@@ -0,0 +1,683 @@
+/* A hotplug monitor receives events from udev when USB devices and serial
+ * ports are added or removed, so that a program does not need to list all of
+ * the devices repeatedly to notice changes.  The events come from udev after
+ * it has finished applying its rules, so added devices are initialized and
+ * ready to use, just like the devices that libusbp_list_connected_devices
+ * returns.
+ *
+ * A monitor made with a sysfs context (libusbp_context_create_sysfs), or any
+ * monitor if libusbp was built without libudev (LIBUSBP_USE_UDEV), receives
+ * the kernel's uevents directly from a netlink socket instead.  Those arrive
+ * before udev has run its rules, and the ones for removed devices do not
+ * include the serial number, so the monitor remembers the serial numbers of
+ * the devices that were connected when it was created or added later. */
+
+#include <libusbp_internal.h>
+
+struct libusbp_hotplug_monitor
+{
+    #ifdef LIBUSBP_USE_UDEV
+    // Used for udev contexts.
+    struct udev * udev;
+    struct udev_monitor * monitor;
+    #endif
+
+    // Used for sysfs contexts.
+    char * sysfs_root;
+    int netlink_fd;
+    hotplug_serial_number * serial_numbers;
+};
+
+struct hotplug_serial_number
+{
+    char * syspath;
+    char * serial_number;
+    hotplug_serial_number * next;
+};
+
+static hotplug_serial_number ** serial_numbers_find(hotplug_serial_number ** list,
+    const char * syspath)
+{
+    while (*list != NULL && strcmp((*list)->syspath, syspath) != 0)
+    {
+        list = &(*list)->next;
+    }
+    return list;
+}
+
+static void serial_numbers_forget(hotplug_serial_number ** list, const char * syspath)
+{
+    hotplug_serial_number ** link = serial_numbers_find(list, syspath);
+    hotplug_serial_number * entry = *link;
+    if (entry == NULL) { return; }
+
+    *link = entry->next;
+    free(entry->syspath);
+    free(entry->serial_number);
+    free(entry);
+}
+
+// Remembers the serial number of a device, if it has one.
+static libusbp_error * serial_numbers_remember(hotplug_serial_number ** list,
+    const libusbp_device * device)
+{
+    const char * syspath;
+    const char * serial_number;
+    device_peek_strings(device, &syspath, &serial_number);
+
+    // A device with the same syspath might have been unplugged while we were
+    // not looking.
+    serial_numbers_forget(list, syspath);
+
+    if (serial_number == NULL) { return NULL; }
+
+    libusbp_error * error = NULL;
+
+    hotplug_serial_number * entry = calloc(1, sizeof(hotplug_serial_number));
+    if (entry == NULL)
+    {
+        error = &error_no_memory;
+    }
+
+    if (error == NULL)
+    {
+        error = string_copy(syspath, &entry->syspath);
+    }
+
+    if (error == NULL)
+    {
+        error = string_copy(serial_number, &entry->serial_number);
+    }
+
+    if (error == NULL)
+    {
+        entry->next = *list;
+        *list = entry;
+        entry = NULL;
+    }
+
+    if (entry != NULL)
+    {
+        free(entry->syspath);
+        free(entry);
+    }
+    return error;
+}
+
+libusbp_error * hotplug_serial_numbers_fill(const char * sysfs_root,
+    hotplug_serial_number ** list)
+{
+    assert(sysfs_root != NULL);
+    assert(list != NULL);
+
+    libusbp_device ** device_list = NULL;
+    size_t device_count = 0;
+    libusbp_error * error = sysfs_list_devices(sysfs_root, NULL, 0,
+        &device_list, &device_count);
+
+    for (size_t i = 0; error == NULL && i < device_count; i++)
+    {
+        error = serial_numbers_remember(list, device_list[i]);
+    }
+
+    free_devices_and_list(device_list);
+    return error;
+}
+
+void hotplug_serial_numbers_free(hotplug_serial_number * list)
+{
+    while (list != NULL)
+    {
+        hotplug_serial_number * next = list->next;
+        free(list->syspath);
+        free(list->serial_number);
+        free(list);
+        list = next;
+    }
+}
+
+// Opens a non-blocking socket that receives the kernel's uevents.
+static libusbp_error * netlink_open(int * fd)
+{
+    assert(fd != NULL);
+
+    *fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+        NETLINK_KOBJECT_UEVENT);
+    if (*fd == -1)
+    {
+        return error_create_errno("Failed to create a netlink socket.");
+    }
+
+    // Group 1 is the kernel's uevents.  udev sends its own events to group 2.
+    struct sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = 1;
+    if (bind(*fd, (struct sockaddr *)&address, sizeof(address)) == -1)
+    {
+        libusbp_error * error = error_create_errno("Failed to bind a netlink socket.");
+        close(*fd);
+        *fd = -1;
+        return error;
+    }
+
+    return NULL;
+}
+
+#ifdef LIBUSBP_USE_UDEV
+// Starts receiving events from udev.
+static libusbp_error * start_udev_monitor(libusbp_hotplug_monitor * monitor,
+    libusbp_context * context)
+{
+    libusbp_error * error = NULL;
+
+    if (error == NULL)
+    {
+        error = context_get_udev(context, &monitor->udev);
+    }
+
+    if (error == NULL)
+    {
+        monitor->monitor = udev_monitor_new_from_netlink(monitor->udev, "udev");
+        if (monitor->monitor == NULL)
+        {
+            error = error_create("Failed to create a udev monitor.");
+        }
+    }
+
+    if (error == NULL)
+    {
+        int result = udev_monitor_filter_add_match_subsystem_devtype(
+            monitor->monitor, "usb", "usb_device");
+        if (result != 0)
+        {
+            error = error_create_udev(result, "Failed to add a subsystem match.");
+        }
+    }
+
+    if (error == NULL)
+    {
+        int result = udev_monitor_filter_add_match_subsystem_devtype(
+            monitor->monitor, "tty", NULL);
+        if (result != 0)
+        {
+            error = error_create_udev(result, "Failed to add a subsystem match.");
+        }
+    }
+
+    if (error == NULL)
+    {
+        int result = udev_monitor_enable_receiving(monitor->monitor);
+        if (result != 0)
+        {
+            error = error_create_udev(result, "Failed to start receiving udev events.");
+        }
+    }
+
+    return error;
+}
+#endif
+
+// Starts receiving the kernel's uevents directly.
+static libusbp_error * start_kernel_monitor(libusbp_hotplug_monitor * monitor,
+    const char * sysfs_root)
+{
+    libusbp_error * error = NULL;
+
+    if (error == NULL)
+    {
+        error = string_copy(sysfs_root, &monitor->sysfs_root);
+    }
+
+    if (error == NULL)
+    {
+        error = netlink_open(&monitor->netlink_fd);
+    }
+
+    // Devices that are added after this are remembered when their events
+    // are received.
+    if (error == NULL)
+    {
+        error = hotplug_serial_numbers_fill(sysfs_root, &monitor->serial_numbers);
+    }
+
+    return error;
+}
+
+libusbp_error * libusbp_hotplug_monitor_create(libusbp_context * context,
+    libusbp_hotplug_monitor ** monitor)
+{
+    if (monitor == NULL)
+    {
+        return error_create("Hotplug monitor output pointer is null.");
+    }
+
+    *monitor = NULL;
+
+    libusbp_error * error = NULL;
+
+    libusbp_hotplug_monitor * new_monitor = NULL;
+    if (error == NULL)
+    {
+        new_monitor = calloc(1, sizeof(libusbp_hotplug_monitor));
+        if (new_monitor == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    if (error == NULL)
+    {
+        new_monitor->netlink_fd = -1;
+
+        const char * sysfs_root = context_get_sysfs_root(context);
+        if (sysfs_root != NULL)
+        {
+            error = start_kernel_monitor(new_monitor, sysfs_root);
+        }
+        #ifdef LIBUSBP_USE_UDEV
+        else
+        {
+            error = start_udev_monitor(new_monitor, context);
+        }
+        #endif
+    }
+
+    if (error == NULL)
+    {
+        *monitor = new_monitor;
+        new_monitor = NULL;
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to create hotplug monitor.");
+    }
+
+    libusbp_hotplug_monitor_free(new_monitor);
+    return error;
+}
+
+void libusbp_hotplug_monitor_free(libusbp_hotplug_monitor * monitor)
+{
+    if (monitor == NULL) { return; }
+
+    #ifdef LIBUSBP_USE_UDEV
+    if (monitor->monitor != NULL) { udev_monitor_unref(monitor->monitor); }
+    if (monitor->udev != NULL) { udev_unref(monitor->udev); }
+    #endif
+    if (monitor->netlink_fd != -1) { close(monitor->netlink_fd); }
+    hotplug_serial_numbers_free(monitor->serial_numbers);
+    free(monitor->sysfs_root);
+    free(monitor);
+}
+
+int libusbp_hotplug_monitor_get_fd(libusbp_hotplug_monitor * monitor)
+{
+    if (monitor == NULL) { return -1; }
+    #ifdef LIBUSBP_USE_UDEV
+    if (monitor->monitor != NULL) { return udev_monitor_get_fd(monitor->monitor); }
+    #endif
+    return monitor->netlink_fd;
+}
+
+libusbp_error * hotplug_uevent_convert(const hotplug_uevent * uevent,
+    uint32_t * event, libusbp_device ** device)
+{
+    assert(uevent != NULL);
+    assert(event != NULL);
+    assert(device != NULL);
+
+    *event = 0;
+    *device = NULL;
+
+    const char * action = uevent->action;
+    const char * subsystem = uevent->subsystem;
+    if (action == NULL || subsystem == NULL || uevent->syspath == NULL) { return NULL; }
+
+    bool added = strcmp(action, "add") == 0;
+    bool removed = strcmp(action, "remove") == 0;
+    if (!added && !removed) { return NULL; }
+
+    // Skip devices that have not been initialized yet, for the same reason
+    // that add_udev_device_to_list_if_needed does.
+    if (added && !uevent->initialized) { return NULL; }
+
+    if (strcmp(subsystem, "usb") == 0)
+    {
+        // Interfaces are in the same subsystem as devices.
+        if (uevent->devtype == NULL || strcmp(uevent->devtype, "usb_device") != 0)
+        {
+            return NULL;
+        }
+
+        *event = added ? LIBUSBP_HOTPLUG_DEVICE_ADDED : LIBUSBP_HOTPLUG_DEVICE_REMOVED;
+        if (added)
+        {
+            return uevent->create_device(uevent->context, device);
+        }
+
+        // The device's directory is gone, so all we know is in the event.
+        return device_create_from_properties(uevent->syspath,
+            uevent->get_property(uevent->context, "PRODUCT"),
+            uevent->get_property(uevent->context, "ID_SERIAL_SHORT"),
+            device);
+    }
+
+    if (strcmp(subsystem, "tty") == 0)
+    {
+        // Serial ports are reported along with the USB device they belong to.
+        // If the USB device was removed, its parent cannot be found anymore,
+        // so we skip the event and rely on the device's own remove event.
+        libusbp_device * parent = NULL;
+        libusbp_error * error = uevent->create_parent_device(uevent->context, &parent);
+        if (error != NULL || parent == NULL) { return error; }
+
+        *event = added ? LIBUSBP_HOTPLUG_SERIAL_PORT_ADDED :
+            LIBUSBP_HOTPLUG_SERIAL_PORT_REMOVED;
+        *device = parent;
+        return NULL;
+    }
+
+    return NULL;
+}
+
+#ifdef LIBUSBP_USE_UDEV
+static const char * udev_event_get_property(void * context, const char * key)
+{
+    return udev_device_get_property_value(context, key);
+}
+
+static libusbp_error * udev_event_create_device(void * context,
+    libusbp_device ** device)
+{
+    return device_create(context, device);
+}
+
+static libusbp_error * udev_event_create_parent_device(void * context,
+    libusbp_device ** device)
+{
+    // The parent is owned by the child, so we do not unref it.
+    struct udev_device * parent = udev_device_get_parent_with_subsystem_devtype(
+        context, "usb", "usb_device");
+    if (parent == NULL) { return NULL; }
+    return device_create(parent, device);
+}
+
+// Converts a udev event into one of our events, like hotplug_uevent_convert.
+static libusbp_error * convert_udev_event(struct udev_device * dev,
+    uint32_t * event, libusbp_device ** device)
+{
+    assert(dev != NULL);
+
+    hotplug_uevent uevent = {
+        .action = udev_device_get_action(dev),
+        .subsystem = udev_device_get_subsystem(dev),
+        .devtype = udev_device_get_devtype(dev),
+        .syspath = udev_device_get_syspath(dev),
+        .initialized = udev_device_get_is_initialized(dev),
+        .get_property = udev_event_get_property,
+        .create_device = udev_event_create_device,
+        .create_parent_device = udev_event_create_parent_device,
+        .context = dev,
+    };
+    return hotplug_uevent_convert(&uevent, event, device);
+}
+
+static libusbp_error * receive_udev_event(libusbp_hotplug_monitor * monitor,
+    uint32_t * event, libusbp_device ** device)
+{
+    // The socket is non-blocking, so this returns NULL when there are no
+    // more events.  Events we do not report are skipped.
+    struct udev_device * dev;
+    while ((dev = udev_monitor_receive_device(monitor->monitor)) != NULL)
+    {
+        uint32_t new_event;
+        libusbp_device * new_device;
+        libusbp_error * error = convert_udev_event(dev, &new_event, &new_device);
+        udev_device_unref(dev);
+
+        if (error != NULL)
+        {
+            // This can happen if a device is removed right after it was
+            // added.  Like libusbp_list_connected_devices, we ignore it.
+            #ifdef LIBUSBP_LOG
+            fprintf(stderr, "Problem handling hotplug event: %s\n",
+                libusbp_error_get_message(error));
+            #endif
+            libusbp_error_free(error);
+            continue;
+        }
+
+        if (new_device != NULL)
+        {
+            if (event != NULL) { *event = new_event; }
+            *device = new_device;
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+typedef struct kernel_event
+{
+    const char * message;
+    size_t size;
+    char syspath[PATH_MAX];
+    hotplug_serial_number ** serial_numbers;
+} kernel_event;
+
+static const char * kernel_event_get_property(void * context, const char * key)
+{
+    kernel_event * ke = context;
+    const char * value = sysfs_uevent_get(ke->message, ke->size, key);
+
+    // Only udev adds ID_SERIAL_SHORT to events.
+    if (value == NULL && strcmp(key, "ID_SERIAL_SHORT") == 0)
+    {
+        hotplug_serial_number * entry = *serial_numbers_find(
+            ke->serial_numbers, ke->syspath);
+        if (entry != NULL) { value = entry->serial_number; }
+    }
+    return value;
+}
+
+static libusbp_error * kernel_event_create_device(void * context,
+    libusbp_device ** device)
+{
+    kernel_event * ke = context;
+    return sysfs_device_create(ke->syspath, device);
+}
+
+static libusbp_error * kernel_event_create_parent_device(void * context,
+    libusbp_device ** device)
+{
+    kernel_event * ke = context;
+
+    char * parent_syspath = NULL;
+    libusbp_error * error = sysfs_find_parent_device(ke->syspath, &parent_syspath);
+    if (error != NULL || parent_syspath == NULL) { return error; }
+
+    error = sysfs_device_create(parent_syspath, device);
+    libusbp_string_free(parent_syspath);
+    return error;
+}
+
+libusbp_error * hotplug_kernel_uevent_convert(const char * sysfs_root,
+    hotplug_serial_number ** serial_numbers, const char * message, size_t size,
+    uint32_t * event, libusbp_device ** device)
+{
+    assert(sysfs_root != NULL);
+    assert(serial_numbers != NULL);
+    assert(message != NULL);
+    assert(event != NULL);
+    assert(device != NULL);
+
+    kernel_event ke = { message, size, "", serial_numbers };
+
+    const char * devpath = sysfs_uevent_get(message, size, "DEVPATH");
+    if (devpath != NULL)
+    {
+        snprintf(ke.syspath, sizeof(ke.syspath), "%s%s", sysfs_root, devpath);
+    }
+
+    // The kernel sends events before udev has looked at the devices, so
+    // there is nothing to wait for.
+    hotplug_uevent uevent = {
+        .action = sysfs_uevent_get(message, size, "ACTION"),
+        .subsystem = sysfs_uevent_get(message, size, "SUBSYSTEM"),
+        .devtype = sysfs_uevent_get(message, size, "DEVTYPE"),
+        .syspath = devpath ? ke.syspath : NULL,
+        .initialized = true,
+        .get_property = kernel_event_get_property,
+        .create_device = kernel_event_create_device,
+        .create_parent_device = kernel_event_create_parent_device,
+        .context = &ke,
+    };
+    libusbp_error * error = hotplug_uevent_convert(&uevent, event, device);
+
+    if (error == NULL && *event == LIBUSBP_HOTPLUG_DEVICE_ADDED)
+    {
+        error = serial_numbers_remember(serial_numbers, *device);
+    }
+
+    if (error == NULL && *event == LIBUSBP_HOTPLUG_DEVICE_REMOVED)
+    {
+        serial_numbers_forget(serial_numbers, ke.syspath);
+    }
+
+    if (error != NULL)
+    {
+        libusbp_device_free(*device);
+        *device = NULL;
+        *event = 0;
+    }
+    return error;
+}
+
+// Receives one kernel uevent.  Sets size to 0 if there are no more events.
+static libusbp_error * netlink_receive(int fd, char * buffer, size_t buffer_size,
+    size_t * size)
+{
+    *size = 0;
+
+    while (true)
+    {
+        struct sockaddr_nl sender;
+        struct iovec iov = { buffer, buffer_size - 1 };
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_name = &sender;
+        message.msg_namelen = sizeof(sender);
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+
+        ssize_t length = recvmsg(fd, &message, 0);
+        if (length < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { return NULL; }
+            if (errno == EINTR) { continue; }
+            return error_create_errno("Failed to receive a kernel uevent.");
+        }
+
+        // Only trust messages from the kernel, which has port ID 0.
+        if (sender.nl_pid != 0 || (message.msg_flags & MSG_TRUNC)) { continue; }
+
+        buffer[length] = 0;
+        *size = length;
+        return NULL;
+    }
+}
+
+// The kernel limits uevents to about 2 KB of properties.
+#define KERNEL_UEVENT_BUFFER_SIZE 8192
+
+static libusbp_error * receive_kernel_event(libusbp_hotplug_monitor * monitor,
+    uint32_t * event, libusbp_device ** device)
+{
+    char buffer[KERNEL_UEVENT_BUFFER_SIZE];
+    while (true)
+    {
+        size_t size;
+        libusbp_error * error = netlink_receive(monitor->netlink_fd,
+            buffer, sizeof(buffer), &size);
+        if (error != NULL || size == 0) { return error; }
+
+        uint32_t new_event;
+        libusbp_device * new_device;
+        error = hotplug_kernel_uevent_convert(monitor->sysfs_root,
+            &monitor->serial_numbers, buffer, size, &new_event, &new_device);
+        if (error != NULL)
+        {
+            // See the comment in receive_udev_event.
+            #ifdef LIBUSBP_LOG
+            fprintf(stderr, "Problem handling hotplug event: %s\n",
+                libusbp_error_get_message(error));
+            #endif
+            libusbp_error_free(error);
+            continue;
+        }
+
+        if (new_device != NULL)
+        {
+            if (event != NULL) { *event = new_event; }
+            *device = new_device;
+            return NULL;
+        }
+    }
+}
+
+libusbp_error * libusbp_hotplug_monitor_receive(libusbp_hotplug_monitor * monitor,
+    uint32_t * event, libusbp_device ** device)
+{
+    if (event != NULL)
+    {
+        *event = 0;
+    }
+
+    if (device == NULL)
+    {
+        return error_create("Device output pointer is null.");
+    }
+
+    *device = NULL;
+
+    if (monitor == NULL)
+    {
+        return error_create("Hotplug monitor argument is null.");
+    }
+
+    #ifdef LIBUSBP_USE_UDEV
+    if (monitor->monitor != NULL)
+    {
+        return receive_udev_event(monitor, event, device);
+    }
+    #endif
+
+    return receive_kernel_event(monitor, event, device);
+}
+
+libusbp_error * libusbp_hotplug_monitor_wait(libusbp_hotplug_monitor * monitor,
+    uint32_t timeout)
+{
+    if (monitor == NULL)
+    {
+        return error_create("Hotplug monitor argument is null.");
+    }
+
+    int poll_timeout = -1;
+    if (timeout != 0)
+    {
+        poll_timeout = timeout > INT_MAX ? INT_MAX : (int)timeout;
+    }
+
+    struct pollfd pfd = { libusbp_hotplug_monitor_get_fd(monitor), POLLIN, 0 };
+    int result = poll(&pfd, 1, poll_timeout);
+    if (result < 0 && errno != EINTR)
+    {
+        return error_create_errno("Failed to wait for hotplug events.");
+    }
+    return NULL;
+}
@@ -0,0 +1,58 @@
+#include <libusbp_internal.h>
+
+libusbp_error * iovec_total_size(const libusbp_iovec * iov, size_t iov_count,
+    size_t * size)
+{
+    assert(size != NULL);
+
+    *size = 0;
+
+    if (iov == NULL && iov_count)
+    {
+        return error_create("Buffer array is null.");
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < iov_count; i++)
+    {
+        if (iov[i].base == NULL && iov[i].size)
+        {
+            return error_create("Buffer is null.");
+        }
+
+        if (iov[i].size > SIZE_MAX - total)
+        {
+            return error_create("Transfer size is too large.");
+        }
+        total += iov[i].size;
+    }
+
+    *size = total;
+    return NULL;
+}
+
+void iovec_gather(const libusbp_iovec * iov, size_t iov_count,
+    void * buffer, size_t size)
+{
+    uint8_t * dest = buffer;
+    for (size_t i = 0; i < iov_count && size; i++)
+    {
+        size_t length = iov[i].size < size ? iov[i].size : size;
+        memcpy(dest, iov[i].base, length);
+        dest += length;
+        size -= length;
+    }
+}
+
+void iovec_scatter(const libusbp_iovec * iov, size_t iov_count,
+    const void * buffer, size_t size)
+{
+    const uint8_t * src = buffer;
+    for (size_t i = 0; i < iov_count && size; i++)
+    {
+        size_t length = iov[i].size < size ? iov[i].size : size;
+        memcpy(iov[i].base, src, length);
+        src += length;
+        size -= length;
+    }
+}
@@ -0,0 +1,414 @@
+#include <libusbp_internal.h>
+
+struct libusbp_iso_pipe
+{
+    libusbp_generic_handle * handle;
+    uint8_t pipe_id;
+    iso_transfer ** transfer_array;
+    size_t transfer_count;
+    size_t packets_per_transfer;
+    size_t packet_size;
+
+    // Only used for IN pipes.  See libusbp_async_in_pipe.
+    bool endless_transfers_enabled;
+
+    // The number of transfers that have been submitted but not finished
+    // (handed back to the user of the pipe) yet.  This uses the same
+    // definition of pending as libusbp_async_in_pipe.
+    size_t pending_count;
+
+    // The index of the transfer that should finish next.  That transfer will be
+    // pending if pending_count > 0.
+    size_t next_finish;
+
+    // The index of the transfer that will be submitted next.  That transfer is
+    // available if pending_count < transfer_count.
+    size_t next_submit;
+};
+
+static void iso_transfer_array_free(iso_transfer ** array, size_t transfer_count)
+{
+    if (array == NULL) { return; }
+
+    for (size_t i = 0; i < transfer_count; i++)
+    {
+        iso_transfer_free(array[i]);
+    }
+    free(array);
+}
+
+void libusbp_iso_pipe_close(libusbp_iso_pipe * pipe)
+{
+    if (pipe != NULL)
+    {
+        iso_transfer_array_free(pipe->transfer_array, pipe->transfer_count);
+        free(pipe);
+    }
+}
+
+libusbp_error * iso_pipe_create(libusbp_generic_handle * handle,
+    uint8_t pipe_id, libusbp_iso_pipe ** pipe)
+{
+    // Check the pipe output pointer.
+    if (pipe == NULL)
+    {
+        return error_create("Pipe output pointer is null.");
+    }
+
+    *pipe = NULL;
+
+    if (handle == NULL)
+    {
+        return error_create("Generic handle is null.");
+    }
+
+    libusbp_error * error = NULL;
+
+    // Check the pipe_id parameter.
+    if (error == NULL)
+    {
+        error = check_pipe_id(pipe_id);
+    }
+    if (error == NULL && (pipe_id & MAX_ENDPOINT_NUMBER) == 0)
+    {
+        error = error_create("Isochronous pipes for endpoint 0 are not supported.");
+    }
+    if (error == NULL &&
+        generic_handle_get_endpoint_type(handle, pipe_id) != USB_ENDPOINT_XFER_ISOC)
+    {
+        error = error_create("Endpoint 0x%02x is not an isochronous endpoint.", pipe_id);
+    }
+
+    libusbp_iso_pipe * new_pipe = NULL;
+    if (error == NULL)
+    {
+        new_pipe = calloc(1, sizeof(libusbp_iso_pipe));
+        if (new_pipe == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    if (error == NULL)
+    {
+        new_pipe->handle = handle;
+        new_pipe->pipe_id = pipe_id;
+        *pipe = new_pipe;
+        new_pipe = NULL;
+    }
+
+    free(new_pipe);
+    return error;
+}
+
+libusbp_generic_handle * iso_pipe_get_handle(libusbp_iso_pipe * pipe)
+{
+    assert(pipe != NULL);
+    return pipe->handle;
+}
+
+libusbp_error * libusbp_iso_pipe_allocate_transfers(
+    libusbp_iso_pipe * pipe,
+    size_t transfer_count,
+    size_t packets_per_transfer,
+    size_t packet_size)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (pipe->transfer_array != NULL)
+    {
+        return error_create("Transfers were already allocated for this pipe.");
+    }
+
+    if (transfer_count == 0)
+    {
+        return error_create("Transfer count cannot be zero.");
+    }
+
+    if (packets_per_transfer == 0)
+    {
+        return error_create("Packets per transfer cannot be zero.");
+    }
+
+    if (packet_size == 0)
+    {
+        return error_create("Packet size cannot be zero.");
+    }
+
+    libusbp_error * error = NULL;
+
+    iso_transfer ** new_transfer_array = NULL;
+    if (error == NULL)
+    {
+        new_transfer_array = calloc(transfer_count, sizeof(iso_transfer *));
+        if (new_transfer_array == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    for(size_t i = 0; error == NULL && i < transfer_count; i++)
+    {
+        error = iso_transfer_create(pipe->handle, pipe->pipe_id,
+            packets_per_transfer, packet_size, &new_transfer_array[i]);
+    }
+
+    // Put the new array and the information about it into the pipe.
+    if (error == NULL)
+    {
+        pipe->transfer_array = new_transfer_array;
+        pipe->transfer_count = transfer_count;
+        pipe->packets_per_transfer = packets_per_transfer;
+        pipe->packet_size = packet_size;
+        new_transfer_array = NULL;
+    }
+
+    iso_transfer_array_free(new_transfer_array, transfer_count);
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to allocate transfers for isochronous pipe.");
+    }
+    return error;
+}
+
+static void iso_pipe_submit_available_transfers(libusbp_iso_pipe * pipe)
+{
+    while (pipe->pending_count < pipe->transfer_count)
+    {
+        iso_transfer_submit_in(pipe->transfer_array[pipe->next_submit]);
+        pipe->pending_count++;
+        pipe->next_submit = increment_and_wrap_size(pipe->next_submit, pipe->transfer_count);
+    }
+}
+
+libusbp_error * libusbp_iso_pipe_start_endless_transfers(libusbp_iso_pipe * pipe)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (!(pipe->pipe_id & 0x80))
+    {
+        return error_create("Endless transfers are only supported for IN pipes.");
+    }
+
+    if (pipe->transfer_array == NULL)
+    {
+        return error_create("Pipe transfers have not been allocated yet.");
+    }
+
+    pipe->endless_transfers_enabled = true;
+    iso_pipe_submit_available_transfers(pipe);
+
+    return NULL;
+}
+
+libusbp_error * libusbp_iso_pipe_submit_transfer(
+    libusbp_iso_pipe * pipe,
+    const void * buffer,
+    const size_t * packet_lengths,
+    size_t packet_count,
+    bool * submitted)
+{
+    if (submitted != NULL)
+    {
+        *submitted = false;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (pipe->pipe_id & 0x80)
+    {
+        return error_create("Data can only be submitted to OUT pipes.");
+    }
+
+    if (pipe->transfer_array == NULL)
+    {
+        return error_create("Pipe transfers have not been allocated yet.");
+    }
+
+    if (packet_count == 0 || packet_count > pipe->packets_per_transfer)
+    {
+        return error_create("Packet count must be between 1 and the number of packets per transfer.");
+    }
+
+    if (pipe->pending_count >= pipe->transfer_count)
+    {
+        // All of the transfers are in use, so the caller needs to handle some
+        // finished transfers before submitting more data.
+        return NULL;
+    }
+
+    libusbp_error * error = iso_transfer_submit_out(
+        pipe->transfer_array[pipe->next_submit], buffer, packet_lengths, packet_count);
+
+    if (error == NULL)
+    {
+        if (submitted != NULL)
+        {
+            *submitted = true;
+        }
+
+        pipe->pending_count++;
+        pipe->next_submit = increment_and_wrap_size(pipe->next_submit, pipe->transfer_count);
+    }
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Failed to submit isochronous transfer.");
+    }
+    return error;
+}
+
+libusbp_error * libusbp_iso_pipe_handle_events(libusbp_iso_pipe * pipe)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    return generic_handle_events(pipe->handle);
+}
+
+static bool iso_pipe_can_finish_transfer(void * context)
+{
+    libusbp_iso_pipe * pipe = context;
+    return pipe->pending_count == 0 ||
+        !iso_transfer_pending(pipe->transfer_array[pipe->next_finish]);
+}
+
+libusbp_error * libusbp_iso_pipe_wait(libusbp_iso_pipe * pipe, uint32_t timeout)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    return generic_handle_wait_until(pipe->handle, timeout,
+        iso_pipe_can_finish_transfer, pipe);
+}
+
+libusbp_error * libusbp_iso_pipe_has_pending_transfers(
+    libusbp_iso_pipe * pipe,
+    bool * result)
+{
+    libusbp_error * error = NULL;
+
+    if (error == NULL && result == NULL)
+    {
+        error = error_create("Boolean output pointer is null.");
+    }
+
+    if (error == NULL)
+    {
+        *result = false;
+    }
+
+    if (error == NULL && pipe == NULL)
+    {
+        error = error_create("Pipe argument is null.");
+    }
+
+    if (error == NULL)
+    {
+        *result = pipe->pending_count ? 1 : 0;
+    }
+
+    return error;
+}
+
+libusbp_error * libusbp_iso_pipe_handle_finished_transfer(
+    libusbp_iso_pipe * pipe,
+    bool * finished,
+    void * buffer,
+    libusbp_iso_packet * packets,
+    size_t * packet_count,
+    libusbp_error ** transfer_error)
+{
+    if (finished != NULL)
+    {
+        *finished = false;
+    }
+
+    if (packet_count != NULL)
+    {
+        *packet_count = 0;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = NULL;
+    }
+
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    if (pipe->pending_count == 0)
+    {
+        // There are no pending transfers that we could check for completion.
+        return NULL;
+    }
+
+    iso_transfer * transfer = pipe->transfer_array[pipe->next_finish];
+
+    if (iso_transfer_pending(transfer))
+    {
+        // The next transfer we expect to finish is still pending;
+        // the kernel has not told us that it is done.
+        return NULL;
+    }
+
+    iso_transfer_get_results(transfer, buffer, packets, packet_count, transfer_error);
+
+    if (finished != NULL)
+    {
+        *finished = true;
+    }
+
+    pipe->pending_count--;
+    pipe->next_finish = increment_and_wrap_size(pipe->next_finish, pipe->transfer_count);
+
+    if (pipe->endless_transfers_enabled)
+    {
+        iso_pipe_submit_available_transfers(pipe);
+    }
+
+    return NULL;
+}
+
+libusbp_error * libusbp_iso_pipe_cancel_transfers(libusbp_iso_pipe * pipe)
+{
+    if (pipe == NULL)
+    {
+        return error_create("Pipe argument is null.");
+    }
+
+    pipe->endless_transfers_enabled = false;
+
+    libusbp_error * error = NULL;
+
+    // Transfers need to be cancelled individually.  Like
+    // async_in_transfer_cancel_pending, we start with the newest one.
+    for (size_t i = 0; error == NULL && i < pipe->pending_count; i++)
+    {
+        size_t index = (pipe->next_submit + pipe->transfer_count - 1 - i) %
+            pipe->transfer_count;
+        iso_transfer * transfer = pipe->transfer_array[index];
+        if (iso_transfer_pending(transfer))
+        {
+            error = iso_transfer_cancel(transfer);
+        }
+    }
+
+    return error;
+}
@@ -0,0 +1,283 @@
+#include <libusbp_internal.h>
+
+struct iso_transfer
+{
+    // The URB is allocated separately because it ends with a flexible array of
+    // packet descriptors.
+    struct usbdevfs_urb * urb;
+    size_t packet_count;
+    size_t packet_size;
+    size_t buffer_size;
+    bool buffer_mapped;  // See usbfd_alloc_buffer.
+
+    // This is accessed with atomic operations because the transfer might be
+    // completed by a reaper thread.
+    bool pending;
+    libusbp_error * error;
+    int fd;
+};
+
+libusbp_error * iso_transfer_create(libusbp_generic_handle * handle,
+    uint8_t pipe_id, size_t packet_count, size_t packet_size,
+    iso_transfer ** transfer)
+{
+    assert(packet_count != 0);
+    assert(packet_size != 0);
+    assert(transfer != NULL);
+
+    // usbdevfs_urb uses an int for the number of packets and the buffer size,
+    // and each packet descriptor uses an unsigned int for its length.
+    if (packet_count > INT_MAX || packet_size > UINT_MAX ||
+        packet_size > INT_MAX / packet_count)
+    {
+        return error_create("Transfer size is too large.");
+    }
+
+    size_t buffer_size = packet_count * packet_size;
+
+    libusbp_error * error = NULL;
+
+    // Allocate the transfer struct.
+    iso_transfer * new_transfer = NULL;
+    if (error == NULL)
+    {
+        new_transfer = calloc(1, sizeof(iso_transfer));
+        if (new_transfer == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    // Allocate the URB with room for the packet descriptors.
+    struct usbdevfs_urb * new_urb = NULL;
+    if (error == NULL)
+    {
+        new_urb = calloc(1, sizeof(struct usbdevfs_urb) +
+            packet_count * sizeof(struct usbdevfs_iso_packet_desc));
+        if (new_urb == NULL)
+        {
+            error = &error_no_memory;
+        }
+    }
+
+    // Allocate the buffer for the transfer.
+    int fd = libusbp_generic_handle_get_fd(handle);
+    void * new_buffer = NULL;
+    bool new_buffer_mapped = false;
+    if (error == NULL)
+    {
+        error = usbfd_alloc_buffer(fd,
+            generic_handle_get_buffer_capabilities(handle),
+            buffer_size, &new_buffer, &new_buffer_mapped);
+    }
+
+    // Assemble the transfer and pass it to the caller.
+    if (error == NULL)
+    {
+        new_transfer->fd = fd;
+        new_transfer->packet_count = packet_count;
+        new_transfer->packet_size = packet_size;
+        new_transfer->buffer_size = buffer_size;
+
+        new_urb->usercontext = new_transfer;
+        new_urb->type = USBDEVFS_URB_TYPE_ISO;
+        new_urb->endpoint = pipe_id;
+        new_urb->flags = USBDEVFS_URB_ISO_ASAP;
+        new_urb->buffer = new_buffer;
+        new_transfer->buffer_mapped = new_buffer_mapped;
+        new_buffer = NULL;
+
+        new_transfer->urb = new_urb;
+        new_urb = NULL;
+
+        *transfer = new_transfer;
+        new_transfer = NULL;
+    }
+
+    usbfd_free_buffer(new_buffer, buffer_size, new_buffer_mapped);
+    free(new_urb);
+    free(new_transfer);
+    return error;
+}
+
+void iso_transfer_free(iso_transfer * transfer)
+{
+    if (transfer == NULL) { return; }
+
+    if (iso_transfer_pending(transfer))
+    {
+        // The kernel might still write to this transfer's buffer and URB, so
+        // we leak it instead of freeing it.  See async_in_transfer_free.
+        return;
+    }
+
+    libusbp_error_free(transfer->error);
+    usbfd_free_buffer(transfer->urb->buffer,
+        transfer->buffer_size, transfer->buffer_mapped);
+    free(transfer->urb);
+    free(transfer);
+}
+
+// Submits the transfer with the specified packet lengths.  The data for each
+// packet must already be in the buffer, packed back to back.  Like
+// async_out_transfer_submit, an error from the kernel is returned directly and
+// the transfer is left idle.
+static libusbp_error * iso_transfer_submit_packets(iso_transfer * transfer,
+    const size_t * packet_lengths, size_t packet_count)
+{
+    assert(transfer != NULL);
+    assert(!iso_transfer_pending(transfer));
+    assert(packet_count != 0 && packet_count <= transfer->packet_count);
+
+    struct usbdevfs_urb * urb = transfer->urb;
+    size_t total = 0;
+    for (size_t i = 0; i < packet_count; i++)
+    {
+        size_t length = packet_lengths ? packet_lengths[i] : transfer->packet_size;
+        assert(length <= transfer->packet_size);
+        urb->iso_frame_desc[i].length = length;
+        urb->iso_frame_desc[i].actual_length = 0;
+        urb->iso_frame_desc[i].status = 0;
+        total += length;
+    }
+
+    libusbp_error_free(transfer->error);
+    transfer->error = NULL;
+    urb->number_of_packets = packet_count;
+    urb->buffer_length = total;
+    urb->actual_length = 0;
+    urb->error_count = 0;
+    urb->status = 0;
+    __atomic_store_n(&transfer->pending, true, __ATOMIC_RELEASE);
+
+    libusbp_error * error = usbfd_submit_urb(transfer->fd, urb);
+    if (error != NULL)
+    {
+        __atomic_store_n(&transfer->pending, false, __ATOMIC_RELEASE);
+    }
+    return error;
+}
+
+void iso_transfer_submit_in(iso_transfer * transfer)
+{
+    // Every packet gets the full packet size, so the data of packet i will be
+    // at offset i * packet_size.
+    libusbp_error * error = iso_transfer_submit_packets(transfer,
+        NULL, transfer->packet_count);
+    if (error != NULL)
+    {
+        // Like async_in_transfer_submit, the error is reported when the
+        // transfer is finished.
+        transfer->error = error;
+    }
+}
+
+libusbp_error * iso_transfer_submit_out(iso_transfer * transfer,
+    const void * buffer, const size_t * packet_lengths, size_t packet_count)
+{
+    assert(transfer != NULL);
+
+    if (packet_lengths == NULL)
+    {
+        return error_create("Packet length array is null.");
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < packet_count; i++)
+    {
+        if (packet_lengths[i] > transfer->packet_size)
+        {
+            return error_create("Packet length is larger than the packet size.");
+        }
+        total += packet_lengths[i];
+    }
+
+    if (buffer == NULL && total)
+    {
+        return error_create("Buffer is null.");
+    }
+
+    if (total)
+    {
+        memcpy(transfer->urb->buffer, buffer, total);
+    }
+
+    return iso_transfer_submit_packets(transfer, packet_lengths, packet_count);
+}
+
+void iso_transfer_handle_completion(iso_transfer * transfer)
+{
+    assert(transfer != NULL);
+
+    #ifdef LIBUSBP_LOG
+    fprintf(stderr, "Isochronous URB completed: %p, status=%d, error_count=%d\n",
+        transfer, transfer->urb->status, transfer->urb->error_count);
+    #endif
+
+    // Errors in individual packets are reported through the packet results,
+    // so only the status of the whole URB is an error here.
+    libusbp_error * error = error_from_urb_status(transfer->urb);
+
+    if (error != NULL)
+    {
+        error = error_add(error, "Isochronous transfer failed.");
+    }
+
+    transfer->error = error;
+    __atomic_store_n(&transfer->pending, false, __ATOMIC_RELEASE);
+}
+
+void iso_transfer_get_results(iso_transfer * transfer, void * buffer,
+    libusbp_iso_packet * packets, size_t * packet_count,
+    libusbp_error ** transfer_error)
+{
+    assert(transfer != NULL);
+    assert(!iso_transfer_pending(transfer));
+
+    struct usbdevfs_urb * urb = transfer->urb;
+    bool in = urb->endpoint & 0x80;
+
+    if (buffer != NULL && in)
+    {
+        memcpy(buffer, urb->buffer, transfer->buffer_size);
+    }
+
+    if (packets != NULL)
+    {
+        size_t offset = 0;
+        for (int i = 0; i < urb->number_of_packets; i++)
+        {
+            packets[i].offset = offset;
+            packets[i].transferred = urb->iso_frame_desc[i].actual_length;
+
+            // The kernel reports packet errors as negative errno values.
+            int status = (int)urb->iso_frame_desc[i].status;
+            packets[i].status = status < 0 ? -status : status;
+
+            offset += urb->iso_frame_desc[i].length;
+        }
+    }
+
+    if (packet_count != NULL)
+    {
+        *packet_count = urb->number_of_packets;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = libusbp_error_copy(transfer->error);
+    }
+}
+
+libusbp_error * iso_transfer_cancel(iso_transfer * transfer)
+{
+    if (transfer == NULL) { return NULL; }
+
+    return usbfd_discard_urb(transfer->fd, transfer->urb);
+}
+
+bool iso_transfer_pending(iso_transfer * transfer)
+{
+    assert(transfer != NULL);
+    return __atomic_load_n(&transfer->pending, __ATOMIC_ACQUIRE);
+}
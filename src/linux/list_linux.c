@@ -1,5 +1,6 @@
 #include <libusbp_internal.h>
 
+#ifdef LIBUSBP_USE_UDEV
 // Adds a device to the list, while maintaining the loop invariants for the loop
 // in libusbp_list_connected_devices.
 static libusbp_error * add_udev_device_to_list(
@@ -26,8 +27,72 @@ static libusbp_error * add_udev_device_to_list(
     return NULL;
 }
 
+// Checks whether a USB device matches every condition in the filter.  This
+// only reads sysattrs, so nothing is allocated for devices that do not match.
+static libusbp_error * check_device_matches_filter(struct udev_device * dev,
+    const libusbp_device_filter * filter, bool * matches)
+{
+    assert(dev != NULL);
+    assert(filter != NULL);
+    assert(matches != NULL);
+
+    *matches = false;
+
+    libusbp_error * error;
+
+    if (filter->id_count != 0)
+    {
+        uint16_t vendor_id;
+        error = udevw_get_sysattr_uint16(dev, "idVendor", &vendor_id);
+        if (error != NULL) { return error; }
+
+        uint16_t product_id;
+        error = udevw_get_sysattr_uint16(dev, "idProduct", &product_id);
+        if (error != NULL) { return error; }
+
+        bool id_matches = false;
+        for (size_t i = 0; i < filter->id_count; i++)
+        {
+            if (filter->ids[i].vendor_id == vendor_id &&
+                filter->ids[i].product_id == product_id)
+            {
+                id_matches = true;
+                break;
+            }
+        }
+        if (!id_matches) { return NULL; }
+    }
+
+    if (filter->serial_number_prefix != NULL)
+    {
+        const char * prefix = filter->serial_number_prefix;
+        const char * serial_number = udev_device_get_sysattr_value(dev, "serial");
+        if (serial_number == NULL) { return NULL; }
+        if (strncmp(serial_number, prefix, strlen(prefix))) { return NULL; }
+    }
+
+    if (filter->bus_number != 0)
+    {
+        uint8_t bus_number;
+        error = udevw_get_sysattr_dec_uint8(dev, "busnum", &bus_number);
+        if (error != NULL) { return error; }
+        if (bus_number != filter->bus_number) { return NULL; }
+    }
+
+    if (filter->match_device_class)
+    {
+        uint8_t device_class;
+        error = udevw_get_sysattr_uint8(dev, "bDeviceClass", &device_class);
+        if (error != NULL) { return error; }
+        if (device_class != filter->device_class) { return NULL; }
+    }
+
+    *matches = true;
+    return NULL;
+}
+
 static libusbp_error * add_udev_device_to_list_if_needed(
-    struct udev * udev, const char * syspath,
+    struct udev * udev, const char * syspath, const libusbp_device_filter * filter,
     libusbp_device *** device_list, size_t * device_count
 )
 {
@@ -67,6 +132,14 @@ static libusbp_error * add_udev_device_to_list_if_needed(
         skip = true;
     }
 
+    // Skip devices that do not match the filter.
+    if (error == NULL && !skip && filter != NULL)
+    {
+        bool matches;
+        error = check_device_matches_filter(dev, filter, &matches);
+        skip = !matches;
+    }
+
     if (error == NULL && !skip)
     {
         // This is a USB device, so we do want to add it to the list.
@@ -80,33 +153,25 @@ static libusbp_error * add_udev_device_to_list_if_needed(
     return error;
 }
 
-libusbp_error * libusbp_list_connected_devices(
+// Lists devices like list_devices, using udev.  The outputs have been cleared.
+static libusbp_error * list_devices_with_udev(libusbp_context * context,
+  const libusbp_device_filter * filter, size_t max_count,
   libusbp_device *** device_list, size_t * device_count)
 {
-    if (device_count != NULL)
-    {
-        *device_count = 0;
-    }
-
-    if (device_list == NULL)
-    {
-        return error_create("Device list output pointer is null.");
-    }
-
     libusbp_error * error = NULL;
 
     // Create a udev context.
     struct udev * udev = NULL;
     if (error == NULL)
     {
-        error = udevw_create_context(&udev);
+        error = context_get_udev(context, &udev);
     }
 
     // Create a list of USB devices and interfaces.
 	struct udev_enumerate * enumerate = NULL;
     if (error == NULL)
     {
-        error = udevw_create_usb_list(udev, &enumerate);
+        error = udevw_create_usb_list(udev, filter, &enumerate);
     }
 
     // Allocate a new list.
@@ -124,10 +189,13 @@ libusbp_error * libusbp_list_connected_devices(
         struct udev_list_entry * list_entry;
         udev_list_entry_foreach(list_entry, first_entry)
         {
+            if (max_count != 0 && count >= max_count) { break; }
+
             const char * path = udev_list_entry_get_name(list_entry);
             assert(path != NULL);
 
-            error = add_udev_device_to_list_if_needed(udev, path, &new_list, &count);
+            error = add_udev_device_to_list_if_needed(udev, path, filter,
+                &new_list, &count);
             if (error != NULL)
             {
                 // Something went wrong when getting information about the
@@ -163,3 +231,82 @@ libusbp_error * libusbp_list_connected_devices(
     free_devices_and_list(new_list);
     return error;
 }
+#endif
+
+// Lists the USB devices that match the filter, which may be NULL.  If
+// max_count is not zero, this stops after finding that many devices.
+static libusbp_error * list_devices(libusbp_context * context,
+  const libusbp_device_filter * filter, size_t max_count,
+  libusbp_device *** device_list, size_t * device_count)
+{
+    if (device_count != NULL)
+    {
+        *device_count = 0;
+    }
+
+    if (device_list == NULL)
+    {
+        return error_create("Device list output pointer is null.");
+    }
+
+    *device_list = NULL;
+
+    // Contexts made with libusbp_context_create_sysfs, and all contexts if
+    // libusbp was built without libudev, do not use udev.
+    const char * sysfs_root = context_get_sysfs_root(context);
+    #ifdef LIBUSBP_USE_UDEV
+    if (sysfs_root == NULL)
+    {
+        return list_devices_with_udev(context, filter, max_count,
+            device_list, device_count);
+    }
+    #endif
+
+    size_t count;
+    libusbp_error * error = sysfs_list_devices(sysfs_root, filter,
+        max_count, device_list, &count);
+    if (error == NULL && device_count != NULL)
+    {
+        *device_count = count;
+    }
+    return error;
+}
+
+libusbp_error * libusbp_list_connected_devices(
+  libusbp_device *** device_list, size_t * device_count)
+{
+    return list_devices(NULL, NULL, 0, device_list, device_count);
+}
+
+libusbp_error * libusbp_list_connected_devices_ctx(libusbp_context * context,
+  libusbp_device *** device_list, size_t * device_count)
+{
+    return list_devices(context, NULL, 0, device_list, device_count);
+}
+
+libusbp_error * libusbp_list_devices_matching(libusbp_context * context,
+  const libusbp_device_filter * filter,
+  libusbp_device *** device_list, size_t * device_count)
+{
+    return list_devices(context, filter, 0, device_list, device_count);
+}
+
+libusbp_error * libusbp_find_device_matching(libusbp_context * context,
+  const libusbp_device_filter * filter, libusbp_device ** device)
+{
+    if (device == NULL)
+    {
+        return error_create("Device output pointer is null.");
+    }
+
+    *device = NULL;
+
+    libusbp_device ** new_list = NULL;
+    size_t count = 0;
+    libusbp_error * error = list_devices(context, filter, 1, &new_list, &count);
+    if (error != NULL) { return error; }
+
+    *device = new_list[0];
+    libusbp_list_free(new_list);
+    return NULL;
+}
@@ -10,11 +10,91 @@ struct libusbp_serial_port
     char * port_name;
 };
 
+#ifdef LIBUSBP_USE_UDEV
+// Finds the syspath and port name of the tty device for an interface using
+// udev.
+static libusbp_error * find_serial_port_with_udev(libusbp_context * context,
+    const char * device_syspath, uint8_t interface_number,
+    char ** syspath, char ** port_name)
+{
+    libusbp_error * error = NULL;
+
+    // Get a udev context.
+    struct udev * new_udev = NULL;
+    if (error == NULL)
+    {
+        error = context_get_udev(context, &new_udev);
+    }
+
+    // Get the USB interface device.
+    struct udev_device * new_interface_dev = NULL;
+    if (error == NULL)
+    {
+        error = udevw_get_interface(new_udev, device_syspath,
+            interface_number, &new_interface_dev);
+    }
+
+    // Get the tty device.
+    struct udev_device * new_tty_dev = NULL;
+    if (error == NULL)
+    {
+        error = udevw_get_tty(new_udev, new_interface_dev, &new_tty_dev);
+    }
+
+    // Get the syspath of the tty device.
+    char * new_syspath = NULL;
+    if (error == NULL)
+    {
+        error = udevw_get_syspath_copy(new_tty_dev, &new_syspath);
+    }
+
+    // Get the port name (e.g. /dev/ttyACM0)
+    const char * new_port_name = NULL;
+    if (error == NULL)
+    {
+        new_port_name = udev_device_get_property_value(new_tty_dev, "DEVNAME");
+        if (new_port_name == NULL)
+        {
+            error = error_create("The DEVNAME property does not exist.");
+        }
+    }
+
+    // Copy the port name and pass both strings to the caller.
+    if (error == NULL)
+    {
+        error = string_copy(new_port_name, port_name);
+    }
+
+    if (error == NULL)
+    {
+        *syspath = new_syspath;
+        new_syspath = NULL;
+    }
+
+    libusbp_string_free(new_syspath);
+    if (new_tty_dev != NULL) { udev_device_unref(new_tty_dev); }
+    if (new_interface_dev != NULL) { udev_device_unref(new_interface_dev); }
+    if (new_udev != NULL) { udev_unref(new_udev); }
+    return error;
+}
+#endif
+
 libusbp_error * libusbp_serial_port_create(
     const libusbp_device * device,
     uint8_t interface_number,
     bool composite,
     libusbp_serial_port ** port)
+{
+    return libusbp_serial_port_create_ctx(NULL, device,
+        interface_number, composite, port);
+}
+
+libusbp_error * libusbp_serial_port_create_ctx(
+    libusbp_context * context,
+    const libusbp_device * device,
+    uint8_t interface_number,
+    bool composite,
+    libusbp_serial_port ** port)
 {
     LIBUSBP_UNUSED(composite);
 
@@ -49,49 +129,21 @@ libusbp_error * libusbp_serial_port_create(
         error = libusbp_device_get_os_id(device, &new_device_syspath);
     }
 
-    // Get a udev context.
-    struct udev * new_udev = NULL;
-    if (error == NULL)
-    {
-        error = udevw_create_context(&new_udev);
-    }
-
-    // Get the USB interface device.
-    struct udev_device * new_interface_dev = NULL;
-    if (error == NULL)
-    {
-        error = udevw_get_interface(new_udev, new_device_syspath,
-            interface_number, &new_interface_dev);
-    }
-
-    // Get the tty device.
-    struct udev_device * new_tty_dev = NULL;
-    if (error == NULL)
-    {
-        error = udevw_get_tty(new_udev, new_interface_dev, &new_tty_dev);
-    }
-
-    // Get the syspath of the tty device.
+    // Find the tty device and its port name.
     if (error == NULL)
     {
-        error = udevw_get_syspath_copy(new_tty_dev, &new_port->syspath);
-    }
-
-    // Get the port name (e.g. /dev/ttyACM0)
-    const char * port_name = NULL;
-    if (error == NULL)
-    {
-        port_name = udev_device_get_property_value(new_tty_dev, "DEVNAME");
-        if (port_name == NULL)
+        if (context_get_sysfs_root(context) != NULL)
         {
-            error = error_create("The DEVNAME property does not exist.");
+            error = sysfs_find_serial_port(new_device_syspath, interface_number,
+                &new_port->syspath, &new_port->port_name);
         }
-    }
-
-    // Copy the port name to the new serial port object.
-    if (error == NULL)
-    {
-        error = string_copy(port_name, &new_port->port_name);
+        #ifdef LIBUSBP_USE_UDEV
+        else
+        {
+            error = find_serial_port_with_udev(context, new_device_syspath,
+                interface_number, &new_port->syspath, &new_port->port_name);
+        }
+        #endif
     }
 
     // Pass the new object to the caller.
@@ -101,9 +153,6 @@ libusbp_error * libusbp_serial_port_create(
         new_port = NULL;
     }
 
-    if (new_tty_dev != NULL) { udev_device_unref(new_tty_dev); }
-    if (new_interface_dev != NULL) { udev_device_unref(new_interface_dev); }
-    if (new_udev != NULL) { udev_unref(new_udev); }
     libusbp_string_free(new_device_syspath);
     libusbp_serial_port_free(new_port);
 
@@ -0,0 +1,783 @@
+/* Functions that find USB devices, interfaces, and serial ports by reading
+ * sysfs directly instead of going through libudev.  These are used by contexts
+ * made with libusbp_context_create_sysfs, and for everything if libusbp was
+ * built without libudev (LIBUSBP_USE_UDEV).
+ *
+ * Most of what we need about a USB device is in its uevent file, which the
+ * kernel generates in one read, so listing a device takes two reads: the
+ * uevent file and the serial number.  The uevent of a USB device looks like
+ * this:
+ *
+ *   MAJOR=189
+ *   MINOR=6
+ *   DEVNAME=bus/usb/001/007
+ *   DEVTYPE=usb_device
+ *   DRIVER=usb
+ *   PRODUCT=1ffb/da01/100
+ *   TYPE=239/2/1
+ *   BUSNUM=001
+ *   DEVNUM=007
+ *
+ * The sysfs root is "/sys" by default, but it can be any directory laid out
+ * the same way, which lets us test and benchmark with a fixture tree. */
+
+#include <libusbp_internal.h>
+
+// A uevent file read into memory, with each newline replaced by a null
+// character so that the values can be used as strings.
+typedef struct sysfs_uevent
+{
+    char buffer[1024];
+    size_t size;
+} sysfs_uevent;
+
+// The information about a USB device that we need for listing and filtering.
+typedef struct sysfs_device_info
+{
+    uint16_t vendor_id;
+    uint16_t product_id;
+    uint16_t revision;
+    uint8_t bus_number;
+    uint8_t device_class;
+    bool has_serial_number;
+    char serial_number[256];
+} sysfs_device_info;
+
+// Reads a small file into a null-terminated buffer with a single read,
+// removing one trailing newline.  If the file does not exist, this sets
+// exists to false and returns no error.
+static libusbp_error * sysfs_read_file_at(int dirfd, const char * name,
+    char * buffer, size_t size, bool * exists)
+{
+    assert(name != NULL);
+    assert(buffer != NULL);
+    assert(size > 0);
+    assert(exists != NULL);
+
+    buffer[0] = 0;
+    *exists = false;
+
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        if (errno == ENOENT) { return NULL; }
+        return error_create_errno("Failed to open %s.", name);
+    }
+
+    ssize_t length = read(fd, buffer, size - 1);
+    int read_errno = errno;
+    close(fd);
+    if (length < 0)
+    {
+        errno = read_errno;
+        return error_create_errno("Failed to read %s.", name);
+    }
+
+    if (length > 0 && buffer[length - 1] == '\n') { length--; }
+    buffer[length] = 0;
+    *exists = true;
+    return NULL;
+}
+
+static libusbp_error * sysfs_read_uevent_at(int dirfd, sysfs_uevent * uevent)
+{
+    assert(uevent != NULL);
+
+    bool exists;
+    libusbp_error * error = sysfs_read_file_at(dirfd, "uevent",
+        uevent->buffer, sizeof(uevent->buffer), &exists);
+    if (error != NULL) { return error; }
+    if (!exists)
+    {
+        return error_create("The device has no uevent file.");
+    }
+
+    uevent->size = strlen(uevent->buffer);
+    for (size_t i = 0; i < uevent->size; i++)
+    {
+        if (uevent->buffer[i] == '\n') { uevent->buffer[i] = 0; }
+    }
+    return NULL;
+}
+
+// Gets the value of a key in a uevent, or NULL if it is not there.  This
+// also works on the null-separated properties of a netlink uevent message.
+const char * sysfs_uevent_get(const char * buffer, size_t size, const char * key)
+{
+    assert(buffer != NULL);
+    assert(key != NULL);
+
+    size_t key_length = strlen(key);
+    size_t i = 0;
+    while (i < size)
+    {
+        const char * line = buffer + i;
+        size_t line_length = strnlen(line, size - i);
+        if (line_length > key_length && line[key_length] == '=' &&
+            memcmp(line, key, key_length) == 0)
+        {
+            return line + key_length + 1;
+        }
+        i += line_length + 1;
+    }
+    return NULL;
+}
+
+static const char * uevent_get(const sysfs_uevent * uevent, const char * key)
+{
+    return sysfs_uevent_get(uevent->buffer, uevent->size, key);
+}
+
+// Reads the information we need about a USB device from its directory.  If
+// the directory is not a USB device (for example, it is an interface), this
+// sets is_device to false and returns no error.
+static libusbp_error * sysfs_read_device_info(int dirfd, sysfs_device_info * info,
+    bool * is_device)
+{
+    assert(info != NULL);
+    assert(is_device != NULL);
+
+    *is_device = false;
+
+    sysfs_uevent uevent;
+    libusbp_error * error = sysfs_read_uevent_at(dirfd, &uevent);
+    if (error != NULL) { return error; }
+
+    const char * devtype = uevent_get(&uevent, "DEVTYPE");
+    if (devtype == NULL || strcmp(devtype, "usb_device") != 0) { return NULL; }
+
+    const char * product = uevent_get(&uevent, "PRODUCT");
+    if (product == NULL || sscanf(product, "%hx/%hx/%hx",
+        &info->vendor_id, &info->product_id, &info->revision) != 3)
+    {
+        return error_create("Failed to parse the PRODUCT of the device.");
+    }
+
+    const char * busnum = uevent_get(&uevent, "BUSNUM");
+    if (busnum == NULL || sscanf(busnum, "%3hhu", &info->bus_number) != 1)
+    {
+        return error_create("Failed to parse the BUSNUM of the device.");
+    }
+
+    // TYPE is missing for devices that are not configured, so we read the
+    // class from its own file in that case.
+    const char * type = uevent_get(&uevent, "TYPE");
+    if (type == NULL || sscanf(type, "%3hhu", &info->device_class) != 1)
+    {
+        char class_str[8];
+        bool exists;
+        error = sysfs_read_file_at(dirfd, "bDeviceClass",
+            class_str, sizeof(class_str), &exists);
+        if (error != NULL) { return error; }
+        if (!exists || sscanf(class_str, "%2hhx", &info->device_class) != 1)
+        {
+            return error_create("Failed to get the class of the device.");
+        }
+    }
+
+    error = sysfs_read_file_at(dirfd, "serial", info->serial_number,
+        sizeof(info->serial_number), &info->has_serial_number);
+    if (error != NULL) { return error; }
+
+    *is_device = true;
+    return NULL;
+}
+
+static bool sysfs_info_matches_filter(const sysfs_device_info * info,
+    const libusbp_device_filter * filter)
+{
+    if (filter == NULL) { return true; }
+
+    if (filter->id_count != 0)
+    {
+        bool id_matches = false;
+        for (size_t i = 0; i < filter->id_count; i++)
+        {
+            if (filter->ids[i].vendor_id == info->vendor_id &&
+                filter->ids[i].product_id == info->product_id)
+            {
+                id_matches = true;
+                break;
+            }
+        }
+        if (!id_matches) { return false; }
+    }
+
+    if (filter->serial_number_prefix != NULL)
+    {
+        const char * prefix = filter->serial_number_prefix;
+        if (!info->has_serial_number) { return false; }
+        if (strncmp(info->serial_number, prefix, strlen(prefix))) { return false; }
+    }
+
+    if (filter->bus_number != 0 && filter->bus_number != info->bus_number)
+    {
+        return false;
+    }
+
+    if (filter->match_device_class && filter->device_class != info->device_class)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static libusbp_error * sysfs_device_create_from_info(const char * syspath,
+    const sysfs_device_info * info, libusbp_device ** device)
+{
+    return device_create_from_values(syspath, info->vendor_id,
+        info->product_id, info->revision,
+        info->has_serial_number ? info->serial_number : NULL, device);
+}
+
+libusbp_error * sysfs_device_create(const char * syspath, libusbp_device ** device)
+{
+    assert(syspath != NULL);
+    assert(device != NULL);
+
+    *device = NULL;
+
+    int dirfd = open(syspath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd == -1)
+    {
+        return error_create_errno("Failed to open device directory %s.", syspath);
+    }
+
+    sysfs_device_info info;
+    bool is_device;
+    libusbp_error * error = sysfs_read_device_info(dirfd, &info, &is_device);
+    close(dirfd);
+
+    if (error == NULL && !is_device)
+    {
+        error = error_create("Not a USB device: %s.", syspath);
+    }
+
+    if (error == NULL)
+    {
+        error = sysfs_device_create_from_info(syspath, &info, device);
+    }
+    return error;
+}
+
+// USB devices in /sys/bus/usb/devices are named like "1-2.3" or "usb1", while
+// interfaces have a colon, like "1-2.3:1.0".
+static bool sysfs_name_is_device(const char * name)
+{
+    return name[0] != '.' && strchr(name, ':') == NULL;
+}
+
+// udev sorts its enumerations by syspath, so we do the same to make both
+// backends list devices in the same order.
+static int sysfs_compare_syspaths(const void * a, const void * b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+// Gets the syspaths of the USB devices in <root>/bus/usb/devices, sorted.
+static libusbp_error * sysfs_get_device_syspaths(const char * root,
+    char *** syspaths, size_t * count)
+{
+    *syspaths = NULL;
+    *count = 0;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/bus/usb/devices", root);
+
+    DIR * dir = opendir(path);
+    if (dir == NULL)
+    {
+        // There are no USB devices, or no USB support in the kernel.
+        if (errno == ENOENT) { return NULL; }
+        return error_create_errno("Failed to open %s.", path);
+    }
+
+    libusbp_error * error = NULL;
+    char ** new_syspaths = NULL;
+    size_t new_count = 0;
+    size_t capacity = 0;
+
+    char link_path[PATH_MAX];
+    char syspath[PATH_MAX];
+    struct dirent * entry;
+    while (error == NULL && (entry = readdir(dir)) != NULL)
+    {
+        if (!sysfs_name_is_device(entry->d_name)) { continue; }
+
+        // The entries are links into <root>/devices.  The resolved path is
+        // the syspath, which is the same one udev would report.  If it cannot
+        // be resolved, the device was probably being unplugged.
+        snprintf(link_path, sizeof(link_path), "%s/bus/usb/devices/%s",
+            root, entry->d_name);
+        if (realpath(link_path, syspath) == NULL) { continue; }
+
+        if (new_count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 32;
+            char ** expanded = realloc(new_syspaths, capacity * sizeof(char *));
+            if (expanded == NULL)
+            {
+                error = &error_no_memory;
+                break;
+            }
+            new_syspaths = expanded;
+        }
+
+        error = string_copy(syspath, &new_syspaths[new_count]);
+        if (error == NULL) { new_count++; }
+    }
+    closedir(dir);
+
+    if (error != NULL)
+    {
+        for (size_t i = 0; i < new_count; i++) { free(new_syspaths[i]); }
+        free(new_syspaths);
+        return error;
+    }
+
+    if (new_count != 0)
+    {
+        qsort(new_syspaths, new_count, sizeof(char *), sysfs_compare_syspaths);
+    }
+    *syspaths = new_syspaths;
+    *count = new_count;
+    return NULL;
+}
+
+libusbp_error * sysfs_list_devices(const char * root,
+    const libusbp_device_filter * filter, size_t max_count,
+    libusbp_device *** device_list, size_t * device_count)
+{
+    assert(root != NULL);
+    assert(device_list != NULL);
+    assert(device_count != NULL);
+
+    *device_list = NULL;
+    *device_count = 0;
+
+    libusbp_error * error = NULL;
+
+    char ** syspaths = NULL;
+    size_t syspath_count = 0;
+    if (error == NULL)
+    {
+        error = sysfs_get_device_syspaths(root, &syspaths, &syspath_count);
+    }
+
+    libusbp_device ** new_list = NULL;
+    size_t count = 0;
+    if (error == NULL)
+    {
+        error = device_list_create(&new_list);
+    }
+
+    for (size_t i = 0; error == NULL && i < syspath_count; i++)
+    {
+        if (max_count != 0 && count >= max_count) { break; }
+
+        const char * syspath = syspaths[i];
+        int dirfd = open(syspath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirfd == -1) { continue; }
+
+        sysfs_device_info info;
+        bool is_device;
+        libusbp_error * device_error = sysfs_read_device_info(dirfd, &info, &is_device);
+        close(dirfd);
+
+        if (device_error == NULL && is_device && sysfs_info_matches_filter(&info, filter))
+        {
+            libusbp_device * new_device;
+            device_error = sysfs_device_create_from_info(syspath, &info, &new_device);
+            if (device_error == NULL)
+            {
+                error = device_list_append(&new_list, &count, new_device);
+                if (error != NULL) { libusbp_device_free(new_device); }
+            }
+        }
+
+        if (device_error != NULL)
+        {
+            // The device was probably being unplugged.  Like the udev code in
+            // list_linux.c, we ignore this and continue.
+            #ifdef LIBUSBP_LOG
+            fprintf(stderr, "Problem adding device to list: %s\n",
+                libusbp_error_get_message(device_error));
+            #endif
+            libusbp_error_free(device_error);
+        }
+    }
+
+    if (error == NULL)
+    {
+        *device_list = new_list;
+        *device_count = count;
+        new_list = NULL;
+    }
+
+    for (size_t i = 0; i < syspath_count; i++) { free(syspaths[i]); }
+    free(syspaths);
+    free_devices_and_list(new_list);
+    return error;
+}
+
+libusbp_error * interface_syspath_create(const char * device_syspath,
+    const char * sysname, unsigned int config, uint8_t interface_number,
+    char ** syspath)
+{
+    assert(device_syspath != NULL);
+    assert(sysname != NULL);
+    assert(syspath != NULL);
+
+    *syspath = NULL;
+
+    // Room for the slash, "-0", ":<configuration>.<interface>", and the null
+    // terminator.
+    size_t size = strlen(device_syspath) + strlen(sysname) + 32;
+    char * new_syspath = malloc(size);
+    if (new_syspath == NULL)
+    {
+        return &error_no_memory;
+    }
+
+    if (strncmp(sysname, "usb", 3) == 0)
+    {
+        snprintf(new_syspath, size, "%s/%s-0:%u.%u", device_syspath,
+            sysname + 3, config, interface_number);
+    }
+    else
+    {
+        snprintf(new_syspath, size, "%s/%s:%u.%u", device_syspath,
+            sysname, config, interface_number);
+    }
+
+    *syspath = new_syspath;
+    return NULL;
+}
+
+// Checks whether a directory is the specified interface.
+static bool sysfs_is_interface(const char * syspath, uint8_t interface_number)
+{
+    int dirfd = open(syspath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd == -1) { return false; }
+
+    char str[8];
+    bool exists;
+    libusbp_error * error = sysfs_read_file_at(dirfd, "bInterfaceNumber",
+        str, sizeof(str), &exists);
+    close(dirfd);
+
+    uint8_t actual;
+    bool result = error == NULL && exists &&
+        sscanf(str, "%2hhx", &actual) == 1 && actual == interface_number;
+    libusbp_error_free(error);
+    return result;
+}
+
+// Finds the syspath of the specified interface of a USB device.  Like
+// udevw_get_interface, this tries the path where the kernel normally puts the
+// interface, and then looks at the other subdirectories of the device.
+static libusbp_error * sysfs_get_interface(const char * device_syspath,
+    uint8_t interface_number, char ** syspath)
+{
+    assert(device_syspath != NULL);
+    assert(syspath != NULL);
+
+    *syspath = NULL;
+
+    libusbp_error * error = NULL;
+
+    const char * sysname = strrchr(device_syspath, '/');
+    sysname = sysname ? sysname + 1 : device_syspath;
+
+    char config_path[PATH_MAX];
+    snprintf(config_path, sizeof(config_path), "%s/bConfigurationValue",
+        device_syspath);
+    char config_str[8];
+    bool exists;
+    error = sysfs_read_file_at(AT_FDCWD, config_path, config_str,
+        sizeof(config_str), &exists);
+
+    unsigned int config;
+    if (error == NULL && exists && sscanf(config_str, "%u", &config) == 1)
+    {
+        char * new_syspath = NULL;
+        error = interface_syspath_create(device_syspath, sysname, config,
+            interface_number, &new_syspath);
+        if (error == NULL && sysfs_is_interface(new_syspath, interface_number))
+        {
+            *syspath = new_syspath;
+            return NULL;
+        }
+        free(new_syspath);
+    }
+    if (error != NULL) { return error; }
+
+    DIR * dir = opendir(device_syspath);
+    if (dir == NULL)
+    {
+        return error_create_errno("Failed to open device directory %s.",
+            device_syspath);
+    }
+
+    struct dirent * entry;
+    while (error == NULL && *syspath == NULL && (entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.' || strchr(entry->d_name, ':') == NULL)
+        {
+            continue;
+        }
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", device_syspath, entry->d_name);
+        if (sysfs_is_interface(path, interface_number))
+        {
+            error = string_copy(path, syspath);
+        }
+    }
+    closedir(dir);
+
+    if (error == NULL && *syspath == NULL)
+    {
+        // See the comment about this error in udevw_get_interface.
+        error = error_create("Could not find interface %d.", interface_number);
+        error = error_add_code(error, LIBUSBP_ERROR_NOT_READY);
+    }
+    return error;
+}
+
+// Gets the device node of a directory from its uevent file, like
+// "/dev/bus/usb/001/007".  The returned string must be freed with
+// libusbp_string_free.
+static libusbp_error * sysfs_get_devnode(const char * syspath, char ** devnode)
+{
+    assert(syspath != NULL);
+    assert(devnode != NULL);
+
+    *devnode = NULL;
+
+    int dirfd = open(syspath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd == -1)
+    {
+        return error_create_errno("Failed to open device directory %s.", syspath);
+    }
+
+    sysfs_uevent uevent;
+    libusbp_error * error = sysfs_read_uevent_at(dirfd, &uevent);
+    close(dirfd);
+    if (error != NULL) { return error; }
+
+    const char * devname = uevent_get(&uevent, "DEVNAME");
+    if (devname == NULL)
+    {
+        return error_create("No device node exists.");
+    }
+
+    char * new_devnode = malloc(strlen(devname) + 6);
+    if (new_devnode == NULL)
+    {
+        return &error_no_memory;
+    }
+    strcpy(new_devnode, "/dev/");
+    strcat(new_devnode, devname);
+    *devnode = new_devnode;
+    return NULL;
+}
+
+libusbp_error * sysfs_find_generic_interface(const char * device_syspath,
+    uint8_t interface_number, char ** interface_syspath, char ** filename)
+{
+    assert(device_syspath != NULL);
+    assert(interface_syspath != NULL);
+    assert(filename != NULL);
+
+    *interface_syspath = NULL;
+    *filename = NULL;
+
+    libusbp_error * error = NULL;
+
+    char * new_interface_syspath = NULL;
+    if (error == NULL)
+    {
+        error = sysfs_get_interface(device_syspath, interface_number,
+            &new_interface_syspath);
+    }
+
+    // Make sure it is not attached to a kernel driver.  See the comment in
+    // libusbp_generic_interface_create_ctx.
+    if (error == NULL)
+    {
+        char driver_link[PATH_MAX];
+        char driver_path[PATH_MAX];
+        snprintf(driver_link, sizeof(driver_link), "%s/driver", new_interface_syspath);
+        ssize_t length = readlink(driver_link, driver_path, sizeof(driver_path) - 1);
+        if (length >= 0)
+        {
+            driver_path[length] = 0;
+            const char * driver_name = strrchr(driver_path, '/');
+            error = check_driver_name(driver_name ? driver_name + 1 : driver_path);
+        }
+    }
+
+    char * new_filename = NULL;
+    if (error == NULL)
+    {
+        error = sysfs_get_devnode(device_syspath, &new_filename);
+    }
+
+    if (error == NULL)
+    {
+        *interface_syspath = new_interface_syspath;
+        *filename = new_filename;
+        new_interface_syspath = NULL;
+        new_filename = NULL;
+    }
+
+    libusbp_string_free(new_interface_syspath);
+    libusbp_string_free(new_filename);
+    return error;
+}
+
+// Finds the tty directory under an interface.  A CDC ACM port looks like
+// "<interface>/tty/ttyACM0", and a USB serial converter port looks like
+// "<interface>/ttyUSB0/tty/ttyUSB0".  The returned path must be freed with
+// libusbp_string_free, and is NULL if there is no tty.
+static libusbp_error * sysfs_find_tty(const char * interface_syspath,
+    char ** tty_syspath)
+{
+    *tty_syspath = NULL;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/tty", interface_syspath);
+
+    libusbp_error * error = NULL;
+    DIR * dir = opendir(path);
+    if (dir != NULL)
+    {
+        struct dirent * entry;
+        while (error == NULL && *tty_syspath == NULL && (entry = readdir(dir)) != NULL)
+        {
+            if (entry->d_name[0] == '.') { continue; }
+            char tty_path[PATH_MAX];
+            int length = snprintf(tty_path, sizeof(tty_path), "%s/%s",
+                path, entry->d_name);
+            if (length < 0 || (size_t)length >= sizeof(tty_path)) { continue; }
+            error = string_copy(tty_path, tty_syspath);
+        }
+        closedir(dir);
+        return error;
+    }
+
+    dir = opendir(interface_syspath);
+    if (dir == NULL)
+    {
+        return error_create_errno("Failed to open interface directory %s.",
+            interface_syspath);
+    }
+
+    struct dirent * entry;
+    while (error == NULL && *tty_syspath == NULL && (entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.' || strncmp(entry->d_name, "tty", 3) != 0)
+        {
+            continue;
+        }
+        char tty_path[PATH_MAX];
+        snprintf(tty_path, sizeof(tty_path), "%s/%s/tty/%s", interface_syspath,
+            entry->d_name, entry->d_name);
+        if (access(tty_path, F_OK) == 0)
+        {
+            error = string_copy(tty_path, tty_syspath);
+        }
+    }
+    closedir(dir);
+    return error;
+}
+
+libusbp_error * sysfs_find_serial_port(const char * device_syspath,
+    uint8_t interface_number, char ** tty_syspath, char ** port_name)
+{
+    assert(device_syspath != NULL);
+    assert(tty_syspath != NULL);
+    assert(port_name != NULL);
+
+    *tty_syspath = NULL;
+    *port_name = NULL;
+
+    libusbp_error * error = NULL;
+
+    char * new_interface_syspath = NULL;
+    if (error == NULL)
+    {
+        error = sysfs_get_interface(device_syspath, interface_number,
+            &new_interface_syspath);
+    }
+
+    char * new_tty_syspath = NULL;
+    if (error == NULL)
+    {
+        error = sysfs_find_tty(new_interface_syspath, &new_tty_syspath);
+    }
+
+    if (error == NULL && new_tty_syspath == NULL)
+    {
+        // See the comment about this error in udevw_get_tty.
+        error = error_create("Could not find tty device.");
+        error = error_add_code(error, LIBUSBP_ERROR_NOT_READY);
+    }
+
+    char * new_port_name = NULL;
+    if (error == NULL)
+    {
+        error = sysfs_get_devnode(new_tty_syspath, &new_port_name);
+    }
+
+    if (error == NULL)
+    {
+        *tty_syspath = new_tty_syspath;
+        *port_name = new_port_name;
+        new_tty_syspath = NULL;
+        new_port_name = NULL;
+    }
+
+    libusbp_string_free(new_interface_syspath);
+    libusbp_string_free(new_tty_syspath);
+    libusbp_string_free(new_port_name);
+    return error;
+}
+
+libusbp_error * sysfs_find_parent_device(const char * syspath, char ** device_syspath)
+{
+    assert(syspath != NULL);
+    assert(device_syspath != NULL);
+
+    *device_syspath = NULL;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s", syspath);
+
+    char * slash;
+    while ((slash = strrchr(path, '/')) != NULL && slash != path)
+    {
+        *slash = 0;
+
+        int dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirfd == -1) { continue; }
+
+        sysfs_uevent uevent;
+        libusbp_error * error = sysfs_read_uevent_at(dirfd, &uevent);
+        close(dirfd);
+        if (error != NULL)
+        {
+            libusbp_error_free(error);
+            continue;
+        }
+
+        const char * devtype = uevent_get(&uevent, "DEVTYPE");
+        if (devtype != NULL && strcmp(devtype, "usb_device") == 0)
+        {
+            return string_copy(path, device_syspath);
+        }
+    }
+    return NULL;
+}
@@ -1,8 +1,11 @@
 /* Wrapper functions for libudev that group together certain operations and
- * provide error handling. */
+ * provide error handling.  The build system leaves this file out when
+ * LIBUSBP_USE_UDEV is off, but the drop-in library includes every file. */
 
 #include <libusbp_internal.h>
 
+#ifdef LIBUSBP_USE_UDEV
+
 // Creates a new udev context (struct udev *).  If there is no error, the caller
 // must call udev_unref at some point.
 libusbp_error * udevw_create_context(struct udev ** context)
@@ -69,11 +72,98 @@ static libusbp_error * udevw_create_child_list(
     return error;
 }
 
+// Adds a sysattr match to a udev enumeration.  The value is a glob pattern.
+static libusbp_error * udevw_add_match_sysattr(struct udev_enumerate * list,
+    const char * name, const char * value)
+{
+    int result = udev_enumerate_add_match_sysattr(list, name, value);
+    if (result != 0)
+    {
+        return error_create_udev(result, "Failed to add a sysattr match.");
+    }
+    return NULL;
+}
+
+// Adds sysattr matches to a udev enumeration for the conditions in the filter
+// that udev can check by itself.  Those checks happen before any udev_device
+// objects are made for the caller, so devices that do not match are cheap to
+// skip.  The conditions are only hints: the caller must still check the
+// filter, since some conditions cannot be expressed here.
+static libusbp_error * udevw_add_filter_matches(struct udev_enumerate * list,
+    const libusbp_device_filter * filter)
+{
+    assert(list != NULL);
+    assert(filter != NULL);
+
+    libusbp_error * error = NULL;
+    char value[32];
+
+    // udev only lets us give one value for each sysattr, so we can only match
+    // the IDs if there is one pair, or the vendor IDs are all the same.
+    if (error == NULL && filter->id_count != 0)
+    {
+        bool same_vendor = true;
+        for (size_t i = 1; i < filter->id_count; i++)
+        {
+            if (filter->ids[i].vendor_id != filter->ids[0].vendor_id)
+            {
+                same_vendor = false;
+            }
+        }
+
+        if (same_vendor)
+        {
+            snprintf(value, sizeof(value), "%04x", filter->ids[0].vendor_id);
+            error = udevw_add_match_sysattr(list, "idVendor", value);
+        }
+
+        if (error == NULL && filter->id_count == 1)
+        {
+            snprintf(value, sizeof(value), "%04x", filter->ids[0].product_id);
+            error = udevw_add_match_sysattr(list, "idProduct", value);
+        }
+    }
+
+    // Only use the serial number prefix if it has no special glob characters.
+    const char * prefix = filter->serial_number_prefix;
+    if (error == NULL && prefix != NULL && strpbrk(prefix, "*?[\\") == NULL)
+    {
+        char * pattern = malloc(strlen(prefix) + 2);
+        if (pattern == NULL)
+        {
+            error = &error_no_memory;
+        }
+        else
+        {
+            strcpy(pattern, prefix);
+            strcat(pattern, "*");
+            error = udevw_add_match_sysattr(list, "serial", pattern);
+            free(pattern);
+        }
+    }
+
+    if (error == NULL && filter->bus_number != 0)
+    {
+        snprintf(value, sizeof(value), "%u", filter->bus_number);
+        error = udevw_add_match_sysattr(list, "busnum", value);
+    }
+
+    if (error == NULL && filter->match_device_class)
+    {
+        snprintf(value, sizeof(value), "%02x", filter->device_class);
+        error = udevw_add_match_sysattr(list, "bDeviceClass", value);
+    }
+
+    return error;
+}
+
 // Creates a list (struct udev_enumerate *) of all devices in the "usb"
 // subsystem.  This includes overall USB devices (devtype == "usb_device") and
-// also interfaces (devtype == "usb_interface").  If there is no error, the
-// caller must use udev_enumerate_unref at some point.
-libusbp_error * udevw_create_usb_list(struct udev * udev, struct udev_enumerate ** list)
+// also interfaces (devtype == "usb_interface").  If the filter is not NULL,
+// udev leaves out some of the devices that do not match it.  If there is no
+// error, the caller must use udev_enumerate_unref at some point.
+libusbp_error * udevw_create_usb_list(struct udev * udev,
+    const libusbp_device_filter * filter, struct udev_enumerate ** list)
 {
     assert(udev != NULL);
     assert(list != NULL);
@@ -101,6 +191,11 @@ libusbp_error * udevw_create_usb_list(struct udev * udev, struct udev_enumerate
         }
     }
 
+    if (error == NULL && filter != NULL)
+    {
+        error = udevw_add_filter_matches(new_list, filter);
+    }
+
     if (error == NULL)
     {
         int result = udev_enumerate_scan_devices(new_list);
@@ -199,6 +294,28 @@ libusbp_error * udevw_get_sysattr_uint16(
     return NULL;
 }
 
+// Gets a sysattr with the specified name and parses it as a decimal uint8_t.
+libusbp_error * udevw_get_sysattr_dec_uint8(
+    struct udev_device * dev, const char * name, uint8_t * value)
+{
+    assert(dev != NULL);
+    assert(name != NULL);
+    assert(value != NULL);
+
+    const char * str = udev_device_get_sysattr_value(dev, name);
+    if (str == NULL)
+    {
+        return error_create("Device does not have sysattr %s.", name);
+    }
+
+    int result = sscanf(str, "%3hhu\n", value);
+    if (result != 1)
+    {
+        return error_create("Failed to parse sysattr %s.", name);
+    }
+    return NULL;
+}
+
 // Gets a sysattr string and makes a copy of it.  The string must be freed with
 // libusbp_string_free().  If the sysattr does not exists, returns a NULL string
 // instead of raising an error.
@@ -271,15 +388,95 @@ static libusbp_error * udevw_check_if_device_is_specific_interface(
     return NULL;
 }
 
-// Finds a udev device of type "usb_interface" that is a child of the specified
-// device and has the specified bInterfaceNumber.
-libusbp_error * udevw_get_interface(
+// Gets the syspath that the specified interface of a USB device would have.
+// The kernel names each interface "<device>:<configuration>.<interface>", for
+// example "1-2:1.0", and puts it in the directory of the device.  The
+// interfaces of a root hub like "usb1" are named "1-0:1.0".  The returned
+// string must be freed with libusbp_string_free.
+static libusbp_error * udevw_get_interface_syspath(
+    struct udev_device * dev, uint8_t interface_number, char ** syspath)
+{
+    assert(dev != NULL);
+    assert(syspath != NULL);
+
+    *syspath = NULL;
+
+    const char * device_syspath = udev_device_get_syspath(dev);
+    const char * sysname = udev_device_get_sysname(dev);
+    if (device_syspath == NULL || sysname == NULL)
+    {
+        return error_create("Failed to get the name of the device.");
+    }
+
+    // This is empty if the device is not configured.
+    const char * config_str = udev_device_get_sysattr_value(dev, "bConfigurationValue");
+    unsigned int config;
+    if (config_str == NULL || sscanf(config_str, "%u", &config) != 1)
+    {
+        return error_create("Failed to get the configuration of the device.");
+    }
+
+    return interface_syspath_create(device_syspath, sysname, config,
+        interface_number, syspath);
+}
+
+// Helper function for udevw_get_interface.  Looks for the interface at the
+// syspath where the kernel normally puts it.  If the interface is not there,
+// this returns a NULL device without an error.
+static libusbp_error * udevw_get_interface_directly(
     struct udev * udev,
+    struct udev_device * parent,
     const char * device_syspath,
     uint8_t interface_number,
     struct udev_device ** device)
 {
     assert(udev != NULL);
+    assert(parent != NULL);
+    assert(device_syspath != NULL);
+    assert(device != NULL);
+
+    *device = NULL;
+
+    char * syspath = NULL;
+    libusbp_error * error = udevw_get_interface_syspath(parent,
+        interface_number, &syspath);
+    if (error != NULL)
+    {
+        // The fallback in udevw_get_interface will report the problem if
+        // it cannot find the interface either.
+        libusbp_error_free(error);
+        return NULL;
+    }
+
+    struct udev_device * dev = udev_device_new_from_syspath(udev, syspath);
+    libusbp_string_free(syspath);
+    if (dev == NULL) { return NULL; }
+
+    bool correct_device = false;
+    error = udevw_check_if_device_is_specific_interface(dev, device_syspath,
+        interface_number, &correct_device);
+    if (error != NULL || !correct_device)
+    {
+        udev_device_unref(dev);
+        return error;
+    }
+
+    *device = dev;
+    return NULL;
+}
+
+// Helper function for udevw_get_interface.  Searches all the descendants of
+// the USB device for the interface.  If it is not found, this returns a NULL
+// device without an error.
+static libusbp_error * udevw_find_interface_in_children(
+    struct udev * udev,
+    struct udev_device * parent,
+    const char * device_syspath,
+    uint8_t interface_number,
+    struct udev_device ** device)
+{
+    assert(udev != NULL);
+    assert(parent != NULL);
     assert(device_syspath != NULL);
     assert(device != NULL);
 
@@ -290,13 +487,10 @@ libusbp_error * udevw_get_interface(
     struct udev_enumerate * list = NULL;
     if (error == NULL)
     {
-        // Note: It would probably be better to create a list using
-        // udev_enumerate_add_match_parent so the list is smaller.
-        error = udevw_create_usb_list(udev, &list);
+        error = udevw_create_child_list(udev, parent, &list);
     }
 
     // Loop over the list to find the device.
-    struct udev_device * found_device = NULL;
     if (error == NULL)
     {
         struct udev_list_entry * first_entry = udev_enumerate_get_list_entry(list);
@@ -324,7 +518,7 @@ libusbp_error * udevw_get_interface(
             // If it is the right device, stop looping.
             if (correct_device)
             {
-                found_device = dev;
+                *device = dev;
                 break;
             }
 
@@ -332,6 +526,49 @@ libusbp_error * udevw_get_interface(
         }
     }
 
+    if (list != NULL) { udev_enumerate_unref(list); }
+    return error;
+}
+
+// Finds a udev device of type "usb_interface" that is a child of the specified
+// device and has the specified bInterfaceNumber.
+libusbp_error * udevw_get_interface(
+    struct udev * udev,
+    const char * device_syspath,
+    uint8_t interface_number,
+    struct udev_device ** device)
+{
+    assert(udev != NULL);
+    assert(device_syspath != NULL);
+    assert(device != NULL);
+
+    *device = NULL;
+
+    libusbp_error * error = NULL;
+
+    // Get the overall USB device.
+    struct udev_device * parent = NULL;
+    if (error == NULL)
+    {
+        error = udevw_get_device_from_syspath(udev, device_syspath, &parent);
+    }
+
+    // Look for the interface where the kernel normally puts it, which avoids
+    // enumerating anything.
+    struct udev_device * found_device = NULL;
+    if (error == NULL)
+    {
+        error = udevw_get_interface_directly(udev, parent, device_syspath,
+            interface_number, &found_device);
+    }
+
+    // If it was not there, search the children of the device.
+    if (error == NULL && found_device == NULL)
+    {
+        error = udevw_find_interface_in_children(udev, parent, device_syspath,
+            interface_number, &found_device);
+    }
+
     // Make sure we found the device.
     if (error == NULL && found_device == NULL)
     {
@@ -349,7 +586,7 @@ libusbp_error * udevw_get_interface(
         *device = found_device;
     }
 
-    if (list != NULL) { udev_enumerate_unref(list); }
+    if (parent != NULL) { udev_device_unref(parent); }
     return error;
 }
 
@@ -508,8 +745,10 @@ libusbp_error * udevw_get_devnode_copy(struct udev_device * device, char ** devn
 
 // Takes a syspath as input and gets the corresponding devpath.  The returned
 // string must be freed with libusbp_string_free if there were no errors.
-libusbp_error * udevw_get_devnode_copy_from_syspath(const char * syspath, char ** devnode)
+libusbp_error * udevw_get_devnode_copy_from_syspath(struct udev * udev,
+    const char * syspath, char ** devnode)
 {
+    assert(udev != NULL);
     assert(syspath != NULL);
     assert(devnode != NULL);
 
@@ -517,16 +756,10 @@ libusbp_error * udevw_get_devnode_copy_from_syspath(const char * syspath, char *
 
     libusbp_error * error = NULL;
 
-    struct udev * context = NULL;
-    if (error == NULL)
-    {
-        error = udevw_create_context(&context);
-    }
-
     struct udev_device * device = NULL;
     if (error == NULL)
     {
-        error = udevw_get_device_from_syspath(context, syspath, &device);
+        error = udevw_get_device_from_syspath(udev, syspath, &device);
     }
 
     if (error == NULL)
@@ -535,6 +768,7 @@ libusbp_error * udevw_get_devnode_copy_from_syspath(const char * syspath, char *
     }
 
     if (device != NULL) { udev_device_unref(device); }
-    if (context != NULL) { udev_unref(context); }
     return error;
 }
+
+#endif
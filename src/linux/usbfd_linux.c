@@ -41,9 +41,87 @@ libusbp_error * usbfd_open(const char * filename, int * fd)
     return NULL;
 }
 
-// Reads the device descriptor.  This is not thread-safe, because it is possible
-// that another thread might change the position of the file descriptor after
-// lseek() and before read().
+/*! Retrieves the USBDEVFS_CAP_* flags for the device file, which tell us
+ * which optional usbfs features the kernel supports.  Kernels older than 3.6
+ * do not support USBDEVFS_GET_CAPABILITIES, so in that case we just report no
+ * capabilities. */
+libusbp_error * usbfd_get_capabilities(int fd, uint32_t * capabilities)
+{
+    assert(capabilities != NULL);
+
+    *capabilities = 0;
+
+    uint32_t result_caps = 0;
+    int result = ioctl(fd, USBDEVFS_GET_CAPABILITIES, &result_caps);
+    if (result < 0)
+    {
+        if (errno == ENOTTY || errno == EINVAL)
+        {
+            return NULL;
+        }
+
+        return error_create_errno("Failed to get usbfs capabilities.");
+    }
+
+    *capabilities = result_caps;
+    return NULL;
+}
+
+/*! Allocates a buffer for use with URBs.  If the kernel supports it (Linux 4.6
+ * and later), the buffer is allocated by calling mmap() on the device file,
+ * which gives us memory that the USB host controller can access directly, so
+ * the kernel does not need to copy the data to or from a buffer of its own.
+ *
+ * The kernel limits how much memory can be allocated this way (see
+ * usbfs_memory_mb), so if mmap() fails we fall back to a normal buffer.
+ *
+ * The retrieved "mapped" boolean must be passed to usbfd_free_buffer. */
+libusbp_error * usbfd_alloc_buffer(int fd, uint32_t capabilities,
+    size_t size, void ** buffer, bool * mapped)
+{
+    assert(size != 0);
+    assert(buffer != NULL);
+    assert(mapped != NULL);
+
+    *buffer = NULL;
+    *mapped = false;
+
+    if (capabilities & USBDEVFS_CAP_MMAP)
+    {
+        void * map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            *buffer = map;
+            *mapped = true;
+            return NULL;
+        }
+    }
+
+    *buffer = malloc(size);
+    if (*buffer == NULL)
+    {
+        return &error_no_memory;
+    }
+    return NULL;
+}
+
+void usbfd_free_buffer(void * buffer, size_t size, bool mapped)
+{
+    if (buffer == NULL) { return; }
+
+    if (mapped)
+    {
+        munmap(buffer, size);
+    }
+    else
+    {
+        free(buffer);
+    }
+}
+
+// Reads the device descriptor.  This uses pread() instead of seeking, so it
+// does not touch the position of the file descriptor and several threads can
+// call it at once.
 //
 // The kernel code that provides the device descriptor can be found in
 // usbdev_read() in devio.c.
@@ -51,15 +129,9 @@ libusbp_error * usbfd_get_device_descriptor(int fd, struct usb_device_descriptor
 {
     assert(desc != NULL);
 
-    // Seek to the beginning of the file, where the device descriptor lives.
-    off_t offset = lseek(fd, 0, SEEK_SET);
-    if (offset == -1)
-    {
-        return error_create_errno("Failed to go to beginning of USB device file.");
-    }
-
+    // The device descriptor lives at the beginning of the file.
     ssize_t expected_size = sizeof(struct usb_device_descriptor);
-    ssize_t size = read(fd, desc, expected_size);
+    ssize_t size = pread(fd, desc, expected_size, 0);
     if (size == -1)
     {
         return error_create_errno("Failed to read device descriptor.");
@@ -73,6 +145,136 @@ libusbp_error * usbfd_get_device_descriptor(int fd, struct usb_device_descriptor
     return NULL;
 }
 
+// Reads all of the descriptors that the kernel provides in the device file:
+// the device descriptor followed by the full configuration descriptor of each
+// configuration.
+static libusbp_error * usbfd_read_descriptors(int fd, uint8_t ** buffer, size_t * size)
+{
+    *buffer = NULL;
+    *size = 0;
+
+    uint8_t * new_buffer = NULL;
+    size_t new_size = 0;
+    size_t capacity = 0;
+    while (true)
+    {
+        if (new_size == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            uint8_t * bigger_buffer = realloc(new_buffer, capacity);
+            if (bigger_buffer == NULL)
+            {
+                free(new_buffer);
+                return &error_no_memory;
+            }
+            new_buffer = bigger_buffer;
+        }
+
+        ssize_t result = pread(fd, new_buffer + new_size, capacity - new_size,
+            new_size);
+        if (result == -1)
+        {
+            free(new_buffer);
+            return error_create_errno("Failed to read descriptors.");
+        }
+        if (result == 0) { break; }
+        new_size += result;
+    }
+
+    *buffer = new_buffer;
+    *size = new_size;
+    return NULL;
+}
+
+/*! Gets the transfer type and maximum packet size of each endpoint from the
+ * descriptors in the device file.  The types are USB_ENDPOINT_XFER_* values,
+ * and the arrays are indexed by endpoint number.  Entries for endpoints that
+ * are not described are set to ENDPOINT_TYPE_UNKNOWN and 0.
+ *
+ * The device file has the descriptors for every configuration and alternate
+ * setting, and an endpoint address can mean something different in each of
+ * them, so we only look at the specified configuration (a bConfigurationValue,
+ * or 0 to use the first configuration in the file).  Within it, we use the
+ * specified alternate setting of the specified interface and alternate
+ * setting 0 of the other interfaces. */
+libusbp_error * usbfd_get_endpoint_info(int fd,
+    uint8_t configuration, uint8_t interface_number, uint8_t alternate_setting,
+    uint8_t * in_types, uint8_t * out_types,
+    uint16_t * in_max_packet_sizes, uint16_t * out_max_packet_sizes)
+{
+    assert(in_types != NULL);
+    assert(out_types != NULL);
+    assert(in_max_packet_sizes != NULL);
+    assert(out_max_packet_sizes != NULL);
+
+    memset(in_types, ENDPOINT_TYPE_UNKNOWN, MAX_ENDPOINT_NUMBER + 1);
+    memset(out_types, ENDPOINT_TYPE_UNKNOWN, MAX_ENDPOINT_NUMBER + 1);
+    memset(in_max_packet_sizes, 0, (MAX_ENDPOINT_NUMBER + 1) * sizeof(uint16_t));
+    memset(out_max_packet_sizes, 0, (MAX_ENDPOINT_NUMBER + 1) * sizeof(uint16_t));
+
+    uint8_t * buffer;
+    size_t size;
+    libusbp_error * error = usbfd_read_descriptors(fd, &buffer, &size);
+    if (error != NULL)
+    {
+        return error;
+    }
+
+    // Whether the descriptors we are looking at belong to the configuration
+    // and alternate settings we want.
+    bool in_configuration = false;
+    bool in_setting = false;
+    size_t configuration_count = 0;
+
+    size_t offset = 0;
+    while (offset + 2 <= size)
+    {
+        const uint8_t * desc = buffer + offset;
+        uint8_t length = desc[0];
+        if (length < 2 || offset + length > size)
+        {
+            // The descriptors are malformed, so stop here and keep any types
+            // we found already.
+            break;
+        }
+
+        if (desc[1] == USB_DT_CONFIG && length >= USB_DT_CONFIG_SIZE)
+        {
+            in_configuration = configuration == 0 ? configuration_count == 0 :
+                desc[5] == configuration;
+            in_setting = false;
+            configuration_count++;
+        }
+        else if (desc[1] == USB_DT_INTERFACE && length >= USB_DT_INTERFACE_SIZE)
+        {
+            uint8_t wanted_setting = desc[2] == interface_number ? alternate_setting : 0;
+            in_setting = in_configuration && desc[3] == wanted_setting;
+        }
+        else if (desc[1] == USB_DT_ENDPOINT && length >= USB_DT_ENDPOINT_SIZE &&
+            in_setting)
+        {
+            uint8_t address = desc[2];
+            bool in = address & USB_ENDPOINT_DIR_MASK;
+            uint8_t * types = in ? in_types : out_types;
+            uint16_t * max_packet_sizes = in ? in_max_packet_sizes : out_max_packet_sizes;
+            uint8_t number = address & USB_ENDPOINT_NUMBER_MASK;
+            if (types[number] == ENDPOINT_TYPE_UNKNOWN)
+            {
+                types[number] = desc[3] & USB_ENDPOINT_XFERTYPE_MASK;
+
+                // Bits 11 and 12 of wMaxPacketSize are for high-bandwidth
+                // endpoints and are not part of the size.
+                max_packet_sizes[number] = (desc[4] | (desc[5] << 8)) & 0x7FF;
+            }
+        }
+
+        offset += length;
+    }
+
+    free(buffer);
+    return NULL;
+}
+
 libusbp_error * usbfd_control_transfer(int fd, libusbp_setup_packet setup,
     uint32_t timeout, void * data, size_t * transferred)
 {
@@ -104,6 +306,24 @@ libusbp_error * usbfd_control_transfer(int fd, libusbp_setup_packet setup,
     return NULL;
 }
 
+/*! Selects an alternate setting of an interface.  The kernel sends the
+ * SET_INTERFACE request and resets the endpoints of the interface, claiming the
+ * interface first if needed. */
+libusbp_error * usbfd_set_interface(int fd, uint8_t interface_number,
+    uint8_t alternate_setting)
+{
+    struct usbdevfs_setinterface setting = {0};
+    setting.interface = interface_number;
+    setting.altsetting = alternate_setting;
+
+    int result = ioctl(fd, USBDEVFS_SETINTERFACE, &setting);
+    if (result < 0)
+    {
+        return error_create_errno("");
+    }
+    return NULL;
+}
+
 /* Performs a bulk or interrupt transfer on the specified endpoint.
  *
  * Despite the name, USBDEVFS_BULK does actually work for interrupt endpoints.
@@ -169,6 +389,32 @@ libusbp_error * usbfd_submit_urb(int fd, struct usbdevfs_urb * urb)
     return NULL;
 }
 
+/*! Submits a control transfer on endpoint 0 without waiting for it.  The
+ * combined buffer holds the 8-byte setup packet followed by space for the data
+ * stage, and the size includes both.  The URB must stay valid until it is
+ * reaped, and its usercontext is set to the specified pointer.
+ *
+ * The kernel copies the data stage of an IN transfer to the buffer right after
+ * the setup packet, and the actual_length it reports does not include the
+ * setup packet. */
+libusbp_error * usbfd_control_transfer_async(int fd, struct usbdevfs_urb * urb,
+    void * combined_buffer, size_t size, void * user_context)
+{
+    assert(urb != NULL);
+    assert(combined_buffer != NULL);
+    assert(size >= 8 && size <= INT_MAX);
+
+    urb->type = USBDEVFS_URB_TYPE_CONTROL;
+    urb->endpoint = 0;
+    urb->status = 0;
+    urb->flags = 0;
+    urb->buffer = combined_buffer;
+    urb->buffer_length = size;
+    urb->actual_length = 0;
+    urb->usercontext = user_context;
+    return usbfd_submit_urb(fd, urb);
+}
+
 /*! Checks to see if there is a finished asynchronous request.  If there is,
  * this function "reaps" the request and retrieves a pointer to its URB.  The
  * kernel writes to the URB and its associated buffer when you call this
@@ -220,3 +466,33 @@ libusbp_error * usbfd_discard_urb(int fd, struct usbdevfs_urb * urb)
     }
     return NULL;
 }
+
+/*! Waits until there is a finished URB that can be reaped or the timeout
+ * elapses.  The timeout is in milliseconds, and -1 means to wait forever.
+ *
+ * The kernel reports POLLOUT on the device file when there is a URB to reap
+ * (see usbdev_poll() in devio.c), and POLLERR | POLLHUP once the device has
+ * been disconnected.  We report both cases as ready, so that reaping URBs will
+ * tell the caller about the disconnection. */
+libusbp_error * usbfd_wait(int fd, int timeout, bool * ready)
+{
+    assert(ready != NULL);
+
+    *ready = false;
+
+    struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+    int result = poll(&pfd, 1, timeout);
+    if (result < 0)
+    {
+        if (errno == EINTR)
+        {
+            // A signal interrupted us, so just return early.
+            return NULL;
+        }
+
+        return error_create_errno("Failed to wait for asynchronous transfers.");
+    }
+
+    *ready = result > 0;
+    return NULL;
+}
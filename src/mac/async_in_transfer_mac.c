@@ -168,6 +168,39 @@ libusbp_error * async_in_transfer_get_results(async_in_transfer * transfer,
     return NULL;
 }
 
+libusbp_error * async_in_transfer_peek_results(async_in_transfer * transfer,
+    const uint8_t ** buffer, size_t * transferred, libusbp_error ** transfer_error)
+{
+    assert(transfer != NULL);
+    assert(transfer->pending == false);
+
+    size_t tmp_transferred = transfer->transferred;
+
+    // Make sure we don't report more data than the buffer holds.
+    if (tmp_transferred > transfer->size)
+    {
+        assert(0);
+        tmp_transferred = transfer->size;
+    }
+
+    if (buffer != NULL)
+    {
+        *buffer = transfer->buffer;
+    }
+
+    if (transferred != NULL)
+    {
+        *transferred = tmp_transferred;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = libusbp_error_copy(transfer->error);
+    }
+
+    return NULL;
+}
+
 // This cancels all of the transfers for the whole pipe.  It is not possible to
 // cancel an individual transfer on Mac OS X, which is one of the reasons
 // individual transfers are not provided as first-class objects by the libusbp
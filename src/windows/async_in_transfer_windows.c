@@ -188,6 +188,38 @@ libusbp_error * async_in_transfer_get_results(async_in_transfer * transfer,
     return NULL;
 }
 
+libusbp_error * async_in_transfer_peek_results(async_in_transfer * transfer,
+    const uint8_t ** buffer, size_t * transferred, libusbp_error ** transfer_error)
+{
+    assert(transfer != NULL);
+    assert(!transfer->pending);
+
+    size_t tmp_transferred = transfer->transferred;
+
+    // Make sure we don't report more data than the buffer holds.
+    if (tmp_transferred > transfer->buffer_size)
+    {
+        tmp_transferred = transfer->buffer_size;
+    }
+
+    if (buffer != NULL)
+    {
+        *buffer = transfer->buffer;
+    }
+
+    if (transferred != NULL)
+    {
+        *transferred = tmp_transferred;
+    }
+
+    if (transfer_error != NULL)
+    {
+        *transfer_error = libusbp_error_copy(transfer->error);
+    }
+
+    return NULL;
+}
+
 // Cancels all of the transfers on this pipe, given one of the transfers.
 libusbp_error * async_in_transfer_cancel(async_in_transfer * transfer)
 {
@@ -0,0 +1,189 @@
+#include <test_helper.h>
+
+#ifdef __linux__
+
+TEST_CASE("async_control_pipe traits")
+{
+    SECTION("is not copy-constructible")
+    {
+        REQUIRE(std::is_copy_constructible<libusbp::async_control_pipe>::value == false);
+    }
+
+    SECTION("is not copy-assignable")
+    {
+        REQUIRE(std::is_copy_assignable<libusbp::async_control_pipe>::value == false);
+    }
+}
+
+TEST_CASE("null async_control_pipe")
+{
+    libusbp::async_control_pipe pipe;
+    std::string expected_message = "Pipe argument is null.";
+
+    SECTION("is not present")
+    {
+        CHECK_FALSE(pipe);
+    }
+
+    SECTION("cannot allocate transfers")
+    {
+        try
+        {
+            pipe.allocate_transfers(4, 32);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot submit a transfer")
+    {
+        bool submitted = true;
+        libusbp::error error(libusbp_async_control_pipe_submit_transfer(
+            NULL, 0x40, 0x90, 0, 0, NULL, 0, &submitted));
+        REQUIRE(error.message() == expected_message);
+        REQUIRE_FALSE(submitted);
+    }
+
+    SECTION("cannot handle a finished transfer")
+    {
+        bool finished = true;
+        size_t transferred = 10;
+        libusbp_error * transfer_error = get_some_error().pointer_release();
+        libusbp::error error(libusbp_async_control_pipe_handle_finished_transfer(
+            NULL, &finished, NULL, &transferred, &transfer_error));
+        REQUIRE(error.message() == expected_message);
+        REQUIRE_FALSE(finished);
+        REQUIRE(transferred == 0);
+        REQUIRE(transfer_error == NULL);
+    }
+
+    SECTION("cannot wait")
+    {
+        try
+        {
+            pipe.wait(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot cancel all transfers")
+    {
+        try
+        {
+            pipe.cancel_transfers();
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+}
+
+#ifdef USE_TEST_DEVICE_A
+
+TEST_CASE("async_control_pipe for Test Device A")
+{
+    libusbp::device device = find_test_device_a();
+    libusbp::generic_interface gi(device, 0, true);
+    libusbp::generic_handle handle(gi);
+    libusbp::async_control_pipe pipe = handle.open_async_control_pipe();
+
+    SECTION("complains if transfers were not allocated")
+    {
+        try
+        {
+            pipe.submit_transfer(0x40, 0x90, 1, 0);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Pipe transfers have not been allocated yet.");
+        }
+    }
+
+    SECTION("does not accept data larger than the transfer size")
+    {
+        pipe.allocate_transfers(1, 8);
+        uint8_t buffer[9] = {0};
+        try
+        {
+            pipe.submit_transfer(0x40, 0x92, 0, 0, buffer, sizeof(buffer));
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Data size is larger than the transfer size.");
+        }
+    }
+
+    SECTION("can write and read data with several requests in flight")
+    {
+        pipe.allocate_transfers(3, 40);
+
+        char buffer1[40] = "hello there";
+        uint16_t size = strlen(buffer1) + 1;
+        REQUIRE(pipe.submit_transfer(0x40, 0x92, 0, 0, buffer1, size));
+        REQUIRE(pipe.submit_transfer(0xC0, 0x91, 0, 12, NULL, 20));
+        REQUIRE(pipe.submit_transfer(0x40, 0x90, 1, 0));
+
+        // All of the transfers are in use now.
+        REQUIRE_FALSE(pipe.submit_transfer(0x40, 0x90, 0, 0));
+
+        test_timeout timeout(500);
+        size_t finish_count = 0;
+        while(pipe.has_pending_transfers())
+        {
+            pipe.wait(100);
+            char buffer2[40] = {0};
+            size_t transferred;
+            libusbp::error transfer_error;
+            while(pipe.handle_finished_transfer(buffer2, &transferred, &transfer_error))
+            {
+                if (transfer_error) { throw transfer_error; }
+                if (finish_count == 0)
+                {
+                    REQUIRE(transferred == size);
+                }
+                else if (finish_count == 1)
+                {
+                    REQUIRE(transferred == size);
+                    REQUIRE(std::string(buffer2) == buffer1);
+                }
+                else
+                {
+                    REQUIRE(transferred == 0);
+                }
+                finish_count++;
+            }
+            timeout.check();
+        }
+        REQUIRE(finish_count == 3);
+    }
+
+    SECTION("reports errors for invalid requests")
+    {
+        pipe.allocate_transfers(1, 0);
+        REQUIRE(pipe.submit_transfer(0x40, 0x48, 0, 0));
+
+        test_timeout timeout(500);
+        libusbp::error transfer_error;
+        while(!pipe.handle_finished_transfer(NULL, NULL, &transfer_error))
+        {
+            pipe.wait(100);
+            timeout.check();
+        }
+        REQUIRE(transfer_error);
+    }
+}
+
+#endif
+
+#endif
@@ -212,6 +212,163 @@ TEST_CASE("null async_in_pipe")
         CHECK_FALSE(error);
     }
 
+#ifdef __linux__
+    SECTION("cannot handle a finished transfer with timestamps")
+    {
+        bool finished = true;
+        libusbp_transfer_times times = { 1, 2 };
+        libusbp::error error(libusbp_async_in_pipe_handle_finished_transfer_ex(
+            NULL, &finished, NULL, NULL, &times, NULL));
+        REQUIRE(error.message() == expected_message);
+        CHECK_FALSE(finished);
+        CHECK(times.submit_time_ns == 0);
+        CHECK(times.complete_time_ns == 0);
+    }
+
+    SECTION("cannot enable a stream")
+    {
+        try
+        {
+            pipe.enable_stream(4096);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot peek at a stream")
+    {
+        const uint8_t * data = (const uint8_t *)1;
+        size_t size = 10;
+        libusbp::error error(libusbp_async_in_pipe_stream_peek(NULL, &data, &size, NULL));
+        REQUIRE(error.message() == expected_message);
+        REQUIRE(data == NULL);
+        REQUIRE(size == 0);
+    }
+
+    SECTION("cannot consume from a stream")
+    {
+        try
+        {
+            pipe.stream_consume(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot enable auto-tuning")
+    {
+        try
+        {
+            pipe.enable_auto_tuning(NULL);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot set a callback")
+    {
+        try
+        {
+            pipe.set_callback(NULL, NULL);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot get transfer info")
+    {
+        size_t count = 1, size = 1;
+        libusbp::error error(libusbp_async_in_pipe_get_transfer_info(NULL, &count, &size));
+        REQUIRE(error.message() == expected_message);
+        REQUIRE(count == 0);
+        REQUIRE(size == 0);
+    }
+
+    SECTION("cannot set the timestamp clock")
+    {
+        try
+        {
+            pipe.set_timestamp_clock(LIBUSBP_CLOCK_MONOTONIC_RAW);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot enable a completion queue")
+    {
+        try
+        {
+            pipe.enable_completion_queue(4);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot wait")
+    {
+        try
+        {
+            pipe.wait(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+#endif
+
+    SECTION("cannot borrow a finished transfer")
+    {
+        const uint8_t * data = (const uint8_t *)"hi";
+        size_t transferred = 10;
+        libusbp::error error = get_some_error();
+        try
+        {
+            pipe.borrow_finished_transfer(&data, &transferred, &error);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+        CHECK(data == NULL);
+        CHECK(transferred == 0);
+        CHECK_FALSE(error);
+    }
+
+    SECTION("cannot release a transfer")
+    {
+        uint8_t buffer[1];
+        try
+        {
+            pipe.release_transfer(buffer);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
     SECTION("cannot cancel all transfers")
     {
         try
@@ -224,6 +381,21 @@ TEST_CASE("null async_in_pipe")
             REQUIRE(error.message() == expected_message);
         }
     }
+
+#ifdef __linux__
+    SECTION("cannot cancel and drain all transfers")
+    {
+        try
+        {
+            pipe.cancel_transfers_and_drain(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+#endif
 }
 
 TEST_CASE("async_in_pipe parameter validation and state checks")
@@ -336,6 +508,24 @@ TEST_CASE("async_in_pipe parameter validation and state checks")
             REQUIRE(error.message() == "Boolean output pointer is null.");
         }
     }
+
+#ifdef __linux__
+    SECTION("set_timestamp_clock")
+    {
+        SECTION("rejects unknown clocks")
+        {
+            try
+            {
+                pipe.set_timestamp_clock(2);
+                REQUIRE(0);
+            }
+            catch(const libusbp::error & error)
+            {
+                REQUIRE(error.message() == "Invalid timestamp clock: 2.");
+            }
+        }
+    }
+#endif
 }
 
 TEST_CASE("async_in_pipe for an interrupt endpoint")
@@ -473,6 +663,25 @@ TEST_CASE("async_in_pipe for an interrupt endpoint")
         clean_up_async_in_pipe_and_expect_a_success(pipe);
     }
 
+#ifdef __linux__
+    SECTION("cancelling and draining transfers")
+    {
+        pipe.allocate_transfers(20, transfer_size);
+        pipe.start_endless_transfers();
+        sleep_ms(10);
+        pipe.handle_events();
+
+        test_timeout timeout(1000);
+        pipe.cancel_transfers_and_drain(1000);
+        timeout.check();
+        REQUIRE_FALSE(pipe.has_pending_transfers());
+        REQUIRE_FALSE(pipe.handle_finished_transfer(NULL, NULL, NULL));
+
+        // Draining a pipe with nothing pending returns immediately.
+        pipe.cancel_transfers_and_drain(1);
+    }
+#endif
+
     SECTION("cancelling a partially completed transfer")
     {
         // Note: This test seems to always fail on Windows Vista and Windows 7
@@ -729,6 +938,130 @@ TEST_CASE("async_in_pipe for an interrupt endpoint")
     }
 
     #ifdef __linux__
+    SECTION("can wait for transfers instead of polling")
+    {
+        pipe.allocate_transfers(2, transfer_size);
+
+        // There is nothing to wait for yet.
+        pipe.wait(0);
+        REQUIRE_FALSE(pipe.handle_finished_transfer(NULL, NULL, NULL));
+
+        pipe.start_endless_transfers();
+
+        size_t finish_count = 0;
+        while(finish_count < 4)
+        {
+            pipe.wait(500);
+
+            uint8_t buffer[transfer_size] = {0};
+            libusbp::error transfer_error;
+            if (!pipe.handle_finished_transfer(buffer, NULL, &transfer_error))
+            {
+                throw "Wait returned before a transfer finished.";
+            }
+            if (transfer_error) { throw transfer_error; }
+            if (buffer[4] != 0xAB) { throw "Wrong data."; }
+            finish_count++;
+            timeout.check();
+        }
+
+        clean_up_async_in_pipe(pipe);
+    }
+    #endif
+
+    #ifdef __linux__
+    SECTION("can copy finished transfers into several pieces of memory")
+    {
+        pipe.allocate_transfers(2, transfer_size);
+
+        uint8_t header[4], tail[1];
+        libusbp_iovec iov[] = { { header, sizeof(header) }, { tail, sizeof(tail) } };
+
+        try
+        {
+            pipe.handle_finished_transfer_v(iov, 1, NULL, NULL);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Buffers are smaller than the transfer size.");
+        }
+
+        pipe.start_endless_transfers();
+        pipe.wait(500);
+
+        size_t transferred;
+        libusbp::error transfer_error;
+        REQUIRE(pipe.handle_finished_transfer_v(iov, 2, &transferred, &transfer_error));
+        REQUIRE_FALSE(transfer_error);
+        REQUIRE(transferred == transfer_size);
+        REQUIRE(tail[0] == 0xAB);
+
+        clean_up_async_in_pipe(pipe);
+    }
+
+    SECTION("can tune its transfers while running")
+    {
+        // Test Device A fills every transfer, so the tuner should use bigger
+        // transfers.
+        const size_t max_size = transfer_size * 4;
+        pipe.allocate_transfers(4, transfer_size);
+        libusbp_async_in_tuning settings = { 4, 16, transfer_size, max_size, 0, 0 };
+        pipe.enable_auto_tuning(&settings);
+        pipe.start_endless_transfers();
+
+        test_timeout tune_timeout(3000);
+        size_t size = transfer_size;
+        while(size == transfer_size)
+        {
+            pipe.wait(100);
+
+            uint8_t buffer[max_size] = {0};
+            size_t transferred;
+            libusbp::error transfer_error;
+            while(pipe.handle_finished_transfer(buffer, &transferred, &transfer_error))
+            {
+                if (transfer_error) { throw transfer_error; }
+                if (transferred % transfer_size != 0) { throw "Wrong size."; }
+                if (buffer[4] != 0xAB) { throw "Wrong data."; }
+            }
+
+            pipe.get_transfer_info(NULL, &size);
+            tune_timeout.check();
+        }
+        REQUIRE(size == transfer_size * 2);
+
+        clean_up_async_in_pipe(pipe);
+    }
+
+    SECTION("records when each transfer was submitted and completed")
+    {
+        pipe.allocate_transfers(2, transfer_size);
+        pipe.set_timestamp_clock(LIBUSBP_CLOCK_MONOTONIC_RAW);
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+        uint64_t start = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+        pipe.start_endless_transfers();
+        pipe.wait(500);
+
+        uint8_t buffer[transfer_size] = {0};
+        libusbp_transfer_times times;
+        libusbp::error transfer_error;
+        REQUIRE(pipe.handle_finished_transfer_ex(buffer, NULL, &times, &transfer_error));
+        REQUIRE_FALSE(transfer_error);
+        REQUIRE(buffer[4] == 0xAB);
+
+        clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+        uint64_t end = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+        CHECK(times.submit_time_ns >= start);
+        CHECK(times.complete_time_ns >= times.submit_time_ns);
+        CHECK(times.complete_time_ns <= end);
+
+        clean_up_async_in_pipe(pipe);
+    }
+
     SECTION("does not prevent the creation of another generic_interface object")
     {
         // It seems that the "usbfs" driver gets attached to the device
@@ -747,4 +1080,449 @@ TEST_CASE("async_in_pipe for an interrupt endpoint")
     #endif
 }
 
+TEST_CASE("async_in_pipe borrowing transfers")
+{
+    libusbp::device device = find_test_device_a();
+    libusbp::generic_interface gi(device, 0, true);
+    libusbp::generic_handle handle(gi);
+    libusbp::async_in_pipe pipe = handle.open_async_in_pipe(0x82);
+    const size_t transfer_size = 5;
+
+    test_timeout timeout(500);
+
+    SECTION("cannot release a pointer that was not borrowed")
+    {
+        pipe.allocate_transfers(2, transfer_size);
+        uint8_t buffer[transfer_size];
+        try
+        {
+            pipe.release_transfer(buffer);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() ==
+                "Data pointer does not belong to a borrowed transfer.");
+        }
+    }
+
+    SECTION("borrowed transfers are resubmitted after they are released")
+    {
+        pipe.allocate_transfers(2, transfer_size);
+        pipe.start_endless_transfers();
+
+        // Borrow both transfers.
+        const uint8_t * data[2] = { NULL, NULL };
+        size_t borrow_count = 0;
+        while(borrow_count < 2)
+        {
+            size_t transferred;
+            libusbp::error transfer_error;
+            if (pipe.borrow_finished_transfer(&data[borrow_count],
+                &transferred, &transfer_error))
+            {
+                if (transfer_error) { throw transfer_error; }
+                if (transferred != transfer_size) { throw "Wrong size."; }
+                if (data[borrow_count][4] != 0xAB) { throw "Wrong data."; }
+                borrow_count++;
+            }
+
+            pipe.handle_events();
+            timeout.check();
+            sleep_quick();
+        }
+        REQUIRE(data[0] != data[1]);
+
+        // Nothing is left in the ring until we give the transfers back.
+        REQUIRE_FALSE(pipe.has_pending_transfers());
+
+        // Either transfer is submitted again as soon as it is released.
+        pipe.release_transfer(data[1]);
+        REQUIRE(pipe.has_pending_transfers());
+
+        pipe.release_transfer(data[0]);
+        REQUIRE(pipe.has_pending_transfers());
+
+        // A transfer can only be released once.
+        try
+        {
+            pipe.release_transfer(data[0]);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() ==
+                "Data pointer does not belong to a borrowed transfer.");
+        }
+
+        clean_up_async_in_pipe(pipe);
+    }
+
+    SECTION("other transfers keep going while one is borrowed")
+    {
+        pipe.allocate_transfers(3, transfer_size);
+        pipe.start_endless_transfers();
+
+        const uint8_t * borrowed = NULL;
+        size_t finish_count = 0;
+        while(finish_count < 10)
+        {
+            if (borrowed == NULL)
+            {
+                pipe.borrow_finished_transfer(&borrowed, NULL, NULL);
+            }
+            else
+            {
+                uint8_t buffer[transfer_size];
+                if (pipe.handle_finished_transfer(buffer, NULL, NULL)) { finish_count++; }
+            }
+
+            pipe.handle_events();
+            timeout.check();
+            sleep_quick();
+        }
+
+        pipe.release_transfer(borrowed);
+        clean_up_async_in_pipe(pipe);
+    }
+}
+
+#ifdef __linux__
+static void read_from_completion_queue(libusbp::generic_handle & handle,
+    libusbp::async_in_pipe & pipe)
+{
+    const size_t transfer_size = 5;
+    pipe.allocate_transfers(4, transfer_size);
+    pipe.enable_completion_queue(8);
+    pipe.start_endless_transfers();
+
+    test_timeout timeout(500);
+    size_t finish_count = 0;
+    while(finish_count < 20)
+    {
+        pipe.wait(100);
+
+        uint8_t buffer[transfer_size] = {0};
+        size_t transferred;
+        libusbp_transfer_times times;
+        libusbp::error transfer_error;
+        while(pipe.handle_finished_transfer_ex(buffer, &transferred, &times, &transfer_error))
+        {
+            if (transfer_error) { throw transfer_error; }
+            if (transferred != transfer_size) { throw "Wrong size."; }
+            if (buffer[4] != 0xAB) { throw "Wrong data."; }
+            if (times.submit_time_ns == 0 || times.complete_time_ns < times.submit_time_ns)
+            {
+                throw "Wrong timestamps.";
+            }
+            finish_count++;
+        }
+        timeout.check();
+    }
+
+    // Let the queue fill up so that some transfers get parked.
+    usleep(50000);
+
+    pipe.cancel_transfers();
+    while(pipe.has_pending_transfers())
+    {
+        pipe.wait(100);
+        libusbp::error transfer_error;
+        while(pipe.handle_finished_transfer(NULL, NULL, &transfer_error))
+        {
+            check_error_for_cancelled_transfer(transfer_error);
+        }
+        timeout.check();
+    }
+
+    (void)handle;
+}
+
+TEST_CASE("async_in_pipe with a stream")
+{
+    libusbp::device device = find_test_device_a();
+    libusbp::generic_interface gi(device, 0, true);
+    libusbp::generic_handle handle(gi);
+    libusbp::async_in_pipe pipe = handle.open_async_in_pipe(0x82);
+    const size_t transfer_size = 5;
+
+    SECTION("complains if transfers were not allocated")
+    {
+        try
+        {
+            pipe.enable_stream(4096);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Pipe transfers have not been allocated yet.");
+        }
+    }
+
+    SECTION("complains if the buffer cannot hold all of the transfers")
+    {
+        pipe.allocate_transfers(1000, transfer_size);
+        try
+        {
+            pipe.enable_stream(4096);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Failed to enable stream.  "
+                "Stream buffer size must be at least the transfer count times "
+                "the transfer size.");
+        }
+    }
+
+    SECTION("does not allow transfers to be handled one at a time")
+    {
+        pipe.allocate_transfers(1, transfer_size);
+        pipe.enable_stream(4096);
+        try
+        {
+            pipe.handle_finished_transfer(NULL, NULL, NULL);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() ==
+                "Transfers cannot be handled one at a time for a pipe with a stream.");
+        }
+    }
+
+    SECTION("cannot consume more than is available")
+    {
+        pipe.allocate_transfers(1, transfer_size);
+        pipe.enable_stream(4096);
+        try
+        {
+            pipe.stream_consume(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Cannot consume more data than is available.");
+        }
+    }
+
+    SECTION("delivers contiguous data across the end of the ring")
+    {
+        // Consume the data in pieces that do not line up with the transfers,
+        // and read more than the ring holds so the data wraps around.
+        pipe.allocate_transfers(8, transfer_size);
+        pipe.enable_stream(4096);
+        handle.start_reaper_thread();
+        pipe.start_endless_transfers();
+
+        test_timeout timeout(5000);
+        size_t offset = 0;
+        while(offset < 5000)
+        {
+            pipe.wait(100);
+
+            const uint8_t * data;
+            libusbp::error transfer_error;
+            size_t size = pipe.stream_peek(&data, &transfer_error);
+            if (transfer_error) { throw transfer_error; }
+
+            size_t consumed = size - size % 3;
+            for (size_t i = 0; i < consumed; i++)
+            {
+                if ((offset + i) % transfer_size == 4 && data[i] != 0xAB)
+                {
+                    throw "Wrong data.";
+                }
+            }
+            pipe.stream_consume(consumed);
+            offset += consumed;
+            timeout.check();
+        }
+
+        pipe.cancel_transfers_and_drain(500);
+        REQUIRE_FALSE(pipe.has_pending_transfers());
+        handle.stop_reaper_thread();
+    }
+}
+
+struct callback_counts
+{
+    size_t calls;
+    size_t wrong_data;
+    size_t errors;
+};
+
+static void count_callback(void * context, const uint8_t * data,
+    size_t transferred, const libusbp_error * transfer_error,
+    const libusbp_transfer_times * times)
+{
+    callback_counts * counts = (callback_counts *)context;
+    if (transfer_error != NULL)
+    {
+        __atomic_add_fetch(&counts->errors, 1, __ATOMIC_RELAXED);
+    }
+    else if (transferred != 5 || data[4] != 0xAB ||
+        times->complete_time_ns < times->submit_time_ns)
+    {
+        __atomic_add_fetch(&counts->wrong_data, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch(&counts->calls, 1, __ATOMIC_RELEASE);
+}
+
+TEST_CASE("async_in_pipe with a callback")
+{
+    libusbp::device device = find_test_device_a();
+    libusbp::generic_interface gi(device, 0, true);
+    libusbp::generic_handle handle(gi);
+    libusbp::async_in_pipe pipe = handle.open_async_in_pipe(0x82);
+    callback_counts counts = { 0, 0, 0 };
+
+    SECTION("complains if transfers were not allocated")
+    {
+        try
+        {
+            pipe.set_callback(count_callback, &counts);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Pipe transfers have not been allocated yet.");
+        }
+    }
+
+    SECTION("does not allow transfers to be handled one at a time")
+    {
+        pipe.allocate_transfers(1, 5);
+        pipe.set_callback(count_callback, &counts);
+        try
+        {
+            pipe.handle_finished_transfer(NULL, NULL, NULL);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() ==
+                "Transfers are passed to the callback for a pipe with a callback.");
+        }
+    }
+
+    SECTION("cannot be combined with a stream")
+    {
+        pipe.allocate_transfers(1, 5);
+        pipe.set_callback(count_callback, &counts);
+        try
+        {
+            pipe.enable_stream(4096);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "A pipe with a callback cannot have a stream.");
+        }
+    }
+
+    SECTION("calls the callback from the reaper thread")
+    {
+        pipe.allocate_transfers(4, 5);
+        pipe.set_callback(count_callback, &counts);
+        handle.start_reaper_thread();
+        pipe.start_endless_transfers();
+
+        test_timeout timeout(5000);
+        while (__atomic_load_n(&counts.calls, __ATOMIC_ACQUIRE) < 20)
+        {
+            pipe.wait(100);
+            timeout.check();
+        }
+
+        pipe.cancel_transfers_and_drain(500);
+        REQUIRE_FALSE(pipe.has_pending_transfers());
+        handle.stop_reaper_thread();
+        REQUIRE(counts.wrong_data == 0);
+
+        // Only the cancelled transfers can have errors.
+        REQUIRE(counts.errors <= 4);
+
+        // The pipe can be started again after it was cancelled.
+        size_t calls = counts.calls;
+        pipe.start_endless_transfers();
+        while (__atomic_load_n(&counts.calls, __ATOMIC_ACQUIRE) < calls + 4)
+        {
+            pipe.wait(100);
+            timeout.check();
+        }
+        pipe.cancel_transfers_and_drain(500);
+        REQUIRE_FALSE(pipe.has_pending_transfers());
+        pipe.set_callback(NULL, NULL);
+    }
+}
+
+TEST_CASE("async_in_pipe with a completion queue")
+{
+    libusbp::device device = find_test_device_a();
+    libusbp::generic_interface gi(device, 0, true);
+    libusbp::generic_handle handle(gi);
+    libusbp::async_in_pipe pipe = handle.open_async_in_pipe(0x82);
+
+    SECTION("complains if transfers were not allocated")
+    {
+        try
+        {
+            pipe.enable_completion_queue(4);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Pipe transfers have not been allocated yet.");
+        }
+    }
+
+    SECTION("cannot be combined with auto-tuning")
+    {
+        pipe.allocate_transfers(1, 5);
+        libusbp_async_in_tuning settings = { 1, 4, 5, 20, 0, 0 };
+        pipe.enable_auto_tuning(&settings);
+        try
+        {
+            pipe.enable_completion_queue(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() ==
+                "A pipe with auto-tuning cannot have a completion queue.");
+        }
+    }
+
+    SECTION("does not allow transfers to be borrowed")
+    {
+        pipe.allocate_transfers(1, 5);
+        pipe.enable_completion_queue(1);
+        const uint8_t * data;
+        try
+        {
+            pipe.borrow_finished_transfer(&data, NULL, NULL);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() ==
+                "Transfers cannot be borrowed from a pipe with a completion queue.");
+        }
+    }
+
+    SECTION("works without a reaper thread")
+    {
+        read_from_completion_queue(handle, pipe);
+    }
+
+    SECTION("works with a reaper thread")
+    {
+        handle.start_reaper_thread();
+        read_from_completion_queue(handle, pipe);
+        handle.stop_reaper_thread();
+    }
+}
+#endif
+
 #endif
@@ -0,0 +1,146 @@
+#include <test_helper.h>
+
+#if defined(__linux__) && !defined(NDEBUG)
+
+// Feeds finished transfers to the tuner, one every interval_ns nanoseconds,
+// until it asks for new transfers or max_transfers is reached.  Returns true
+// if the tuner asked for new transfers.
+static bool feed_tuner(async_in_tuner * tuner, uint64_t & time,
+    size_t max_transfers, uint64_t interval_ns, size_t transferred, bool underrun,
+    size_t * new_count, size_t * new_size)
+{
+    for (size_t i = 0; i < max_transfers; i++)
+    {
+        libusbp_transfer_times times;
+        times.submit_time_ns = underrun ? time + 1 : time - 1;
+        time += interval_ns;
+        times.complete_time_ns = time;
+        if (async_in_tuner_record(tuner, transferred, &times, new_count, new_size))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST_CASE("async_in_tuner_create")
+{
+    libusbp_async_in_tuning settings = { 2, 64, 64, 4096, 0, 0 };
+    async_in_tuner * tuner = NULL;
+
+    SECTION("rejects null settings")
+    {
+        libusbp::error error(async_in_tuner_create(NULL, 4, 64, &tuner));
+        REQUIRE(error.message() == "Tuning settings pointer is null.");
+        REQUIRE(tuner == NULL);
+    }
+
+    SECTION("rejects minimums of zero")
+    {
+        settings.min_transfer_size = 0;
+        libusbp::error error(async_in_tuner_create(&settings, 4, 64, &tuner));
+        REQUIRE(error.message() == "Minimum transfer count and size cannot be zero.");
+    }
+
+    SECTION("rejects maximums less than the minimums")
+    {
+        settings.max_transfer_count = 1;
+        libusbp::error error(async_in_tuner_create(&settings, 4, 64, &tuner));
+        REQUIRE(error.message() ==
+            "Maximum transfer count and size cannot be less than the minimums.");
+    }
+
+    SECTION("rejects current transfers outside of the limits")
+    {
+        libusbp::error error(async_in_tuner_create(&settings, 4, 32, &tuner));
+        REQUIRE(error.message() ==
+            "The current transfer count and size are not within the tuning limits.");
+    }
+
+    SECTION("rejects current transfers that use too much memory")
+    {
+        settings.max_memory = 128;
+        libusbp::error error(async_in_tuner_create(&settings, 4, 64, &tuner));
+        REQUIRE(error.message() ==
+            "The current transfers use more memory than the tuning limit.");
+    }
+}
+
+TEST_CASE("async_in_tuner")
+{
+    libusbp_async_in_tuning settings = { 2, 64, 64, 4096, 0, 0 };
+    async_in_tuner * tuner = NULL;
+    uint64_t time = 1000000000;
+    size_t count, size;
+
+    SECTION("uses more transfers after an underrun")
+    {
+        REQUIRE_FALSE(libusbp::error(async_in_tuner_create(&settings, 4, 64, &tuner)));
+        REQUIRE(feed_tuner(tuner, time, 1000, 1000000, 32, true, &count, &size));
+        REQUIRE(count == 8);
+        REQUIRE(size == 64);
+    }
+
+    SECTION("uses bigger transfers if they are full")
+    {
+        REQUIRE_FALSE(libusbp::error(async_in_tuner_create(&settings, 4, 64, &tuner)));
+        REQUIRE(feed_tuner(tuner, time, 1000, 1000000, 64, false, &count, &size));
+        REQUIRE(count == 4);
+        REQUIRE(size == 128);
+    }
+
+    SECTION("uses smaller transfers if they are mostly empty")
+    {
+        REQUIRE_FALSE(libusbp::error(async_in_tuner_create(&settings, 4, 1024, &tuner)));
+        REQUIRE(feed_tuner(tuner, time, 1000, 1000000, 10, false, &count, &size));
+        REQUIRE(count == 4);
+        REQUIRE(size == 512);
+    }
+
+    SECTION("keeps transfers that are partly full")
+    {
+        REQUIRE_FALSE(libusbp::error(async_in_tuner_create(&settings, 4, 1024, &tuner)));
+        REQUIRE_FALSE(feed_tuner(tuner, time, 1000, 1000000, 700, false, &count, &size));
+    }
+
+    SECTION("uses smaller transfers if they take too long to fill")
+    {
+        // 1024 bytes every 100 ms is much slower than the 20 ms target.
+        settings.target_latency_ms = 20;
+        REQUIRE_FALSE(libusbp::error(async_in_tuner_create(&settings, 4, 1024, &tuner)));
+        REQUIRE(feed_tuner(tuner, time, 1000, 100000000, 1024, false, &count, &size));
+        REQUIRE(size == 512);
+    }
+
+    SECTION("uses bigger transfers if they fill well within the target latency")
+    {
+        settings.target_latency_ms = 20;
+        REQUIRE_FALSE(libusbp::error(async_in_tuner_create(&settings, 4, 64, &tuner)));
+        REQUIRE(feed_tuner(tuner, time, 1000, 1000000, 64, false, &count, &size));
+        REQUIRE(size == 128);
+    }
+
+    SECTION("stays within the memory limit")
+    {
+        settings.max_memory = 4 * 64;
+        REQUIRE_FALSE(libusbp::error(async_in_tuner_create(&settings, 4, 64, &tuner)));
+        REQUIRE_FALSE(feed_tuner(tuner, time, 1000, 1000000, 64, true, &count, &size));
+    }
+
+    SECTION("starts over after the transfers change")
+    {
+        REQUIRE_FALSE(libusbp::error(async_in_tuner_create(&settings, 4, 64, &tuner)));
+        REQUIRE(feed_tuner(tuner, time, 1000, 1000000, 64, false, &count, &size));
+        async_in_tuner_set_transfers(tuner, count, size);
+
+        // The new transfers need a whole window of their own before the tuner
+        // decides anything.
+        REQUIRE_FALSE(feed_tuner(tuner, time, 8, 1000000, 128, false, &count, &size));
+        REQUIRE(feed_tuner(tuner, time, 1000, 1000000, 128, false, &count, &size));
+        REQUIRE(size == 256);
+    }
+
+    async_in_tuner_free(tuner);
+}
+
+#endif
@@ -0,0 +1,319 @@
+#include <test_helper.h>
+
+#ifdef __linux__
+
+const uint8_t out_pipe_id = 0x03;
+
+#ifdef USE_TEST_DEVICE_A
+static void wait_for_async_out_pipe(libusbp::async_out_pipe & pipe,
+    size_t * success_count)
+{
+    test_timeout timeout(500);
+    while(pipe.has_pending_transfers())
+    {
+        pipe.handle_events();
+        libusbp::error transfer_error;
+        size_t transferred;
+        while(pipe.handle_finished_transfer(&transferred, &transfer_error))
+        {
+            if (transfer_error) { throw transfer_error; }
+            if (success_count != NULL) { (*success_count)++; }
+        }
+        timeout.check();
+        sleep_quick();
+    }
+}
+#endif
+
+TEST_CASE("async_out_pipe traits")
+{
+    SECTION("is not copy-constructible")
+    {
+        REQUIRE(std::is_copy_constructible<libusbp::async_out_pipe>::value == false);
+    }
+
+    SECTION("is not copy-assignable")
+    {
+        REQUIRE(std::is_copy_assignable<libusbp::async_out_pipe>::value == false);
+    }
+}
+
+TEST_CASE("null async_out_pipe")
+{
+    libusbp::async_out_pipe pipe;
+    std::string expected_message = "Pipe argument is null.";
+
+    SECTION("is not present")
+    {
+        CHECK_FALSE(pipe);
+    }
+
+    SECTION("cannot allocate transfers")
+    {
+        try
+        {
+            pipe.allocate_transfers(4, 32);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot submit a transfer")
+    {
+        uint8_t buffer[32] = {0};
+        bool submitted = true;
+        libusbp::error error(libusbp_async_out_pipe_submit_transfer(
+            NULL, buffer, sizeof(buffer), &submitted));
+        REQUIRE(error.message() == expected_message);
+        REQUIRE_FALSE(submitted);
+    }
+
+    SECTION("cannot submit a transfer with flags")
+    {
+        uint8_t buffer[32] = {0};
+        bool submitted = true;
+        libusbp::error error(libusbp_async_out_pipe_submit_transfer_with_flags(
+            NULL, buffer, sizeof(buffer), LIBUSBP_TRANSFER_ZERO_PACKET, &submitted));
+        REQUIRE(error.message() == expected_message);
+        REQUIRE_FALSE(submitted);
+    }
+
+    SECTION("cannot handle a finished transfer")
+    {
+        bool finished = true;
+        size_t transferred = 10;
+        libusbp_error * transfer_error = get_some_error().pointer_release();
+        libusbp::error error(libusbp_async_out_pipe_handle_finished_transfer(
+            NULL, &finished, &transferred, &transfer_error));
+        REQUIRE(error.message() == expected_message);
+        REQUIRE_FALSE(finished);
+        REQUIRE(transferred == 0);
+        REQUIRE(transfer_error == NULL);
+    }
+
+    SECTION("cannot wait")
+    {
+        try
+        {
+            pipe.wait(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot cancel all transfers")
+    {
+        try
+        {
+            pipe.cancel_transfers();
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+}
+
+#ifdef USE_TEST_DEVICE_A
+
+TEST_CASE("async_out_pipe parameter validation and state checks")
+{
+    libusbp::device device = find_test_device_a();
+    libusbp::generic_interface gi(device, 0, true);
+    libusbp::generic_handle handle(gi);
+
+    SECTION("cannot be opened for an IN endpoint")
+    {
+        try
+        {
+            handle.open_async_out_pipe(0x82);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Invalid pipe ID 0x82.");
+        }
+    }
+
+    libusbp::async_out_pipe pipe = handle.open_async_out_pipe(out_pipe_id);
+
+    SECTION("complains if transfers were not allocated")
+    {
+        uint8_t buffer[32] = {0};
+        try
+        {
+            pipe.submit_transfer(buffer, sizeof(buffer));
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Pipe transfers have not been allocated yet.");
+        }
+    }
+
+    SECTION("does not accept data larger than the transfer size")
+    {
+        pipe.allocate_transfers(1, 32);
+        uint8_t buffer[33] = {0};
+        try
+        {
+            pipe.submit_transfer(buffer, sizeof(buffer));
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Data size is larger than the transfer size.");
+        }
+    }
+}
+
+TEST_CASE("async_out_pipe on a bulk endpoint")
+{
+    libusbp::device device = find_test_device_a();
+    libusbp::generic_interface gi(device, 0, true);
+    libusbp::generic_handle handle(gi);
+    libusbp::async_out_pipe pipe = handle.open_async_out_pipe(out_pipe_id);
+
+    SECTION("can queue several packets and finish them in order")
+    {
+        pipe.allocate_transfers(4, 32);
+
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            uint8_t buffer[32] = { 0x92, (uint8_t)(0x40 + i) };
+            REQUIRE(pipe.submit_transfer(buffer, sizeof(buffer)));
+        }
+
+        // All of the transfers are in use now.
+        uint8_t buffer[32] = { 0x92, 0x50 };
+        REQUIRE_FALSE(pipe.submit_transfer(buffer, sizeof(buffer)));
+
+        size_t success_count = 0;
+        wait_for_async_out_pipe(pipe, &success_count);
+        REQUIRE(success_count == 4);
+
+        // The last packet written should be the one the device remembers.
+        uint8_t buffer2[1];
+        size_t transferred;
+        handle.control_transfer(0xC0, 0x91, 0, 1, buffer2, 1, &transferred);
+        REQUIRE(transferred == 1);
+        REQUIRE(buffer2[0] == 0x43);
+    }
+
+    SECTION("can send zero-length packets")
+    {
+        pipe.allocate_transfers(1, 32);
+        REQUIRE(pipe.submit_transfer(NULL, 0));
+        wait_for_async_out_pipe(pipe, NULL);
+
+        uint8_t buffer2[1];
+        size_t transferred;
+        handle.control_transfer(0xC0, 0x91, 0, 1, buffer2, 1, &transferred);
+        REQUIRE(buffer2[0] == 0x66);
+    }
+
+    SECTION("can send a zero-length packet after a full transfer")
+    {
+        // The device remembers 0x66 when it gets a zero-length packet, so
+        // that is what we should read back instead of 0x45.
+        pipe.allocate_transfers(1, 32);
+        uint8_t buffer[32] = { 0x92, 0x45 };
+        REQUIRE(pipe.submit_transfer_with_flags(buffer, sizeof(buffer),
+            LIBUSBP_TRANSFER_ZERO_PACKET));
+        wait_for_async_out_pipe(pipe, NULL);
+
+        uint8_t buffer2[1];
+        size_t transferred;
+        handle.control_transfer(0xC0, 0x91, 0, 1, buffer2, 1, &transferred);
+        REQUIRE(buffer2[0] == 0x66);
+    }
+
+    SECTION("uses the flags of the pipe")
+    {
+        handle.set_pipe_flags(out_pipe_id, LIBUSBP_TRANSFER_ZERO_PACKET);
+        pipe.allocate_transfers(1, 32);
+        uint8_t buffer[32] = { 0x92, 0x46 };
+        REQUIRE(pipe.submit_transfer(buffer, sizeof(buffer)));
+        wait_for_async_out_pipe(pipe, NULL);
+
+        uint8_t buffer2[1];
+        size_t transferred;
+        handle.control_transfer(0xC0, 0x91, 0, 1, buffer2, 1, &transferred);
+        REQUIRE(buffer2[0] == 0x66);
+    }
+
+    SECTION("wait returns immediately if nothing is pending")
+    {
+        pipe.allocate_transfers(1, 32);
+        test_timeout timeout(50);
+        pipe.wait(0);
+        timeout.check();
+    }
+
+    SECTION("wait returns when the timeout elapses or the transfer finishes")
+    {
+        // The packet makes the device wait for 100 ms before accepting
+        // another packet, so the second transfer will take a while.
+        pipe.allocate_transfers(2, 32);
+        uint8_t buffer[32] = { 0xDE, 100, 0 };
+        REQUIRE(pipe.submit_transfer(buffer, sizeof(buffer)));
+        uint8_t buffer2[32] = { 0x92, 0x44 };
+        REQUIRE(pipe.submit_transfer(buffer2, sizeof(buffer2)));
+
+        pipe.wait(0);
+        REQUIRE(pipe.handle_finished_transfer(NULL, NULL));
+
+        pipe.wait(10);
+        REQUIRE_FALSE(pipe.handle_finished_transfer(NULL, NULL));
+
+        pipe.wait(500);
+        REQUIRE(pipe.handle_finished_transfer(NULL, NULL));
+        REQUIRE_FALSE(pipe.has_pending_transfers());
+    }
+
+    SECTION("can cancel transfers")
+    {
+        // The first packet makes the device wait for 100 ms, so the other
+        // transfers will still be pending when we cancel them.
+        pipe.allocate_transfers(4, 32 * 3);
+        uint8_t buffer[32 * 3] = { 0xDE, 100, 0 };
+        for (int i = 0; i < 4; i++)
+        {
+            REQUIRE(pipe.submit_transfer(buffer, sizeof(buffer)));
+        }
+        pipe.cancel_transfers();
+
+        size_t cancel_count = 0;
+        test_timeout timeout(1000);
+        while(pipe.has_pending_transfers())
+        {
+            pipe.handle_events();
+            libusbp::error transfer_error;
+            while(pipe.handle_finished_transfer(NULL, &transfer_error))
+            {
+                if (transfer_error.has_code(LIBUSBP_ERROR_CANCELLED))
+                {
+                    cancel_count++;
+                }
+                else if (transfer_error)
+                {
+                    throw transfer_error;
+                }
+            }
+            timeout.check();
+            sleep_quick();
+        }
+        REQUIRE(cancel_count > 0);
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+#include <test_helper.h>
+
+// The coroutine header needs C++20, so this file only has tests when the build
+// compiles it that way (see CMakeLists.txt).
+#if defined(__linux__) && defined(__cpp_impl_coroutine) && __cplusplus >= 202002L
+
+#include <libusbp_coro.hpp>
+
+static libusbp::task<int> add_one(int x)
+{
+    co_return x + 1;
+}
+
+static libusbp::task<int> add_two(int x)
+{
+    int y = co_await add_one(x);
+    co_return co_await add_one(y);
+}
+
+static libusbp::task<void> fail()
+{
+    throw std::runtime_error("failed");
+    co_return;
+}
+
+static libusbp::task<void> set_flag(bool & flag)
+{
+    flag = true;
+    co_return;
+}
+
+TEST_CASE("task and executor")
+{
+    libusbp::generic_handle handle;
+    libusbp::executor exec(handle);
+
+    SECTION("does not start a task until it is run")
+    {
+        bool flag = false;
+        libusbp::task<void> t = set_flag(flag);
+        REQUIRE_FALSE(flag);
+        REQUIRE_FALSE(t.done());
+        exec.run(std::move(t));
+        REQUIRE(flag);
+    }
+
+    SECTION("returns values from nested tasks")
+    {
+        REQUIRE(exec.run(add_two(40)) == 42);
+        REQUIRE(exec.idle());
+    }
+
+    SECTION("rethrows exceptions from tasks")
+    {
+        REQUIRE_THROWS_WITH(exec.run(fail()), "failed");
+    }
+
+    SECTION("rethrows exceptions from spawned tasks")
+    {
+        REQUIRE_THROWS_WITH(exec.spawn(fail()), "failed");
+    }
+}
+
+#ifdef USE_TEST_DEVICE_A
+
+static libusbp::task<size_t> echo(libusbp::executor & exec,
+    libusbp::async_control_pipe & pipe, const char * message)
+{
+    uint16_t size = strlen(message) + 1;
+    libusbp::transfer_result r = co_await exec.control(pipe, 0x40, 0x92, 0, 0,
+        (void *)message, size);
+    if (r.transfer_error) { throw r.transfer_error; }
+
+    char buffer[40] = {0};
+    r = co_await exec.control(pipe, 0xC0, 0x91, 0, size, buffer, size);
+    if (r.transfer_error) { throw r.transfer_error; }
+    if (std::string(buffer) != message) { throw "Wrong data."; }
+    co_return r.transferred;
+}
+
+static libusbp::task<void> read_some(libusbp::executor & exec,
+    libusbp::async_in_pipe & pipe, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t buffer[5];
+        libusbp::transfer_result r = co_await exec.next(pipe, buffer);
+        if (r.transfer_error) { throw r.transfer_error; }
+        if (r.transferred != 5 || buffer[4] != 0xAB) { throw "Wrong data."; }
+    }
+}
+
+TEST_CASE("executor for Test Device A")
+{
+    libusbp::device device = find_test_device_a();
+    libusbp::generic_interface gi(device, 0, true);
+    libusbp::generic_handle handle(gi);
+    libusbp::executor exec(handle);
+
+    SECTION("performs control transfers")
+    {
+        libusbp::async_control_pipe pipe = handle.open_async_control_pipe();
+        pipe.allocate_transfers(2, 40);
+        REQUIRE(exec.run(echo(exec, pipe, "hello there")) == 12);
+    }
+
+    SECTION("reads from an IN pipe while other tasks run")
+    {
+        libusbp::async_control_pipe control_pipe = handle.open_async_control_pipe();
+        control_pipe.allocate_transfers(1, 40);
+        libusbp::async_in_pipe pipe = handle.open_async_in_pipe(0x82);
+        pipe.allocate_transfers(4, 5);
+        pipe.start_endless_transfers();
+
+        exec.spawn(read_some(exec, pipe, 10));
+        REQUIRE(exec.run(echo(exec, control_pipe, "hi")) == 3);
+
+        test_timeout timeout(500);
+        while (!exec.idle())
+        {
+            exec.run_once(100);
+            timeout.check();
+        }
+
+        pipe.cancel_transfers_and_drain(500);
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+#include <test_helper.h>
+
+#ifdef __linux__
+
+TEST_CASE("null device_index")
+{
+    libusbp::device_index index;
+    std::string expected_message = "Device index argument is null.";
+
+    SECTION("is not present")
+    {
+        CHECK_FALSE(index);
+    }
+
+    SECTION("has an invalid file descriptor")
+    {
+        REQUIRE(index.get_fd() == -1);
+    }
+
+    SECTION("cannot be updated")
+    {
+        bool changed = true;
+        libusbp::error error(libusbp_device_index_update(NULL, &changed));
+        REQUIRE(error.message() == expected_message);
+        REQUIRE_FALSE(changed);
+    }
+
+    SECTION("cannot find devices")
+    {
+        const libusbp_device * device = (const libusbp_device *)1;
+        libusbp::error error(libusbp_device_index_find(NULL, 1, 2, NULL, &device));
+        REQUIRE(error.message() == expected_message);
+        REQUIRE(device == NULL);
+    }
+}
+
+TEST_CASE("device_index parameter validation")
+{
+    SECTION("complains if the index output pointer is NULL")
+    {
+        libusbp::error error(libusbp_device_index_create(NULL, NULL));
+        REQUIRE(error.message() == "Device index output pointer is null.");
+    }
+
+    libusbp::device_index index = libusbp::device_index::create();
+
+    SECTION("complains if the device output pointer is NULL")
+    {
+        libusbp::error error(libusbp_device_index_find(
+            index.pointer_get(), 1, 2, NULL, NULL));
+        REQUIRE(error.message() == "Device output pointer is null.");
+    }
+
+    SECTION("complains if the OS ID is NULL")
+    {
+        const libusbp_device * device;
+        libusbp::error error(libusbp_device_index_find_by_os_id(
+            index.pointer_get(), NULL, &device));
+        REQUIRE(error.message() == "Device OS ID is null.");
+    }
+
+    SECTION("complains if the count output pointer is NULL")
+    {
+        libusbp::error error(libusbp_device_index_get_count(index.pointer_get(), NULL));
+        REQUIRE(error.message() == "Count output pointer is null.");
+    }
+}
+
+TEST_CASE("device_index contents")
+{
+    libusbp::context context = libusbp::context::create();
+    libusbp::device_index index = libusbp::device_index::create(context);
+    std::vector<libusbp::device> list = context.list_connected_devices();
+
+    SECTION("has the connected devices")
+    {
+        // A device could be plugged in or removed while this test runs, but
+        // that is unlikely.
+        REQUIRE(index.get_count() == list.size());
+        for (const libusbp::device & device : list)
+        {
+            libusbp::device found = index.find_by_os_id(device.get_os_id());
+            REQUIRE(found);
+            CHECK(found.get_vendor_id() == device.get_vendor_id());
+
+            std::string serial_number;
+            const char * serial_pointer = NULL;
+            try
+            {
+                serial_number = device.get_serial_number();
+                serial_pointer = serial_number.c_str();
+            }
+            catch(const libusbp::error & error)
+            {
+                REQUIRE(error.has_code(LIBUSBP_ERROR_NO_SERIAL_NUMBER));
+            }
+            found = index.find(device.get_vendor_id(), device.get_product_id(),
+                serial_pointer);
+            REQUIRE(found);
+            CHECK(found.get_product_id() == device.get_product_id());
+        }
+    }
+
+    SECTION("returns null devices when nothing matches")
+    {
+        CHECK_FALSE(index.find_by_os_id("/sys/devices/no/such/device"));
+        CHECK_FALSE(index.find(0xABCD, 0x1234, "no such serial number"));
+    }
+
+    SECTION("can be updated with no events")
+    {
+        CHECK_FALSE(index.update());
+        REQUIRE(index.get_fd() > 2);
+    }
+}
+
+#endif
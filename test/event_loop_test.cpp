@@ -0,0 +1,218 @@
+#include <test_helper.h>
+
+#ifdef __linux__
+
+TEST_CASE("event_loop traits")
+{
+    SECTION("is not copy-constructible")
+    {
+        REQUIRE(std::is_copy_constructible<libusbp::event_loop>::value == false);
+    }
+
+    SECTION("is not copy-assignable")
+    {
+        REQUIRE(std::is_copy_assignable<libusbp::event_loop>::value == false);
+    }
+}
+
+TEST_CASE("null event_loop")
+{
+    libusbp::event_loop loop;
+    std::string expected_message = "Event loop argument is null.";
+
+    SECTION("is not present")
+    {
+        CHECK_FALSE(loop);
+    }
+
+    SECTION("has an invalid file descriptor")
+    {
+        REQUIRE(loop.get_fd() == -1);
+    }
+
+    SECTION("cannot handle events")
+    {
+        try
+        {
+            loop.handle_events();
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot wait")
+    {
+        try
+        {
+            loop.wait(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+}
+
+TEST_CASE("event_loop with no handles")
+{
+    libusbp::event_loop loop = libusbp::event_loop::create();
+
+    SECTION("is present")
+    {
+        REQUIRE(loop);
+        REQUIRE(loop.get_fd() > 2);
+    }
+
+    SECTION("can handle events and wait")
+    {
+        loop.handle_events();
+        loop.wait(1);
+    }
+
+    SECTION("cannot add a null handle")
+    {
+        libusbp::generic_handle handle;
+        try
+        {
+            loop.add_handle(handle);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Generic handle is null.");
+        }
+    }
+
+    SECTION("cannot add a null pipe")
+    {
+        libusbp::async_in_pipe pipe;
+        try
+        {
+            loop.add_async_in_pipe(pipe);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Pipe argument is null.");
+        }
+    }
+}
+
+#ifdef USE_TEST_DEVICE_A
+TEST_CASE("event_loop with Test Device A")
+{
+    libusbp::device device = find_test_device_a();
+    libusbp::generic_interface gi(device, 0, true);
+    libusbp::generic_handle handle(gi);
+    libusbp::async_in_pipe pipe = handle.open_async_in_pipe(0x82);
+    libusbp::event_loop loop = libusbp::event_loop::create();
+
+    SECTION("cannot remove a handle that was not added")
+    {
+        try
+        {
+            loop.remove_handle(handle);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Generic handle is not in the event loop.");
+        }
+    }
+
+    SECTION("counts how many times a handle was added")
+    {
+        loop.add_handle(handle);
+        loop.add_async_in_pipe(pipe);
+        loop.remove_handle(handle);
+        loop.remove_async_in_pipe(pipe);
+        try
+        {
+            loop.remove_handle(handle);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Generic handle is not in the event loop.");
+        }
+    }
+
+    SECTION("rejects a handle with a reaper thread")
+    {
+        handle.start_reaper_thread();
+        try
+        {
+            loop.add_handle(handle);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Failed to add generic handle to event loop.  "
+                "A handle with a reaper thread cannot be added to an event loop.");
+        }
+        handle.stop_reaper_thread();
+
+        // The failed attempt did not count as adding the handle.
+        loop.add_handle(handle);
+        loop.remove_handle(handle);
+        handle.start_reaper_thread();
+        handle.stop_reaper_thread();
+    }
+
+    SECTION("does not let a handle in the loop start a reaper thread")
+    {
+        loop.add_handle(handle);
+        try
+        {
+            handle.start_reaper_thread();
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() ==
+                "A handle in an event loop cannot have a reaper thread.");
+        }
+        loop.remove_handle(handle);
+    }
+
+    SECTION("dispatches completed transfers to the pipe")
+    {
+        loop.add_async_in_pipe(pipe);
+        pipe.allocate_transfers(2, 5);
+        pipe.start_endless_transfers();
+
+        test_timeout timeout(500);
+        size_t finish_count = 0;
+        while(finish_count < 4)
+        {
+            loop.wait(100);
+
+            uint8_t buffer[5] = {0};
+            libusbp::error transfer_error;
+            while(pipe.handle_finished_transfer(buffer, NULL, &transfer_error))
+            {
+                if (transfer_error) { throw transfer_error; }
+                if (buffer[4] != 0xAB) { throw "Wrong data."; }
+                finish_count++;
+            }
+            timeout.check();
+        }
+
+        pipe.cancel_transfers();
+        while(pipe.has_pending_transfers())
+        {
+            loop.wait(100);
+            while(pipe.handle_finished_transfer(NULL, NULL, NULL)) { }
+            timeout.check();
+        }
+
+        loop.remove_async_in_pipe(pipe);
+    }
+}
+#endif
+
+#endif
@@ -1,4 +1,5 @@
 #include <test_helper.h>
+#include <thread>
 
 TEST_CASE("generic_handle traits")
 {
@@ -111,6 +112,88 @@ TEST_CASE("null generic_handle")
         }
     }
 
+#ifdef __linux__
+    SECTION("cannot wait")
+    {
+        try
+        {
+            handle.wait(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Generic handle is null.");
+        }
+    }
+
+    SECTION("cannot start a reaper thread")
+    {
+        try
+        {
+            handle.start_reaper_thread();
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Generic handle is null.");
+        }
+    }
+
+    SECTION("cannot set zero-copy mode")
+    {
+        try
+        {
+            handle.set_zero_copy(false);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Generic handle is null.");
+        }
+    }
+
+    SECTION("cannot set pipe flags")
+    {
+        try
+        {
+            handle.set_pipe_flags(0x02, LIBUSBP_TRANSFER_ZERO_PACKET);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Generic handle is null.");
+        }
+    }
+
+    SECTION("cannot select an alternate setting")
+    {
+        try
+        {
+            handle.set_alternate_setting(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Generic handle is null.");
+        }
+    }
+
+    SECTION("cannot read or write pieces of memory")
+    {
+        uint8_t buffer[4];
+        libusbp_iovec iov = { buffer, sizeof(buffer) };
+        size_t transferred = 1;
+        libusbp::error error(libusbp_write_pipe_v(NULL, 0x02, &iov, 1, &transferred));
+        REQUIRE(error.message() == "Generic handle is null.");
+        REQUIRE(transferred == 0);
+
+        transferred = 1;
+        error.pointer_reset(libusbp_read_pipe_v(NULL, 0x82, &iov, 1, &transferred));
+        REQUIRE(error.message() == "Generic handle is null.");
+        REQUIRE(transferred == 0);
+    }
+#endif
+
     SECTION("exports invalid underlying handles")
     {
 #if defined(_WIN32)
@@ -249,6 +332,153 @@ TEST_CASE("generic_handle creation for Test Device A")
     }
 #endif
 }
+
+#ifdef __linux__
+// Runs the function over and over on its own thread until the time runs out,
+// and counts how many times it ran.  If it throws, the exception is saved so
+// the test can report it.
+class stress_thread
+{
+public:
+    template<class F>
+    stress_thread(F f, uint32_t duration_ms) : count(0)
+    {
+        thread = std::thread([this, f, duration_ms]()
+        {
+            test_timeout timeout(duration_ms);
+            try
+            {
+                while (timeout.get_milliseconds() < duration_ms)
+                {
+                    f();
+                    count++;
+                }
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+        });
+    }
+
+    size_t join()
+    {
+        thread.join();
+        if (exception) { std::rethrow_exception(exception); }
+        return count;
+    }
+
+private:
+    std::thread thread;
+    size_t count;
+    std::exception_ptr exception;
+};
+
+TEST_CASE("generic_handle shared by several threads")
+{
+    libusbp::device device = find_test_device_a();
+    libusbp::generic_interface gi(device, 0, true);
+    libusbp::generic_handle handle(gi);
+    const uint32_t duration_ms = 1000;
+
+    // Unpause the ADC if it was paused by some previous test.
+    handle.control_transfer(0x40, 0xA0, 0, 0);
+
+    libusbp::async_in_pipe in_pipe = handle.open_async_in_pipe(0x82);
+    in_pipe.allocate_transfers(4, 5);
+    in_pipe.start_endless_transfers();
+
+    libusbp::async_control_pipe control_pipe = handle.open_async_control_pipe();
+    control_pipe.allocate_transfers(1, 0);
+
+    auto read_in_pipe = [&]()
+    {
+        // Both this thread and the LED thread wait on the handle, so each of
+        // them can reap the other's URBs.
+        uint8_t buffer[5];
+        libusbp::error transfer_error;
+        in_pipe.wait(500);
+        if (in_pipe.handle_finished_transfer(buffer, NULL, &transfer_error))
+        {
+            if (transfer_error) { throw transfer_error; }
+            if (buffer[4] != 0xAB) { throw "Wrong data."; }
+        }
+    };
+
+    uint16_t led = 0;
+    auto toggle_led = [&]()
+    {
+        led ^= 1;
+        if (!control_pipe.submit_transfer(0x40, 0x90, led, 0))
+        {
+            throw "Control transfer not submitted.";
+        }
+        libusbp::error transfer_error;
+        test_timeout timeout(500);
+        while (!control_pipe.handle_finished_transfer(NULL, NULL, &transfer_error))
+        {
+            control_pipe.wait(100);
+            timeout.check();
+        }
+        if (transfer_error) { throw transfer_error; }
+    };
+
+    auto write_out_pipe = [&]()
+    {
+        // Test Device A discards packets that do not start with a command.
+        uint8_t buffer[5] = { 0 };
+        size_t transferred;
+        handle.write_pipe(0x03, buffer, sizeof(buffer), &transferred);
+        if (transferred != sizeof(buffer)) { throw "Wrong size written."; }
+    };
+
+    auto echo = [&]()
+    {
+        char buffer1[] = "hello";
+        char buffer2[sizeof(buffer1)] = { 0 };
+        size_t transferred;
+        handle.control_transfer(0x40, 0x92, 0, 0, buffer1, sizeof(buffer1), &transferred);
+        handle.control_transfer(0xC0, 0x91, 0, sizeof(buffer1),
+            buffer2, sizeof(buffer2), &transferred);
+        if (std::string(buffer2) != buffer1) { throw "Wrong data."; }
+    };
+
+    auto set_timeouts = [&]()
+    {
+        handle.set_timeout(0x82, 1000);
+        handle.set_timeout(0x03, 1000);
+        sleep_quick();
+    };
+
+    SECTION("without a reaper thread")
+    {
+        stress_thread t1(read_in_pipe, duration_ms);
+        stress_thread t2(toggle_led, duration_ms);
+        stress_thread t3(write_out_pipe, duration_ms);
+        stress_thread t4(echo, duration_ms);
+        stress_thread t5(set_timeouts, duration_ms);
+        CHECK(t1.join() > 0);
+        CHECK(t2.join() > 0);
+        CHECK(t3.join() > 0);
+        CHECK(t4.join() > 0);
+        CHECK(t5.join() > 0);
+    }
+
+    SECTION("with a reaper thread")
+    {
+        handle.start_reaper_thread();
+        stress_thread t1(read_in_pipe, duration_ms);
+        stress_thread t2(toggle_led, duration_ms);
+        stress_thread t3(write_out_pipe, duration_ms);
+        CHECK(t1.join() > 0);
+        CHECK(t2.join() > 0);
+        CHECK(t3.join() > 0);
+        handle.stop_reaper_thread();
+    }
+
+    in_pipe.cancel_transfers_and_drain(500);
+}
+#endif
 #endif
 
 #ifdef USE_TEST_DEVICE_B
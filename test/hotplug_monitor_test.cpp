@@ -0,0 +1,395 @@
+#include <test_helper.h>
+
+#ifdef __linux__
+
+TEST_CASE("hotplug_monitor traits")
+{
+    SECTION("is not copy-constructible")
+    {
+        REQUIRE(std::is_copy_constructible<libusbp::hotplug_monitor>::value == false);
+    }
+
+    SECTION("is not copy-assignable")
+    {
+        REQUIRE(std::is_copy_assignable<libusbp::hotplug_monitor>::value == false);
+    }
+}
+
+TEST_CASE("null hotplug_monitor")
+{
+    libusbp::hotplug_monitor monitor;
+    std::string expected_message = "Hotplug monitor argument is null.";
+
+    SECTION("is not present")
+    {
+        CHECK_FALSE(monitor);
+    }
+
+    SECTION("has an invalid file descriptor")
+    {
+        REQUIRE(monitor.get_fd() == -1);
+    }
+
+    SECTION("cannot receive events")
+    {
+        uint32_t event = 44;
+        try
+        {
+            monitor.receive(&event);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+        REQUIRE(event == 0);
+    }
+
+    SECTION("cannot wait")
+    {
+        try
+        {
+            monitor.wait(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+}
+
+TEST_CASE("hotplug_monitor parameter validation")
+{
+    SECTION("complains if the monitor output pointer is NULL")
+    {
+        libusbp::error error(libusbp_hotplug_monitor_create(NULL, NULL));
+        REQUIRE(error.message() == "Hotplug monitor output pointer is null.");
+    }
+
+    SECTION("complains if the device output pointer is NULL")
+    {
+        libusbp::hotplug_monitor monitor = libusbp::hotplug_monitor::create();
+        uint32_t event = 44;
+        libusbp::error error(libusbp_hotplug_monitor_receive(
+            monitor.pointer_get(), &event, NULL));
+        REQUIRE(error.message() == "Device output pointer is null.");
+        REQUIRE(event == 0);
+    }
+}
+
+TEST_CASE("hotplug_monitor with no events")
+{
+    SECTION("can be created with or without a context")
+    {
+        libusbp::context context = libusbp::context::create();
+        libusbp::hotplug_monitor monitor1 = libusbp::hotplug_monitor::create(context);
+        libusbp::hotplug_monitor monitor2 = libusbp::hotplug_monitor::create();
+        REQUIRE(monitor1);
+        REQUIRE(monitor2);
+        REQUIRE(monitor1.get_fd() > 2);
+        REQUIRE(monitor1.get_fd() != monitor2.get_fd());
+    }
+
+    SECTION("can wait and receive nothing")
+    {
+        libusbp::hotplug_monitor monitor = libusbp::hotplug_monitor::create();
+        monitor.wait(1);
+        uint32_t event = 44;
+        libusbp::device device = monitor.receive(&event);
+        REQUIRE_FALSE(device);
+        REQUIRE(event == 0);
+    }
+}
+
+
+// A uevent made up by a test, with properties in a map and devices that come
+// from a sysfs context.
+class fake_uevent
+{
+public:
+    fake_uevent(libusbp::context & context, const char * action,
+        const char * subsystem, const char * devtype, const std::string & syspath)
+        : context(context), syspath(syspath)
+    {
+        uevent.action = action;
+        uevent.subsystem = subsystem;
+        uevent.devtype = devtype;
+        uevent.syspath = this->syspath.c_str();
+        uevent.initialized = true;
+        uevent.get_property = get_property;
+        uevent.create_device = create_device;
+        uevent.create_parent_device = create_parent_device;
+        uevent.context = this;
+    }
+
+    // Converts the event.  Returns a null device if it was skipped.
+    libusbp::device convert(uint32_t * event)
+    {
+        libusbp_device * device;
+        libusbp::throw_if_needed(hotplug_uevent_convert(&uevent, event, &device));
+        return libusbp::device(device);
+    }
+
+    hotplug_uevent uevent;
+    std::map<std::string, std::string> properties;
+    std::string parent_syspath;
+
+private:
+    libusbp::context & context;
+    std::string syspath;
+
+    static libusbp_error * copy_device(fake_uevent * self,
+        const std::string & syspath, libusbp_device ** device)
+    {
+        libusbp::device found = find_in_list(
+            self->context.list_connected_devices(), syspath);
+        REQUIRE(found);
+        return libusbp_device_copy(found.pointer_get(), device);
+    }
+
+    static const char * get_property(void * context, const char * key)
+    {
+        fake_uevent * self = (fake_uevent *)context;
+        auto it = self->properties.find(key);
+        if (it == self->properties.end()) { return NULL; }
+        return it->second.c_str();
+    }
+
+    static libusbp_error * create_device(void * context, libusbp_device ** device)
+    {
+        fake_uevent * self = (fake_uevent *)context;
+        return copy_device(self, self->syspath, device);
+    }
+
+    static libusbp_error * create_parent_device(void * context, libusbp_device ** device)
+    {
+        fake_uevent * self = (fake_uevent *)context;
+        *device = NULL;
+        if (self->parent_syspath.empty()) { return NULL; }
+        return copy_device(self, self->parent_syspath, device);
+    }
+};
+
+TEST_CASE("hotplug_uevent_convert")
+{
+    sysfs_fixture fixture;
+    libusbp::context context = libusbp::context::create_sysfs(fixture.root.c_str());
+    std::string pci = fixture.root + "/devices/pci0000:00/0000:00:14.0";
+    uint32_t event = 44;
+
+    SECTION("reports added devices")
+    {
+        fake_uevent uevent(context, "add", "usb", "usb_device", pci + "/usb1/1-2");
+        libusbp::device device = uevent.convert(&event);
+        REQUIRE(device);
+        CHECK(event == LIBUSBP_HOTPLUG_DEVICE_ADDED);
+        CHECK(device.get_os_id() == pci + "/usb1/1-2");
+        CHECK(device.get_serial_number() == "12345678");
+    }
+
+    SECTION("skips added devices that are not initialized")
+    {
+        fake_uevent uevent(context, "add", "usb", "usb_device", pci + "/usb1/1-2");
+        uevent.uevent.initialized = false;
+        CHECK_FALSE(uevent.convert(&event));
+        CHECK(event == 0);
+    }
+
+    SECTION("reports removed devices using their properties")
+    {
+        fake_uevent uevent(context, "remove", "usb", "usb_device", "/sys/devices/gone/1-4");
+        uevent.uevent.initialized = false;
+        uevent.properties["PRODUCT"] = "1ffb/da02/1a0";
+        uevent.properties["ID_SERIAL_SHORT"] = "00ABCDEF";
+        libusbp::device device = uevent.convert(&event);
+        REQUIRE(device);
+        CHECK(event == LIBUSBP_HOTPLUG_DEVICE_REMOVED);
+        CHECK(device.get_os_id() == "/sys/devices/gone/1-4");
+        CHECK(device.get_vendor_id() == 0x1FFB);
+        CHECK(device.get_product_id() == 0xDA02);
+        CHECK(device.get_revision() == 0x1A0);
+        CHECK(device.get_serial_number() == "00ABCDEF");
+    }
+
+    SECTION("reports removed devices without a serial number")
+    {
+        fake_uevent uevent(context, "remove", "usb", "usb_device", "/sys/devices/gone/1-4");
+        uevent.properties["PRODUCT"] = "10c4/ea60/100";
+        libusbp::device device = uevent.convert(&event);
+        REQUIRE(device);
+        CHECK(device.get_product_id() == 0xEA60);
+        char * serial_number;
+        libusbp::error error(libusbp_device_get_serial_number(
+            device.pointer_get(), &serial_number));
+        CHECK(error.message() == "Device does not have a serial number.");
+    }
+
+    SECTION("complains if a removed device has no PRODUCT property")
+    {
+        fake_uevent uevent(context, "remove", "usb", "usb_device", "/sys/devices/gone/1-4");
+        uevent.properties["PRODUCT"] = "1ffb";
+        try
+        {
+            uevent.convert(&event);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Failed to get the PRODUCT property of the device.");
+        }
+    }
+
+    SECTION("reports serial ports as their parent devices")
+    {
+        fake_uevent uevent(context, "add", "tty", NULL,
+            pci + "/usb1/1-2/1-2:1.2/tty/ttyACM0");
+        uevent.parent_syspath = pci + "/usb1/1-2";
+        libusbp::device device = uevent.convert(&event);
+        REQUIRE(device);
+        CHECK(event == LIBUSBP_HOTPLUG_SERIAL_PORT_ADDED);
+        CHECK(device.get_os_id() == pci + "/usb1/1-2");
+
+        fake_uevent removal(context, "remove", "tty", NULL,
+            pci + "/usb1/1-2/1-2:1.2/tty/ttyACM0");
+        removal.parent_syspath = pci + "/usb1/1-2";
+        REQUIRE(removal.convert(&event));
+        CHECK(event == LIBUSBP_HOTPLUG_SERIAL_PORT_REMOVED);
+    }
+
+    SECTION("skips serial ports without a parent device")
+    {
+        fake_uevent uevent(context, "remove", "tty", NULL, "/sys/devices/gone/ttyACM1");
+        CHECK_FALSE(uevent.convert(&event));
+        CHECK(event == 0);
+    }
+
+    SECTION("skips other events")
+    {
+        CHECK_FALSE(fake_uevent(context, "change", "usb", "usb_device",
+            pci + "/usb1/1-2").convert(&event));
+        CHECK_FALSE(fake_uevent(context, "add", "usb", "usb_interface",
+            pci + "/usb1/1-2/1-2:1.0").convert(&event));
+        CHECK_FALSE(fake_uevent(context, "add", "input", NULL,
+            pci + "/usb1/1-2/1-2:1.0/input0").convert(&event));
+        CHECK(event == 0);
+    }
+}
+
+TEST_CASE("hotplug_kernel_uevent_convert")
+{
+    sysfs_fixture fixture;
+    std::string pci = "/devices/pci0000:00/0000:00:14.0";
+    uint32_t event = 44;
+
+    // Makes a message like the kernel sends, with the properties separated by
+    // null characters.
+    auto message = [](const std::string & action, const std::string & devpath,
+        const std::string & properties)
+    {
+        std::string m = action + "@" + devpath + '\0' + "ACTION=" + action + '\0' +
+            "DEVPATH=" + devpath + '\0' + properties;
+        std::replace(m.begin(), m.end(), '\n', '\0');
+        return m;
+    };
+
+    hotplug_serial_number * serial_numbers = NULL;
+    auto convert = [&](const std::string & m)
+    {
+        libusbp_device * device;
+        libusbp::throw_if_needed(hotplug_kernel_uevent_convert(fixture.root.c_str(),
+            &serial_numbers, m.c_str(), m.size() + 1, &event, &device));
+        return libusbp::device(device);
+    };
+
+    SECTION("reports added devices from sysfs")
+    {
+        libusbp::device device = convert(message("add", pci + "/usb1/1-2",
+            "SUBSYSTEM=usb\nDEVTYPE=usb_device\nPRODUCT=1ffb/da01/100"));
+        REQUIRE(device);
+        CHECK(event == LIBUSBP_HOTPLUG_DEVICE_ADDED);
+        CHECK(device.get_os_id() == fixture.root + pci + "/usb1/1-2");
+        CHECK(device.get_serial_number() == "12345678");
+    }
+
+    SECTION("reports removed devices from the message")
+    {
+        libusbp::device device = convert(message("remove", pci + "/usb1/1-5",
+            "SUBSYSTEM=usb\nDEVTYPE=usb_device\nPRODUCT=1ffb/da02/101"));
+        REQUIRE(device);
+        CHECK(event == LIBUSBP_HOTPLUG_DEVICE_REMOVED);
+        CHECK(device.get_os_id() == fixture.root + pci + "/usb1/1-5");
+        CHECK(device.get_product_id() == 0xDA02);
+        CHECK(device.get_revision() == 0x101);
+
+        // The kernel does not tell us the serial number, and we never saw
+        // the device.
+        char * serial_number;
+        libusbp::error error(libusbp_device_get_serial_number(
+            device.pointer_get(), &serial_number));
+        CHECK(error.has_code(LIBUSBP_ERROR_NO_SERIAL_NUMBER));
+    }
+
+    SECTION("remembers the serial numbers of added devices")
+    {
+        std::string remove = message("remove", pci + "/usb1/1-2",
+            "SUBSYSTEM=usb\nDEVTYPE=usb_device\nPRODUCT=1ffb/da01/100");
+
+        REQUIRE(convert(message("add", pci + "/usb1/1-2",
+            "SUBSYSTEM=usb\nDEVTYPE=usb_device\nPRODUCT=1ffb/da01/100")));
+
+        libusbp::device device = convert(remove);
+        REQUIRE(device);
+        CHECK(event == LIBUSBP_HOTPLUG_DEVICE_REMOVED);
+        CHECK(device.get_serial_number() == "12345678");
+
+        // The serial number is forgotten once the device is removed.
+        device = convert(remove);
+        REQUIRE(device);
+        char * serial_number;
+        libusbp::error error(libusbp_device_get_serial_number(
+            device.pointer_get(), &serial_number));
+        CHECK(error.has_code(LIBUSBP_ERROR_NO_SERIAL_NUMBER));
+    }
+
+    SECTION("remembers the serial numbers of devices that were connected")
+    {
+        libusbp::throw_if_needed(hotplug_serial_numbers_fill(
+            fixture.root.c_str(), &serial_numbers));
+
+        libusbp::device device = convert(message("remove", pci + "/usb2/2-1",
+            "SUBSYSTEM=usb\nDEVTYPE=usb_device\nPRODUCT=10c4/ea60/100"));
+        REQUIRE(device);
+        CHECK(device.get_serial_number() == "0001");
+
+        device = convert(message("remove", pci + "/usb1/1-2",
+            "SUBSYSTEM=usb\nDEVTYPE=usb_device\nPRODUCT=1ffb/da01/100"));
+        REQUIRE(device);
+        CHECK(device.get_serial_number() == "12345678");
+    }
+
+    SECTION("reports serial ports as their parent devices")
+    {
+        libusbp::device device = convert(message("add",
+            pci + "/usb2/2-1/2-1:1.0/ttyUSB0/tty/ttyUSB0",
+            "SUBSYSTEM=tty\nMAJOR=188\nMINOR=0\nDEVNAME=ttyUSB0"));
+        REQUIRE(device);
+        CHECK(event == LIBUSBP_HOTPLUG_SERIAL_PORT_ADDED);
+        CHECK(device.get_os_id() == fixture.root + pci + "/usb2/2-1");
+        CHECK(device.get_vendor_id() == 0x10C4);
+    }
+
+    SECTION("skips other events")
+    {
+        CHECK_FALSE(convert(message("add", pci + "/usb1/1-2/1-2:1.0",
+            "SUBSYSTEM=usb\nDEVTYPE=usb_interface")));
+        CHECK_FALSE(convert(message("bind", pci + "/usb1/1-2",
+            "SUBSYSTEM=usb\nDEVTYPE=usb_device\nPRODUCT=1ffb/da01/100")));
+        CHECK_FALSE(convert("libudev\0garbage"));
+        CHECK(event == 0);
+    }
+
+    hotplug_serial_numbers_free(serial_numbers);
+}
+
+#endif
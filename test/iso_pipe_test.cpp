@@ -0,0 +1,145 @@
+#include <test_helper.h>
+
+#ifdef __linux__
+
+TEST_CASE("iso_pipe traits")
+{
+    SECTION("is not copy-constructible")
+    {
+        REQUIRE(std::is_copy_constructible<libusbp::iso_pipe>::value == false);
+    }
+
+    SECTION("is not copy-assignable")
+    {
+        REQUIRE(std::is_copy_assignable<libusbp::iso_pipe>::value == false);
+    }
+}
+
+TEST_CASE("null iso_pipe")
+{
+    libusbp::iso_pipe pipe;
+    std::string expected_message = "Pipe argument is null.";
+
+    SECTION("is not present")
+    {
+        CHECK_FALSE(pipe);
+    }
+
+    SECTION("cannot allocate transfers")
+    {
+        try
+        {
+            pipe.allocate_transfers(4, 8, 192);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot start endless transfers")
+    {
+        try
+        {
+            pipe.start_endless_transfers();
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot submit a transfer")
+    {
+        uint8_t buffer[192] = {0};
+        size_t length = sizeof(buffer);
+        bool submitted = true;
+        libusbp::error error(libusbp_iso_pipe_submit_transfer(
+            NULL, buffer, &length, 1, &submitted));
+        REQUIRE(error.message() == expected_message);
+        REQUIRE_FALSE(submitted);
+    }
+
+    SECTION("cannot handle a finished transfer")
+    {
+        bool finished = true;
+        size_t packet_count = 10;
+        libusbp_error * transfer_error = get_some_error().pointer_release();
+        libusbp::error error(libusbp_iso_pipe_handle_finished_transfer(
+            NULL, &finished, NULL, NULL, &packet_count, &transfer_error));
+        REQUIRE(error.message() == expected_message);
+        REQUIRE_FALSE(finished);
+        REQUIRE(packet_count == 0);
+        REQUIRE(transfer_error == NULL);
+    }
+
+    SECTION("cannot wait")
+    {
+        try
+        {
+            pipe.wait(1);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+
+    SECTION("cannot cancel all transfers")
+    {
+        try
+        {
+            pipe.cancel_transfers();
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == expected_message);
+        }
+    }
+}
+
+#ifdef USE_TEST_DEVICE_A
+
+TEST_CASE("iso_pipe for Test Device A")
+{
+    libusbp::device device = find_test_device_a();
+    libusbp::generic_interface gi(device, 0, true);
+    libusbp::generic_handle handle(gi);
+
+    // Test Device A has no isochronous endpoints, so all we can check is that
+    // the pipe refuses to be opened for its other endpoints.
+
+    SECTION("cannot be opened for an interrupt endpoint")
+    {
+        try
+        {
+            handle.open_iso_pipe(0x82);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Endpoint 0x82 is not an isochronous endpoint.");
+        }
+    }
+
+    SECTION("cannot be opened for endpoint 0")
+    {
+        try
+        {
+            handle.open_iso_pipe(0x80);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Isochronous pipes for endpoint 0 are not supported.");
+        }
+    }
+}
+
+#endif
+
+#endif
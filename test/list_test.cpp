@@ -67,6 +67,151 @@ TEST_CASE("list_connected_devices (C)")
     }
 }
 
+#ifdef __linux__
+TEST_CASE("list_connected_devices with a context")
+{
+    SECTION("can be called many times with the same context")
+    {
+        libusbp::context context = libusbp::context::create();
+        REQUIRE(context);
+        size_t expected_size = libusbp::list_connected_devices().size();
+        for (int i = 0; i < 3; i++)
+        {
+            // A device could be plugged in or removed while this test runs, but
+            // that is unlikely.
+            CHECK(context.list_connected_devices().size() == expected_size);
+        }
+    }
+
+    SECTION("works with a NULL context")
+    {
+        libusbp_device ** list;
+        size_t device_count;
+        libusbp_error * error = libusbp_list_connected_devices_ctx(
+            NULL, &list, &device_count);
+        if (error != NULL) { throw libusbp::error(error); }
+        for (size_t i = 0; i < device_count; i++)
+        {
+            libusbp_device_free(list[i]);
+        }
+        libusbp_list_free(list);
+    }
+
+    SECTION("complains if the context output pointer is NULL")
+    {
+        libusbp::error error(libusbp_context_create(NULL));
+        REQUIRE(error.message() == "Context output pointer is null.");
+    }
+
+    SECTION("complains if the device list output pointer is NULL")
+    {
+        libusbp::context context = libusbp::context::create();
+        size_t device_count = 4444;
+        libusbp::error error(libusbp_list_connected_devices_ctx(
+            context.pointer_get(), NULL, &device_count));
+        REQUIRE(error.message() == "Device list output pointer is null.");
+        REQUIRE(device_count == 0);
+    }
+
+    #ifdef USE_TEST_DEVICE_A
+    SECTION("can find Test Device A and open its interfaces")
+    {
+        libusbp::context context = libusbp::context::create();
+        std::vector<libusbp::device> list = context.list_connected_devices();
+        libusbp::device device;
+        for (auto it = list.begin(); it != list.end(); ++it)
+        {
+            if (it->get_vendor_id() == 0x1FFB && it->get_product_id() == 0xDA01)
+            {
+                device = *it;
+            }
+        }
+        REQUIRE(device);
+
+        libusbp::generic_interface gi = context.create_generic_interface(device, 0, true);
+        REQUIRE(gi);
+        libusbp::generic_interface gi_plain(device, 0, true);
+        CHECK(gi.get_os_filename() == gi_plain.get_os_filename());
+
+        libusbp::serial_port port = context.create_serial_port(device, 2, true);
+        REQUIRE(port);
+        libusbp::serial_port port_plain(device, 2, true);
+        CHECK(port.get_name() == port_plain.get_name());
+    }
+    #endif
+}
+#endif
+
+#ifdef __linux__
+TEST_CASE("list_devices_matching")
+{
+    libusbp_device_filter filter = libusbp_device_filter();
+
+    SECTION("with an empty filter returns every device")
+    {
+        size_t expected_size = libusbp::list_connected_devices().size();
+        CHECK(libusbp::list_devices_matching(filter).size() == expected_size);
+    }
+
+    SECTION("returns nothing if no devices match")
+    {
+        libusbp_vid_pid ids[] = { { 0xABCD, 0x1234 }, { 0xABCE, 0x1234 } };
+        filter.ids = ids;
+        filter.id_count = 2;
+        CHECK(libusbp::list_devices_matching(filter).size() == 0);
+        CHECK_FALSE(libusbp::find_device_matching(filter));
+
+        filter.id_count = 0;
+        filter.serial_number_prefix = "*no such serial number";
+        CHECK(libusbp::list_devices_matching(filter).size() == 0);
+    }
+
+    SECTION("complains if the device list output pointer is NULL")
+    {
+        size_t device_count = 4444;
+        libusbp::error error(libusbp_list_devices_matching(
+            NULL, &filter, NULL, &device_count));
+        REQUIRE(error.message() == "Device list output pointer is null.");
+        REQUIRE(device_count == 0);
+    }
+
+    SECTION("complains if the device output pointer is NULL")
+    {
+        libusbp::error error(libusbp_find_device_matching(NULL, &filter, NULL));
+        REQUIRE(error.message() == "Device output pointer is null.");
+    }
+
+    #ifdef USE_TEST_DEVICE_A
+    SECTION("can find Test Device A")
+    {
+        libusbp::device device = libusbp::find_device_with_vid_pid(0x1FFB, 0xDA01);
+        REQUIRE(device);
+
+        libusbp_vid_pid ids[] = { { 0x1FFB, 0xDA00 }, { 0x1FFB, 0xDA01 } };
+        filter.ids = ids;
+        filter.id_count = 2;
+        std::vector<libusbp::device> list = libusbp::list_devices_matching(filter);
+        REQUIRE(list.size() == 1);
+        CHECK(list[0].get_os_id() == device.get_os_id());
+
+        std::string prefix = device.get_serial_number().substr(0, 3);
+        filter.serial_number_prefix = prefix.c_str();
+        libusbp::device found = libusbp::find_device_matching(filter);
+        REQUIRE(found);
+        CHECK(found.get_os_id() == device.get_os_id());
+
+        // Test Device A is a composite device, so its class is 0xEF.
+        filter.serial_number_prefix = NULL;
+        filter.match_device_class = true;
+        filter.device_class = 0xEF;
+        CHECK(libusbp::find_device_matching(filter));
+        filter.device_class = 0xFF;
+        CHECK_FALSE(libusbp::find_device_matching(filter));
+    }
+    #endif
+}
+#endif
+
 TEST_CASE("find_device_with_vid_pid (C++)")
 {
     #ifdef USE_TEST_DEVICE_A
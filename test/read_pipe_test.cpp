@@ -129,6 +129,36 @@ TEST_CASE("read_pipe (synchronous) on an interrupt endpoint ", "[rpi]")
         REQUIRE(buffer[4 + packet_size] == 0xAB);
     }
 
+    #ifdef __linux__
+    SECTION("can read two packets into several pieces of memory")
+    {
+        // The pieces do not line up with the packets, so the data goes
+        // through a temporary buffer.
+        uint8_t first[3], second[packet_size * 2 - 3];
+        libusbp_iovec iov[] = { { first, sizeof(first) }, { second, sizeof(second) } };
+        handle.read_pipe_v(pipe, iov, 2, &transferred);
+        REQUIRE(transferred == packet_size * 2);
+        REQUIRE(second[4 - 3] == 0xAB);
+        REQUIRE(second[4 + packet_size - 3] == 0xAB);
+    }
+    #endif
+
+    #ifdef __linux__
+    SECTION("does not allow transfer flags on an interrupt endpoint")
+    {
+        try
+        {
+            handle.set_pipe_flags(pipe, LIBUSBP_TRANSFER_SHORT_NOT_OK);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Failed to set pipe flags.  "
+                "Transfer flags are only supported for bulk endpoints.");
+        }
+    }
+    #endif
+
     SECTION("can read without returning the size transferred")
     {
         // But this is bad; you should be checking how many bytes are
@@ -0,0 +1,152 @@
+#include <test_helper.h>
+
+#ifdef __linux__
+
+TEST_CASE("sysfs context")
+{
+    sysfs_fixture fixture;
+    libusbp::context context = libusbp::context::create_sysfs(fixture.root.c_str());
+
+    SECTION("complains if the output pointer is null")
+    {
+        libusbp::error error(libusbp_context_create_sysfs(NULL, NULL));
+        REQUIRE(error.message() == "Context output pointer is null.");
+    }
+
+    SECTION("complains if the root does not exist")
+    {
+        libusbp_context * ctx = (libusbp_context *)1;
+        std::string root = fixture.root + "/missing";
+        libusbp::error error(libusbp_context_create_sysfs(root.c_str(), &ctx));
+        REQUIRE(error.message().find("Failed to find sysfs root") == 0);
+        REQUIRE(ctx == NULL);
+    }
+
+    SECTION("lists the devices in order")
+    {
+        std::vector<libusbp::device> list = context.list_connected_devices();
+        REQUIRE(list.size() == 4);
+        std::string pci = fixture.root + "/devices/pci0000:00/0000:00:14.0";
+        CHECK(list[0].get_os_id() == pci + "/usb1");
+        CHECK(list[1].get_os_id() == pci + "/usb1/1-2");
+        CHECK(list[2].get_os_id() == pci + "/usb2");
+        CHECK(list[3].get_os_id() == pci + "/usb2/2-1");
+    }
+
+    SECTION("reads the device information")
+    {
+        std::vector<libusbp::device> list = context.list_connected_devices();
+        libusbp::device device = find_in_list(list, "/1-2");
+        REQUIRE(device);
+        CHECK(device.get_vendor_id() == 0x1FFB);
+        CHECK(device.get_product_id() == 0xDA01);
+        CHECK(device.get_revision() == 0x100);
+        CHECK(device.get_serial_number() == "12345678");
+
+        libusbp::device hub = find_in_list(list, "/usb1");
+        REQUIRE(hub);
+        CHECK(hub.get_vendor_id() == 0x1D6B);
+        char * serial_number;
+        libusbp::error error(libusbp_device_get_serial_number(
+            hub.pointer_get(), &serial_number));
+        CHECK(error.message() == "Device does not have a serial number.");
+    }
+
+    SECTION("applies filters")
+    {
+        libusbp_device_filter filter = {};
+
+        libusbp_vid_pid id = { 0x1FFB, 0xDA01 };
+        filter.ids = &id;
+        filter.id_count = 1;
+        std::vector<libusbp::device> list = context.list_devices_matching(filter);
+        REQUIRE(list.size() == 1);
+        CHECK(list[0].get_serial_number() == "12345678");
+
+        filter = {};
+        filter.serial_number_prefix = "000";
+        list = context.list_devices_matching(filter);
+        REQUIRE(list.size() == 1);
+        CHECK(list[0].get_product_id() == 0xEA60);
+
+        filter = {};
+        filter.bus_number = 2;
+        list = context.list_devices_matching(filter);
+        CHECK(list.size() == 2);
+
+        filter = {};
+        filter.match_device_class = true;
+        filter.device_class = 0xEF;
+        libusbp::device device = context.find_device_matching(filter);
+        REQUIRE(device);
+        CHECK(device.get_vendor_id() == 0x1FFB);
+    }
+
+    SECTION("finds a CDC ACM port")
+    {
+        libusbp::device device = find_in_list(context.list_connected_devices(), "/1-2");
+        libusbp::serial_port port = context.create_serial_port(device, 2, true);
+        CHECK(port.get_name() == "/dev/ttyACM0");
+    }
+
+    SECTION("finds a USB serial converter port")
+    {
+        libusbp::device device = find_in_list(context.list_connected_devices(), "/2-1");
+        libusbp::serial_port port = context.create_serial_port(device, 0, false);
+        CHECK(port.get_name() == "/dev/ttyUSB0");
+    }
+
+    SECTION("reports interfaces without a port as not ready")
+    {
+        libusbp::device device = find_in_list(context.list_connected_devices(), "/1-2");
+        libusbp_serial_port * port;
+        libusbp::error error(libusbp_serial_port_create_ctx(context.pointer_get(),
+            device.pointer_get(), 0, true, &port));
+        REQUIRE(error.message() == "Could not find tty device.");
+        CHECK(error.has_code(LIBUSBP_ERROR_NOT_READY));
+    }
+
+    SECTION("reports missing interfaces as not ready")
+    {
+        libusbp::device device = find_in_list(context.list_connected_devices(), "/1-2");
+        libusbp_serial_port * port;
+        libusbp::error error(libusbp_serial_port_create_ctx(context.pointer_get(),
+            device.pointer_get(), 5, true, &port));
+        REQUIRE(error.message() == "Could not find interface 5.");
+        CHECK(error.has_code(LIBUSBP_ERROR_NOT_READY));
+    }
+
+    SECTION("checks the driver of a generic interface")
+    {
+        libusbp::device device = find_in_list(context.list_connected_devices(), "/1-2");
+        libusbp_generic_interface * gi;
+        libusbp::error error(libusbp_generic_interface_create_ctx(
+            context.pointer_get(), device.pointer_get(), 2, true, &gi));
+        REQUIRE(error.message() == "Failed to initialize generic interface.  "
+            "Device is attached to an incorrect driver: cdc_acm.");
+    }
+
+    SECTION("fills a device index")
+    {
+        libusbp::device_index index = libusbp::device_index::create(context);
+        CHECK(index.get_count() == 4);
+        libusbp::device device = index.find(0x10C4, 0xEA60, "0001");
+        REQUIRE(device);
+        CHECK(device.get_os_id() == find_in_list(
+            context.list_connected_devices(), "/2-1").get_os_id());
+    }
+}
+
+TEST_CASE("sysfs_uevent_get")
+{
+    const char message[] = "add@/devices/usb1/1-2\0ACTION=add\0"
+        "SUBSYSTEM=usb\0PRODUCT=1ffb/da01/100";
+    size_t size = sizeof(message);
+
+    CHECK(std::string(sysfs_uevent_get(message, size, "ACTION")) == "add");
+    CHECK(std::string(sysfs_uevent_get(message, size, "PRODUCT")) == "1ffb/da01/100");
+    CHECK(sysfs_uevent_get(message, size, "SUBSYS") == NULL);
+    CHECK(sysfs_uevent_get(message, size, "DEVTYPE") == NULL);
+}
+
+#endif
@@ -76,3 +76,142 @@ inline libusbp::error get_some_error()
 {
     return libusbp::error(libusbp_device_copy(NULL, NULL));
 }
+
+#ifdef __linux__
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+// Builds a small sysfs tree in a temporary directory that looks like this:
+//
+//   usb1: a root hub on bus 1
+//   1-2: a composite device on bus 1 with a CDC ACM port on interface 2
+//   usb2: a root hub on bus 2
+//   2-1: a USB serial converter on bus 2 with a port on interface 0
+class sysfs_fixture
+{
+public:
+    sysfs_fixture()
+    {
+        char dir[] = "/tmp/libusbp_sysfs_XXXXXX";
+        REQUIRE(mkdtemp(dir) != NULL);
+        char * resolved = realpath(dir, NULL);
+        REQUIRE(resolved != NULL);
+        root = resolved;
+        free(resolved);
+
+        std::string pci = "/devices/pci0000:00/0000:00:14.0";
+        mkdir_p("/bus/usb/devices");
+        mkdir_p("/bus/usb/drivers/cdc_acm");
+
+        add_device(pci + "/usb1", "1d6b/2/606", "9/0/0", 1, 1, "");
+        add_device(pci + "/usb1/1-2", "1ffb/da01/100", "239/2/1", 1, 7, "12345678");
+        add_interface(pci + "/usb1/1-2/1-2:1.0", 0);
+        add_interface(pci + "/usb1/1-2/1-2:1.2", 2);
+        write(pci + "/usb1/1-2/1-2:1.2/tty/ttyACM0/uevent",
+            "MAJOR=166\nMINOR=0\nDEVNAME=ttyACM0\n");
+        link(pci + "/usb1/1-2/1-2:1.2/driver", "/bus/usb/drivers/cdc_acm");
+
+        add_device(pci + "/usb2", "1d6b/3/606", "9/0/0", 2, 1, "");
+        add_device(pci + "/usb2/2-1", "10c4/ea60/100", "0/0/0", 2, 3, "0001");
+        add_interface(pci + "/usb2/2-1/2-1:1.0", 0);
+        write(pci + "/usb2/2-1/2-1:1.0/ttyUSB0/tty/ttyUSB0/uevent",
+            "MAJOR=188\nMINOR=0\nDEVNAME=ttyUSB0\n");
+    }
+
+    ~sysfs_fixture()
+    {
+        nftw(root.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    std::string root;
+
+private:
+    static int remove_entry(const char * path, const struct stat *, int,
+        struct FTW *)
+    {
+        return remove(path);
+    }
+
+    void mkdir_p(const std::string & path)
+    {
+        std::string full = root;
+        size_t start = 1;
+        while (true)
+        {
+            size_t slash = path.find('/', start);
+            full = root + path.substr(0, slash);
+            mkdir(full.c_str(), 0755);
+            if (slash == std::string::npos) { break; }
+            start = slash + 1;
+        }
+    }
+
+    void write(const std::string & path, const std::string & contents)
+    {
+        mkdir_p(path.substr(0, path.rfind('/')));
+        std::ofstream file(root + path);
+        file << contents;
+    }
+
+    // Makes a relative symbolic link, like the ones in sysfs.
+    void link(const std::string & from, const std::string & to)
+    {
+        size_t depth = std::count(from.begin(), from.end(), '/') - 1;
+        std::string target;
+        for (size_t i = 0; i < depth; i++) { target += "../"; }
+        target += to.substr(1);
+        REQUIRE(symlink(target.c_str(), (root + from).c_str()) == 0);
+    }
+
+    void add_device(const std::string & path, const std::string & product,
+        const std::string & type, int bus, int dev, const std::string & serial)
+    {
+        char devname[32];
+        snprintf(devname, sizeof(devname), "bus/usb/%03d/%03d", bus, dev);
+        char busnum[8];
+        snprintf(busnum, sizeof(busnum), "%03d", bus);
+
+        write(path + "/uevent", "DEVNAME=" + std::string(devname) +
+            "\nDEVTYPE=usb_device\nDRIVER=usb\nPRODUCT=" + product +
+            "\nTYPE=" + type + "\nBUSNUM=" + busnum + "\n");
+        write(path + "/bConfigurationValue", "1\n");
+        if (serial.size())
+        {
+            write(path + "/serial", serial + "\n");
+        }
+        std::string name = path.substr(path.rfind('/') + 1);
+        link("/bus/usb/devices/" + name, path);
+    }
+
+    void add_interface(const std::string & path, int number)
+    {
+        char str[8];
+        snprintf(str, sizeof(str), "%02x\n", number);
+        write(path + "/uevent", "DEVTYPE=usb_interface\nDRIVER=usbfs\n");
+        write(path + "/bInterfaceNumber", str);
+        std::string name = path.substr(path.rfind('/') + 1);
+        link("/bus/usb/devices/" + name, path);
+    }
+};
+
+inline libusbp::device find_in_list(const std::vector<libusbp::device> & list,
+    const std::string & suffix)
+{
+    for (const libusbp::device & device : list)
+    {
+        std::string id = device.get_os_id();
+        if (id.size() >= suffix.size() &&
+            id.compare(id.size() - suffix.size(), suffix.size(), suffix) == 0)
+        {
+            return device;
+        }
+    }
+    return libusbp::device();
+}
+
+#endif
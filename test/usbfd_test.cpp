@@ -17,4 +17,98 @@ TEST_CASE("usbfd_check_existence")
     }
 }
 
+TEST_CASE("usbfd_get_endpoint_info")
+{
+    // A device descriptor and a configuration with two interfaces.  Interface
+    // 0 has an interrupt IN endpoint, a bulk OUT endpoint, and an isochronous
+    // IN endpoint in alternate setting 0, and makes endpoint 0x83 a bulk
+    // endpoint in alternate setting 1.  Interface 1 has an interrupt endpoint
+    // in alternate setting 0 and a bulk endpoint in alternate setting 1.  A
+    // second configuration describes endpoint 0x81 differently.
+    const uint8_t descriptors[] = {
+        18, 1, 0x00, 0x02, 0, 0, 0, 64, 0xFB, 0x1F, 0x01, 0xDA, 0, 1, 1, 2, 3, 2,
+        9, 2, 89, 0, 2, 1, 0, 0x80, 50,
+        9, 4, 0, 0, 3, 0xFF, 0, 0, 0,
+        7, 5, 0x81, 3, 8, 0, 1,
+        7, 5, 0x02, 2, 64, 0, 0,
+        9, 5, 0x83, 1, 192, 0, 1, 0, 0,
+        9, 4, 0, 1, 1, 0xFF, 0, 0, 0,
+        7, 5, 0x83, 2, 0, 2, 0,
+        9, 4, 1, 0, 1, 0xFF, 0, 0, 0,
+        7, 5, 0x84, 3, 16, 0, 1,
+        9, 4, 1, 1, 1, 0xFF, 0, 0, 0,
+        7, 5, 0x84, 2, 64, 0, 0,
+        9, 2, 25, 0, 1, 2, 0, 0x80, 50,
+        9, 4, 0, 0, 1, 0xFF, 0, 0, 0,
+        7, 5, 0x81, 2, 64, 0, 0,
+    };
+
+    char filename[] = "/tmp/libusbp_test_XXXXXX";
+    int fd = mkstemp(filename);
+    REQUIRE(fd != -1);
+    unlink(filename);
+    REQUIRE(write(fd, descriptors, sizeof(descriptors)) == sizeof(descriptors));
+
+    uint8_t in_types[MAX_ENDPOINT_NUMBER + 1];
+    uint8_t out_types[MAX_ENDPOINT_NUMBER + 1];
+    uint16_t in_sizes[MAX_ENDPOINT_NUMBER + 1];
+    uint16_t out_sizes[MAX_ENDPOINT_NUMBER + 1];
+
+    SECTION("reads the active configuration")
+    {
+        libusbp::error error(usbfd_get_endpoint_info(fd, 1, 0, 0,
+            in_types, out_types, in_sizes, out_sizes));
+        REQUIRE_FALSE(error);
+
+        CHECK(in_types[1] == USB_ENDPOINT_XFER_INT);
+        CHECK(out_types[2] == USB_ENDPOINT_XFER_BULK);
+        CHECK(in_types[3] == USB_ENDPOINT_XFER_ISOC);
+        CHECK(in_types[4] == USB_ENDPOINT_XFER_INT);
+        CHECK(in_types[2] == ENDPOINT_TYPE_UNKNOWN);
+        CHECK(out_types[1] == ENDPOINT_TYPE_UNKNOWN);
+
+        CHECK(in_sizes[1] == 8);
+        CHECK(out_sizes[2] == 64);
+        CHECK(in_sizes[3] == 192);
+        CHECK(in_sizes[4] == 16);
+        CHECK(in_sizes[2] == 0);
+    }
+
+    SECTION("uses the first configuration if the active one is not known")
+    {
+        libusbp::error error(usbfd_get_endpoint_info(fd, 0, 0, 0,
+            in_types, out_types, in_sizes, out_sizes));
+        REQUIRE_FALSE(error);
+        CHECK(in_types[1] == USB_ENDPOINT_XFER_INT);
+        CHECK(in_sizes[1] == 8);
+    }
+
+    SECTION("ignores other configurations")
+    {
+        libusbp::error error(usbfd_get_endpoint_info(fd, 2, 0, 0,
+            in_types, out_types, in_sizes, out_sizes));
+        REQUIRE_FALSE(error);
+        CHECK(in_types[1] == USB_ENDPOINT_XFER_BULK);
+        CHECK(in_sizes[1] == 64);
+        CHECK(out_types[2] == ENDPOINT_TYPE_UNKNOWN);
+        CHECK(in_types[3] == ENDPOINT_TYPE_UNKNOWN);
+    }
+
+    SECTION("uses the alternate setting of the interface")
+    {
+        libusbp::error error(usbfd_get_endpoint_info(fd, 1, 0, 1,
+            in_types, out_types, in_sizes, out_sizes));
+        REQUIRE_FALSE(error);
+        CHECK(in_types[3] == USB_ENDPOINT_XFER_BULK);
+        CHECK(in_sizes[3] == 512);
+        CHECK(in_types[1] == ENDPOINT_TYPE_UNKNOWN);
+        CHECK(out_types[2] == ENDPOINT_TYPE_UNKNOWN);
+
+        // Other interfaces are assumed to use alternate setting 0.
+        CHECK(in_types[4] == USB_ENDPOINT_XFER_INT);
+    }
+
+    close(fd);
+}
+
 #endif
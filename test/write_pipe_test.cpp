@@ -120,6 +120,104 @@ TEST_CASE("write_pipe (synchronous) on a bulk endpoint ", "[wpi]")
         // we did not send any zero-length packets at the end.
     }
 
+    SECTION("can write a transfer that is split into several URBs")
+    {
+        // Every 32-byte packet sets the device's data buffer, so the last one
+        // to arrive determines what we read back.
+        const size_t size = 32 * 2048;
+        std::vector<uint8_t> buffer(size);
+        for (size_t i = 0; i < size; i += 32)
+        {
+            buffer[i] = 0x92;
+            buffer[i + 1] = (i + 32 == size) ? 0x77 : 0x76;
+        }
+        handle.set_timeout(pipe, 2000);
+        handle.write_pipe(pipe, buffer.data(), size, &transferred);
+        REQUIRE(transferred == size);
+
+        uint8_t buffer2[1];
+        handle.control_transfer(0xC0, 0x91, 0, 1, buffer2, 1, &transferred);
+        REQUIRE(transferred == 1);
+        REQUIRE(buffer2[0] == 0x77);
+    }
+
+    #ifdef __linux__
+    SECTION("can write one packet from several pieces of memory")
+    {
+        // The pieces are smaller than a packet, so they get copied into one
+        // packet instead of being sent as two short packets.
+        uint8_t command[1] = { 0x92 };
+        uint8_t value[31] = { 0x88 };
+        libusbp_iovec iov[] = { { command, sizeof(command) }, { value, sizeof(value) } };
+        handle.write_pipe_v(pipe, iov, 2, &transferred);
+        REQUIRE(transferred == 32);
+
+        uint8_t buffer2[1];
+        handle.control_transfer(0xC0, 0x91, 0, 1, buffer2, 1, &transferred);
+        REQUIRE(transferred == 1);
+        REQUIRE(buffer2[0] == 0x88);
+    }
+
+    SECTION("can write packets directly from several pieces of memory")
+    {
+        uint8_t first[32] = { 0x92, 0x98 };
+        uint8_t second[32] = { 0x92, 0x99 };
+        libusbp_iovec iov[] = { { first, sizeof(first) }, { second, sizeof(second) } };
+        handle.write_pipe_v(pipe, iov, 2, &transferred);
+        REQUIRE(transferred == 64);
+
+        uint8_t buffer2[1];
+        handle.control_transfer(0xC0, 0x91, 0, 1, buffer2, 1, &transferred);
+        REQUIRE(transferred == 1);
+        REQUIRE(buffer2[0] == 0x99);
+    }
+
+    SECTION("can send a zero-length packet after a full transfer")
+    {
+        uint8_t buffer[32] = { 0x92, 0x47 };
+        handle.write_pipe_with_flags(pipe, buffer, sizeof(buffer),
+            LIBUSBP_TRANSFER_ZERO_PACKET, &transferred);
+        REQUIRE(transferred == sizeof(buffer));
+
+        // Expect dataBuffer to contain 0x66 from the zero-length packet.
+        uint8_t buffer2[1];
+        handle.control_transfer(0xC0, 0x91, 0, 1, buffer2, 1, &transferred);
+        REQUIRE(transferred == 1);
+        REQUIRE(buffer2[0] == 0x66);
+    }
+
+    SECTION("rejects flags that are only valid for IN pipes")
+    {
+        uint8_t buffer[32] = { 0x92, 0x47 };
+        try
+        {
+            handle.write_pipe_with_flags(pipe, buffer, sizeof(buffer),
+                LIBUSBP_TRANSFER_SHORT_NOT_OK, &transferred);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Failed to write to pipe.  "
+                "The short-not-OK and bulk continuation flags are only valid "
+                "for IN pipes.");
+        }
+    }
+
+    SECTION("write_pipe_v requires the buffer array to be non-NULL")
+    {
+        try
+        {
+            handle.write_pipe_v(pipe, NULL, 2, &transferred);
+            REQUIRE(0);
+        }
+        catch(const libusbp::error & error)
+        {
+            REQUIRE(error.message() == "Failed to write to pipe.  "
+                "Buffer array is null.");
+        }
+    }
+    #endif
+
     SECTION("can send zero-length trasnfers")
     {
         handle.write_pipe(pipe, NULL, 0, NULL);